@@ -25,3 +25,8 @@ CREATE OR REPLACE FUNCTION _timescaledb_internal.refresh_continuous_aggregate(
     continuous_aggregate     REGCLASS,
     hypertable_chunk         REGCLASS
 ) RETURNS VOID AS '@MODULE_PATHNAME@', 'ts_continuous_agg_refresh_chunk' LANGUAGE C VOLATILE;
+
+-- Check a value against the bloom filter metadata of a compressed batch. Used
+-- in conditions pushed down to compressed chunks.
+CREATE OR REPLACE FUNCTION _timescaledb_internal.bloom1_contains(bloom BYTEA, value ANYELEMENT) RETURNS BOOL
+AS '@MODULE_PATHNAME@', 'ts_bloom1_contains' LANGUAGE C IMMUTABLE PARALLEL SAFE;
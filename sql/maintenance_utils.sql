@@ -28,3 +28,19 @@ CREATE OR REPLACE FUNCTION decompress_chunk(
     uncompressed_chunk REGCLASS,
     if_compressed BOOLEAN = false
 ) RETURNS REGCLASS AS '@MODULE_PATHNAME@', 'ts_decompress_chunk' LANGUAGE C STRICT VOLATILE;
+
+CREATE OR REPLACE FUNCTION recompress_chunk(
+    uncompressed_chunk REGCLASS,
+    if_not_compressed BOOLEAN = false
+) RETURNS REGCLASS AS '@MODULE_PATHNAME@', 'ts_recompress_chunk' LANGUAGE C STRICT VOLATILE;
+
+-- Trial compress a sample of the chunk with every combination of the
+-- segmentby and orderby candidates without writing anything
+CREATE OR REPLACE FUNCTION compression_advisor(
+    chunk REGCLASS,
+    segmentby_candidates TEXT[] = NULL,
+    orderby_candidates TEXT[] = NULL,
+    sample_size INTEGER = 10000
+) RETURNS TABLE(segmentby TEXT, orderby TEXT, compression_ratio FLOAT8, batch_fill_rate FLOAT8,
+    decompression_rows_per_second FLOAT8)
+AS '@MODULE_PATHNAME@', 'ts_compression_advisor' LANGUAGE C VOLATILE;
@@ -352,6 +352,43 @@ CREATE TABLE IF NOT EXISTS _timescaledb_catalog.compression_chunk_size (
 
 SELECT pg_catalog.pg_extension_config_dump('_timescaledb_catalog.compression_chunk_size', '');
 
+-- Rows per compressed batch for hypertables that do not use the default of
+-- 1000 rows. A non-zero target_batch_bytes sizes batches adaptively toward
+-- that many bytes of compressed data, with batch_size as the upper bound.
+CREATE TABLE IF NOT EXISTS _timescaledb_catalog.hypertable_compression_batch (
+  hypertable_id integer PRIMARY KEY REFERENCES _timescaledb_catalog.hypertable (id) ON DELETE CASCADE,
+  batch_size integer NOT NULL CHECK (batch_size > 0),
+  target_batch_bytes integer NOT NULL DEFAULT 0 CHECK (target_batch_bytes >= 0)
+);
+
+SELECT pg_catalog.pg_extension_config_dump('_timescaledb_catalog.hypertable_compression_batch', '');
+
+-- Block compression codec of columns that compress the output of the array or
+-- dictionary algorithm further: 1 for LZ4, 2 for Zstd.
+CREATE TABLE IF NOT EXISTS _timescaledb_catalog.hypertable_compression_codec (
+  hypertable_id integer REFERENCES _timescaledb_catalog.hypertable (id) ON DELETE CASCADE,
+  attname name NOT NULL,
+  codec smallint NOT NULL CHECK (codec IN (1, 2)),
+  PRIMARY KEY (hypertable_id, attname)
+);
+
+SELECT pg_catalog.pg_extension_config_dump('_timescaledb_catalog.hypertable_compression_codec', '');
+
+-- Dictionaries shared by the batches of a column of a compressed chunk. The
+-- batches reference their dictionary by id and only store the codes of their
+-- values. The dictionary is stored in the format of the array algorithm.
+CREATE TABLE IF NOT EXISTS _timescaledb_catalog.compression_chunk_dictionary (
+  id serial PRIMARY KEY,
+  compressed_chunk_id integer NOT NULL REFERENCES _timescaledb_catalog.chunk (id) ON DELETE CASCADE,
+  dictionary bytea NOT NULL
+);
+
+CREATE INDEX IF NOT EXISTS compression_chunk_dictionary_compressed_chunk_id_idx
+ON _timescaledb_catalog.compression_chunk_dictionary (compressed_chunk_id);
+
+SELECT pg_catalog.pg_extension_config_dump('_timescaledb_catalog.compression_chunk_dictionary', '');
+SELECT pg_catalog.pg_extension_config_dump(pg_get_serial_sequence('_timescaledb_catalog.compression_chunk_dictionary', 'id'), '');
+
 --This stores commit decisions for 2pc remote txns. Abort decisions are never stored.
 --If a PREPARE TRANSACTION fails for any data node then the entire
 --frontend transaction will be rolled back and no rows will be stored.
@@ -383,3 +420,10 @@ GRANT SELECT ON ALL SEQUENCES IN SCHEMA _timescaledb_catalog TO PUBLIC;
 GRANT SELECT ON ALL SEQUENCES IN SCHEMA _timescaledb_config TO PUBLIC;
 
 GRANT SELECT ON ALL SEQUENCES IN SCHEMA _timescaledb_internal TO PUBLIC;
+
+-- The shared compression dictionaries contain the values of the compressed
+-- columns and would bypass the permissions of the hypertables if readable by
+-- everyone. They are only read through the catalog scanner.
+REVOKE SELECT ON _timescaledb_catalog.compression_chunk_dictionary FROM PUBLIC;
+
+REVOKE SELECT ON SEQUENCE _timescaledb_catalog.compression_chunk_dictionary_id_seq FROM PUBLIC;
@@ -89,3 +89,44 @@ GRANT SELECT ON _timescaledb_catalog.chunk_id_seq TO PUBLIC;
 GRANT SELECT ON _timescaledb_catalog.chunk TO PUBLIC;
 
 -- end recreate _timescaledb_catalog.chunk table --
+
+CREATE TABLE IF NOT EXISTS _timescaledb_catalog.hypertable_compression_batch (
+  hypertable_id integer PRIMARY KEY REFERENCES _timescaledb_catalog.hypertable (id) ON DELETE CASCADE,
+  batch_size integer NOT NULL CHECK (batch_size > 0),
+  target_batch_bytes integer NOT NULL DEFAULT 0 CHECK (target_batch_bytes >= 0)
+);
+
+SELECT pg_catalog.pg_extension_config_dump('_timescaledb_catalog.hypertable_compression_batch', '');
+GRANT SELECT ON _timescaledb_catalog.hypertable_compression_batch TO PUBLIC;
+
+CREATE TABLE IF NOT EXISTS _timescaledb_catalog.hypertable_compression_codec (
+  hypertable_id integer REFERENCES _timescaledb_catalog.hypertable (id) ON DELETE CASCADE,
+  attname name NOT NULL,
+  codec smallint NOT NULL CHECK (codec IN (1, 2)),
+  PRIMARY KEY (hypertable_id, attname)
+);
+
+SELECT pg_catalog.pg_extension_config_dump('_timescaledb_catalog.hypertable_compression_codec', '');
+GRANT SELECT ON _timescaledb_catalog.hypertable_compression_codec TO PUBLIC;
+
+CREATE TABLE IF NOT EXISTS _timescaledb_catalog.compression_chunk_dictionary (
+  id serial PRIMARY KEY,
+  compressed_chunk_id integer NOT NULL REFERENCES _timescaledb_catalog.chunk (id) ON DELETE CASCADE,
+  dictionary bytea NOT NULL
+);
+
+CREATE INDEX IF NOT EXISTS compression_chunk_dictionary_compressed_chunk_id_idx
+ON _timescaledb_catalog.compression_chunk_dictionary (compressed_chunk_id);
+
+SELECT pg_catalog.pg_extension_config_dump('_timescaledb_catalog.compression_chunk_dictionary', '');
+SELECT pg_catalog.pg_extension_config_dump(pg_get_serial_sequence('_timescaledb_catalog.compression_chunk_dictionary', 'id'), '');
+-- not readable by PUBLIC since the dictionaries contain column values, the
+-- REVOKE gives the same ACL as on a new installation
+REVOKE SELECT ON _timescaledb_catalog.compression_chunk_dictionary FROM PUBLIC;
+REVOKE SELECT ON SEQUENCE _timescaledb_catalog.compression_chunk_dictionary_id_seq FROM PUBLIC;
+
+INSERT INTO _timescaledb_catalog.compression_algorithm( id, version, name, description) VALUES
+( 5, 1, 'COMPRESSION_ALGORITHM_FOR', 'frame-of-reference'),
+( 6, 1, 'COMPRESSION_ALGORITHM_ALP', 'alp'),
+( 7, 1, 'COMPRESSION_ALGORITHM_BLOCK', 'block'),
+( 8, 1, 'COMPRESSION_ALGORITHM_SHARED_DICTIONARY', 'shared dictionary');
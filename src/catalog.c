@@ -99,6 +99,18 @@ static const TableInfoDef catalog_table_names[_MAX_CATALOG_TABLES + 1] = {
 		.schema_name = CATALOG_SCHEMA_NAME,
 		.table_name = COMPRESSION_CHUNK_SIZE_TABLE_NAME,
 	},
+	[HYPERTABLE_COMPRESSION_BATCH] = {
+		.schema_name = CATALOG_SCHEMA_NAME,
+		.table_name = HYPERTABLE_COMPRESSION_BATCH_TABLE_NAME,
+	},
+	[HYPERTABLE_COMPRESSION_CODEC] = {
+		.schema_name = CATALOG_SCHEMA_NAME,
+		.table_name = HYPERTABLE_COMPRESSION_CODEC_TABLE_NAME,
+	},
+	[COMPRESSION_CHUNK_DICTIONARY] = {
+		.schema_name = CATALOG_SCHEMA_NAME,
+		.table_name = COMPRESSION_CHUNK_DICTIONARY_TABLE_NAME,
+	},
 	[REMOTE_TXN] = {
 		.schema_name = CATALOG_SCHEMA_NAME,
 		.table_name = REMOTE_TXN_TABLE_NAME,
@@ -239,6 +251,25 @@ static const TableIndexDef catalog_table_index_definitions[_MAX_CATALOG_TABLES]
 			[COMPRESSION_CHUNK_SIZE_PKEY] = "compression_chunk_size_pkey",
 		},
 	},
+	[HYPERTABLE_COMPRESSION_BATCH] = {
+		.length =  _MAX_HYPERTABLE_COMPRESSION_BATCH_INDEX,
+		.names = (char *[]) {
+			[HYPERTABLE_COMPRESSION_BATCH_PKEY] = "hypertable_compression_batch_pkey",
+		},
+	},
+	[HYPERTABLE_COMPRESSION_CODEC] = {
+		.length =  _MAX_HYPERTABLE_COMPRESSION_CODEC_INDEX,
+		.names = (char *[]) {
+			[HYPERTABLE_COMPRESSION_CODEC_PKEY] = "hypertable_compression_codec_pkey",
+		},
+	},
+	[COMPRESSION_CHUNK_DICTIONARY] = {
+		.length =  _MAX_COMPRESSION_CHUNK_DICTIONARY_INDEX,
+		.names = (char *[]) {
+			[COMPRESSION_CHUNK_DICTIONARY_PKEY] = "compression_chunk_dictionary_pkey",
+			[COMPRESSION_CHUNK_DICTIONARY_COMPRESSED_CHUNK_ID_IDX] = "compression_chunk_dictionary_compressed_chunk_id_idx",
+		},
+	},
 	[REMOTE_TXN] = {
 		.length = _MAX_REMOTE_TXN_INDEX,
 		.names = (char *[]) {
@@ -265,6 +296,9 @@ static const char *catalog_table_serial_id_names[_MAX_CATALOG_TABLES] = {
 	[CONTINUOUS_AGGS_MATERIALIZATION_INVALIDATION_LOG] = NULL,
 	[HYPERTABLE_COMPRESSION] = NULL,
 	[COMPRESSION_CHUNK_SIZE] = NULL,
+	[HYPERTABLE_COMPRESSION_BATCH] = NULL,
+	[HYPERTABLE_COMPRESSION_CODEC] = NULL,
+	[COMPRESSION_CHUNK_DICTIONARY] = CATALOG_SCHEMA_NAME ".compression_chunk_dictionary_id_seq",
 	[REMOTE_TXN] = NULL,
 };
 
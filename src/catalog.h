@@ -52,6 +52,9 @@ typedef enum CatalogTable
 	CONTINUOUS_AGGS_MATERIALIZATION_INVALIDATION_LOG,
 	HYPERTABLE_COMPRESSION,
 	COMPRESSION_CHUNK_SIZE,
+	HYPERTABLE_COMPRESSION_BATCH,
+	HYPERTABLE_COMPRESSION_CODEC,
+	COMPRESSION_CHUNK_DICTIONARY,
 	REMOTE_TXN,
 	_MAX_CATALOG_TABLES,
 } CatalogTable;
@@ -1127,6 +1130,102 @@ typedef enum Anum_compression_chunk_size_pkey
 
 #define Natts_compression_chunk_size_pkey (_Anum_compression_chunk_size_pkey_max - 1)
 
+#define HYPERTABLE_COMPRESSION_BATCH_TABLE_NAME "hypertable_compression_batch"
+typedef enum Anum_hypertable_compression_batch
+{
+	Anum_hypertable_compression_batch_hypertable_id = 1,
+	Anum_hypertable_compression_batch_batch_size,
+	Anum_hypertable_compression_batch_target_batch_bytes,
+	_Anum_hypertable_compression_batch_max,
+} Anum_hypertable_compression_batch;
+
+#define Natts_hypertable_compression_batch (_Anum_hypertable_compression_batch_max - 1)
+
+typedef struct FormData_hypertable_compression_batch
+{
+	int32 hypertable_id;
+	int32 batch_size;
+	int32 target_batch_bytes;
+} FormData_hypertable_compression_batch;
+
+typedef FormData_hypertable_compression_batch *Form_hypertable_compression_batch;
+
+enum
+{
+	HYPERTABLE_COMPRESSION_BATCH_PKEY = 0,
+	_MAX_HYPERTABLE_COMPRESSION_BATCH_INDEX,
+};
+typedef enum Anum_hypertable_compression_batch_pkey
+{
+	Anum_hypertable_compression_batch_pkey_hypertable_id = 1,
+	_Anum_hypertable_compression_batch_pkey_max,
+} Anum_hypertable_compression_batch_pkey;
+
+#define Natts_hypertable_compression_batch_pkey (_Anum_hypertable_compression_batch_pkey_max - 1)
+
+#define HYPERTABLE_COMPRESSION_CODEC_TABLE_NAME "hypertable_compression_codec"
+typedef enum Anum_hypertable_compression_codec
+{
+	Anum_hypertable_compression_codec_hypertable_id = 1,
+	Anum_hypertable_compression_codec_attname,
+	Anum_hypertable_compression_codec_codec,
+	_Anum_hypertable_compression_codec_max,
+} Anum_hypertable_compression_codec;
+
+#define Natts_hypertable_compression_codec (_Anum_hypertable_compression_codec_max - 1)
+
+typedef struct FormData_hypertable_compression_codec
+{
+	int32 hypertable_id;
+	NameData attname;
+	int16 codec;
+} FormData_hypertable_compression_codec;
+
+typedef FormData_hypertable_compression_codec *Form_hypertable_compression_codec;
+
+enum
+{
+	HYPERTABLE_COMPRESSION_CODEC_PKEY = 0,
+	_MAX_HYPERTABLE_COMPRESSION_CODEC_INDEX,
+};
+typedef enum Anum_hypertable_compression_codec_pkey
+{
+	Anum_hypertable_compression_codec_pkey_hypertable_id = 1,
+	Anum_hypertable_compression_codec_pkey_attname,
+	_Anum_hypertable_compression_codec_pkey_max,
+} Anum_hypertable_compression_codec_pkey;
+
+#define Natts_hypertable_compression_codec_pkey (_Anum_hypertable_compression_codec_pkey_max - 1)
+
+#define COMPRESSION_CHUNK_DICTIONARY_TABLE_NAME "compression_chunk_dictionary"
+typedef enum Anum_compression_chunk_dictionary
+{
+	Anum_compression_chunk_dictionary_id = 1,
+	Anum_compression_chunk_dictionary_compressed_chunk_id,
+	Anum_compression_chunk_dictionary_dictionary,
+	_Anum_compression_chunk_dictionary_max,
+} Anum_compression_chunk_dictionary;
+
+#define Natts_compression_chunk_dictionary (_Anum_compression_chunk_dictionary_max - 1)
+
+enum
+{
+	COMPRESSION_CHUNK_DICTIONARY_PKEY = 0,
+	COMPRESSION_CHUNK_DICTIONARY_COMPRESSED_CHUNK_ID_IDX,
+	_MAX_COMPRESSION_CHUNK_DICTIONARY_INDEX,
+};
+typedef enum Anum_compression_chunk_dictionary_pkey
+{
+	Anum_compression_chunk_dictionary_pkey_id = 1,
+	_Anum_compression_chunk_dictionary_pkey_max,
+} Anum_compression_chunk_dictionary_pkey;
+
+typedef enum Anum_compression_chunk_dictionary_compressed_chunk_id_idx
+{
+	Anum_compression_chunk_dictionary_compressed_chunk_id_idx_compressed_chunk_id = 1,
+	_Anum_compression_chunk_dictionary_compressed_chunk_id_idx_max,
+} Anum_compression_chunk_dictionary_compressed_chunk_id_idx;
+
 /*
  * The maximum number of indexes a catalog table can have.
  * This needs to be bumped in case of new catalog tables that have more indexes.
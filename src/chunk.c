@@ -8,6 +8,7 @@
 #include <catalog/namespace.h>
 #include <catalog/pg_trigger.h>
 #include <catalog/indexing.h>
+#include <catalog/pg_index.h>
 #include <catalog/pg_inherits.h>
 #include <catalog/toasting.h>
 #include <commands/trigger.h>
@@ -23,6 +24,7 @@
 #include <utils/lsyscache.h>
 #include <utils/syscache.h>
 #include <utils/hsearch.h>
+#include <utils/inval.h>
 #include <storage/lmgr.h>
 #include <miscadmin.h>
 #include <funcapi.h>
@@ -62,6 +64,7 @@
 #include "cache.h"
 #include "bgw_policy/chunk_stats.h"
 #include "scan_iterator.h"
+#include "compression_chunk_dictionary.h"
 #include "compression_chunk_size.h"
 #include "extension.h"
 
@@ -134,8 +137,6 @@ static Chunk *get_chunks_in_time_range(Hypertable *ht, int64 older_than, int64 n
 
 #define ASSERT_IS_NULL_OR_VALID_CHUNK(chunk) Assert(chunk == NULL || IS_VALID_CHUNK(chunk))
 
-#define CHUNK_STATUS_DEFAULT 0
-
 static HeapTuple
 chunk_formdata_make_tuple(const FormData_chunk *fd, TupleDesc desc)
 {
@@ -157,7 +158,7 @@ chunk_formdata_make_tuple(const FormData_chunk *fd, TupleDesc desc)
 			Int32GetDatum(fd->compressed_chunk_id);
 	}
 	values[AttrNumberGetAttrOffset(Anum_chunk_dropped)] = BoolGetDatum(fd->dropped);
-	values[AttrNumberGetAttrOffset(Anum_chunk_status)] = Int32GetDatum(CHUNK_STATUS_DEFAULT);
+	values[AttrNumberGetAttrOffset(Anum_chunk_status)] = Int32GetDatum(fd->status);
 
 	return heap_form_tuple(desc, values, nulls);
 }
@@ -1641,6 +1642,7 @@ chunk_resurrect(Hypertable *ht, ChunkStub *stub)
 
 		/* Finally, update the chunk tuple to no longer be a tombstone */
 		chunk->fd.dropped = false;
+		chunk->fd.status = CHUNK_STATUS_DEFAULT;
 		new_tuple = chunk_formdata_make_tuple(&chunk->fd, ts_scan_iterator_tupledesc(&iterator));
 		ts_catalog_update_tid(ti->scanrel, ts_scanner_get_tuple_tid(ti), new_tuple);
 		heap_freetuple(new_tuple);
@@ -2594,6 +2596,7 @@ chunk_tuple_delete(TupleInfo *ti, DropBehavior behavior, bool preserve_chunk_cat
 
 	ts_chunk_index_delete_by_chunk_id(form.id, true);
 	ts_compression_chunk_size_delete(form.id);
+	ts_compression_chunk_dictionary_delete(form.id);
 	ts_chunk_data_node_delete_by_chunk_id(form.id);
 
 	/* Delete any row in bgw_policy_chunk-stats corresponding to this chunk */
@@ -2995,6 +2998,10 @@ chunk_set_compressed_id_in_tuple(TupleInfo *ti, void *data)
 
 	chunk_formdata_fill(&form, ti);
 	form.compressed_chunk_id = compressed_chunk_id;
+	/* Rows staged in a partially compressed chunk are decompressed along
+	 * with the rest of the chunk */
+	if (compressed_chunk_id == INVALID_CHUNK_ID)
+		form.status &= ~CHUNK_STATUS_COMPRESSED_PARTIAL;
 	new_tuple = chunk_formdata_make_tuple(&form, ts_scanner_get_tupledesc(ti));
 
 	ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
@@ -3032,6 +3039,95 @@ ts_chunk_set_compressed_chunk(Chunk *chunk, int32 compressed_chunk_id, bool isnu
 							   CurrentMemoryContext) > 0;
 }
 
+static ScanTupleResult
+chunk_set_status_in_tuple(TupleInfo *ti, void *data)
+{
+	FormData_chunk form;
+	HeapTuple new_tuple;
+	CatalogSecurityContext sec_ctx;
+	int32 status = *((int32 *) data);
+
+	chunk_formdata_fill(&form, ti);
+	form.status = status;
+	new_tuple = chunk_formdata_make_tuple(&form, ts_scanner_get_tupledesc(ti));
+
+	ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
+	ts_catalog_update_tid(ti->scanrel, ts_scanner_get_tuple_tid(ti), new_tuple);
+	ts_catalog_restore_user(&sec_ctx);
+	heap_freetuple(new_tuple);
+
+	return SCAN_DONE;
+}
+
+/*
+ * Update the status flags of a chunk. Plans on the chunk depend on whether
+ * it has staged rows, so invalidate the relcache to force replanning.
+ *
+ * Assumes permissions are already checked.
+ */
+bool
+ts_chunk_set_status(Chunk *chunk, int32 status)
+{
+	ScanKeyData scankey[1];
+	bool found;
+
+	ScanKeyInit(&scankey[0],
+				Anum_chunk_idx_id,
+				BTEqualStrategyNumber,
+				F_INT4EQ,
+				Int32GetDatum(chunk->fd.id));
+	found = chunk_scan_internal(CHUNK_ID_INDEX,
+								scankey,
+								1,
+								chunk_tuple_dropped_filter,
+								chunk_set_status_in_tuple,
+								&status,
+								0,
+								ForwardScanDirection,
+								RowExclusiveLock,
+								CurrentMemoryContext) > 0;
+
+	if (found)
+	{
+		chunk->fd.status = status;
+		CacheInvalidateRelcacheByRelid(chunk->table_id);
+	}
+
+	return found;
+}
+
+bool
+ts_chunk_is_partial(const Chunk *chunk)
+{
+	return (chunk->fd.status & CHUNK_STATUS_COMPRESSED_PARTIAL) != 0;
+}
+
+/*
+ * Mark a compressed chunk as having rows in its uncompressed relation.
+ *
+ * Concurrent inserters serialize on the chunk relation so that only the
+ * first one updates the catalog tuple; the others see the flag when they
+ * re-read the status after acquiring the lock.
+ */
+void
+ts_chunk_set_partial(Chunk *chunk)
+{
+	Chunk *current;
+
+	Assert(chunk->fd.compressed_chunk_id != INVALID_CHUNK_ID);
+
+	if (ts_chunk_is_partial(chunk))
+		return;
+
+	LockRelationOid(chunk->table_id, ShareUpdateExclusiveLock);
+	current = ts_chunk_get_by_id(chunk->fd.id, true);
+
+	if (!ts_chunk_is_partial(current))
+		ts_chunk_set_status(chunk, current->fd.status | CHUNK_STATUS_COMPRESSED_PARTIAL);
+	else
+		chunk->fd.status = current->fd.status;
+}
+
 /* Used as a tuple found function */
 static ScanTupleResult
 chunk_rename_schema_name(TupleInfo *ti, void *data)
@@ -3601,14 +3697,110 @@ ts_chunk_can_be_compressed(int32 chunk_id)
 	return can_be_compressed;
 }
 
+/* Check if this chunk is compressed and has rows staged in its uncompressed
+ * relation that should be merged into the compressed data. */
+bool
+ts_chunk_needs_recompression(int32 chunk_id)
+{
+	bool needs_recompression = false;
+	ScanIterator iterator = ts_scan_iterator_create(CHUNK, AccessShareLock, CurrentMemoryContext);
+	iterator.ctx.index = catalog_get_index(ts_catalog_get(), CHUNK, CHUNK_ID_INDEX);
+	ts_scan_iterator_scan_key_init(&iterator,
+								   Anum_chunk_idx_id,
+								   BTEqualStrategyNumber,
+								   F_INT4EQ,
+								   Int32GetDatum(chunk_id));
+
+	ts_scanner_foreach(&iterator)
+	{
+		TupleInfo *ti = ts_scan_iterator_tuple_info(&iterator);
+		bool dropped_isnull;
+		bool status_isnull;
+		Datum dropped;
+		Datum status;
+
+		dropped = slot_getattr(ti->slot, Anum_chunk_dropped, &dropped_isnull);
+		status = slot_getattr(ti->slot, Anum_chunk_status, &status_isnull);
+		Assert(!dropped_isnull && !status_isnull);
+		needs_recompression = !DatumGetBool(dropped) &&
+							  !slot_attisnull(ti->slot, Anum_chunk_compressed_chunk_id) &&
+							  (DatumGetInt32(status) & CHUNK_STATUS_COMPRESSED_PARTIAL) != 0;
+	}
+	ts_scan_iterator_close(&iterator);
+	return needs_recompression;
+}
+
+static bool
+relation_has_unique_index(Relation rel)
+{
+	List *indexoids = RelationGetIndexList(rel);
+	ListCell *lc;
+	bool has_unique = false;
+
+	foreach (lc, indexoids)
+	{
+		HeapTuple tuple = SearchSysCache1(INDEXRELID, ObjectIdGetDatum(lfirst_oid(lc)));
+
+		if (!HeapTupleIsValid(tuple))
+			elog(ERROR, "cache lookup failed for index %u", lfirst_oid(lc));
+
+		has_unique = ((Form_pg_index) GETSTRUCT(tuple))->indisunique;
+		ReleaseSysCache(tuple);
+
+		if (has_unique)
+			break;
+	}
+
+	list_free(indexoids);
+	return has_unique;
+}
+
+/*
+ * Trigger installed on the uncompressed relation of a compressed chunk.
+ *
+ * Inserts are allowed and land in the (otherwise empty) uncompressed
+ * relation, which acts as a staging area that is scanned together with the
+ * compressed data and merged into it by recompress_chunk. The first insert
+ * in a statement marks the chunk as partially compressed. Updates and
+ * deletes are blocked.
+ *
+ * The unique indexes of the staging area do not cover the compressed rows, so
+ * a key that is already compressed would be accepted and make the chunk fail
+ * to decompress later. Inserts into chunks with unique indexes are therefore
+ * blocked as well.
+ */
 Datum
 ts_chunk_dml_blocker(PG_FUNCTION_ARGS)
 {
 	TriggerData *trigdata = (TriggerData *) fcinfo->context;
-	const char *relname = get_rel_name(trigdata->tg_relation->rd_id);
+	const char *relname;
 
 	if (!CALLED_AS_TRIGGER(fcinfo))
 		elog(ERROR, "dml_blocker: not called by trigger manager");
+
+	if (TRIGGER_FIRED_BY_INSERT(trigdata->tg_event) && TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
+	{
+		/* The flag only needs to be set once per statement, so remember
+		 * that it was done in the function's cache */
+		if (fcinfo->flinfo->fn_extra == NULL)
+		{
+			Chunk *chunk = ts_chunk_get_by_relid(trigdata->tg_relation->rd_id, true);
+
+			if (relation_has_unique_index(trigdata->tg_relation))
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("cannot insert into compressed chunk \"%s\" with unique index",
+								get_rel_name(trigdata->tg_relation->rd_id)),
+						 errhint("Decompress the chunk before inserting into it.")));
+
+			ts_chunk_set_partial(chunk);
+			fcinfo->flinfo->fn_extra = MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, 1);
+		}
+
+		return PointerGetDatum(trigdata->tg_trigtuple);
+	}
+
+	relname = get_rel_name(trigdata->tg_relation->rd_id);
 	ereport(ERROR,
 			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 			 errmsg("insert/update/delete not permitted on chunk \"%s\"", relname),
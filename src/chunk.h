@@ -20,6 +20,15 @@
 
 #define INVALID_CHUNK_ID 0
 
+/*
+ * Chunk status flags stored in the status column of the chunk catalog
+ * table. CHUNK_STATUS_COMPRESSED_PARTIAL marks a compressed chunk that has
+ * received new rows in its uncompressed relation since it was last
+ * (re)compressed.
+ */
+#define CHUNK_STATUS_DEFAULT 0
+#define CHUNK_STATUS_COMPRESSED_PARTIAL 1
+
 /* Should match definition in ddl_api.sql */
 #define DROP_CHUNKS_FUNCNAME "drop_chunks"
 #define DROP_CHUNKS_NARGS 4
@@ -157,6 +166,10 @@ extern TSDLLEXPORT Chunk *ts_chunk_find_or_create_without_cuts(Hypertable *ht, H
 extern TSDLLEXPORT Chunk *ts_chunk_get_compressed_chunk_parent(const Chunk *chunk);
 extern TSDLLEXPORT bool ts_chunk_contains_compressed_data(const Chunk *chunk);
 extern TSDLLEXPORT bool ts_chunk_can_be_compressed(int32 chunk_id);
+extern TSDLLEXPORT bool ts_chunk_needs_recompression(int32 chunk_id);
+extern TSDLLEXPORT bool ts_chunk_is_partial(const Chunk *chunk);
+extern TSDLLEXPORT void ts_chunk_set_partial(Chunk *chunk);
+extern TSDLLEXPORT bool ts_chunk_set_status(Chunk *chunk, int32 status);
 extern TSDLLEXPORT Datum ts_chunk_id_from_relid(PG_FUNCTION_ARGS);
 extern TSDLLEXPORT List *ts_chunk_get_chunk_ids_by_hypertable_id(int32 hypertable_id);
 extern TSDLLEXPORT List *ts_chunk_get_data_node_name_list(const Chunk *chunk);
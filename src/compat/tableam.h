@@ -13,6 +13,8 @@
 #include <access/heapam.h>
 #include <access/genam.h>
 
+#include "export.h"
+
 #define TableScanDesc HeapScanDesc
 
 #define table_open(r, l) heap_open(r, l)
@@ -31,12 +33,12 @@
 	ts_table_scan_getnextslot(scan, direction, slot)
 #define index_getnext_slot(scan, direction, slot) ts_index_getnext_slot(scan, direction, slot)
 
-extern TupleTableSlot *ts_table_slot_create(Relation rel, List **reglist);
+extern TSDLLEXPORT TupleTableSlot *ts_table_slot_create(Relation rel, List **reglist);
 extern void ts_table_tuple_insert(Relation rel, TupleTableSlot *slot, CommandId cid, int options,
 								  struct BulkInsertStateData *bistate);
 extern bool ts_table_scan_getnextslot(TableScanDesc scan, const ScanDirection direction,
 									  TupleTableSlot *slot);
-extern bool ts_index_getnext_slot(IndexScanDesc scan, const ScanDirection direction,
-								  TupleTableSlot *slot);
+extern TSDLLEXPORT bool ts_index_getnext_slot(IndexScanDesc scan, const ScanDirection direction,
+											  TupleTableSlot *slot);
 
 #endif /* TIMESCALEDB_COMPAT_TABLEAM_H */
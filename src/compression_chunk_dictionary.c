@@ -0,0 +1,130 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#include <postgres.h>
+#include <access/htup_details.h>
+#include <utils/fmgroids.h>
+
+#include "compression_chunk_dictionary.h"
+#include "catalog.h"
+#include "scanner.h"
+#include "scan_iterator.h"
+
+/*
+ * The dictionary id has to be known before the dictionary is complete since
+ * the batches referencing it are written first.
+ */
+TSDLLEXPORT int32
+ts_compression_chunk_dictionary_next_id(void)
+{
+	CatalogSecurityContext sec_ctx;
+	int32 id;
+
+	ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
+	id = ts_catalog_table_next_seq_id(ts_catalog_get(), COMPRESSION_CHUNK_DICTIONARY);
+	ts_catalog_restore_user(&sec_ctx);
+
+	return id;
+}
+
+TSDLLEXPORT void
+ts_compression_chunk_dictionary_insert(int32 id, int32 compressed_chunk_id, Datum dictionary)
+{
+	Catalog *catalog = ts_catalog_get();
+	Relation rel;
+	TupleDesc desc;
+	Datum values[Natts_compression_chunk_dictionary];
+	bool nulls[Natts_compression_chunk_dictionary] = { false };
+	CatalogSecurityContext sec_ctx;
+
+	rel = table_open(catalog_get_table_id(catalog, COMPRESSION_CHUNK_DICTIONARY),
+					 RowExclusiveLock);
+	desc = RelationGetDescr(rel);
+
+	values[AttrNumberGetAttrOffset(Anum_compression_chunk_dictionary_id)] = Int32GetDatum(id);
+	values[AttrNumberGetAttrOffset(Anum_compression_chunk_dictionary_compressed_chunk_id)] =
+		Int32GetDatum(compressed_chunk_id);
+	values[AttrNumberGetAttrOffset(Anum_compression_chunk_dictionary_dictionary)] = dictionary;
+
+	ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
+	ts_catalog_insert_values(rel, desc, values, nulls);
+	ts_catalog_restore_user(&sec_ctx);
+	table_close(rel, NoLock);
+}
+
+/*
+ * Get a detoasted copy of a dictionary, allocated in the current memory
+ * context.
+ */
+TSDLLEXPORT Datum
+ts_compression_chunk_dictionary_get(int32 id)
+{
+	Datum dictionary = (Datum) 0;
+	bool found = false;
+	MemoryContext mcxt = CurrentMemoryContext;
+	ScanIterator iterator =
+		ts_scan_iterator_create(COMPRESSION_CHUNK_DICTIONARY, AccessShareLock, mcxt);
+
+	iterator.ctx.index = catalog_get_index(ts_catalog_get(),
+										   COMPRESSION_CHUNK_DICTIONARY,
+										   COMPRESSION_CHUNK_DICTIONARY_PKEY);
+	ts_scan_iterator_scan_key_init(&iterator,
+								   Anum_compression_chunk_dictionary_pkey_id,
+								   BTEqualStrategyNumber,
+								   F_INT4EQ,
+								   Int32GetDatum(id));
+
+	ts_scanner_foreach(&iterator)
+	{
+		bool isnull;
+		bool should_free;
+		HeapTuple tuple = ts_scan_iterator_fetch_heap_tuple(&iterator, false, &should_free);
+		Datum value = heap_getattr(tuple,
+								   Anum_compression_chunk_dictionary_dictionary,
+								   ts_scan_iterator_tupledesc(&iterator),
+								   &isnull);
+		MemoryContext old = MemoryContextSwitchTo(mcxt);
+
+		Assert(!isnull);
+		dictionary = PointerGetDatum(PG_DETOAST_DATUM_COPY(value));
+		found = true;
+		MemoryContextSwitchTo(old);
+
+		if (should_free)
+			heap_freetuple(tuple);
+	}
+
+	if (!found)
+		elog(ERROR, "compression dictionary %d not found", id);
+
+	return dictionary;
+}
+
+TSDLLEXPORT int
+ts_compression_chunk_dictionary_delete(int32 compressed_chunk_id)
+{
+	ScanIterator iterator = ts_scan_iterator_create(COMPRESSION_CHUNK_DICTIONARY,
+													RowExclusiveLock,
+													CurrentMemoryContext);
+	int count = 0;
+
+	iterator.ctx.index = catalog_get_index(ts_catalog_get(),
+										   COMPRESSION_CHUNK_DICTIONARY,
+										   COMPRESSION_CHUNK_DICTIONARY_COMPRESSED_CHUNK_ID_IDX);
+	ts_scan_iterator_scan_key_init(
+		&iterator,
+		Anum_compression_chunk_dictionary_compressed_chunk_id_idx_compressed_chunk_id,
+		BTEqualStrategyNumber,
+		F_INT4EQ,
+		Int32GetDatum(compressed_chunk_id));
+
+	ts_scanner_foreach(&iterator)
+	{
+		TupleInfo *ti = ts_scan_iterator_tuple_info(&iterator);
+		ts_catalog_delete_tid(ti->scanrel, ts_scanner_get_tuple_tid(ti));
+		count++;
+	}
+	return count;
+}
@@ -0,0 +1,19 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_COMPRESSION_CHUNK_DICTIONARY_H
+#define TIMESCALEDB_COMPRESSION_CHUNK_DICTIONARY_H
+#include <postgres.h>
+#include <compat.h>
+
+#include "catalog.h"
+
+extern TSDLLEXPORT int32 ts_compression_chunk_dictionary_next_id(void);
+extern TSDLLEXPORT void ts_compression_chunk_dictionary_insert(int32 id, int32 compressed_chunk_id,
+															   Datum dictionary);
+extern TSDLLEXPORT Datum ts_compression_chunk_dictionary_get(int32 id);
+extern TSDLLEXPORT int ts_compression_chunk_dictionary_delete(int32 compressed_chunk_id);
+
+#endif
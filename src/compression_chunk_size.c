@@ -38,6 +38,109 @@ ts_compression_chunk_size_delete(int32 uncompressed_chunk_id)
 	return count;
 }
 
+/* NULL values, such as unrecorded row counts, are left as they are */
+static void
+add_to_int64_value(Datum *values, bool *nulls, AttrNumber attno, int64 delta)
+{
+	int off = AttrNumberGetAttrOffset(attno);
+
+	if (!nulls[off])
+		values[off] = Int64GetDatum(DatumGetInt64(values[off]) + delta);
+}
+
+static void
+compression_chunk_size_update(int32 uncompressed_chunk_id,
+							  const FormData_compression_chunk_size *added,
+							  bool replace_compressed_sizes)
+{
+	ScanIterator iterator =
+		ts_scan_iterator_create(COMPRESSION_CHUNK_SIZE, RowExclusiveLock, CurrentMemoryContext);
+
+	init_scan_by_uncompressed_chunk_id(&iterator, uncompressed_chunk_id);
+	ts_scanner_foreach(&iterator)
+	{
+		TupleInfo *ti = ts_scan_iterator_tuple_info(&iterator);
+		TupleDesc desc = ts_scan_iterator_tupledesc(&iterator);
+		bool nulls[Natts_compression_chunk_size];
+		Datum values[Natts_compression_chunk_size];
+		CatalogSecurityContext sec_ctx;
+		bool should_free;
+		HeapTuple tuple = ts_scan_iterator_fetch_heap_tuple(&iterator, false, &should_free);
+		HeapTuple new_tuple;
+
+		heap_deform_tuple(tuple, desc, values, nulls);
+
+		add_to_int64_value(values,
+						   nulls,
+						   Anum_compression_chunk_size_uncompressed_heap_size,
+						   added->uncompressed_heap_size);
+		add_to_int64_value(values,
+						   nulls,
+						   Anum_compression_chunk_size_uncompressed_toast_size,
+						   added->uncompressed_toast_size);
+		add_to_int64_value(values,
+						   nulls,
+						   Anum_compression_chunk_size_uncompressed_index_size,
+						   added->uncompressed_index_size);
+		add_to_int64_value(values,
+						   nulls,
+						   Anum_compression_chunk_size_numrows_pre_compression,
+						   added->numrows_pre_compression);
+		add_to_int64_value(values,
+						   nulls,
+						   Anum_compression_chunk_size_numrows_post_compression,
+						   added->numrows_post_compression);
+
+		if (replace_compressed_sizes)
+		{
+			values[AttrNumberGetAttrOffset(Anum_compression_chunk_size_compressed_heap_size)] =
+				Int64GetDatum(added->compressed_heap_size);
+			values[AttrNumberGetAttrOffset(Anum_compression_chunk_size_compressed_toast_size)] =
+				Int64GetDatum(added->compressed_toast_size);
+			values[AttrNumberGetAttrOffset(Anum_compression_chunk_size_compressed_index_size)] =
+				Int64GetDatum(added->compressed_index_size);
+		}
+
+		new_tuple = heap_form_tuple(desc, values, nulls);
+		ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
+		ts_catalog_update_tid(ti->scanrel, ts_scanner_get_tuple_tid(ti), new_tuple);
+		ts_catalog_restore_user(&sec_ctx);
+		heap_freetuple(new_tuple);
+
+		if (should_free)
+			heap_freetuple(tuple);
+	}
+}
+
+/*
+ * Account for rows merged into an already compressed chunk. The uncompressed
+ * sizes and row counts in "added" are added to the recorded ones, while the
+ * compressed sizes replace the recorded ones since they are measured again
+ * after recompressing.
+ */
+TSDLLEXPORT void
+ts_compression_chunk_size_update_recompressed(int32 uncompressed_chunk_id,
+											  const FormData_compression_chunk_size *added)
+{
+	compression_chunk_size_update(uncompressed_chunk_id, added, true);
+}
+
+/*
+ * Account for batches moved out of a compressed chunk. The rows of the batches
+ * are counted again when the chunk is recompressed.
+ */
+TSDLLEXPORT void
+ts_compression_chunk_size_remove_rows(int32 uncompressed_chunk_id, int64 numrows_pre_compression,
+									  int64 numrows_post_compression)
+{
+	FormData_compression_chunk_size removed = {
+		.numrows_pre_compression = -numrows_pre_compression,
+		.numrows_post_compression = -numrows_post_compression,
+	};
+
+	compression_chunk_size_update(uncompressed_chunk_id, &removed, false);
+}
+
 TotalSizes
 ts_compression_chunk_size_totals()
 {
@@ -122,3 +225,40 @@ ts_compression_chunk_size_row_count(int32 uncompressed_chunk_id)
 			 COMPRESSION_CHUNK_SIZE_TABLE_NAME);
 	return rowcnt;
 }
+
+/*
+ * Return the average number of rows in the compressed batches of the chunk,
+ * or 0 if the row counts were not recorded when it was compressed.
+ */
+TSDLLEXPORT double
+ts_compression_chunk_size_rows_per_batch(int32 uncompressed_chunk_id)
+{
+	double rows_per_batch = 0;
+	ScanIterator iterator =
+		ts_scan_iterator_create(COMPRESSION_CHUNK_SIZE, AccessShareLock, CurrentMemoryContext);
+	init_scan_by_uncompressed_chunk_id(&iterator, uncompressed_chunk_id);
+	ts_scanner_foreach(&iterator)
+	{
+		bool nulls[Natts_compression_chunk_size];
+		Datum values[Natts_compression_chunk_size];
+		bool should_free;
+		HeapTuple tuple = ts_scan_iterator_fetch_heap_tuple(&iterator, false, &should_free);
+
+		heap_deform_tuple(tuple, ts_scan_iterator_tupledesc(&iterator), values, nulls);
+		if (!nulls[AttrNumberGetAttrOffset(
+				Anum_compression_chunk_size_numrows_pre_compression)] &&
+			!nulls[AttrNumberGetAttrOffset(Anum_compression_chunk_size_numrows_post_compression)])
+		{
+			int64 rows_pre = DatumGetInt64(
+				values[AttrNumberGetAttrOffset(Anum_compression_chunk_size_numrows_pre_compression)]);
+			int64 rows_post = DatumGetInt64(values[AttrNumberGetAttrOffset(
+				Anum_compression_chunk_size_numrows_post_compression)]);
+
+			if (rows_post > 0)
+				rows_per_batch = (double) rows_pre / rows_post;
+		}
+		if (should_free)
+			heap_freetuple(tuple);
+	}
+	return rows_per_batch;
+}
@@ -8,7 +8,15 @@
 #include <postgres.h>
 #include <compat.h>
 
+#include "catalog.h"
+
 extern TSDLLEXPORT int ts_compression_chunk_size_delete(int32 uncompressed_chunk_id);
+extern TSDLLEXPORT void
+ts_compression_chunk_size_update_recompressed(int32 uncompressed_chunk_id,
+											  const FormData_compression_chunk_size *added);
+extern TSDLLEXPORT void ts_compression_chunk_size_remove_rows(int32 uncompressed_chunk_id,
+															 int64 numrows_pre_compression,
+															 int64 numrows_post_compression);
 
 typedef struct TotalSizes
 {
@@ -22,5 +30,6 @@ typedef struct TotalSizes
 
 extern TSDLLEXPORT TotalSizes ts_compression_chunk_size_totals(void);
 extern TSDLLEXPORT int64 ts_compression_chunk_size_row_count(int32 uncompressed_chunk_id);
+extern TSDLLEXPORT double ts_compression_chunk_size_rows_per_batch(int32 uncompressed_chunk_id);
 
 #endif
@@ -35,6 +35,26 @@ static const WithClauseDefinition compress_hypertable_with_clause_def[] = {
 			 .arg_name = "compress_orderby",
 			 .type_id = TEXTOID,
 		},
+		[CompressBloomFilter] = {
+			 .arg_name = "compress_bloomfilter",
+			 .type_id = TEXTOID,
+		},
+		[CompressBatchSize] = {
+			 .arg_name = "compress_batch_size",
+			 .type_id = INT4OID,
+		},
+		[CompressBatchTargetSize] = {
+			 .arg_name = "compress_batch_target_size",
+			 .type_id = INT4OID,
+		},
+		[CompressLz4] = {
+			 .arg_name = "compress_lz4",
+			 .type_id = TEXTOID,
+		},
+		[CompressZstd] = {
+			 .arg_name = "compress_zstd",
+			 .type_id = TEXTOID,
+		},
 };
 
 WithClauseResult *
@@ -45,7 +65,7 @@ ts_compress_hypertable_set_clause_parse(const List *defelems)
 								 TS_ARRAY_LEN(compress_hypertable_with_clause_def));
 }
 
-static inline void
+static void
 throw_segment_by_error(char *segment_by)
 {
 	ereport(ERROR,
@@ -55,6 +75,36 @@ throw_segment_by_error(char *segment_by)
 					 " be a set of columns separated by commas.")));
 }
 
+static void
+throw_bloom_filter_error(char *bloom_filter)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_SYNTAX_ERROR),
+			 errmsg("unable to parse bloom filter option \"%s\"", bloom_filter),
+			 errhint("The option timescaledb.compress_bloomfilter must"
+					 " be a set of columns separated by commas.")));
+}
+
+static void
+throw_lz4_error(char *lz4)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_SYNTAX_ERROR),
+			 errmsg("unable to parse LZ4 option \"%s\"", lz4),
+			 errhint("The option timescaledb.compress_lz4 must"
+					 " be a set of columns separated by commas.")));
+}
+
+static void
+throw_zstd_error(char *zstd)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_SYNTAX_ERROR),
+			 errmsg("unable to parse Zstd option \"%s\"", zstd),
+			 errhint("The option timescaledb.compress_zstd must"
+					 " be a set of columns separated by commas.")));
+}
+
 static bool
 select_stmt_as_expected(SelectStmt *stmt)
 {
@@ -70,7 +120,7 @@ select_stmt_as_expected(SelectStmt *stmt)
 }
 
 static List *
-parse_segment_collist(char *inpstr, Hypertable *hypertable)
+parse_segment_collist(char *inpstr, Hypertable *hypertable, void (*throw_error)(char *))
 {
 	StringInfoData buf;
 	List *parsed;
@@ -98,26 +148,26 @@ parse_segment_collist(char *inpstr, Hypertable *hypertable)
 	}
 	PG_CATCH();
 	{
-		throw_segment_by_error(inpstr);
+		throw_error(inpstr);
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
 
 	if (list_length(parsed) != 1)
-		throw_segment_by_error(inpstr);
+		throw_error(inpstr);
 	if (!IsA(linitial(parsed), RawStmt))
-		throw_segment_by_error(inpstr);
+		throw_error(inpstr);
 	raw = linitial(parsed);
 
 	if (!IsA(raw->stmt, SelectStmt))
-		throw_segment_by_error(inpstr);
+		throw_error(inpstr);
 	select = (SelectStmt *) raw->stmt;
 
 	if (!select_stmt_as_expected(select))
-		throw_segment_by_error(inpstr);
+		throw_error(inpstr);
 
 	if (select->sortClause != NIL)
-		throw_segment_by_error(inpstr);
+		throw_error(inpstr);
 
 	foreach (lc, select->groupClause)
 	{
@@ -125,13 +175,13 @@ parse_segment_collist(char *inpstr, Hypertable *hypertable)
 		CompressedParsedCol *col = (CompressedParsedCol *) palloc(sizeof(*col));
 
 		if (!IsA(lfirst(lc), ColumnRef))
-			throw_segment_by_error(inpstr);
+			throw_error(inpstr);
 		cf = lfirst(lc);
 		if (list_length(cf->fields) != 1)
-			throw_segment_by_error(inpstr);
+			throw_error(inpstr);
 
 		if (!IsA(linitial(cf->fields), String))
-			throw_segment_by_error(inpstr);
+			throw_error(inpstr);
 
 		col->index = index;
 		index++;
@@ -257,7 +307,9 @@ ts_compress_hypertable_parse_segment_by(WithClauseResult *parsed_options, Hypert
 	if (parsed_options[CompressSegmentBy].is_default == false)
 	{
 		Datum textarg = parsed_options[CompressSegmentBy].parsed;
-		return parse_segment_collist(TextDatumGetCString(textarg), hypertable);
+		return parse_segment_collist(TextDatumGetCString(textarg),
+									 hypertable,
+									 throw_segment_by_error);
 	}
 	else
 		return NIL;
@@ -277,3 +329,66 @@ ts_compress_hypertable_parse_order_by(WithClauseResult *parsed_options, Hypertab
 	else
 		return NIL;
 }
+
+/*
+ * Parse segmentby and orderby settings given as plain strings instead of as
+ * part of a WITH clause, e.g. the candidates of the compression advisor.
+ */
+List *
+ts_compress_hypertable_parse_segment_by_string(char *segmentby, Hypertable *hypertable)
+{
+	return parse_segment_collist(segmentby, hypertable, throw_segment_by_error);
+}
+
+List *
+ts_compress_hypertable_parse_order_by_string(char *orderby, Hypertable *hypertable)
+{
+	return parse_order_collist(orderby, hypertable);
+}
+
+/* returns List of CompressedParsedCol
+ * compress_bloomfilter = `col1,col2,col3`
+ */
+List *
+ts_compress_hypertable_parse_bloom_filter(WithClauseResult *parsed_options, Hypertable *hypertable)
+{
+	if (parsed_options[CompressBloomFilter].is_default == false)
+	{
+		Datum textarg = parsed_options[CompressBloomFilter].parsed;
+		return parse_segment_collist(TextDatumGetCString(textarg),
+									 hypertable,
+									 throw_bloom_filter_error);
+	}
+	else
+		return NIL;
+}
+
+/* returns List of CompressedParsedCol
+ * compress_lz4 = `col1,col2,col3`
+ */
+List *
+ts_compress_hypertable_parse_lz4(WithClauseResult *parsed_options, Hypertable *hypertable)
+{
+	if (parsed_options[CompressLz4].is_default == false)
+	{
+		Datum textarg = parsed_options[CompressLz4].parsed;
+		return parse_segment_collist(TextDatumGetCString(textarg), hypertable, throw_lz4_error);
+	}
+	else
+		return NIL;
+}
+
+/* returns List of CompressedParsedCol
+ * compress_zstd = `col1,col2,col3`
+ */
+List *
+ts_compress_hypertable_parse_zstd(WithClauseResult *parsed_options, Hypertable *hypertable)
+{
+	if (parsed_options[CompressZstd].is_default == false)
+	{
+		Datum textarg = parsed_options[CompressZstd].parsed;
+		return parse_segment_collist(TextDatumGetCString(textarg), hypertable, throw_zstd_error);
+	}
+	else
+		return NIL;
+}
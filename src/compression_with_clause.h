@@ -18,6 +18,11 @@ typedef enum CompressHypertableOption
 	CompressEnabled = 0,
 	CompressSegmentBy,
 	CompressOrderBy,
+	CompressBloomFilter,
+	CompressBatchSize,
+	CompressBatchTargetSize,
+	CompressLz4,
+	CompressZstd,
 } CompressHypertableOption;
 
 typedef struct
@@ -33,5 +38,15 @@ extern TSDLLEXPORT List *ts_compress_hypertable_parse_segment_by(WithClauseResul
 																 Hypertable *hypertable);
 extern TSDLLEXPORT List *ts_compress_hypertable_parse_order_by(WithClauseResult *parsed_options,
 															   Hypertable *hypertable);
+extern TSDLLEXPORT List *ts_compress_hypertable_parse_segment_by_string(char *segmentby,
+																	   Hypertable *hypertable);
+extern TSDLLEXPORT List *ts_compress_hypertable_parse_order_by_string(char *orderby,
+																	 Hypertable *hypertable);
+extern TSDLLEXPORT List *ts_compress_hypertable_parse_bloom_filter(WithClauseResult *parsed_options,
+																   Hypertable *hypertable);
+extern TSDLLEXPORT List *ts_compress_hypertable_parse_lz4(WithClauseResult *parsed_options,
+														  Hypertable *hypertable);
+extern TSDLLEXPORT List *ts_compress_hypertable_parse_zstd(WithClauseResult *parsed_options,
+														   Hypertable *hypertable);
 
 #endif
@@ -102,6 +102,8 @@ typedef struct CrossModuleFunctions
 	void (*process_rename_cmd)(Hypertable *ht, const RenameStmt *stmt);
 	PGFunction compress_chunk;
 	PGFunction decompress_chunk;
+	PGFunction recompress_chunk;
+	PGFunction compression_advisor;
 	/* The compression functions below are not installed in SQL as part of create extension;
 	 *  They are installed and tested during testing scripts. They are exposed in cross-module
 	 *  functions because they may be very useful for debugging customer problems if the sql
@@ -117,6 +119,7 @@ typedef struct CrossModuleFunctions
 	PGFunction dictionary_compressor_finish;
 	PGFunction array_compressor_append;
 	PGFunction array_compressor_finish;
+	PGFunction bloom1_contains;
 
 	Datum (*data_node_add)(PG_FUNCTION_ARGS);
 	Datum (*data_node_delete)(PG_FUNCTION_ARGS);
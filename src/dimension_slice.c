@@ -943,9 +943,10 @@ dimension_slice_check_is_chunk_uncompressed_tuple_found(TupleInfo *ti, void *dat
 	foreach (lc, chunk_ids)
 	{
 		int32 chunk_id = lfirst_int(lc);
-		if (ts_chunk_can_be_compressed(chunk_id))
+		if (ts_chunk_can_be_compressed(chunk_id) || ts_chunk_needs_recompression(chunk_id))
 		{
-			/* found a chunk that has not yet been compressed */
+			/* found a chunk that has not yet been compressed or has rows
+			 * inserted since it was compressed */
 			*((int32 *) data) = chunk_id;
 			return SCAN_DONE;
 		}
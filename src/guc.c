@@ -6,6 +6,7 @@
 #include <postgres.h>
 #include <utils/guc.h>
 #include <miscadmin.h>
+#include <postmaster/bgworker.h>
 
 #include "guc.h"
 #include "license_guc.h"
@@ -51,9 +52,18 @@ bool ts_guc_enable_constraint_exclusion = true;
 bool ts_guc_enable_qual_propagation = true;
 bool ts_guc_enable_cagg_reorder_groupby = true;
 TSDLLEXPORT bool ts_guc_enable_transparent_decompression = true;
+TSDLLEXPORT bool ts_guc_enable_vectorized_aggregation = false;
 bool ts_guc_enable_per_data_node_queries = true;
 bool ts_guc_enable_async_append = true;
 TSDLLEXPORT bool ts_guc_enable_skip_scan = true;
+TSDLLEXPORT int ts_guc_max_parallel_compression_workers = 0;
+TSDLLEXPORT bool ts_guc_enable_compression_indexscan = true;
+TSDLLEXPORT bool ts_guc_enable_compressed_dml = true;
+TSDLLEXPORT bool ts_guc_enable_decompression_batch_merge = false;
+TSDLLEXPORT bool ts_guc_enable_decompression_batch_distribution = false;
+TSDLLEXPORT bool ts_guc_enable_compressed_metadata_scan = false;
+TSDLLEXPORT bool ts_guc_enable_shared_dictionary_compression = false;
+TSDLLEXPORT bool ts_guc_enable_frozen_compression = false;
 int ts_guc_max_open_chunks_per_insert = 10;
 int ts_guc_max_cached_chunks_per_hypertable = 10;
 int ts_guc_telemetry_level = TELEMETRY_DEFAULT;
@@ -198,6 +208,121 @@ _guc_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("timescaledb.enable_vectorized_aggregation",
+							 "Enable vectorized aggregation",
+							 "Enable computing partial aggregates on whole batches of compressed "
+							 "chunks",
+							 &ts_guc_enable_vectorized_aggregation,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("timescaledb.enable_compression_indexscan",
+							 "Enable index scans when compressing chunks",
+							 "Enable reading the rows of a chunk in order through an index that "
+							 "matches the segmentby and orderby columns instead of sorting them",
+							 &ts_guc_enable_compression_indexscan,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("timescaledb.enable_compressed_dml",
+							 "Enable UPDATE and DELETE on compressed chunks",
+							 "Enable UPDATE and DELETE on compressed chunks by decompressing the "
+							 "batches that may contain affected rows",
+							 &ts_guc_enable_compressed_dml,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("timescaledb.enable_decompression_batch_merge",
+							 "Enable merging of compressed batches",
+							 "Enable producing output ordered by the compress_orderby columns from "
+							 "chunks with segmentby columns by merging the open batches of all "
+							 "segments instead of sorting the decompressed rows",
+							 &ts_guc_enable_decompression_batch_merge,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("timescaledb.enable_decompression_batch_distribution",
+							 "Enable distributing compressed batches to parallel workers",
+							 "Enable parallel decompression where the workers claim whole "
+							 "compressed batches through shared memory instead of splitting the "
+							 "compressed chunk by heap page",
+							 &ts_guc_enable_decompression_batch_distribution,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("timescaledb.enable_compressed_metadata_scan",
+							 "Enable answering queries from batch metadata",
+							 "Enable skipping the decompression of columns whose quals are proven "
+							 "for a whole batch by its min and max metadata, and index-only scans "
+							 "on the segmentby indexes of compressed chunks",
+							 &ts_guc_enable_compressed_metadata_scan,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("timescaledb.enable_shared_dictionary_compression",
+							 "Enable dictionaries shared by all batches of a chunk",
+							 "Enable building one dictionary per column of a compressed chunk for "
+							 "columns using dictionary compression, so that the batches only store "
+							 "the codes of their values",
+							 &ts_guc_enable_shared_dictionary_compression,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("timescaledb.enable_frozen_compression",
+							 "Enable writing compressed chunks frozen",
+							 "Enable writing the rows of a compressed chunk that is created by "
+							 "the same transaction already frozen, like COPY FREEZE, so that "
+							 "vacuum does not need to freeze them later",
+							 &ts_guc_enable_frozen_compression,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("timescaledb.max_parallel_compression_workers",
+							"Maximum parallel workers per compress_chunk",
+							"Maximum number of parallel workers that compress the segments of a "
+							"chunk. Setting this to 0 compresses chunks in a single process",
+							&ts_guc_max_parallel_compression_workers,
+							0,
+							0,
+							MAX_PARALLEL_WORKER_LIMIT,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomBoolVariable("timescaledb.enable_skipscan",
 							 "Enable SkipScan",
 							 "Enable SkipScan for DISTINCT queries",
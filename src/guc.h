@@ -21,9 +21,18 @@ extern bool ts_guc_enable_runtime_exclusion;
 extern bool ts_guc_enable_constraint_exclusion;
 extern bool ts_guc_enable_cagg_reorder_groupby;
 extern TSDLLEXPORT bool ts_guc_enable_transparent_decompression;
+extern TSDLLEXPORT bool ts_guc_enable_vectorized_aggregation;
 extern TSDLLEXPORT bool ts_guc_enable_per_data_node_queries;
 extern TSDLLEXPORT bool ts_guc_enable_async_append;
 extern TSDLLEXPORT bool ts_guc_enable_skip_scan;
+extern TSDLLEXPORT int ts_guc_max_parallel_compression_workers;
+extern TSDLLEXPORT bool ts_guc_enable_compression_indexscan;
+extern TSDLLEXPORT bool ts_guc_enable_compressed_dml;
+extern TSDLLEXPORT bool ts_guc_enable_decompression_batch_merge;
+extern TSDLLEXPORT bool ts_guc_enable_decompression_batch_distribution;
+extern TSDLLEXPORT bool ts_guc_enable_compressed_metadata_scan;
+extern TSDLLEXPORT bool ts_guc_enable_shared_dictionary_compression;
+extern TSDLLEXPORT bool ts_guc_enable_frozen_compression;
 extern bool ts_guc_restoring;
 extern int ts_guc_max_open_chunks_per_insert;
 extern int ts_guc_max_cached_chunks_per_hypertable;
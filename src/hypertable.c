@@ -698,6 +698,8 @@ hypertable_tuple_delete(TupleInfo *ti, void *data)
 
 	/* remove any associated compression definitions */
 	ts_hypertable_compression_delete_by_hypertable_id(hypertable_id);
+	ts_hypertable_compression_batch_delete_by_hypertable_id(hypertable_id);
+	ts_hypertable_compression_codec_delete_by_hypertable_id(hypertable_id);
 
 	if (!compressed_hypertable_id_isnull)
 	{
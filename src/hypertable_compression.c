@@ -4,6 +4,7 @@
  * LICENSE-APACHE for a copy of the license.
  */
 #include <postgres.h>
+#include <utils/builtins.h>
 
 #include "hypertable.h"
 #include "hypertable_cache.h"
@@ -204,3 +205,216 @@ ts_hypertable_compression_rename_column(int32 htid, char *old_column_name, char
 	if (found == false)
 		elog(ERROR, "column %s not found in hypertable_compression catalog table", old_column_name);
 }
+
+static void
+init_scan_batch_by_hypertable_id(ScanIterator *iterator, int32 htid)
+{
+	iterator->ctx.index = catalog_get_index(ts_catalog_get(),
+											HYPERTABLE_COMPRESSION_BATCH,
+											HYPERTABLE_COMPRESSION_BATCH_PKEY);
+	ts_scan_iterator_scan_key_init(iterator,
+								   Anum_hypertable_compression_batch_pkey_hypertable_id,
+								   BTEqualStrategyNumber,
+								   F_INT4EQ,
+								   Int32GetDatum(htid));
+}
+
+/*
+ * Get the batch size settings of a hypertable. Returns false if the
+ * hypertable uses the defaults, in which case fd is not filled in.
+ */
+TSDLLEXPORT bool
+ts_hypertable_compression_batch_get(int32 htid, FormData_hypertable_compression_batch *fd)
+{
+	bool found = false;
+	ScanIterator iterator = ts_scan_iterator_create(HYPERTABLE_COMPRESSION_BATCH,
+													AccessShareLock,
+													CurrentMemoryContext);
+	init_scan_batch_by_hypertable_id(&iterator, htid);
+
+	ts_scanner_foreach(&iterator)
+	{
+		bool should_free;
+		HeapTuple tuple = ts_scan_iterator_fetch_heap_tuple(&iterator, false, &should_free);
+
+		memcpy(fd, GETSTRUCT(tuple), sizeof(FormData_hypertable_compression_batch));
+		found = true;
+
+		if (should_free)
+			heap_freetuple(tuple);
+	}
+	return found;
+}
+
+TSDLLEXPORT void
+ts_hypertable_compression_batch_insert(FormData_hypertable_compression_batch *fd)
+{
+	Catalog *catalog = ts_catalog_get();
+	Relation rel;
+	TupleDesc desc;
+	Datum values[Natts_hypertable_compression_batch];
+	bool nulls[Natts_hypertable_compression_batch] = { false };
+	CatalogSecurityContext sec_ctx;
+
+	rel = table_open(catalog_get_table_id(catalog, HYPERTABLE_COMPRESSION_BATCH),
+					 RowExclusiveLock);
+	desc = RelationGetDescr(rel);
+
+	values[AttrNumberGetAttrOffset(Anum_hypertable_compression_batch_hypertable_id)] =
+		Int32GetDatum(fd->hypertable_id);
+	values[AttrNumberGetAttrOffset(Anum_hypertable_compression_batch_batch_size)] =
+		Int32GetDatum(fd->batch_size);
+	values[AttrNumberGetAttrOffset(Anum_hypertable_compression_batch_target_batch_bytes)] =
+		Int32GetDatum(fd->target_batch_bytes);
+
+	ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
+	ts_catalog_insert_values(rel, desc, values, nulls);
+	ts_catalog_restore_user(&sec_ctx);
+	table_close(rel, NoLock);
+}
+
+TSDLLEXPORT bool
+ts_hypertable_compression_batch_delete_by_hypertable_id(int32 htid)
+{
+	int count = 0;
+	ScanIterator iterator = ts_scan_iterator_create(HYPERTABLE_COMPRESSION_BATCH,
+													RowExclusiveLock,
+													CurrentMemoryContext);
+	init_scan_batch_by_hypertable_id(&iterator, htid);
+
+	ts_scanner_foreach(&iterator)
+	{
+		TupleInfo *ti = ts_scan_iterator_tuple_info(&iterator);
+		ts_catalog_delete_tid(ti->scanrel, ts_scanner_get_tuple_tid(ti));
+		count++;
+	}
+	return count > 0;
+}
+
+static void
+init_scan_codec_by_hypertable_id(ScanIterator *iterator, int32 htid)
+{
+	iterator->ctx.index = catalog_get_index(ts_catalog_get(),
+											HYPERTABLE_COMPRESSION_CODEC,
+											HYPERTABLE_COMPRESSION_CODEC_PKEY);
+	ts_scan_iterator_scan_key_init(iterator,
+								   Anum_hypertable_compression_codec_pkey_hypertable_id,
+								   BTEqualStrategyNumber,
+								   F_INT4EQ,
+								   Int32GetDatum(htid));
+}
+
+/*
+ * Get the block compression codecs of a hypertable as a list of
+ * FormData_hypertable_compression_codec. Columns without a codec have no entry.
+ */
+TSDLLEXPORT List *
+ts_hypertable_compression_codec_get(int32 htid)
+{
+	List *fdlist = NIL;
+	ScanIterator iterator = ts_scan_iterator_create(HYPERTABLE_COMPRESSION_CODEC,
+													AccessShareLock,
+													CurrentMemoryContext);
+	init_scan_codec_by_hypertable_id(&iterator, htid);
+
+	ts_scanner_foreach(&iterator)
+	{
+		bool should_free;
+		HeapTuple tuple = ts_scan_iterator_fetch_heap_tuple(&iterator, false, &should_free);
+		FormData_hypertable_compression_codec *fd =
+			palloc(sizeof(FormData_hypertable_compression_codec));
+
+		memcpy(fd, GETSTRUCT(tuple), sizeof(FormData_hypertable_compression_codec));
+		fdlist = lappend(fdlist, fd);
+
+		if (should_free)
+			heap_freetuple(tuple);
+	}
+	return fdlist;
+}
+
+TSDLLEXPORT void
+ts_hypertable_compression_codec_insert(FormData_hypertable_compression_codec *fd)
+{
+	Catalog *catalog = ts_catalog_get();
+	Relation rel;
+	TupleDesc desc;
+	Datum values[Natts_hypertable_compression_codec];
+	bool nulls[Natts_hypertable_compression_codec] = { false };
+	CatalogSecurityContext sec_ctx;
+
+	rel = table_open(catalog_get_table_id(catalog, HYPERTABLE_COMPRESSION_CODEC),
+					 RowExclusiveLock);
+	desc = RelationGetDescr(rel);
+
+	values[AttrNumberGetAttrOffset(Anum_hypertable_compression_codec_hypertable_id)] =
+		Int32GetDatum(fd->hypertable_id);
+	values[AttrNumberGetAttrOffset(Anum_hypertable_compression_codec_attname)] =
+		NameGetDatum(&fd->attname);
+	values[AttrNumberGetAttrOffset(Anum_hypertable_compression_codec_codec)] =
+		Int16GetDatum(fd->codec);
+
+	ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
+	ts_catalog_insert_values(rel, desc, values, nulls);
+	ts_catalog_restore_user(&sec_ctx);
+	table_close(rel, NoLock);
+}
+
+TSDLLEXPORT bool
+ts_hypertable_compression_codec_delete_by_hypertable_id(int32 htid)
+{
+	int count = 0;
+	ScanIterator iterator = ts_scan_iterator_create(HYPERTABLE_COMPRESSION_CODEC,
+													RowExclusiveLock,
+													CurrentMemoryContext);
+	init_scan_codec_by_hypertable_id(&iterator, htid);
+
+	ts_scanner_foreach(&iterator)
+	{
+		TupleInfo *ti = ts_scan_iterator_tuple_info(&iterator);
+		ts_catalog_delete_tid(ti->scanrel, ts_scanner_get_tuple_tid(ti));
+		count++;
+	}
+	return count > 0;
+}
+
+/* Unlike the hypertable_compression entries, most columns do not have a codec */
+TSDLLEXPORT void
+ts_hypertable_compression_codec_rename_column(int32 htid, char *old_column_name,
+											  char *new_column_name)
+{
+	ScanIterator iterator = ts_scan_iterator_create(HYPERTABLE_COMPRESSION_CODEC,
+													RowExclusiveLock,
+													CurrentMemoryContext);
+	init_scan_codec_by_hypertable_id(&iterator, htid);
+	ts_scan_iterator_scan_key_init(&iterator,
+								   Anum_hypertable_compression_codec_pkey_attname,
+								   BTEqualStrategyNumber,
+								   F_NAMEEQ,
+								   DirectFunctionCall1(namein, CStringGetDatum(old_column_name)));
+
+	ts_scanner_foreach(&iterator)
+	{
+		Datum values[Natts_hypertable_compression_codec];
+		bool isnulls[Natts_hypertable_compression_codec];
+		bool repl[Natts_hypertable_compression_codec] = { false };
+		bool should_free;
+		NameData new_name;
+		TupleInfo *ti = ts_scan_iterator_tuple_info(&iterator);
+		TupleDesc tupdesc = ts_scanner_get_tupledesc(ti);
+		HeapTuple tuple = ts_scanner_fetch_heap_tuple(ti, false, &should_free);
+		HeapTuple new_tuple;
+
+		heap_deform_tuple(tuple, tupdesc, values, isnulls);
+		namestrcpy(&new_name, new_column_name);
+		values[AttrNumberGetAttrOffset(Anum_hypertable_compression_codec_attname)] =
+			NameGetDatum(&new_name);
+		repl[AttrNumberGetAttrOffset(Anum_hypertable_compression_codec_attname)] = true;
+		new_tuple = heap_modify_tuple(tuple, tupdesc, values, isnulls, repl);
+		ts_catalog_update(ti->scanrel, new_tuple);
+		heap_freetuple(new_tuple);
+
+		if (should_free)
+			heap_freetuple(tuple);
+	}
+}
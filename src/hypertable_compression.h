@@ -20,4 +20,18 @@ extern TSDLLEXPORT bool ts_hypertable_compression_delete_by_hypertable_id(int32
 extern TSDLLEXPORT void ts_hypertable_compression_rename_column(int32 htid, char *old_column_name,
 																char *new_column_name);
 
+extern TSDLLEXPORT bool
+ts_hypertable_compression_batch_get(int32 htid, FormData_hypertable_compression_batch *fd);
+extern TSDLLEXPORT void
+ts_hypertable_compression_batch_insert(FormData_hypertable_compression_batch *fd);
+extern TSDLLEXPORT bool ts_hypertable_compression_batch_delete_by_hypertable_id(int32 htid);
+
+extern TSDLLEXPORT List *ts_hypertable_compression_codec_get(int32 htid);
+extern TSDLLEXPORT void
+ts_hypertable_compression_codec_insert(FormData_hypertable_compression_codec *fd);
+extern TSDLLEXPORT bool ts_hypertable_compression_codec_delete_by_hypertable_id(int32 htid);
+extern TSDLLEXPORT void ts_hypertable_compression_codec_rename_column(int32 htid,
+																	  char *old_column_name,
+																	  char *new_column_name);
+
 #endif
@@ -576,6 +576,13 @@ ts_chunk_insert_state_create(Chunk *chunk, ChunkDispatch *dispatch)
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 				 errmsg("hypertables do not support row-level security")));
 
+	/* Rows inserted into a compressed chunk are staged in its uncompressed
+	 * relation, so conflicts with the compressed data cannot be detected */
+	if (chunk->fd.compressed_chunk_id != INVALID_CHUNK_ID && onconflict_action != ONCONFLICT_NONE)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("insert with ON CONFLICT clause is not supported on compressed chunks")));
+
 	/*
 	 * We must allocate the range table entry on the executor's per-query
 	 * context
@@ -391,12 +391,25 @@ policy_compression_execute(int32 job_id, Jsonb *config)
 	if (chunkid != INVALID_CHUNK_ID)
 	{
 		Chunk *chunk = ts_chunk_get_by_id(chunkid, true);
-		tsl_compress_chunk_wrapper(chunk, false);
 
-		elog(LOG,
-			 "completed compressing chunk %s.%s",
-			 NameStr(chunk->fd.schema_name),
-			 NameStr(chunk->fd.table_name));
+		if (chunk->fd.compressed_chunk_id != INVALID_CHUNK_ID)
+		{
+			tsl_recompress_chunk_wrapper(chunk, false);
+
+			elog(LOG,
+				 "completed recompressing chunk %s.%s",
+				 NameStr(chunk->fd.schema_name),
+				 NameStr(chunk->fd.table_name));
+		}
+		else
+		{
+			tsl_compress_chunk_wrapper(chunk, false);
+
+			elog(LOG,
+				 "completed compressing chunk %s.%s",
+				 NameStr(chunk->fd.schema_name),
+				 NameStr(chunk->fd.table_name));
+		}
 	}
 
 	chunkid = get_chunk_to_compress(dim, config);
@@ -0,0 +1,892 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+/*
+ * The compression advisor trial-compresses a sample of the rows of a chunk
+ * with candidate segmentby and orderby settings. It uses the same compressors
+ * as compress_chunk but keeps the compressed data in memory and never writes
+ * anything. For every candidate it reports:
+ *
+ *   compression_ratio: the size of the sampled rows divided by the estimated
+ *     size of the compressed rows built from them.
+ *   batch_fill_rate: how full the batches of the whole chunk would be, using
+ *     the number of rows of every segment extrapolated from the sample.
+ *   decompression_rows_per_second: how fast the compressed sample is bulk
+ *     decompressed.
+ *
+ * The sample spreads over all segments, so the segments of the sample are
+ * smaller than the ones of the chunk and the compression ratio is on the
+ * pessimistic side for candidates with many segments.
+ */
+#include <postgres.h>
+#include <access/heapam.h>
+#include <access/htup_details.h>
+#include <catalog/pg_type.h>
+#include <executor/tuptable.h>
+#include <funcapi.h>
+#include <miscadmin.h>
+#include <portability/instr_time.h>
+#include <utils/acl.h>
+#include <utils/array.h>
+#include <utils/builtins.h>
+#include <utils/datum.h>
+#include <utils/lsyscache.h>
+#include <utils/memutils.h>
+#include <utils/rel.h>
+#include <utils/snapmgr.h>
+#include <utils/tuplesort.h>
+#include <utils/typcache.h>
+
+#include "chunk.h"
+#include "compat.h"
+#include "compression_with_clause.h"
+#include "dimension.h"
+#include "hypertable.h"
+#include "hypertable_compression.h"
+
+#include "compression/advisor.h"
+#include "compression/compression.h"
+#include "compression/create.h"
+
+typedef struct AdvisorCandidate
+{
+	/* the settings as they are reported */
+	char *segmentby;
+	char *orderby;
+	/* List of CompressedParsedCol */
+	List *segmentby_cols;
+	List *orderby_cols;
+} AdvisorCandidate;
+
+typedef struct AdvisorResult
+{
+	double compression_ratio;
+	double batch_fill_rate;
+	/* NULL if the decompression was too fast to measure */
+	bool rows_per_second_isnull;
+	double rows_per_second;
+} AdvisorResult;
+
+typedef struct AdvisorState
+{
+	List *candidates;
+	AdvisorResult *results;
+	int next;
+} AdvisorState;
+
+/* the rows of the chunk that every candidate compresses */
+typedef struct AdvisorSample
+{
+	Relation rel;
+	HeapTuple *rows;
+	int num_rows;
+	/* the number of rows in the chunk */
+	double total_rows;
+	Size uncompressed_size;
+	int batch_rows;
+} AdvisorSample;
+
+typedef struct AdvisorColumn
+{
+	bool is_segmentby;
+	bool is_orderby;
+	Oid typid;
+	int16 typlen;
+	bool typbyval;
+	Oid collation;
+	/* the equality function of segmentby columns */
+	FmgrInfo eq_fn;
+	/* the compressor of all other columns */
+	Compressor *compressor;
+} AdvisorColumn;
+
+typedef struct AdvisorCompressedValue
+{
+	Datum value;
+	Oid typid;
+} AdvisorCompressedValue;
+
+/* the trial compression of the sample with one candidate */
+typedef struct AdvisorCompression
+{
+	AdvisorColumn *columns;
+	int num_columns;
+	/* segmentby values of the current segment */
+	Datum *segment_values;
+	bool *segment_isnull;
+	int segment_rows;
+	int batch_rows;
+	Size batch_metadata_size;
+	Size compressed_size;
+	/* rows and batches of the whole chunk extrapolated from the sample */
+	double estimated_rows;
+	double estimated_batches;
+	/* List of AdvisorCompressedValue */
+	List *compressed_values;
+} AdvisorCompression;
+
+static char *
+advisor_format_segmentby(List *segmentby_cols)
+{
+	StringInfoData buf;
+	ListCell *lc;
+
+	initStringInfo(&buf);
+	foreach (lc, segmentby_cols)
+	{
+		CompressedParsedCol *col = lfirst(lc);
+
+		appendStringInfo(&buf,
+						 "%s%s",
+						 buf.len > 0 ? ", " : "",
+						 quote_identifier(NameStr(col->colname)));
+	}
+	return buf.data;
+}
+
+static char *
+advisor_format_orderby(List *orderby_cols)
+{
+	StringInfoData buf;
+	ListCell *lc;
+
+	initStringInfo(&buf);
+	foreach (lc, orderby_cols)
+	{
+		CompressedParsedCol *col = lfirst(lc);
+
+		appendStringInfo(&buf,
+						 "%s%s%s",
+						 buf.len > 0 ? ", " : "",
+						 quote_identifier(NameStr(col->colname)),
+						 col->asc ? "" : " DESC");
+		/* only mention the null ordering if it is not the default of the direction */
+		if (col->nullsfirst == col->asc)
+			appendStringInfoString(&buf, col->nullsfirst ? " NULLS FIRST" : " NULLS LAST");
+	}
+	return buf.data;
+}
+
+static bool
+advisor_parsed_cols_contain(List *cols, const char *colname)
+{
+	ListCell *lc;
+
+	foreach (lc, cols)
+	{
+		CompressedParsedCol *col = lfirst(lc);
+
+		if (namestrcmp(&col->colname, colname) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Build a candidate the way ALTER TABLE SET (timescaledb.compress) would set
+ * it up: orderby columns that are segmentby columns are dropped and the time
+ * column is added to the orderby columns if it is not used yet.
+ */
+static AdvisorCandidate *
+advisor_candidate_create(Hypertable *ht, Relation rel, char *segmentby, char *orderby)
+{
+	AdvisorCandidate *candidate = palloc0(sizeof(*candidate));
+	Dimension *time_dim = hyperspace_get_open_dimension(ht->space, 0);
+	char *time_colname = get_attname(ht->main_table_relid, time_dim->column_attno, false);
+	List *orderby_cols = NIL;
+	ListCell *lc;
+
+	candidate->segmentby_cols = ts_compress_hypertable_parse_segment_by_string(segmentby, ht);
+	foreach (lc, ts_compress_hypertable_parse_order_by_string(orderby, ht))
+	{
+		CompressedParsedCol *col = lfirst(lc);
+
+		if (!advisor_parsed_cols_contain(candidate->segmentby_cols, NameStr(col->colname)))
+			orderby_cols = lappend(orderby_cols, col);
+	}
+
+	if (!advisor_parsed_cols_contain(candidate->segmentby_cols, time_colname) &&
+		!advisor_parsed_cols_contain(orderby_cols, time_colname))
+	{
+		CompressedParsedCol *col = palloc(sizeof(*col));
+
+		*col = (CompressedParsedCol){
+			.index = list_length(orderby_cols),
+			.asc = false,
+			.nullsfirst = true,
+		};
+		namestrcpy(&col->colname, time_colname);
+		orderby_cols = lappend(orderby_cols, col);
+	}
+	candidate->orderby_cols = orderby_cols;
+
+	foreach (lc, list_concat(list_copy(candidate->segmentby_cols), orderby_cols))
+	{
+		CompressedParsedCol *col = lfirst(lc);
+
+		if (get_attnum(RelationGetRelid(rel), NameStr(col->colname)) == InvalidAttrNumber)
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_COLUMN),
+					 errmsg("column \"%s\" does not exist", NameStr(col->colname))));
+	}
+
+	candidate->segmentby = advisor_format_segmentby(candidate->segmentby_cols);
+	candidate->orderby = advisor_format_orderby(candidate->orderby_cols);
+	return candidate;
+}
+
+/*
+ * The current compression settings of the hypertable, as they would be given
+ * to ALTER TABLE. Both are NULL if compression is not enabled.
+ */
+static void
+advisor_current_settings(Hypertable *ht, char **segmentby, char **orderby)
+{
+	List *settings = ts_hypertable_compression_get(ht->fd.id);
+	int num_settings = list_length(settings);
+	List *segmentby_cols = NIL;
+	List *orderby_cols = NIL;
+	int index;
+	ListCell *lc;
+
+	*segmentby = NULL;
+	*orderby = NULL;
+	if (settings == NIL)
+		return;
+
+	/* collect the columns in the order of their index */
+	for (index = 1; index <= num_settings; index++)
+	{
+		foreach (lc, settings)
+		{
+			FormData_hypertable_compression *fd = lfirst(lc);
+			CompressedParsedCol *col;
+
+			if (fd->segmentby_column_index != index && fd->orderby_column_index != index)
+				continue;
+
+			col = palloc(sizeof(*col));
+			*col = (CompressedParsedCol){
+				.index = index - 1,
+				.asc = fd->orderby_asc,
+				.nullsfirst = fd->orderby_nullsfirst,
+			};
+			namestrcpy(&col->colname, NameStr(fd->attname));
+
+			if (fd->segmentby_column_index == index)
+				segmentby_cols = lappend(segmentby_cols, col);
+			else
+				orderby_cols = lappend(orderby_cols, col);
+		}
+	}
+
+	*segmentby = advisor_format_segmentby(segmentby_cols);
+	*orderby = advisor_format_orderby(orderby_cols);
+}
+
+static List *
+advisor_string_list_append_unique(List *list, char *str)
+{
+	ListCell *lc;
+
+	foreach (lc, list)
+	{
+		if (strcmp(lfirst(lc), str) == 0)
+			return list;
+	}
+	return lappend(list, str);
+}
+
+static List *
+advisor_text_array_to_list(ArrayType *array, const char *argname)
+{
+	Datum *elems;
+	bool *nulls;
+	int num_elems;
+	List *list = NIL;
+	int i;
+
+	deconstruct_array(array, TEXTOID, -1, false, 'i', &elems, &nulls, &num_elems);
+	for (i = 0; i < num_elems; i++)
+	{
+		if (nulls[i])
+			ereport(ERROR,
+					(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+					 errmsg("%s must not contain NULL elements", argname)));
+		list = advisor_string_list_append_unique(list, TextDatumGetCString(elems[i]));
+	}
+	return list;
+}
+
+/*
+ * Without explicit candidates we try no segmentby columns, the current
+ * setting and every single column, except the time column, that can be
+ * sorted. The orderby columns default to the current setting, or to the
+ * time column.
+ */
+static List *
+advisor_default_segmentby_candidates(Hypertable *ht, Relation rel, char *current)
+{
+	TupleDesc desc = RelationGetDescr(rel);
+	Dimension *time_dim = hyperspace_get_open_dimension(ht->space, 0);
+	char *time_colname = get_attname(ht->main_table_relid, time_dim->column_attno, false);
+	List *candidates = list_make1(pstrdup(""));
+	int i;
+
+	if (current != NULL)
+		candidates = advisor_string_list_append_unique(candidates, current);
+
+	for (i = 0; i < desc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(desc, i);
+		TypeCacheEntry *tentry;
+
+		if (attr->attisdropped || strcmp(NameStr(attr->attname), time_colname) == 0)
+			continue;
+
+		tentry = lookup_type_cache(attr->atttypid, TYPECACHE_LT_OPR | TYPECACHE_EQ_OPR);
+		if (!OidIsValid(tentry->lt_opr) || !OidIsValid(tentry->eq_opr))
+			continue;
+
+		candidates =
+			advisor_string_list_append_unique(candidates,
+											  pstrdup(quote_identifier(NameStr(attr->attname))));
+	}
+
+	return candidates;
+}
+
+/*
+ * Sample the rows of the chunk with reservoir sampling while counting all of
+ * them.
+ */
+static void
+advisor_sample_rows(AdvisorSample *sample, int sample_size)
+{
+	TableScanDesc scan = table_beginscan(sample->rel, GetActiveSnapshot(), 0, NULL);
+	HeapTuple tuple;
+
+	sample->rows = palloc(sizeof(HeapTuple) * sample_size);
+	sample->num_rows = 0;
+	sample->total_rows = 0;
+
+	while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		sample->total_rows += 1;
+		if (sample->num_rows < sample_size)
+			sample->rows[sample->num_rows++] = heap_copytuple(tuple);
+		else
+		{
+			/* keep the row with a probability of sample_size / total_rows */
+			double pos = floor(((double) random() / ((double) MAX_RANDOM_VALUE + 1)) *
+							   sample->total_rows);
+
+			if (pos < sample_size)
+			{
+				heap_freetuple(sample->rows[(int) pos]);
+				sample->rows[(int) pos] = heap_copytuple(tuple);
+			}
+		}
+	}
+
+	heap_endscan(scan);
+
+	sample->uncompressed_size = 0;
+	for (int i = 0; i < sample->num_rows; i++)
+		sample->uncompressed_size += MAXALIGN(sample->rows[i]->t_len) + sizeof(ItemIdData);
+}
+
+static Tuplesortstate *
+advisor_sort_sample(AdvisorSample *sample, AdvisorCandidate *candidate)
+{
+	TupleDesc desc = RelationGetDescr(sample->rel);
+	int n_keys = list_length(candidate->segmentby_cols) + list_length(candidate->orderby_cols);
+	AttrNumber *sort_keys = palloc(sizeof(*sort_keys) * n_keys);
+	Oid *sort_operators = palloc(sizeof(*sort_operators) * n_keys);
+	Oid *sort_collations = palloc(sizeof(*sort_collations) * n_keys);
+	bool *nulls_first = palloc(sizeof(*nulls_first) * n_keys);
+	Tuplesortstate *sort;
+	TupleTableSlot *slot;
+	ListCell *lc;
+	int n = 0;
+
+	Assert(n_keys > 0);
+	foreach (lc, list_concat(list_copy(candidate->segmentby_cols), candidate->orderby_cols))
+	{
+		CompressedParsedCol *col = lfirst(lc);
+		bool is_segmentby = n < list_length(candidate->segmentby_cols);
+		AttrNumber attno = get_attnum(RelationGetRelid(sample->rel), NameStr(col->colname));
+		Form_pg_attribute attr = TupleDescAttr(desc, AttrNumberGetAttrOffset(attno));
+		TypeCacheEntry *tentry =
+			lookup_type_cache(attr->atttypid, TYPECACHE_LT_OPR | TYPECACHE_GT_OPR);
+
+		sort_keys[n] = attno;
+		sort_collations[n] = attr->attcollation;
+		sort_operators[n] = (is_segmentby || col->asc) ? tentry->lt_opr : tentry->gt_opr;
+		nulls_first[n] = !is_segmentby && col->nullsfirst;
+
+		if (!OidIsValid(sort_operators[n]))
+			elog(ERROR,
+				 "no valid sort operator for column \"%s\" of type \"%s\"",
+				 NameStr(col->colname),
+				 format_type_be(attr->atttypid));
+		n++;
+	}
+
+	sort = tuplesort_begin_heap(desc,
+								n_keys,
+								sort_keys,
+								sort_operators,
+								sort_collations,
+								nulls_first,
+								work_mem,
+								NULL,
+								false /*=randomAccess*/);
+
+	slot = MakeSingleTupleTableSlotCompat(desc, TTSOpsHeapTupleP);
+	for (n = 0; n < sample->num_rows; n++)
+	{
+		ExecStoreHeapTupleCompat(sample->rows[n], slot, false);
+		tuplesort_puttupleslot(sort, slot);
+	}
+	ExecDropSingleTupleTableSlot(slot);
+
+	tuplesort_performsort(sort);
+	return sort;
+}
+
+static void
+advisor_compression_init(AdvisorCompression *compression, AdvisorSample *sample,
+						 AdvisorCandidate *candidate)
+{
+	TupleDesc desc = RelationGetDescr(sample->rel);
+	int i;
+
+	*compression = (AdvisorCompression){
+		.columns = palloc0(sizeof(AdvisorColumn) * desc->natts),
+		.num_columns = desc->natts,
+		.segment_values = palloc0(sizeof(Datum) * desc->natts),
+		.segment_isnull = palloc0(sizeof(bool) * desc->natts),
+	};
+
+	for (i = 0; i < desc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(desc, i);
+		AdvisorColumn *column = &compression->columns[i];
+
+		if (attr->attisdropped)
+			continue;
+
+		column->typid = attr->atttypid;
+		column->typlen = attr->attlen;
+		column->typbyval = attr->attbyval;
+		column->collation = attr->attcollation;
+		column->is_segmentby =
+			advisor_parsed_cols_contain(candidate->segmentby_cols, NameStr(attr->attname));
+		column->is_orderby =
+			advisor_parsed_cols_contain(candidate->orderby_cols, NameStr(attr->attname));
+
+		if (column->is_segmentby)
+		{
+			TypeCacheEntry *tentry = lookup_type_cache(attr->atttypid, TYPECACHE_EQ_OPR_FINFO);
+
+			if (!OidIsValid(tentry->eq_opr_finfo.fn_oid))
+				elog(ERROR, "no equality function for column \"%s\"", NameStr(attr->attname));
+			fmgr_info(tentry->eq_opr_finfo.fn_oid, &column->eq_fn);
+		}
+		else
+		{
+			/*
+			 * Always use the regular algorithms, the shared dictionaries would
+			 * need a dictionary id from the catalog.
+			 */
+			column->compressor =
+				compressor_for_algorithm_and_type(compression_get_default_algorithm_id(
+													  attr->atttypid),
+												  attr->atttypid);
+		}
+	}
+}
+
+static bool
+advisor_is_new_segment(AdvisorCompression *compression, TupleTableSlot *slot)
+{
+	int i;
+
+	for (i = 0; i < compression->num_columns; i++)
+	{
+		AdvisorColumn *column = &compression->columns[i];
+		bool isnull;
+		Datum value;
+
+		if (!column->is_segmentby)
+			continue;
+
+		value = slot_getattr(slot, AttrOffsetGetAttrNumber(i), &isnull);
+		if (isnull != compression->segment_isnull[i])
+			return true;
+		if (!isnull && !DatumGetBool(FunctionCall2Coll(&column->eq_fn,
+													   column->collation,
+													   value,
+													   compression->segment_values[i])))
+			return true;
+	}
+
+	return false;
+}
+
+static void
+advisor_start_segment(AdvisorCompression *compression, TupleTableSlot *slot)
+{
+	int i;
+
+	for (i = 0; i < compression->num_columns; i++)
+	{
+		AdvisorColumn *column = &compression->columns[i];
+		bool isnull;
+		Datum value;
+
+		if (!column->is_segmentby)
+			continue;
+
+		value = slot_getattr(slot, AttrOffsetGetAttrNumber(i), &isnull);
+		compression->segment_isnull[i] = isnull;
+		compression->segment_values[i] =
+			isnull ? (Datum) 0 : datumCopy(value, column->typbyval, column->typlen);
+	}
+	compression->segment_rows = 0;
+}
+
+static void
+advisor_end_segment(AdvisorCompression *compression, AdvisorSample *sample)
+{
+	double estimated_rows =
+		compression->segment_rows * sample->total_rows / Max(sample->num_rows, 1);
+
+	compression->estimated_rows += estimated_rows;
+	compression->estimated_batches += ceil(estimated_rows / sample->batch_rows);
+}
+
+/*
+ * Finish the current batch and add the estimated size of the compressed row
+ * holding it.
+ */
+static void
+advisor_flush_batch(AdvisorCompression *compression)
+{
+	/* the count and sequence number metadata columns */
+	Size row_size = MAXALIGN(SizeofHeapTupleHeader + BITMAPLEN(compression->num_columns + 2)) +
+					sizeof(ItemIdData) + 2 * sizeof(int32) + compression->batch_metadata_size;
+	int i;
+
+	for (i = 0; i < compression->num_columns; i++)
+	{
+		AdvisorColumn *column = &compression->columns[i];
+
+		if (column->is_segmentby && !compression->segment_isnull[i])
+			row_size +=
+				datumGetSize(compression->segment_values[i], column->typbyval, column->typlen);
+		else if (column->compressor != NULL)
+		{
+			void *compressed = column->compressor->finish(column->compressor);
+
+			if (compressed != NULL)
+			{
+				AdvisorCompressedValue *value = palloc(sizeof(*value));
+
+				*value = (AdvisorCompressedValue){
+					.value = PointerGetDatum(compressed),
+					.typid = column->typid,
+				};
+				compression->compressed_values = lappend(compression->compressed_values, value);
+				row_size += VARSIZE(compressed);
+			}
+		}
+	}
+
+	compression->compressed_size += row_size;
+	compression->batch_rows = 0;
+	compression->batch_metadata_size = 0;
+}
+
+static void
+advisor_append_row(AdvisorCompression *compression, TupleTableSlot *slot)
+{
+	int i;
+
+	for (i = 0; i < compression->num_columns; i++)
+	{
+		AdvisorColumn *column = &compression->columns[i];
+		bool isnull;
+		Datum value;
+
+		if (column->compressor == NULL)
+			continue;
+
+		value = slot_getattr(slot, AttrOffsetGetAttrNumber(i), &isnull);
+		if (isnull)
+			column->compressor->append_null(column->compressor);
+		else
+		{
+			column->compressor->append_val(column->compressor, value);
+
+			/* the min and max metadata of orderby columns */
+			if (column->is_orderby && compression->batch_rows == 0)
+				compression->batch_metadata_size +=
+					2 * datumGetSize(value, column->typbyval, column->typlen);
+		}
+	}
+
+	compression->batch_rows++;
+	compression->segment_rows++;
+}
+
+static double
+advisor_decompression_seconds(AdvisorCompression *compression)
+{
+	MemoryContext decompress_ctx = AllocSetContextCreate(CurrentMemoryContext,
+														 "compression advisor decompression",
+														 ALLOCSET_DEFAULT_SIZES);
+	MemoryContext old_ctx = MemoryContextSwitchTo(decompress_ctx);
+	instr_time start;
+	instr_time duration;
+	ListCell *lc;
+
+	INSTR_TIME_SET_CURRENT(start);
+	foreach (lc, compression->compressed_values)
+	{
+		AdvisorCompressedValue *value = lfirst(lc);
+		CompressedDataHeader *header = (CompressedDataHeader *) DatumGetPointer(value->value);
+
+		tsl_get_decompress_all_function(header->compression_algorithm)(value->value,
+																		value->typid);
+		MemoryContextReset(decompress_ctx);
+	}
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	MemoryContextSwitchTo(old_ctx);
+	MemoryContextDelete(decompress_ctx);
+	return INSTR_TIME_GET_DOUBLE(duration);
+}
+
+static void
+advisor_evaluate(AdvisorSample *sample, AdvisorCandidate *candidate, AdvisorResult *result)
+{
+	AdvisorCompression compression;
+	Tuplesortstate *sort = advisor_sort_sample(sample, candidate);
+	TupleTableSlot *slot =
+		MakeSingleTupleTableSlotCompat(RelationGetDescr(sample->rel), TTSOpsMinimalTupleP);
+	bool first = true;
+	double seconds;
+
+	advisor_compression_init(&compression, sample, candidate);
+
+	while (tuplesort_gettupleslot(sort, true /*=forward*/, false /*=copy*/, slot, NULL))
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		slot_getallattrs(slot);
+		if (first || advisor_is_new_segment(&compression, slot))
+		{
+			if (!first)
+			{
+				advisor_flush_batch(&compression);
+				advisor_end_segment(&compression, sample);
+			}
+			advisor_start_segment(&compression, slot);
+			first = false;
+		}
+		else if (compression.batch_rows >= sample->batch_rows)
+			advisor_flush_batch(&compression);
+
+		advisor_append_row(&compression, slot);
+	}
+
+	if (!first)
+	{
+		advisor_flush_batch(&compression);
+		advisor_end_segment(&compression, sample);
+	}
+
+	ExecDropSingleTupleTableSlot(slot);
+	tuplesort_end(sort);
+
+	result->compression_ratio =
+		compression.compressed_size > 0 ?
+			(double) sample->uncompressed_size / compression.compressed_size :
+			0;
+	result->batch_fill_rate =
+		compression.estimated_batches > 0 ?
+			compression.estimated_rows / (compression.estimated_batches * sample->batch_rows) :
+			0;
+
+	seconds = advisor_decompression_seconds(&compression);
+	result->rows_per_second_isnull = seconds <= 0;
+	result->rows_per_second = seconds > 0 ? sample->num_rows / seconds : 0;
+}
+
+static AdvisorState *
+advisor_run(FunctionCallInfo fcinfo)
+{
+	Oid relid = PG_ARGISNULL(0) ? InvalidOid : PG_GETARG_OID(0);
+	int32 sample_size = PG_ARGISNULL(3) ? 0 : PG_GETARG_INT32(3);
+	AdvisorState *state = palloc0(sizeof(*state));
+	MemoryContext result_ctx = CurrentMemoryContext;
+	MemoryContext work_ctx;
+	MemoryContext candidate_ctx;
+	FormData_hypertable_compression_batch batch_fd;
+	AdvisorSample sample = { 0 };
+	char *current_segmentby;
+	char *current_orderby;
+	List *segmentby_strings;
+	List *orderby_strings;
+	AclResult aclresult;
+	Hypertable *ht;
+	Chunk *chunk;
+	ListCell *lc_seg;
+	ListCell *lc_ord;
+	ListCell *lc;
+	int i;
+
+	if (!OidIsValid(relid))
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("invalid chunk")));
+
+	if (sample_size <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("sample size must be greater than zero")));
+
+	chunk = ts_chunk_get_by_relid(relid, false);
+	if (chunk == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("\"%s\" is not a chunk", get_rel_name(relid))));
+
+	if (chunk->relkind != RELKIND_RELATION)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("compression advisor is not supported on distributed chunks")));
+
+	if (chunk->fd.compressed_chunk_id != INVALID_CHUNK_ID)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("chunk \"%s\" is compressed", get_rel_name(relid)),
+				 errhint("Run the advisor on an uncompressed chunk.")));
+
+	aclresult = pg_class_aclcheck(relid, GetUserId(), ACL_SELECT);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, get_relkind_objtype(chunk->relkind), get_rel_name(relid));
+
+	ht = ts_hypertable_get_by_id(chunk->fd.hypertable_id);
+	sample.rel = table_open(relid, AccessShareLock);
+	sample.batch_rows = COMPRESSION_DEFAULT_BATCH_SIZE;
+	if (ts_hypertable_compression_batch_get(ht->fd.id, &batch_fd) && batch_fd.batch_size > 0)
+		sample.batch_rows = batch_fd.batch_size;
+
+	/* the candidates are returned, so they live in the context of the result */
+	advisor_current_settings(ht, &current_segmentby, &current_orderby);
+	if (PG_ARGISNULL(1))
+		segmentby_strings = advisor_default_segmentby_candidates(ht, sample.rel, current_segmentby);
+	else
+		segmentby_strings = advisor_text_array_to_list(PG_GETARG_ARRAYTYPE_P(1), "segmentby");
+	if (PG_ARGISNULL(2))
+		orderby_strings = list_make1(current_orderby != NULL ? current_orderby : pstrdup(""));
+	else
+		orderby_strings = advisor_text_array_to_list(PG_GETARG_ARRAYTYPE_P(2), "orderby");
+
+	foreach (lc_seg, segmentby_strings)
+	{
+		foreach (lc_ord, orderby_strings)
+			state->candidates = lappend(state->candidates,
+										advisor_candidate_create(ht,
+																 sample.rel,
+																 lfirst(lc_seg),
+																 lfirst(lc_ord)));
+	}
+	state->results = palloc0(sizeof(AdvisorResult) * Max(list_length(state->candidates), 1));
+
+	work_ctx =
+		AllocSetContextCreate(result_ctx, "compression advisor", ALLOCSET_DEFAULT_SIZES);
+	candidate_ctx =
+		AllocSetContextCreate(work_ctx, "compression advisor candidate", ALLOCSET_DEFAULT_SIZES);
+	MemoryContextSwitchTo(work_ctx);
+
+	advisor_sample_rows(&sample, sample_size);
+
+	i = 0;
+	foreach (lc, state->candidates)
+	{
+		MemoryContextSwitchTo(candidate_ctx);
+		advisor_evaluate(&sample, lfirst(lc), &state->results[i++]);
+		MemoryContextReset(candidate_ctx);
+	}
+
+	MemoryContextSwitchTo(result_ctx);
+	MemoryContextDelete(work_ctx);
+	table_close(sample.rel, NoLock);
+
+	return state;
+}
+
+/*
+ * compression_advisor(chunk REGCLASS, segmentby TEXT[], orderby TEXT[], sample_size INTEGER)
+ *
+ * Returns one row for every combination of the segmentby and orderby
+ * candidates.
+ */
+Datum
+tsl_compression_advisor(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *funcctx;
+	AdvisorState *state;
+	AdvisorCandidate *candidate;
+	AdvisorResult *result;
+	Datum values[5];
+	bool nulls[5] = { false };
+	HeapTuple tuple;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("function returning record called in context "
+							"that cannot accept type record")));
+
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+		funcctx->user_fctx = advisor_run(fcinfo);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	state = funcctx->user_fctx;
+
+	if (state->next >= list_length(state->candidates))
+		SRF_RETURN_DONE(funcctx);
+
+	candidate = list_nth(state->candidates, state->next);
+	result = &state->results[state->next];
+	state->next++;
+
+	values[0] = CStringGetTextDatum(candidate->segmentby);
+	values[1] = CStringGetTextDatum(candidate->orderby);
+	values[2] = Float8GetDatum(result->compression_ratio);
+	values[3] = Float8GetDatum(result->batch_fill_rate);
+	values[4] = Float8GetDatum(result->rows_per_second);
+	nulls[4] = result->rows_per_second_isnull;
+
+	tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+	SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+}
@@ -0,0 +1,715 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+#include "compression/alp.h"
+
+#include <math.h>
+
+#include <catalog/pg_type.h>
+#include <utils/builtins.h>
+#include <funcapi.h>
+#include <lib/stringinfo.h>
+#include <libpq/pqformat.h>
+
+#include <adts/uint64_vec.h>
+
+#include "compression/compression.h"
+#include "compression/detoast_reader.h"
+#include "compression/for.h"
+#include "compression/simple8b_rle.h"
+#include "compression/utils.h"
+
+/*
+ * ALP compressed data is stored as
+ *     the compressed data header
+ *     uint8 has_nulls: 1 if we store a NULLs bitmap at the end, otherwise 0
+ *     uint8 exponent: the power of ten the values were scaled by
+ *     uint8 is_float4: 1 if the values round-trip at float4 rather than float8 precision
+ *     uint32 num_exceptions: the number of values stored verbatim
+ *     FOR compressed encoded integers, one per non-null value; exceptions hold a placeholder
+ *     uint32 exception_positions[num_exceptions], padded to 8 bytes
+ *     uint64 exceptions[num_exceptions]: the float8 bits of the exceptions
+ *     optional simple8b_rle nulls bitmap
+ */
+typedef struct AlpCompressed
+{
+	CompressedDataHeaderFields;
+	uint8 has_nulls;
+	uint8 exponent;
+	uint8 is_float4;
+	uint32 num_exceptions;
+	uint8 padding[4];
+} AlpCompressed;
+
+static void
+pg_attribute_unused() assertions(void)
+{
+	AlpCompressed test_val = { { 0 } };
+	/* make sure no padding bytes make it to disk */
+	StaticAssertStmt(sizeof(AlpCompressed) ==
+						 sizeof(test_val.vl_len_) + sizeof(test_val.compression_algorithm) +
+							 sizeof(test_val.has_nulls) + sizeof(test_val.exponent) +
+							 sizeof(test_val.is_float4) + sizeof(test_val.num_exceptions) +
+							 sizeof(test_val.padding),
+					 "AlpCompressed wrong size");
+	StaticAssertStmt(sizeof(AlpCompressed) == 16, "AlpCompressed wrong size");
+}
+
+/* expanded version of the compressed data */
+typedef struct AlpData
+{
+	const AlpCompressed *header;
+	const ForCompressed *encoded;
+	const uint32 *exception_positions;
+	const uint64 *exceptions;
+	Simple8bRleSerialized *nulls; /* NULL if no nulls */
+} AlpData;
+
+typedef struct AlpCompressor
+{
+	/* the float8 bits of the non-null values */
+	uint64_vec values;
+	Simple8bRleCompressor nulls;
+	bool has_nulls;
+	bool is_float4;
+} AlpCompressor;
+
+typedef struct ExtendedCompressor
+{
+	Compressor base;
+	AlpCompressor *internal;
+	Oid element_type;
+} ExtendedCompressor;
+
+/*
+ * ALP decompresses the whole batch up front, the iterators only walk over the
+ * decompressed rows.
+ */
+typedef struct AlpDecompressionIterator
+{
+	DecompressionIterator base;
+	DecompressedBatch *batch;
+	uint32 num_returned;
+} AlpDecompressionIterator;
+
+/* the largest exponents for which a float8 and float4 can still have a fractional part */
+#define ALP_MAX_EXPONENT_FLOAT8 18
+#define ALP_MAX_EXPONENT_FLOAT4 10
+
+/* number of values sampled to choose the exponent */
+#define ALP_SAMPLE_SIZE 64
+
+/* storage cost of an exception: its position and value */
+#define ALP_EXCEPTION_BITS (32 + 64)
+
+/* scaled values must fit into an int64 with room to spare, 2^62 */
+#define ALP_ENCODING_LIMIT 4611686018427387904.0
+
+static const double alp_powers_of_ten[ALP_MAX_EXPONENT_FLOAT8 + 1] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,
+	1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+};
+
+/********************
+ *****  UTILS  *****
+ ********************/
+
+static inline double
+alp_decode_one(int64 encoded, uint8 exponent)
+{
+	return (double) encoded / alp_powers_of_ten[exponent];
+}
+
+/*
+ * Encode a value as an integer scaled by 10^exponent. Returns false if the
+ * integer does not decode back to exactly the same value. This also rejects
+ * NaN, infinities and negative zero.
+ */
+static inline bool
+alp_encode_one(double value, uint8 exponent, bool is_float4, int64 *encoded)
+{
+	double scaled = value * alp_powers_of_ten[exponent];
+	int64 candidate;
+
+	if (!(scaled > -ALP_ENCODING_LIMIT && scaled < ALP_ENCODING_LIMIT))
+		return false;
+
+	candidate = (int64) rint(scaled);
+
+	if (is_float4)
+	{
+		if (float_get_bits((float4) alp_decode_one(candidate, exponent)) !=
+			float_get_bits((float4) value))
+			return false;
+	}
+	else if (double_get_bits(alp_decode_one(candidate, exponent)) != double_get_bits(value))
+		return false;
+
+	*encoded = candidate;
+	return true;
+}
+
+static inline Size
+alp_exception_positions_size(uint32 num_exceptions)
+{
+	return TYPEALIGN(sizeof(uint64), sizeof(uint32) * num_exceptions);
+}
+
+static void
+alp_data_init_from_pointer(AlpData *data, const AlpCompressed *header)
+{
+	const char *ptr = ((const char *) header) + sizeof(AlpCompressed);
+
+	Assert(header->has_nulls == 0 || header->has_nulls == 1);
+
+	data->header = header;
+	data->encoded = (const ForCompressed *) ptr;
+	ptr += VARSIZE(data->encoded);
+	data->exception_positions = (const uint32 *) ptr;
+	ptr += alp_exception_positions_size(header->num_exceptions);
+	data->exceptions = (const uint64 *) ptr;
+	ptr += sizeof(uint64) * header->num_exceptions;
+	data->nulls = header->has_nulls ? bytes_deserialize_simple8b_and_advance(&ptr) : NULL;
+}
+
+static AlpCompressed *
+alp_from_parts(uint8 exponent, bool is_float4, const ForCompressed *encoded, uint32 num_exceptions,
+			   const uint32 *exception_positions, const uint64 *exceptions,
+			   Simple8bRleSerialized *nulls)
+{
+	Size nulls_size = nulls != NULL ? simple8brle_serialized_total_size(nulls) : 0;
+	Size compressed_size = sizeof(AlpCompressed) + VARSIZE(encoded) +
+						   alp_exception_positions_size(num_exceptions) +
+						   sizeof(uint64) * num_exceptions + nulls_size;
+	AlpCompressed *compressed;
+	char *data;
+
+	if (!AllocSizeIsValid(compressed_size))
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("compressed size exceeds the maximum allowed (%d)", (int) MaxAllocSize)));
+
+	/* palloc0 so that the padding bytes are zeroed */
+	compressed = palloc0(compressed_size);
+	SET_VARSIZE(&compressed->vl_len_, compressed_size);
+
+	compressed->compression_algorithm = COMPRESSION_ALGORITHM_ALP;
+	compressed->has_nulls = nulls != NULL ? 1 : 0;
+	compressed->exponent = exponent;
+	compressed->is_float4 = is_float4 ? 1 : 0;
+	compressed->num_exceptions = num_exceptions;
+
+	data = ((char *) compressed) + sizeof(AlpCompressed);
+	memcpy(data, encoded, VARSIZE(encoded));
+	data += VARSIZE(encoded);
+	if (num_exceptions > 0)
+	{
+		memcpy(data, exception_positions, sizeof(uint32) * num_exceptions);
+		data += alp_exception_positions_size(num_exceptions);
+		memcpy(data, exceptions, sizeof(uint64) * num_exceptions);
+		data += sizeof(uint64) * num_exceptions;
+	}
+
+	if (nulls != NULL)
+	{
+		Assert(nulls->num_elements > for_compressed_num_values(encoded));
+		bytes_serialize_simple8b_and_advance(data, nulls_size, nulls);
+	}
+
+	return compressed;
+}
+
+/*******************
+ ***  Compressor  ***
+ *******************/
+
+AlpCompressor *
+alp_compressor_alloc(Oid element_type)
+{
+	AlpCompressor *compressor = palloc0(sizeof(*compressor));
+
+	Assert(element_type == FLOAT4OID || element_type == FLOAT8OID);
+
+	uint64_vec_init(&compressor->values, CurrentMemoryContext, 0);
+	simple8brle_compressor_init(&compressor->nulls);
+	compressor->is_float4 = element_type == FLOAT4OID;
+	return compressor;
+}
+
+void
+alp_compressor_free(AlpCompressor *compressor)
+{
+	uint64_vec_free_data(&compressor->values);
+	pfree(compressor);
+}
+
+void
+alp_compressor_append_null(AlpCompressor *compressor)
+{
+	compressor->has_nulls = true;
+	simple8brle_compressor_append(&compressor->nulls, 1);
+}
+
+void
+alp_compressor_append_value(AlpCompressor *compressor, double next_val)
+{
+	uint64_vec_append(&compressor->values, double_get_bits(next_val));
+	simple8brle_compressor_append(&compressor->nulls, 0);
+}
+
+/*
+ * Choose the exponent by estimating the encoded size of a sample of the
+ * values: the bit width of the encoded integers, which the exceptions take up
+ * as well, plus the cost of storing the exceptions. On a tie we keep the
+ * smaller exponent.
+ */
+static uint8
+alp_choose_exponent(const AlpCompressor *compressor)
+{
+	const uint32 num_values = compressor->values.num_elements;
+	const uint32 step = Max(1, num_values / ALP_SAMPLE_SIZE);
+	const uint8 max_exponent =
+		compressor->is_float4 ? ALP_MAX_EXPONENT_FLOAT4 : ALP_MAX_EXPONENT_FLOAT8;
+	uint8 best_exponent = 0;
+	uint64 best_cost = ~UINT64CONST(0);
+	uint8 exponent;
+
+	for (exponent = 0; exponent <= max_exponent; exponent++)
+	{
+		uint32 num_encoded = 0;
+		uint32 num_exceptions = 0;
+		int64 min_val = 0;
+		int64 max_val = 0;
+		uint64 cost;
+		uint32 i;
+
+		for (i = 0; i < num_values; i += step)
+		{
+			int64 encoded;
+
+			if (!alp_encode_one(bits_get_double(compressor->values.data[i]),
+								exponent,
+								compressor->is_float4,
+								&encoded))
+			{
+				num_exceptions++;
+				continue;
+			}
+
+			if (num_encoded == 0)
+				min_val = max_val = encoded;
+			min_val = Min(min_val, encoded);
+			max_val = Max(max_val, encoded);
+			num_encoded++;
+		}
+
+		cost = (uint64) (num_encoded + num_exceptions) * for_bit_width(min_val, max_val) +
+			   (uint64) num_exceptions * ALP_EXCEPTION_BITS;
+		if (cost < best_cost)
+		{
+			best_cost = cost;
+			best_exponent = exponent;
+		}
+	}
+
+	return best_exponent;
+}
+
+void *
+alp_compressor_finish(AlpCompressor *compressor)
+{
+	Simple8bRleSerialized *nulls = simple8brle_compressor_finish(&compressor->nulls);
+	const uint32 num_values = compressor->values.num_elements;
+	uint8 exponent;
+	uint64 *encoded;
+	uint32 *exception_positions;
+	uint64 *exceptions;
+	uint32 num_exceptions = 0;
+	bool has_encoded = false;
+	int64 min_val = 0;
+	int64 max_val = 0;
+	ForCompressed *encoded_compressed;
+	AlpCompressed *compressed;
+	uint32 i;
+
+	if (num_values == 0)
+		return NULL;
+
+	exponent = alp_choose_exponent(compressor);
+
+	encoded = palloc(sizeof(uint64) * num_values);
+	exception_positions = palloc(sizeof(uint32) * num_values);
+	exceptions = palloc(sizeof(uint64) * num_values);
+
+	for (i = 0; i < num_values; i++)
+	{
+		const uint64 bits = compressor->values.data[i];
+		int64 value;
+
+		if (!alp_encode_one(bits_get_double(bits), exponent, compressor->is_float4, &value))
+		{
+			exception_positions[num_exceptions] = i;
+			exceptions[num_exceptions] = bits;
+			num_exceptions++;
+			continue;
+		}
+
+		if (!has_encoded)
+			min_val = max_val = value;
+		min_val = Min(min_val, value);
+		max_val = Max(max_val, value);
+		has_encoded = true;
+		encoded[i] = (uint64) value;
+	}
+
+	/* exceptions get a placeholder from within the range, so they do not widen it */
+	for (i = 0; i < num_exceptions; i++)
+		encoded[exception_positions[i]] = (uint64) min_val;
+
+	encoded_compressed = for_compressed_from_values(encoded, num_values, min_val, max_val, NULL);
+	compressed = alp_from_parts(exponent,
+								compressor->is_float4,
+								encoded_compressed,
+								num_exceptions,
+								exception_positions,
+								exceptions,
+								compressor->has_nulls ? nulls : NULL);
+
+	pfree(encoded_compressed);
+	pfree(encoded);
+	pfree(exception_positions);
+	pfree(exceptions);
+
+	return compressed;
+}
+
+static void
+alp_compressor_append_float(Compressor *compressor, Datum val)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = alp_compressor_alloc(extended->element_type);
+
+	alp_compressor_append_value(extended->internal, DatumGetFloat4(val));
+}
+
+static void
+alp_compressor_append_double(Compressor *compressor, Datum val)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = alp_compressor_alloc(extended->element_type);
+
+	alp_compressor_append_value(extended->internal, DatumGetFloat8(val));
+}
+
+static void
+alp_compressor_append_null_value(Compressor *compressor)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = alp_compressor_alloc(extended->element_type);
+
+	alp_compressor_append_null(extended->internal);
+}
+
+static void *
+alp_compressor_finish_and_reset(Compressor *compressor)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	void *compressed = alp_compressor_finish(extended->internal);
+	alp_compressor_free(extended->internal);
+	extended->internal = NULL;
+	return compressed;
+}
+
+const Compressor alp_float_compressor = {
+	.append_val = alp_compressor_append_float,
+	.append_null = alp_compressor_append_null_value,
+	.finish = alp_compressor_finish_and_reset,
+};
+
+const Compressor alp_double_compressor = {
+	.append_val = alp_compressor_append_double,
+	.append_null = alp_compressor_append_null_value,
+	.finish = alp_compressor_finish_and_reset,
+};
+
+Compressor *
+alp_compressor_for_type(Oid element_type)
+{
+	ExtendedCompressor *compressor = palloc(sizeof(*compressor));
+	switch (element_type)
+	{
+		case FLOAT4OID:
+			*compressor = (ExtendedCompressor){ .base = alp_float_compressor,
+												.element_type = element_type };
+			return &compressor->base;
+		case FLOAT8OID:
+			*compressor = (ExtendedCompressor){ .base = alp_double_compressor,
+												.element_type = element_type };
+			return &compressor->base;
+		default:
+			elog(ERROR, "invalid type for ALP compression \"%s\"", format_type_be(element_type));
+	}
+	pg_unreachable();
+}
+
+/****************************
+ ***  Bulk decompression  ***
+ ****************************/
+
+/*
+ * The sections are read one at a time, so a large value that is still toasted
+ * is read in slices. The nulls are read first to size the batch; their offset
+ * follows from the sizes of the other sections.
+ */
+DecompressedBatch *
+alp_decompress_all(Datum alp_compressed, Oid element_type)
+{
+	DetoastReader reader;
+	AlpCompressed header;
+	DecompressedBatch *batch;
+	const ForCompressed *for_encoded;
+	const char *exceptions;
+	Size offset = sizeof(AlpCompressed);
+	Size encoded_size;
+	Size positions_size;
+	uint64 *is_null = NULL;
+	uint32 num_values;
+	uint32 num_rows = 0;
+	uint64 *encoded;
+	double divisor;
+	uint32 i;
+
+	detoast_reader_init(&reader, alp_compressed);
+	header = *(const AlpCompressed *) detoast_reader_read(&reader, 0, sizeof(AlpCompressed));
+	Assert(header.has_nulls == 0 || header.has_nulls == 1);
+
+	if (header.exponent > ALP_MAX_EXPONENT_FLOAT8)
+		elog(ERROR, "the compressed data is corrupt: invalid ALP exponent");
+
+	for_encoded = (const ForCompressed *) detoast_reader_read(&reader, offset, VARHDRSZ);
+	encoded_size = VARSIZE(for_encoded);
+	positions_size = alp_exception_positions_size(header.num_exceptions);
+
+	if (header.has_nulls)
+	{
+		Size nulls_offset = offset + encoded_size + positions_size +
+							sizeof(uint64) * header.num_exceptions;
+		Simple8bRleSerialized *nulls = detoast_reader_read_simple8b(&reader, &nulls_offset);
+
+		num_rows = nulls->num_elements;
+		is_null = simple8brle_decompress_all(nulls);
+	}
+
+	for_encoded = (const ForCompressed *) detoast_reader_read(&reader, offset, encoded_size);
+	offset += encoded_size;
+	num_values = for_compressed_num_values(for_encoded);
+
+	batch = decompressed_batch_alloc(element_type, is_null != NULL ? num_rows : num_values);
+
+	encoded = palloc(sizeof(uint64) * Max(num_values, 1));
+	for_unpack_values(for_encoded, encoded);
+	divisor = alp_powers_of_ten[header.exponent];
+
+	/* the type dispatch is hoisted out of the loops, so that they vectorize */
+	switch (element_type)
+	{
+		case FLOAT8OID:
+			for (i = 0; i < num_values; i++)
+				batch->values[i] = Float8GetDatum((double) (int64) encoded[i] / divisor);
+			break;
+		case FLOAT4OID:
+			for (i = 0; i < num_values; i++)
+				batch->values[i] = Float4GetDatum((float4) ((double) (int64) encoded[i] / divisor));
+			break;
+		default:
+			elog(ERROR,
+				 "invalid type requested from ALP decompression \"%s\"",
+				 format_type_be(element_type));
+	}
+
+	pfree(encoded);
+
+	/* the exception positions and values are read together */
+	exceptions = detoast_reader_read(&reader,
+									 offset,
+									 positions_size + sizeof(uint64) * header.num_exceptions);
+	for (i = 0; i < header.num_exceptions; i++)
+	{
+		uint32 position = ((const uint32 *) exceptions)[i];
+		double value = bits_get_double(((const uint64 *) (exceptions + positions_size))[i]);
+
+		if (position >= num_values)
+			elog(ERROR, "the compressed data is corrupt: invalid ALP exception position");
+
+		batch->values[position] =
+			element_type == FLOAT4OID ? Float4GetDatum((float4) value) : Float8GetDatum(value);
+	}
+	detoast_reader_free(&reader);
+
+	if (is_null != NULL)
+	{
+		decompressed_batch_spread_nulls(batch, is_null, num_values);
+		pfree(is_null);
+	}
+
+	return batch;
+}
+
+/*******************************
+ ***  Decompression Iterator  ***
+ *******************************/
+
+static DecompressionIterator *
+alp_decompression_iterator_init(Datum alp_compressed, Oid element_type, bool forward)
+{
+	AlpDecompressionIterator *iter = palloc(sizeof(*iter));
+
+	*iter = (AlpDecompressionIterator){
+		.base = {
+			.compression_algorithm = COMPRESSION_ALGORITHM_ALP,
+			.forward = forward,
+			.element_type = element_type,
+			.try_next = forward ? alp_decompression_iterator_try_next_forward :
+								  alp_decompression_iterator_try_next_reverse,
+		},
+		.batch = alp_decompress_all(alp_compressed, element_type),
+		.num_returned = 0,
+	};
+
+	return &iter->base;
+}
+
+DecompressionIterator *
+alp_decompression_iterator_from_datum_forward(Datum alp_compressed, Oid element_type)
+{
+	return alp_decompression_iterator_init(alp_compressed, element_type, true);
+}
+
+DecompressionIterator *
+alp_decompression_iterator_from_datum_reverse(Datum alp_compressed, Oid element_type)
+{
+	return alp_decompression_iterator_init(alp_compressed, element_type, false);
+}
+
+static DecompressResult
+alp_decompression_iterator_try_next(AlpDecompressionIterator *iter)
+{
+	const DecompressedBatch *batch = iter->batch;
+	uint32 row;
+
+	if (iter->num_returned >= batch->num_rows)
+		return (DecompressResult){
+			.is_done = true,
+		};
+
+	row = iter->base.forward ? iter->num_returned : batch->num_rows - 1 - iter->num_returned;
+	iter->num_returned++;
+
+	if (!decompressed_batch_row_is_valid(batch, row))
+		return (DecompressResult){
+			.is_null = true,
+		};
+
+	return (DecompressResult){
+		.val = batch->values[row],
+	};
+}
+
+DecompressResult
+alp_decompression_iterator_try_next_forward(DecompressionIterator *iter)
+{
+	Assert(iter->compression_algorithm == COMPRESSION_ALGORITHM_ALP && iter->forward);
+	return alp_decompression_iterator_try_next((AlpDecompressionIterator *) iter);
+}
+
+DecompressResult
+alp_decompression_iterator_try_next_reverse(DecompressionIterator *iter)
+{
+	Assert(iter->compression_algorithm == COMPRESSION_ALGORITHM_ALP && !iter->forward);
+	return alp_decompression_iterator_try_next((AlpDecompressionIterator *) iter);
+}
+
+/*************
+ ***  I/O  ***
+ *************/
+
+void
+alp_compressed_send(CompressedDataHeader *header, StringInfo buffer)
+{
+	AlpData data;
+	uint32 i;
+
+	Assert(header->compression_algorithm == COMPRESSION_ALGORITHM_ALP);
+	alp_data_init_from_pointer(&data, (AlpCompressed *) header);
+
+	pq_sendbyte(buffer, data.header->has_nulls);
+	pq_sendbyte(buffer, data.header->exponent);
+	pq_sendbyte(buffer, data.header->is_float4);
+	pq_sendint32(buffer, data.header->num_exceptions);
+	for_compressed_send((CompressedDataHeader *) data.encoded, buffer);
+	for (i = 0; i < data.header->num_exceptions; i++)
+		pq_sendint32(buffer, data.exception_positions[i]);
+	for (i = 0; i < data.header->num_exceptions; i++)
+		pq_sendint64(buffer, data.exceptions[i]);
+	if (data.nulls != NULL)
+		simple8brle_serialized_send(buffer, data.nulls);
+}
+
+Datum
+alp_compressed_recv(StringInfo buffer)
+{
+	uint8 has_nulls;
+	uint8 exponent;
+	uint8 is_float4;
+	uint32 num_exceptions;
+	ForCompressed *encoded;
+	uint32 *exception_positions;
+	uint64 *exceptions;
+	Simple8bRleSerialized *nulls = NULL;
+	uint32 i;
+
+	has_nulls = pq_getmsgbyte(buffer);
+	if (has_nulls != 0 && has_nulls != 1)
+		elog(ERROR, "invalid recv in ALP: bad bool");
+
+	exponent = pq_getmsgbyte(buffer);
+	if (exponent > ALP_MAX_EXPONENT_FLOAT8)
+		elog(ERROR, "invalid recv in ALP: bad exponent");
+
+	is_float4 = pq_getmsgbyte(buffer);
+	if (is_float4 != 0 && is_float4 != 1)
+		elog(ERROR, "invalid recv in ALP: bad bool");
+
+	num_exceptions = pq_getmsgint32(buffer);
+	encoded = (ForCompressed *) DatumGetPointer(for_compressed_recv(buffer));
+	if (num_exceptions > for_compressed_num_values(encoded))
+		elog(ERROR, "invalid recv in ALP: too many exceptions");
+
+	exception_positions = palloc(sizeof(uint32) * Max(num_exceptions, 1));
+	exceptions = palloc(sizeof(uint64) * Max(num_exceptions, 1));
+	for (i = 0; i < num_exceptions; i++)
+	{
+		exception_positions[i] = pq_getmsgint32(buffer);
+		if (exception_positions[i] >= for_compressed_num_values(encoded))
+			elog(ERROR, "invalid recv in ALP: bad exception position");
+	}
+	for (i = 0; i < num_exceptions; i++)
+		exceptions[i] = pq_getmsgint64(buffer);
+
+	if (has_nulls)
+		nulls = simple8brle_serialized_recv(buffer);
+
+	PG_RETURN_POINTER(alp_from_parts(exponent,
+									 is_float4 == 1,
+									 encoded,
+									 num_exceptions,
+									 exception_positions,
+									 exceptions,
+									 nulls));
+}
@@ -0,0 +1,65 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+/*
+ * ALP (adaptive lossless floating-point compression, Afroozeh et al., SIGMOD 2024) is used to
+ * encode floating point values that were produced from decimals of a fixed precision, e.g.
+ * sensor readings with two decimal digits. Such values XOR poorly, since the mantissa bits of
+ * neighbouring decimals share little, but scaled by a power of ten they become small integers.
+ *
+ * For each batch we pick the exponent e that encodes the values best, and store every value v
+ * as the integer n = round(v * 10^e), for which n / 10^e gives back exactly v. The integers
+ * are stored with frame-of-reference bit-packing (see for.h). Values that do not round-trip,
+ * e.g. NaN, infinities or values with more digits, are stored verbatim as exceptions with
+ * their positions. Decoding is one division per value followed by patching the exceptions,
+ * so it vectorizes, unlike the bit-by-bit reading Gorilla needs.
+ *
+ * This is a simplified ALP: we only use the exponent, not the additional factor, and no
+ * ALP_rd fallback for high-precision values; the column compressor falls back to Gorilla for
+ * batches where that is smaller.
+ */
+#ifndef TIMESCALEDB_TSL_COMPRESSION_ALP_H
+#define TIMESCALEDB_TSL_COMPRESSION_ALP_H
+
+#include <postgres.h>
+#include <c.h>
+#include <fmgr.h>
+#include <lib/stringinfo.h>
+
+#include "compression/compression.h"
+
+typedef struct AlpCompressor AlpCompressor;
+typedef struct AlpCompressed AlpCompressed;
+
+extern Compressor *alp_compressor_for_type(Oid element_type);
+extern AlpCompressor *alp_compressor_alloc(Oid element_type);
+extern void alp_compressor_append_null(AlpCompressor *compressor);
+extern void alp_compressor_append_value(AlpCompressor *compressor, double next_val);
+extern void *alp_compressor_finish(AlpCompressor *compressor);
+extern void alp_compressor_free(AlpCompressor *compressor);
+
+extern DecompressionIterator *alp_decompression_iterator_from_datum_forward(Datum alp_compressed,
+																			Oid element_type);
+extern DecompressionIterator *alp_decompression_iterator_from_datum_reverse(Datum alp_compressed,
+																			Oid element_type);
+extern DecompressResult alp_decompression_iterator_try_next_forward(DecompressionIterator *iter);
+extern DecompressResult alp_decompression_iterator_try_next_reverse(DecompressionIterator *iter);
+extern DecompressedBatch *alp_decompress_all(Datum alp_compressed, Oid element_type);
+
+extern void alp_compressed_send(CompressedDataHeader *header, StringInfo buffer);
+extern Datum alp_compressed_recv(StringInfo buf);
+
+#define ALP_ALGORITHM_DEFINITION                                                                   \
+	{                                                                                              \
+		.iterator_init_forward = alp_decompression_iterator_from_datum_forward,                    \
+		.iterator_init_reverse = alp_decompression_iterator_from_datum_reverse,                    \
+		.decompress_all = alp_decompress_all,                                                      \
+		.compressed_data_send = alp_compressed_send,                                               \
+		.compressed_data_recv = alp_compressed_recv,                                               \
+		.compressor_for_type = alp_compressor_for_type,                                            \
+		.compressed_data_storage = TOAST_STORAGE_EXTERNAL,                                         \
+	}
+
+#endif
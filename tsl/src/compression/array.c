@@ -517,6 +517,66 @@ array_decompression_iterator_try_next_reverse(DecompressionIterator *base_iter)
 	};
 }
 
+/***************************
+ *** Decompress All Rows ***
+ ***************************/
+
+DecompressedBatch *
+array_decompress_all_serialized(const char *serialized_data, Size data_size, Oid element_type,
+								bool has_nulls)
+{
+	ArrayCompressedData data =
+		array_compressed_data_from_bytes(serialized_data, data_size, element_type, has_nulls);
+	DatumDeserializer *deserializer = create_datum_deserializer(element_type);
+	uint32 num_values = data.sizes->num_elements;
+	const char *current = data.data;
+	DecompressedBatch *batch;
+	uint32 i;
+
+	batch = decompressed_batch_alloc(element_type,
+									 data.nulls != NULL ? data.nulls->num_elements : num_values);
+
+	/* the sizes are only needed for reverse iteration, the datums are self-delimiting */
+	for (i = 0; i < num_values; i++)
+		batch->values[i] = bytes_to_datum_and_advance(deserializer, &current);
+
+	if ((Size) (current - data.data) > data.data_len)
+		elog(ERROR, "the compressed data is corrupt: array data is too short");
+
+	if (data.nulls != NULL)
+	{
+		uint64 *is_null = simple8brle_decompress_all(data.nulls);
+		decompressed_batch_spread_nulls(batch, is_null, num_values);
+		pfree(is_null);
+	}
+
+	return batch;
+}
+
+DecompressedBatch *
+tsl_array_decompress_all(Datum compressed_array, Oid element_type)
+{
+	ArrayCompressed *compressed_array_header;
+	uint32 data_size;
+	const char *compressed_data = (void *) PG_DETOAST_DATUM(compressed_array);
+
+	compressed_array_header = (ArrayCompressed *) compressed_data;
+	compressed_data += sizeof(*compressed_array_header);
+
+	Assert(compressed_array_header->compression_algorithm == COMPRESSION_ALGORITHM_ARRAY);
+
+	data_size = VARSIZE(compressed_array_header);
+	data_size -= sizeof(*compressed_array_header);
+
+	if (element_type != compressed_array_header->element_type)
+		elog(ERROR, "trying to decompress the wrong type");
+
+	return array_decompress_all_serialized(compressed_data,
+										   data_size,
+										   compressed_array_header->element_type,
+										   compressed_array_header->has_nulls == 1);
+}
+
 /*********************
  ***  send / recv  ***
  *********************/
@@ -40,6 +40,8 @@ extern DecompressionIterator *
 tsl_array_decompression_iterator_from_datum_reverse(Datum compressed_array, Oid element_type);
 extern DecompressResult array_decompression_iterator_try_next_reverse(DecompressionIterator *iter);
 
+extern DecompressedBatch *tsl_array_decompress_all(Datum compressed_array, Oid element_type);
+
 /* API for using this as an embedded data structure */
 typedef struct ArrayCompressorSerializationInfo ArrayCompressorSerializationInfo;
 extern ArrayCompressorSerializationInfo *
@@ -51,6 +53,9 @@ extern char *bytes_serialize_array_compressor_and_advance(char *dst, Size dst_si
 extern DecompressionIterator *
 array_decompression_iterator_alloc_forward(const char *serialized_data, Size data_size,
 										   Oid element_type, bool has_nulls);
+extern DecompressedBatch *array_decompress_all_serialized(const char *serialized_data,
+														  Size data_size, Oid element_type,
+														  bool has_nulls);
 
 typedef struct StringInfoData StringInfoData;
 typedef StringInfoData *StringInfo;
@@ -70,6 +75,7 @@ extern Datum tsl_array_compressor_finish(PG_FUNCTION_ARGS);
 	{                                                                                              \
 		.iterator_init_forward = tsl_array_decompression_iterator_from_datum_forward,              \
 		.iterator_init_reverse = tsl_array_decompression_iterator_from_datum_reverse,              \
+		.decompress_all = tsl_array_decompress_all,                                                \
 		.compressed_data_send = array_compressed_send,                                             \
 		.compressed_data_recv = array_compressed_recv,                                             \
 		.compressor_for_type = array_compressor_for_type,                                          \
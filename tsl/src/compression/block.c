@@ -0,0 +1,360 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+#include "compression/block.h"
+
+#include <lib/stringinfo.h>
+#include <libpq/pqformat.h>
+
+#include "config.h"
+
+#ifdef TS_USE_LZ4
+#include <lz4.h>
+#endif
+#ifdef TS_USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "compression/compression.h"
+
+/* the Zstd default level, higher levels cost a lot of compression speed for little gain */
+#define BLOCK_ZSTD_LEVEL 3
+
+/*
+ * Block compressed data is stored as
+ *     the compressed data header
+ *     uint8 codec: the CompressionBlockCodec the data was compressed with
+ *     uint32 raw_size: the size of the wrapped datum, including its varlena header
+ *     the wrapped datum compressed with the codec
+ */
+typedef struct BlockCompressed
+{
+	CompressedDataHeaderFields;
+	uint8 codec;
+	uint8 padding[2];
+	uint32 raw_size;
+	char data[FLEXIBLE_ARRAY_MEMBER];
+} BlockCompressed;
+
+typedef struct ExtendedCompressor
+{
+	Compressor base;
+	Compressor *inner;
+	CompressionBlockCodec codec;
+} ExtendedCompressor;
+
+bool
+block_codec_is_available(CompressionBlockCodec codec)
+{
+	switch (codec)
+	{
+#ifdef TS_USE_LZ4
+		case COMPRESSION_BLOCK_CODEC_LZ4:
+			return true;
+#endif
+#ifdef TS_USE_ZSTD
+		case COMPRESSION_BLOCK_CODEC_ZSTD:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+const char *
+block_codec_name(CompressionBlockCodec codec)
+{
+	switch (codec)
+	{
+		case COMPRESSION_BLOCK_CODEC_LZ4:
+			return "LZ4";
+		case COMPRESSION_BLOCK_CODEC_ZSTD:
+			return "Zstd";
+		default:
+			elog(ERROR, "invalid block compression codec %d", codec);
+			pg_unreachable();
+	}
+}
+
+static void
+block_codec_check_available(CompressionBlockCodec codec)
+{
+	if (!block_codec_is_available(codec))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("compressed data uses %s block compression", block_codec_name(codec)),
+				 errdetail("TimescaleDB was built without %s support.",
+						   block_codec_name(codec))));
+}
+
+/*
+ * Compress the datum produced by another compression algorithm with the codec. Returns the
+ * datum unchanged if the block would not be smaller.
+ */
+void *
+block_compress(CompressedDataHeader *inner, CompressionBlockCodec codec)
+{
+	uint32 raw_size = VARSIZE(inner);
+	Size bound;
+	Size compressed_size = 0;
+	BlockCompressed *block;
+
+	Assert(inner->compression_algorithm != COMPRESSION_ALGORITHM_BLOCK);
+	block_codec_check_available(codec);
+
+	switch (codec)
+	{
+#ifdef TS_USE_LZ4
+		case COMPRESSION_BLOCK_CODEC_LZ4:
+			bound = LZ4_compressBound(raw_size);
+			break;
+#endif
+#ifdef TS_USE_ZSTD
+		case COMPRESSION_BLOCK_CODEC_ZSTD:
+			bound = ZSTD_compressBound(raw_size);
+			break;
+#endif
+		default:
+			pg_unreachable();
+	}
+
+	if (!AllocSizeIsValid(sizeof(BlockCompressed) + bound))
+		return inner;
+
+	block = palloc(sizeof(BlockCompressed) + bound);
+
+	switch (codec)
+	{
+#ifdef TS_USE_LZ4
+		case COMPRESSION_BLOCK_CODEC_LZ4:
+		{
+			int size = LZ4_compress_default((char *) inner, block->data, raw_size, (int) bound);
+			if (size > 0)
+				compressed_size = size;
+			break;
+		}
+#endif
+#ifdef TS_USE_ZSTD
+		case COMPRESSION_BLOCK_CODEC_ZSTD:
+		{
+			size_t size = ZSTD_compress(block->data, bound, inner, raw_size, BLOCK_ZSTD_LEVEL);
+			if (!ZSTD_isError(size))
+				compressed_size = size;
+			break;
+		}
+#endif
+		default:
+			pg_unreachable();
+	}
+
+	/* keep the wrapped datum if the codec failed or did not make it smaller */
+	if (compressed_size == 0 || sizeof(BlockCompressed) + compressed_size >= raw_size)
+	{
+		pfree(block);
+		return inner;
+	}
+
+	SET_VARSIZE(block, sizeof(BlockCompressed) + compressed_size);
+	block->compression_algorithm = COMPRESSION_ALGORITHM_BLOCK;
+	block->codec = codec;
+	block->padding[0] = 0;
+	block->padding[1] = 0;
+	block->raw_size = raw_size;
+	return block;
+}
+
+/*
+ * Decompress the block back into the datum it wraps. The result is newly allocated in the
+ * current memory context.
+ */
+CompressedDataHeader *
+block_decompress(Datum block_compressed)
+{
+	BlockCompressed *block = (BlockCompressed *) PG_DETOAST_DATUM(block_compressed);
+	Size compressed_size = VARSIZE(block) - sizeof(BlockCompressed);
+	char *raw;
+	uint8 algorithm;
+	bool ok = false;
+
+	Assert(block->compression_algorithm == COMPRESSION_ALGORITHM_BLOCK);
+	block_codec_check_available(block->codec);
+
+	if (block->raw_size < sizeof(CompressedDataHeader) || !AllocSizeIsValid(block->raw_size))
+		elog(ERROR, "invalid size of block compressed data");
+
+	raw = palloc(block->raw_size);
+
+	switch (block->codec)
+	{
+#ifdef TS_USE_LZ4
+		case COMPRESSION_BLOCK_CODEC_LZ4:
+			ok = LZ4_decompress_safe(block->data, raw, compressed_size, block->raw_size) ==
+				 (int) block->raw_size;
+			break;
+#endif
+#ifdef TS_USE_ZSTD
+		case COMPRESSION_BLOCK_CODEC_ZSTD:
+			ok = ZSTD_decompress(raw, block->raw_size, block->data, compressed_size) ==
+				 block->raw_size;
+			break;
+#endif
+		default:
+			pg_unreachable();
+	}
+
+	if (!ok || VARSIZE(raw) != block->raw_size)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("could not decompress %s block compressed data",
+						block_codec_name(block->codec))));
+
+	algorithm = ((CompressedDataHeader *) raw)->compression_algorithm;
+	if (algorithm == _INVALID_COMPRESSION_ALGORITHM || algorithm == COMPRESSION_ALGORITHM_BLOCK ||
+		algorithm >= _END_COMPRESSION_ALGORITHMS)
+		elog(ERROR, "invalid compression algorithm in block compressed data");
+
+	return (CompressedDataHeader *) raw;
+}
+
+/********************
+ ***  Compressor  ***
+ ********************/
+
+static void
+block_compressor_append_null(Compressor *compressor)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	extended->inner->append_null(extended->inner);
+}
+
+static void
+block_compressor_append_val(Compressor *compressor, Datum val)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	extended->inner->append_val(extended->inner, val);
+}
+
+static void *
+block_compressor_finish_and_reset(Compressor *compressor)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	CompressedDataHeader *inner = extended->inner->finish(extended->inner);
+	void *compressed;
+
+	if (inner == NULL)
+		return NULL;
+
+	compressed = block_compress(inner, extended->codec);
+	if (compressed != inner)
+		pfree(inner);
+	return compressed;
+}
+
+/*
+ * Block compression only wraps the output of other algorithms, so it is never the algorithm
+ * of a column. Use block_compressor_wrap to add it to the compressor of a column.
+ */
+Compressor *
+block_compressor_for_type(Oid element_type)
+{
+	elog(ERROR, "block compression cannot be used without another compression algorithm");
+	pg_unreachable();
+}
+
+Compressor *
+block_compressor_wrap(Compressor *inner, CompressionBlockCodec codec)
+{
+	ExtendedCompressor *compressor = palloc(sizeof(*compressor));
+
+	block_codec_check_available(codec);
+
+	*compressor = (ExtendedCompressor){
+		.base = {
+			.append_null = block_compressor_append_null,
+			.append_val = block_compressor_append_val,
+			.finish = block_compressor_finish_and_reset,
+		},
+		.inner = inner,
+		.codec = codec,
+	};
+	return &compressor->base;
+}
+
+/********************
+ ***  Decompress  ***
+ ********************/
+
+DecompressionIterator *
+block_decompression_iterator_from_datum_forward(Datum compressed, Oid element_type)
+{
+	CompressedDataHeader *inner = block_decompress(compressed);
+
+	return tsl_get_decompression_iterator_init(inner->compression_algorithm,
+											   false)(PointerGetDatum(inner), element_type);
+}
+
+DecompressionIterator *
+block_decompression_iterator_from_datum_reverse(Datum compressed, Oid element_type)
+{
+	CompressedDataHeader *inner = block_decompress(compressed);
+
+	return tsl_get_decompression_iterator_init(inner->compression_algorithm,
+											   true)(PointerGetDatum(inner), element_type);
+}
+
+DecompressedBatch *
+block_decompress_all(Datum compressed, Oid element_type)
+{
+	CompressedDataHeader *inner = block_decompress(compressed);
+
+	return tsl_get_decompress_all_function(inner->compression_algorithm)(PointerGetDatum(inner),
+																		 element_type);
+}
+
+/*********************
+ ***  send / recv  ***
+ *********************/
+
+/*
+ * On the wire we send the codec followed by the wrapped datum in the format of its own
+ * algorithm, so that the receiving side does not need to have the codec to read the data.
+ */
+void
+block_compressed_send(CompressedDataHeader *header, StringInfo buffer)
+{
+	const BlockCompressed *block = (BlockCompressed *) header;
+	CompressedDataHeader *inner = block_decompress(PointerGetDatum(header));
+
+	Assert(header->compression_algorithm == COMPRESSION_ALGORITHM_BLOCK);
+	pq_sendbyte(buffer, block->codec);
+	pq_sendbyte(buffer, inner->compression_algorithm);
+	tsl_get_compressed_data_send_function(inner->compression_algorithm)(inner, buffer);
+}
+
+Datum
+block_compressed_recv(StringInfo buffer)
+{
+	uint8 codec;
+	uint8 algorithm;
+	Datum inner;
+
+	codec = pq_getmsgbyte(buffer);
+	if (codec != COMPRESSION_BLOCK_CODEC_LZ4 && codec != COMPRESSION_BLOCK_CODEC_ZSTD)
+		elog(ERROR, "invalid recv in block compression: bad codec");
+
+	algorithm = pq_getmsgbyte(buffer);
+	if (algorithm == COMPRESSION_ALGORITHM_BLOCK)
+		elog(ERROR, "invalid recv in block compression: nested block");
+
+	inner = tsl_get_compressed_data_recv_function(algorithm)(buffer);
+
+	/* without the codec the data stays readable, just not block compressed */
+	if (!block_codec_is_available(codec))
+		return inner;
+
+	return PointerGetDatum(
+		block_compress((CompressedDataHeader *) DatumGetPointer(inner), codec));
+}
@@ -0,0 +1,57 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+/*
+ * Block compression wraps the output of another compression algorithm, in practice array or
+ * dictionary compressed text, in a general purpose compressor: LZ4 for speed or Zstd for
+ * density. Array and dictionary compression store the values themselves verbatim, which
+ * leaves a lot of redundancy in e.g. log lines or JSON documents that PostgreSQL's pglz only
+ * partially removes, and pglz is slow to decompress.
+ *
+ * The codec is picked per column with the timescaledb.compress_lz4 and
+ * timescaledb.compress_zstd options. Both libraries are optional build dependencies; a
+ * block is only written if it is smaller than the wrapped datum, so a column with a codec
+ * may contain a mix of wrapped and plain batches. The wrapped datum is stored whole,
+ * including its header, so decompression unwraps it and dispatches on the inner algorithm.
+ */
+#ifndef TIMESCALEDB_TSL_COMPRESSION_BLOCK_H
+#define TIMESCALEDB_TSL_COMPRESSION_BLOCK_H
+
+#include <postgres.h>
+#include <c.h>
+#include <fmgr.h>
+#include <lib/stringinfo.h>
+
+#include "compression/compression.h"
+
+extern bool block_codec_is_available(CompressionBlockCodec codec);
+extern const char *block_codec_name(CompressionBlockCodec codec);
+
+extern Compressor *block_compressor_for_type(Oid element_type);
+extern Compressor *block_compressor_wrap(Compressor *inner, CompressionBlockCodec codec);
+extern void *block_compress(CompressedDataHeader *inner, CompressionBlockCodec codec);
+extern CompressedDataHeader *block_decompress(Datum block_compressed);
+
+extern DecompressionIterator *block_decompression_iterator_from_datum_forward(Datum compressed,
+																			  Oid element_type);
+extern DecompressionIterator *block_decompression_iterator_from_datum_reverse(Datum compressed,
+																			  Oid element_type);
+extern DecompressedBatch *block_decompress_all(Datum compressed, Oid element_type);
+
+extern void block_compressed_send(CompressedDataHeader *header, StringInfo buffer);
+extern Datum block_compressed_recv(StringInfo buf);
+
+#define BLOCK_ALGORITHM_DEFINITION                                                                 \
+	{                                                                                              \
+		.iterator_init_forward = block_decompression_iterator_from_datum_forward,                  \
+		.iterator_init_reverse = block_decompression_iterator_from_datum_reverse,                  \
+		.decompress_all = block_decompress_all,                                                    \
+		.compressed_data_send = block_compressed_send,                                             \
+		.compressed_data_recv = block_compressed_recv,                                             \
+		.compressor_for_type = block_compressor_for_type,                                          \
+		.compressed_data_storage = TOAST_STORAGE_EXTERNAL,                                         \
+	}
+
+#endif
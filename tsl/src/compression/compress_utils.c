@@ -272,16 +272,66 @@ restore_autovacuum_on_decompress(Oid uncompressed_hypertable_relid, Oid uncompre
 	}
 }
 
+typedef struct CompressionSettings
+{
+	const ColumnCompressionInfo **colinfo_array;
+	int num_columns;
+	CompressionBatchSize batch_size;
+	CompressionBlockCodec *codec_array;
+} CompressionSettings;
+
+/* get the compression properties of the hypertable in the form compress_chunk takes them */
+static void
+compression_settings_get(int32 hypertable_id, CompressionSettings *settings)
+{
+	ListCell *lc;
+	List *htcols_list = ts_hypertable_compression_get(hypertable_id);
+	List *codec_list = ts_hypertable_compression_codec_get(hypertable_id);
+	FormData_hypertable_compression_batch batch_fd;
+	int i = 0;
+
+	settings->num_columns = list_length(htcols_list);
+	settings->batch_size.max_rows = COMPRESSION_DEFAULT_BATCH_SIZE;
+	settings->batch_size.target_bytes = 0;
+	settings->codec_array = NULL;
+
+	if (ts_hypertable_compression_batch_get(hypertable_id, &batch_fd))
+	{
+		settings->batch_size.max_rows = batch_fd.batch_size;
+		settings->batch_size.target_bytes = batch_fd.target_batch_bytes;
+	}
+
+	/* convert list to array of pointers for compress_chunk */
+	settings->colinfo_array = palloc(sizeof(ColumnCompressionInfo *) * settings->num_columns);
+	foreach (lc, htcols_list)
+	{
+		FormData_hypertable_compression *fd = (FormData_hypertable_compression *) lfirst(lc);
+		settings->colinfo_array[i++] = fd;
+	}
+
+	/* block compression codecs are looked up by column name, most columns have none */
+	if (codec_list != NIL)
+	{
+		settings->codec_array = palloc0(sizeof(CompressionBlockCodec) * settings->num_columns);
+		for (i = 0; i < settings->num_columns; i++)
+		{
+			foreach (lc, codec_list)
+			{
+				FormData_hypertable_compression_codec *fd = lfirst(lc);
+				if (namestrcmp(&fd->attname, NameStr(settings->colinfo_array[i]->attname)) == 0)
+					settings->codec_array[i] = fd->codec;
+			}
+		}
+	}
+}
+
 static void
 compress_chunk_impl(Oid hypertable_relid, Oid chunk_relid)
 {
 	CompressChunkCxt cxt;
 	Chunk *compress_ht_chunk;
 	Cache *hcache;
-	ListCell *lc;
-	List *htcols_list = NIL;
-	const ColumnCompressionInfo **colinfo_array;
-	int i = 0, htcols_listlen;
+	CompressionSettings settings;
 	ChunkSize before_size, after_size;
 	CompressionStats cstat;
 
@@ -302,22 +352,16 @@ compress_chunk_impl(Oid hypertable_relid, Oid chunk_relid)
 	LockRelationOid(catalog_get_table_id(ts_catalog_get(), CHUNK), RowExclusiveLock);
 
 	/* get compression properties for hypertable */
-	htcols_list = ts_hypertable_compression_get(cxt.srcht->fd.id);
-	htcols_listlen = list_length(htcols_list);
+	compression_settings_get(cxt.srcht->fd.id, &settings);
 	/* create compressed chunk DDL and compress the data */
 	compress_ht_chunk = create_compress_chunk_table(cxt.compress_ht, cxt.srcht_chunk);
-	/* convert list to array of pointers for compress_chunk */
-	colinfo_array = palloc(sizeof(ColumnCompressionInfo *) * htcols_listlen);
-	foreach (lc, htcols_list)
-	{
-		FormData_hypertable_compression *fd = (FormData_hypertable_compression *) lfirst(lc);
-		colinfo_array[i++] = fd;
-	}
 	before_size = compute_chunk_size(cxt.srcht_chunk->table_id);
 	cstat = compress_chunk(cxt.srcht_chunk->table_id,
 						   compress_ht_chunk->table_id,
-						   colinfo_array,
-						   htcols_listlen);
+						   settings.colinfo_array,
+						   settings.num_columns,
+						   &settings.batch_size,
+						   settings.codec_array);
 
 	/* Copy chunk constraints (including fkey) to compressed chunk.
 	 * Do this after compressing the chunk to avoid holding strong, unnecessary locks on the
@@ -348,6 +392,64 @@ compress_chunk_impl(Oid hypertable_relid, Oid chunk_relid)
 	ts_cache_release(hcache);
 }
 
+/*
+ * Merge the rows inserted into a compressed chunk since it was compressed
+ * into its compressed chunk, rebuilding only the segments that received
+ * new rows.
+ */
+static void
+recompress_chunk_impl(Oid hypertable_relid, Oid chunk_relid)
+{
+	CompressChunkCxt cxt;
+	Chunk *compress_ht_chunk;
+	Cache *hcache;
+	CompressionSettings settings;
+	ChunkSize staged_size, after_size;
+	CompressionStats cstat;
+	FormData_compression_chunk_size added;
+
+	hcache = ts_hypertable_cache_pin();
+	compresschunkcxt_init(&cxt, hcache, hypertable_relid, chunk_relid);
+
+	/* acquire locks on src and compress hypertable and src chunk */
+	LockRelationOid(cxt.srcht->main_table_relid, AccessShareLock);
+	LockRelationOid(cxt.compress_ht->main_table_relid, AccessShareLock);
+	LockRelationOid(cxt.srcht_chunk->table_id, ShareLock);
+
+	/* aquire locks on catalog tables to keep till end of txn */
+	LockRelationOid(catalog_get_table_id(ts_catalog_get(), HYPERTABLE_COMPRESSION),
+					AccessShareLock);
+	LockRelationOid(catalog_get_table_id(ts_catalog_get(), CHUNK), RowExclusiveLock);
+
+	compress_ht_chunk = ts_chunk_get_by_id(cxt.srcht_chunk->fd.compressed_chunk_id, true);
+	compression_settings_get(cxt.srcht->fd.id, &settings);
+
+	staged_size = compute_chunk_size(cxt.srcht_chunk->table_id);
+	cstat = recompress_chunk_segments(cxt.srcht_chunk->table_id,
+									  compress_ht_chunk->table_id,
+									  settings.colinfo_array,
+									  settings.num_columns,
+									  &settings.batch_size,
+									  settings.codec_array);
+	after_size = compute_chunk_size(compress_ht_chunk->table_id);
+
+	added = (FormData_compression_chunk_size){
+		.uncompressed_heap_size = staged_size.heap_size,
+		.uncompressed_toast_size = staged_size.toast_size,
+		.uncompressed_index_size = staged_size.index_size,
+		.compressed_heap_size = after_size.heap_size,
+		.compressed_toast_size = after_size.toast_size,
+		.compressed_index_size = after_size.index_size,
+		.numrows_pre_compression = cstat.rowcnt_pre_compression,
+		.numrows_post_compression = cstat.rowcnt_post_compression,
+	};
+	ts_compression_chunk_size_update_recompressed(cxt.srcht_chunk->fd.id, &added);
+
+	ts_chunk_set_status(cxt.srcht_chunk,
+						cxt.srcht_chunk->fd.status & ~CHUNK_STATUS_COMPRESSED_PARTIAL);
+	ts_cache_release(hcache);
+}
+
 static bool
 decompress_chunk_impl(Oid uncompressed_hypertable_relid, Oid uncompressed_chunk_relid,
 					  bool if_compressed)
@@ -427,6 +529,25 @@ tsl_compress_chunk_wrapper(Chunk *chunk, bool if_not_compressed)
 	return true;
 }
 
+bool
+tsl_recompress_chunk_wrapper(Chunk *chunk, bool if_not_compressed)
+{
+	if (chunk->fd.compressed_chunk_id == INVALID_CHUNK_ID)
+	{
+		ereport((if_not_compressed ? NOTICE : ERROR),
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("chunk \"%s\" is not compressed", get_rel_name(chunk->table_id))));
+		return false;
+	}
+
+	/* nothing was inserted since the chunk was compressed */
+	if (!ts_chunk_is_partial(chunk))
+		return true;
+
+	recompress_chunk_impl(chunk->hypertable_relid, chunk->table_id);
+	return true;
+}
+
 /*
  * Helper for remote invocation of chunk compression and decompression.
  */
@@ -516,6 +637,27 @@ tsl_compress_chunk(PG_FUNCTION_ARGS)
 	PG_RETURN_OID(uncompressed_chunk_id);
 }
 
+Datum
+tsl_recompress_chunk(PG_FUNCTION_ARGS)
+{
+	Oid uncompressed_chunk_id = PG_ARGISNULL(0) ? InvalidOid : PG_GETARG_OID(0);
+	bool if_not_compressed = PG_ARGISNULL(1) ? false : PG_GETARG_BOOL(1);
+	Chunk *chunk = ts_chunk_get_by_relid(uncompressed_chunk_id, true);
+
+	if (chunk->relkind == RELKIND_FOREIGN_TABLE)
+	{
+		if (!invoke_compression_func_remotely(fcinfo, chunk))
+			PG_RETURN_NULL();
+
+		PG_RETURN_OID(uncompressed_chunk_id);
+	}
+
+	if (!tsl_recompress_chunk_wrapper(chunk, if_not_compressed))
+		PG_RETURN_NULL();
+
+	PG_RETURN_OID(uncompressed_chunk_id);
+}
+
 Datum
 tsl_decompress_chunk(PG_FUNCTION_ARGS)
 {
@@ -6,47 +6,71 @@
 
 #include "compression/compression.h"
 
+#include <access/genam.h>
 #include <access/heapam.h>
 #include <access/htup_details.h>
 #include <access/multixact.h>
+#include <access/parallel.h>
+#include <access/stratnum.h>
 #include <access/xact.h>
 #include <catalog/namespace.h>
+#include <catalog/pg_am.h>
 #include <catalog/pg_attribute.h>
+#include <catalog/pg_index.h>
 #include <catalog/pg_type.h>
 #include <catalog/index.h>
 #include <catalog/heap.h>
 #include <common/base64.h>
+#include <executor/executor.h>
 #include <executor/tuptable.h>
 #include <funcapi.h>
 #include <libpq/pqformat.h>
 #include <miscadmin.h>
+#include <optimizer/paths.h>
+#include <optimizer/planner.h>
+#include <pgstat.h>
 #include <storage/predicate.h>
+#include <storage/shm_mq.h>
+#include <storage/shm_toc.h>
 #include <utils/builtins.h>
 #include <utils/datum.h>
 #include <utils/lsyscache.h>
 #include <utils/memutils.h>
+#include <utils/portal.h>
 #include <utils/rel.h>
 #include <utils/snapmgr.h>
 #include <utils/syscache.h>
 #include <utils/tuplesort.h>
+#include <utils/tuplestore.h>
 #include <utils/typcache.h>
 
 #include <catalog.h>
 #include <utils.h>
 
 #include "compat.h"
+#if PG13_LT
+#include <access/tuptoaster.h>
+#else
+#include <access/heaptoast.h>
+#endif
+
+#include "extension_constants.h"
+#include "guc.h"
 
+#include "alp.h"
 #include "array.h"
+#include "block.h"
 #include "chunk.h"
 #include "deltadelta.h"
+#include "detoast_reader.h"
 #include "dictionary.h"
+#include "for.h"
 #include "gorilla.h"
 #include "compression_chunk_size.h"
 #include "create.h"
 #include "custom_type_cache.h"
 #include "segment_meta.h"
 
-#define MAX_ROWS_PER_COMPRESSION 1000
 /* gap in sequence id between rows, potential for adding rows in gap later */
 #define SEQUENCE_NUM_GAP 10
 #define COMPRESSIONCOL_IS_SEGMENT_BY(col) (col->segmentby_column_index > 0)
@@ -57,9 +81,13 @@ static const CompressionAlgorithmDefinition definitions[_END_COMPRESSION_ALGORIT
 	[COMPRESSION_ALGORITHM_DICTIONARY] = DICTIONARY_ALGORITHM_DEFINITION,
 	[COMPRESSION_ALGORITHM_GORILLA] = GORILLA_ALGORITHM_DEFINITION,
 	[COMPRESSION_ALGORITHM_DELTADELTA] = DELTA_DELTA_ALGORITHM_DEFINITION,
+	[COMPRESSION_ALGORITHM_FOR] = FOR_ALGORITHM_DEFINITION,
+	[COMPRESSION_ALGORITHM_ALP] = ALP_ALGORITHM_DEFINITION,
+	[COMPRESSION_ALGORITHM_BLOCK] = BLOCK_ALGORITHM_DEFINITION,
+	[COMPRESSION_ALGORITHM_SHARED_DICTIONARY] = SHARED_DICTIONARY_ALGORITHM_DEFINITION,
 };
 
-static Compressor *
+Compressor *
 compressor_for_algorithm_and_type(CompressionAlgorithms algorithm, Oid type)
 {
 	if (algorithm >= _END_COMPRESSION_ALGORITHMS)
@@ -80,6 +108,330 @@ DecompressionIterator *(*tsl_get_decompression_iterator_init(CompressionAlgorith
 		return definitions[algorithm].iterator_init_forward;
 }
 
+DecompressedBatch *(*tsl_get_decompress_all_function(CompressionAlgorithms algorithm))(Datum, Oid)
+{
+	if (algorithm >= _END_COMPRESSION_ALGORITHMS)
+		elog(ERROR, "invalid compression algorithm %d", algorithm);
+
+	return definitions[algorithm].decompress_all;
+}
+
+/*
+ * Decompress all rows of a compressed value that may still be toasted.
+ *
+ * A large value that the algorithm can read in slices is passed on toasted, and
+ * only its first byte is fetched here to find the algorithm. Any other value is
+ * detoasted here; when the decompressed values do not point into the detoasted
+ * copy, because the type is passed by value, the copy is freed right away.
+ */
+DecompressedBatch *
+tsl_decompress_all(Datum compressed, Oid element_type, bool typbyval)
+{
+	CompressedDataHeader *header;
+	DecompressedBatch *batch;
+
+	if (detoast_reader_reads_slices(compressed))
+	{
+		struct varlena *first = PG_DETOAST_DATUM_SLICE(compressed, 0, 1);
+		CompressionAlgorithms algorithm = *(uint8 *) VARDATA(first);
+
+		pfree(first);
+		return tsl_get_decompress_all_function(algorithm)(compressed, element_type);
+	}
+
+	header = (CompressedDataHeader *) PG_DETOAST_DATUM(compressed);
+	batch = tsl_get_decompress_all_function(header->compression_algorithm)(PointerGetDatum(header),
+																		   element_type);
+
+	if (typbyval && (Pointer) header != DatumGetPointer(compressed))
+		pfree(header);
+
+	return batch;
+}
+
+void (*tsl_get_compressed_data_send_function(CompressionAlgorithms algorithm))(
+	CompressedDataHeader *, StringInfo)
+{
+	if (algorithm == _INVALID_COMPRESSION_ALGORITHM || algorithm >= _END_COMPRESSION_ALGORITHMS)
+		elog(ERROR, "invalid compression algorithm %d", algorithm);
+
+	return definitions[algorithm].compressed_data_send;
+}
+
+Datum (*tsl_get_compressed_data_recv_function(CompressionAlgorithms algorithm))(StringInfo)
+{
+	if (algorithm == _INVALID_COMPRESSION_ALGORITHM || algorithm >= _END_COMPRESSION_ALGORITHMS)
+		elog(ERROR, "invalid compression algorithm %d", algorithm);
+
+	return definitions[algorithm].compressed_data_recv;
+}
+
+/*
+ * Allocate a batch for num_rows rows with all rows marked as valid (not NULL).
+ */
+DecompressedBatch *
+decompressed_batch_alloc(Oid element_type, uint32 num_rows)
+{
+	DecompressedBatch *batch = palloc(sizeof(*batch));
+	/* allocate at least one element so that an empty batch has valid pointers */
+	Size num_values = Max(num_rows, 1);
+	Size num_validity_words = DECOMPRESSED_BATCH_VALIDITY_WORDS(num_values);
+
+	*batch = (DecompressedBatch){
+		.element_type = element_type,
+		.num_rows = num_rows,
+		.num_nulls = 0,
+		.values = palloc(sizeof(Datum) * num_values),
+		.validity = palloc(sizeof(uint64) * num_validity_words),
+	};
+	memset(batch->validity, 0xFF, sizeof(uint64) * num_validity_words);
+
+	return batch;
+}
+
+/*
+ * The algorithms store NULLs out of line and only encode the non-null values,
+ * so they decode the first num_non_null values densely into batch->values.
+ * Given the decompressed nulls stream (one entry per row, 1 for NULL) move
+ * the values to their final row positions and clear the validity bits of the
+ * NULL rows. We walk backwards so the move can be done in place: the source
+ * position is never after the destination row.
+ */
+void
+decompressed_batch_spread_nulls(DecompressedBatch *batch, const uint64 *nulls, uint32 num_non_null)
+{
+	uint32 src = num_non_null;
+	uint32 row = batch->num_rows;
+
+	Assert(num_non_null <= batch->num_rows);
+
+	while (row > 0)
+	{
+		row--;
+		if (nulls[row] != 0)
+		{
+			Assert(nulls[row] == 1);
+			batch->validity[row / 64] &= ~(UINT64CONST(1) << (row % 64));
+			batch->num_nulls++;
+		}
+		else
+		{
+			if (src == 0)
+				elog(ERROR, "the compressed data is corrupt: too few non-null values");
+			src--;
+			batch->values[row] = batch->values[src];
+			if (batch->codes != NULL)
+				batch->codes[row] = batch->codes[src];
+		}
+	}
+
+	if (src != 0)
+		elog(ERROR, "the compressed data is corrupt: too many non-null values");
+}
+
+/*************************
+ ** multi_insert_buffer **
+ *************************/
+
+/*
+ * Rows written by the compressor and decompressor are buffered and inserted
+ * with heap_multi_insert, which locks and WAL-logs each page once per flush
+ * instead of once per row. The limits are the same as the ones of COPY.
+ */
+#define MULTI_INSERT_MAX_TUPLES 1000
+#define MULTI_INSERT_MAX_BYTES 65535
+
+typedef struct MultiInsertBuffer
+{
+	Relation rel;
+	CommandId mycid;
+	BulkInsertState bistate;
+	/* heap_multi_insert options, see multi_insert_buffer_set_frozen */
+	int options;
+	/* if set, index entries for the rows are inserted through the result
+	 * relation of this executor state */
+	EState *estate;
+	/* the buffered tuples, reset on every flush */
+	MemoryContext tuple_ctx;
+	/* the slots holding the buffered tuples, created on first use */
+	TupleTableSlot **slots;
+	int num_slots;
+	int num_tuples;
+	Size num_bytes;
+} MultiInsertBuffer;
+
+static MultiInsertBuffer *
+multi_insert_buffer_create(Relation rel, EState *estate)
+{
+	MultiInsertBuffer *buffer = palloc0(sizeof(*buffer));
+
+	*buffer = (MultiInsertBuffer){
+		.rel = rel,
+		.mycid = InvalidCommandId,
+		.bistate = GetBulkInsertState(),
+		.options = 0,
+		.estate = estate,
+		.tuple_ctx = AllocSetContextCreate(CurrentMemoryContext,
+										   "multi insert buffer",
+										   ALLOCSET_DEFAULT_SIZES),
+		.slots = palloc0(sizeof(TupleTableSlot *) * MULTI_INSERT_MAX_TUPLES),
+	};
+	return buffer;
+}
+
+/*
+ * Write the rows of the buffer already frozen, in the same way as COPY FREEZE,
+ * so that the first vacuum of the relation does not have to rewrite every page
+ * to freeze them. Like COPY, this is only safe if the relation was created, or
+ * got a new relfilenode, in the current subtransaction since then no other
+ * transaction can see it, and if no snapshot older than the insertion is still
+ * in use in this transaction. If that is not the case the rows are inserted
+ * normally.
+ *
+ * heap_multi_insert in the supported PostgreSQL versions does not set the
+ * pages all-visible for frozen rows, so the visibility map is still set by
+ * the next vacuum, which then only has to read the pages.
+ */
+static void
+multi_insert_buffer_set_frozen(MultiInsertBuffer *buffer)
+{
+	Relation rel = buffer->rel;
+
+	if (!ts_guc_enable_frozen_compression)
+		return;
+
+	if (rel->rd_createSubid == InvalidSubTransactionId &&
+		rel->rd_newRelfilenodeSubid == InvalidSubTransactionId)
+		return;
+
+	InvalidateCatalogSnapshot();
+	if (!ThereAreNoPriorRegisteredSnapshots() || !ThereAreNoReadyPortals())
+		return;
+
+	buffer->options |= HEAP_INSERT_FROZEN;
+}
+
+static void
+multi_insert_buffer_flush(MultiInsertBuffer *buffer)
+{
+	MemoryContext old_ctx;
+	int i;
+
+	if (buffer->num_tuples == 0)
+		return;
+
+	/* toasting and the index insertions allocate, so clean up on every flush */
+	old_ctx = MemoryContextSwitchTo(buffer->tuple_ctx);
+
+#if PG12_LT
+	{
+		HeapTuple *tuples = palloc(sizeof(HeapTuple) * buffer->num_tuples);
+
+		/* sets t_self of the tuples, so also of the tuples in the slots */
+		for (i = 0; i < buffer->num_tuples; i++)
+			tuples[i] = buffer->slots[i]->tts_tuple;
+		heap_multi_insert(buffer->rel,
+						  tuples,
+						  buffer->num_tuples,
+						  buffer->mycid,
+						  buffer->options,
+						  buffer->bistate);
+	}
+#else
+	heap_multi_insert(buffer->rel,
+					  buffer->slots,
+					  buffer->num_tuples,
+					  buffer->mycid,
+					  buffer->options,
+					  buffer->bistate);
+#endif
+
+	for (i = 0; i < buffer->num_tuples; i++)
+	{
+		if (buffer->estate != NULL)
+		{
+			List *recheck_indexes = ExecInsertIndexTuplesCompat(buffer->slots[i],
+																buffer->estate,
+																false,
+																NULL,
+																NIL);
+			list_free(recheck_indexes);
+			ResetPerTupleExprContext(buffer->estate);
+		}
+		ExecClearTuple(buffer->slots[i]);
+	}
+
+	MemoryContextSwitchTo(old_ctx);
+	MemoryContextReset(buffer->tuple_ctx);
+	buffer->num_tuples = 0;
+	buffer->num_bytes = 0;
+}
+
+/* takes ownership of tuple, which must be allocated in the tuple_ctx of the buffer */
+static void
+multi_insert_buffer_store(MultiInsertBuffer *buffer, CommandId mycid, HeapTuple tuple)
+{
+	TupleTableSlot *slot;
+
+	Assert(buffer->num_tuples == 0 || buffer->mycid == mycid);
+	buffer->mycid = mycid;
+
+	if (buffer->num_tuples == buffer->num_slots)
+	{
+		/* the slots live as long as the buffer */
+		MemoryContext old_ctx = MemoryContextSwitchTo(GetMemoryChunkContext(buffer));
+
+		buffer->slots[buffer->num_slots++] =
+			MakeSingleTupleTableSlotCompat(RelationGetDescr(buffer->rel), TTSOpsHeapTupleP);
+		MemoryContextSwitchTo(old_ctx);
+	}
+
+	slot = buffer->slots[buffer->num_tuples++];
+	ExecStoreHeapTupleCompat(tuple, slot, true);
+	buffer->num_bytes += tuple->t_len;
+
+	if (buffer->num_tuples >= MULTI_INSERT_MAX_TUPLES ||
+		buffer->num_bytes >= MULTI_INSERT_MAX_BYTES)
+		multi_insert_buffer_flush(buffer);
+}
+
+static void
+multi_insert_buffer_add_values(MultiInsertBuffer *buffer, CommandId mycid, Datum *values,
+							   bool *isnull)
+{
+	MemoryContext old_ctx = MemoryContextSwitchTo(buffer->tuple_ctx);
+	HeapTuple tuple = heap_form_tuple(RelationGetDescr(buffer->rel), values, isnull);
+
+	MemoryContextSwitchTo(old_ctx);
+	multi_insert_buffer_store(buffer, mycid, tuple);
+}
+
+static void
+multi_insert_buffer_add_tuple(MultiInsertBuffer *buffer, CommandId mycid, HeapTuple tuple)
+{
+	MemoryContext old_ctx = MemoryContextSwitchTo(buffer->tuple_ctx);
+	HeapTuple copy = heap_copytuple(tuple);
+
+	MemoryContextSwitchTo(old_ctx);
+	multi_insert_buffer_store(buffer, mycid, copy);
+}
+
+/* inserts the remaining tuples */
+static void
+multi_insert_buffer_destroy(MultiInsertBuffer *buffer)
+{
+	int i;
+
+	multi_insert_buffer_flush(buffer);
+
+	for (i = 0; i < buffer->num_slots; i++)
+		ExecDropSingleTupleTableSlot(buffer->slots[i]);
+	FreeBulkInsertState(buffer->bistate);
+	MemoryContextDelete(buffer->tuple_ctx);
+	pfree(buffer->slots);
+	pfree(buffer);
+}
+
 typedef struct SegmentInfo
 {
 	Datum val;
@@ -94,6 +446,12 @@ typedef struct PerColumn
 {
 	/* the compressor to use for regular columns, NULL for segmenters */
 	Compressor *compressor;
+	/*
+	 * The shared dictionary compressor of the column, possibly wrapped by
+	 * compressor, whose dictionary is stored when the chunk is done. NULL if
+	 * the column does not use a shared dictionary.
+	 */
+	Compressor *shared_dictionary;
 	/*
 	 * Information on the metadata we'll store for this column (currently only min/max).
 	 * Only used for order-by columns right now, will be {-1, NULL} for others.
@@ -101,6 +459,12 @@ typedef struct PerColumn
 	int16 min_metadata_attr_offset;
 	int16 max_metadata_attr_offset;
 	SegmentMetaMinMaxBuilder *min_max_metadata_builder;
+	/*
+	 * The bloom filter metadata of columns listed in the compress_bloomfilter
+	 * option, {-1, NULL} for others.
+	 */
+	int16 bloom_metadata_attr_offset;
+	SegmentMetaBloomBuilder *bloom_metadata_builder;
 
 	/* segment info; only used if compressor is NULL */
 	SegmentInfo *segment_info;
@@ -113,7 +477,9 @@ typedef struct RowCompressor
 
 	/* the table we're writing the compressed data to */
 	Relation compressed_table;
-	BulkInsertState bistate;
+	MultiInsertBuffer *insert_buffer;
+	/* in a parallel worker, the queue the compressed rows are sent to the leader through */
+	shm_mq_handle *tuple_queue;
 
 	/* in theory we could have more input columns than outputted ones, so we
 	   store the number of inputs/compressors seperately*/
@@ -132,6 +498,11 @@ typedef struct RowCompressor
 
 	/* the number of uncompressed rows compressed into the current compressed row */
 	uint32 rows_compressed_into_current_value;
+	/* the number of rows after which the current compressed row is full */
+	uint32 rows_per_batch;
+	uint32 max_rows_per_batch;
+	/* compressed size to adapt rows_per_batch toward, 0 for a fixed number of rows */
+	int32 target_batch_bytes;
 	/* a unique monotonically increasing (according to order by) id for each compressed row */
 	int32 sequence_num;
 
@@ -145,14 +516,33 @@ typedef struct RowCompressor
 static int16 *compress_chunk_populate_keys(Oid in_table, const ColumnCompressionInfo **columns,
 										   int n_columns, int *n_keys_out,
 										   const ColumnCompressionInfo ***keys_out);
+typedef struct SegmentPartition SegmentPartition;
+
+static Tuplesortstate *compress_chunk_begin_sort(Relation in_rel, int n_keys,
+												 const ColumnCompressionInfo **keys);
 static Tuplesortstate *compress_chunk_sort_relation(Relation in_rel, int n_keys,
-													const ColumnCompressionInfo **keys);
+													const ColumnCompressionInfo **keys,
+													Snapshot snapshot);
+static Relation compress_chunk_find_ordered_index(Relation in_rel, int n_keys,
+												 const ColumnCompressionInfo **keys,
+												 ScanDirection *direction);
+static bool compress_chunk_parallel(Relation in_rel, Relation out_rel,
+									const ColumnCompressionInfo **columns, int num_columns,
+									int n_keys, const ColumnCompressionInfo **keys,
+									const CompressionBatchSize *batch_size,
+									const CompressionBlockCodec *column_codecs,
+									CompressionStats *cstat);
 static void row_compressor_init(RowCompressor *row_compressor, TupleDesc uncompressed_tuple_desc,
 								Relation compressed_table, int num_compression_infos,
 								const ColumnCompressionInfo **column_compression_info,
-								int16 *column_offsets, int16 num_compressed_columns);
+								int16 *column_offsets, int16 num_compressed_columns,
+								const CompressionBatchSize *batch_size,
+								const CompressionBlockCodec *column_codecs);
 static void row_compressor_append_sorted_rows(RowCompressor *row_compressor,
 											  Tuplesortstate *sorted_rel, TupleDesc sorted_desc);
+static void row_compressor_append_index_ordered_rows(RowCompressor *row_compressor,
+													 Relation in_rel, Relation index_rel,
+													 ScanDirection direction);
 static void row_compressor_finish(RowCompressor *row_compressor);
 
 /********************
@@ -268,7 +658,8 @@ truncate_relation(Oid table_oid)
 
 CompressionStats
 compress_chunk(Oid in_table, Oid out_table, const ColumnCompressionInfo **column_compression_info,
-			   int num_compression_infos)
+			   int num_compression_infos, const CompressionBatchSize *batch_size,
+			   const CompressionBlockCodec *column_codecs)
 {
 	int n_keys;
 	const ColumnCompressionInfo **keys;
@@ -295,26 +686,59 @@ compress_chunk(Oid in_table, Oid out_table, const ColumnCompressionInfo **column
 	TupleDesc in_desc = RelationGetDescr(in_rel);
 	TupleDesc out_desc = RelationGetDescr(out_rel);
 
-	Tuplesortstate *sorted_rel = compress_chunk_sort_relation(in_rel, n_keys, keys);
-
-	RowCompressor row_compressor;
-
 	Assert(num_compression_infos <= in_desc->natts);
 	Assert(num_compression_infos <= out_desc->natts);
 
-	row_compressor_init(&row_compressor,
-						in_desc,
-						out_rel,
-						num_compression_infos,
-						column_compression_info,
-						in_column_offsets,
-						out_desc->natts);
+	if (!compress_chunk_parallel(in_rel,
+								 out_rel,
+								 column_compression_info,
+								 num_compression_infos,
+								 n_keys,
+								 keys,
+								 batch_size,
+								 column_codecs,
+								 &cstat))
+	{
+		ScanDirection index_direction = NoMovementScanDirection;
+		Relation index_rel =
+			ts_guc_enable_compression_indexscan ?
+				compress_chunk_find_ordered_index(in_rel, n_keys, keys, &index_direction) :
+				NULL;
+		RowCompressor row_compressor;
+
+		row_compressor_init(&row_compressor,
+							in_desc,
+							out_rel,
+							num_compression_infos,
+							column_compression_info,
+							in_column_offsets,
+							out_desc->natts,
+							batch_size,
+							column_codecs);
+
+		/* an index already in the order we need saves sorting, which may spill to disk */
+		if (index_rel != NULL)
+		{
+			row_compressor_append_index_ordered_rows(&row_compressor,
+													 in_rel,
+													 index_rel,
+													 index_direction);
+			index_close(index_rel, NoLock);
+		}
+		else
+		{
+			Tuplesortstate *sorted_rel =
+				compress_chunk_sort_relation(in_rel, n_keys, keys, GetLatestSnapshot());
 
-	row_compressor_append_sorted_rows(&row_compressor, sorted_rel, in_desc);
+			row_compressor_append_sorted_rows(&row_compressor, sorted_rel, in_desc);
+			tuplesort_end(sorted_rel);
+		}
 
-	row_compressor_finish(&row_compressor);
+		row_compressor_finish(&row_compressor);
 
-	tuplesort_end(sorted_rel);
+		cstat.rowcnt_pre_compression = row_compressor.rowcnt_pre_compression;
+		cstat.rowcnt_post_compression = row_compressor.num_compressed_rows;
+	}
 
 	truncate_relation(in_table);
 
@@ -324,8 +748,6 @@ compress_chunk(Oid in_table, Oid out_table, const ColumnCompressionInfo **column
 
 	table_close(out_rel, NoLock);
 	table_close(in_rel, NoLock);
-	cstat.rowcnt_pre_compression = row_compressor.rowcnt_pre_compression;
-	cstat.rowcnt_post_compression = row_compressor.num_compressed_rows;
 	return cstat;
 }
 
@@ -381,14 +803,11 @@ static void compress_chunk_populate_sort_info_for_column(Oid table,
 														 AttrNumber *att_nums, Oid *sort_operator,
 														 Oid *collation, bool *nulls_first);
 
+/* A sort of rows of the chunk into the order of the compressed batches */
 static Tuplesortstate *
-compress_chunk_sort_relation(Relation in_rel, int n_keys, const ColumnCompressionInfo **keys)
+compress_chunk_begin_sort(Relation in_rel, int n_keys, const ColumnCompressionInfo **keys)
 {
 	TupleDesc tupDesc = RelationGetDescr(in_rel);
-	Tuplesortstate *tuplesortstate;
-	HeapTuple tuple;
-	TableScanDesc heapScan;
-	TupleTableSlot *heap_tuple_slot = MakeTupleTableSlotCompat(tupDesc, TTSOpsHeapTupleP);
 	AttrNumber *sort_keys = palloc(sizeof(*sort_keys) * n_keys);
 	Oid *sort_operators = palloc(sizeof(*sort_operators) * n_keys);
 	Oid *sort_collations = palloc(sizeof(*sort_collations) * n_keys);
@@ -403,17 +822,29 @@ compress_chunk_sort_relation(Relation in_rel, int n_keys, const ColumnCompressio
 													 &sort_collations[n],
 													 &nulls_first[n]);
 
-	tuplesortstate = tuplesort_begin_heap(tupDesc,
-										  n_keys,
-										  sort_keys,
-										  sort_operators,
-										  sort_collations,
-										  nulls_first,
-										  work_mem,
-										  NULL,
-										  false /*=randomAccess*/);
-
-	heapScan = table_beginscan(in_rel, GetLatestSnapshot(), 0, (ScanKey) NULL);
+	return tuplesort_begin_heap(tupDesc,
+								n_keys,
+								sort_keys,
+								sort_operators,
+								sort_collations,
+								nulls_first,
+								work_mem,
+								NULL,
+								false /*=randomAccess*/);
+}
+
+/* Sort the rows of the chunk visible to the snapshot */
+static Tuplesortstate *
+compress_chunk_sort_relation(Relation in_rel, int n_keys, const ColumnCompressionInfo **keys,
+							 Snapshot snapshot)
+{
+	Tuplesortstate *tuplesortstate = compress_chunk_begin_sort(in_rel, n_keys, keys);
+	HeapTuple tuple;
+	TableScanDesc heapScan;
+	TupleTableSlot *heap_tuple_slot =
+		MakeTupleTableSlotCompat(RelationGetDescr(in_rel), TTSOpsHeapTupleP);
+
+	heapScan = table_beginscan(in_rel, snapshot, 0, (ScanKey) NULL);
 	for (tuple = heap_getnext(heapScan, ForwardScanDirection); tuple != NULL;
 		 tuple = heap_getnext(heapScan, ForwardScanDirection))
 	{
@@ -458,28 +889,603 @@ compress_chunk_populate_sort_info_for_column(Oid table, const ColumnCompressionI
 			 get_rel_name(table),
 			 NameStr(column->attname));
 
-	att_tup = (Form_pg_attribute) GETSTRUCT(tp);
-	/* Other valdation checks beyond just existence of a valid comparison operator could be useful
-	 */
+	att_tup = (Form_pg_attribute) GETSTRUCT(tp);
+	/* Other valdation checks beyond just existence of a valid comparison operator could be useful
+	 */
+
+	*att_nums = att_tup->attnum;
+	*collation = att_tup->attcollation;
+	*nulls_first = (!(COMPRESSIONCOL_IS_SEGMENT_BY(column))) && column->orderby_nullsfirst;
+
+	tentry = lookup_type_cache(att_tup->atttypid, TYPECACHE_LT_OPR | TYPECACHE_GT_OPR);
+
+	if (COMPRESSIONCOL_IS_SEGMENT_BY(column) || column->orderby_asc)
+		*sort_operator = tentry->lt_opr;
+	else
+		*sort_operator = tentry->gt_opr;
+
+	if (!OidIsValid(*sort_operator))
+		elog(ERROR,
+			 "no valid sort operator for column \"%s\" of type \"%s\"",
+			 NameStr(column->attname),
+			 format_type_be(att_tup->atttypid));
+
+	ReleaseSysCache(tp);
+}
+
+/*
+ * Returns the direction to scan the index in to read the rows in the sort order, or
+ * NoMovementScanDirection if the index does not give that order.
+ */
+static ScanDirection
+index_scan_direction_for_sort(Relation index_rel, int n_keys, const AttrNumber *sort_keys,
+							  const Oid *sort_operators, const Oid *sort_collations,
+							  const bool *nulls_first)
+{
+	Form_pg_index index = index_rel->rd_index;
+	ScanDirection direction = NoMovementScanDirection;
+	int n;
+
+	/* a partial index does not have all the rows */
+	if (index_rel->rd_rel->relam != BTREE_AM_OID || !index->indisvalid ||
+		IndexRelationGetNumberOfKeyAttributes(index_rel) < n_keys ||
+		RelationGetIndexPredicate(index_rel) != NIL)
+		return NoMovementScanDirection;
+
+	for (n = 0; n < n_keys; n++)
+	{
+		bool index_desc = (index_rel->rd_indoption[n] & INDOPTION_DESC) != 0;
+		bool index_nulls_first = (index_rel->rd_indoption[n] & INDOPTION_NULLS_FIRST) != 0;
+		Oid opfamily;
+		Oid opcintype;
+		int16 strategy;
+		bool sort_desc;
+		ScanDirection column_direction;
+
+		if (index->indkey.values[n] != sort_keys[n] ||
+			index_rel->rd_indcollation[n] != sort_collations[n] ||
+			!get_ordering_op_properties(sort_operators[n], &opfamily, &opcintype, &strategy) ||
+			index_rel->rd_opfamily[n] != opfamily)
+			return NoMovementScanDirection;
+
+		sort_desc = strategy == BTGreaterStrategyNumber;
+
+		/* a backward scan reverses both the order and the position of the NULLs */
+		if (index_desc == sort_desc && index_nulls_first == nulls_first[n])
+			column_direction = ForwardScanDirection;
+		else if (index_desc != sort_desc && index_nulls_first != nulls_first[n])
+			column_direction = BackwardScanDirection;
+		else
+			return NoMovementScanDirection;
+
+		if (n > 0 && column_direction != direction)
+			return NoMovementScanDirection;
+
+		direction = column_direction;
+	}
+
+	return direction;
+}
+
+/*
+ * Find a btree index on the chunk whose leading columns are ordered by the segmentby and
+ * orderby columns, e.g. the one the reorder policy uses, so that the rows can be read in
+ * order with an index scan instead of sorting them. The index is returned open.
+ *
+ * Like CLUSTER, we only use the index if the planner estimates the full index scan to be
+ * cheaper than a sequential scan and sort. That depends on the correlation of the index with
+ * the table in the statistics of the chunk: reading an uncorrelated index fetches the heap
+ * pages in random order, which is slower than sorting once the chunk does not fit in the cache.
+ */
+static Relation
+compress_chunk_find_ordered_index(Relation in_rel, int n_keys, const ColumnCompressionInfo **keys,
+								  ScanDirection *direction)
+{
+	AttrNumber *sort_keys = palloc(sizeof(*sort_keys) * n_keys);
+	Oid *sort_operators = palloc(sizeof(*sort_operators) * n_keys);
+	Oid *sort_collations = palloc(sizeof(*sort_collations) * n_keys);
+	bool *nulls_first = palloc(sizeof(*nulls_first) * n_keys);
+	List *index_oids = RelationGetIndexList(in_rel);
+	ListCell *lc;
+	int n;
+
+	for (n = 0; n < n_keys; n++)
+		compress_chunk_populate_sort_info_for_column(RelationGetRelid(in_rel),
+													 keys[n],
+													 &sort_keys[n],
+													 &sort_operators[n],
+													 &sort_collations[n],
+													 &nulls_first[n]);
+
+	foreach (lc, index_oids)
+	{
+		Relation index_rel = index_open(lfirst_oid(lc), AccessShareLock);
+
+		*direction = index_scan_direction_for_sort(index_rel,
+												   n_keys,
+												   sort_keys,
+												   sort_operators,
+												   sort_collations,
+												   nulls_first);
+		if (*direction != NoMovementScanDirection &&
+			plan_cluster_use_sort(RelationGetRelid(in_rel), RelationGetRelid(index_rel)))
+		{
+			elog(DEBUG1,
+				 "not compressing \"%s\" using index scan on \"%s\", sorting is cheaper",
+				 RelationGetRelationName(in_rel),
+				 RelationGetRelationName(index_rel));
+			*direction = NoMovementScanDirection;
+		}
+
+		if (*direction != NoMovementScanDirection)
+		{
+			elog(DEBUG1,
+				 "compressing \"%s\" using index scan on \"%s\"",
+				 RelationGetRelationName(in_rel),
+				 RelationGetRelationName(index_rel));
+			list_free(index_oids);
+			return index_rel;
+		}
+
+		index_close(index_rel, AccessShareLock);
+	}
+
+	list_free(index_oids);
+	return NULL;
+}
+
+/*****************************
+ ** parallel compress_chunk **
+ *****************************/
+
+/*
+ * With timescaledb.max_parallel_compression_workers set, chunks with segmentby columns are
+ * compressed by parallel workers. The leader scans the chunk once and routes every row, by a
+ * hash of its segmentby values, through a queue to one of the workers. Each worker sorts the
+ * rows it receives and, once the leader has sent all rows, compresses them. Since every segment
+ * is compressed by exactly one worker, the compressed rows are the same as in the serial case,
+ * except that the sequence numbers restart in every worker; they only need to be increasing
+ * within a segment.
+ *
+ * Parallel workers cannot insert, so they send the compressed rows to the leader through a
+ * second queue, and the leader inserts them as they arrive. Toasting a compressed value assigns
+ * an OID, which is not possible while in parallel mode, so the rows that need toasting are
+ * kept in a tuplestore and inserted once the workers are done.
+ */
+#define PARALLEL_KEY_COMPRESS_SHARED UINT64CONST(0xC0FFEE0000000001)
+#define PARALLEL_KEY_TUPLE_QUEUE UINT64CONST(0xC0FFEE0000000002)
+#define PARALLEL_TUPLE_QUEUE_SIZE 65536
+
+/* every worker has a queue for the rows it compresses and one for the compressed rows */
+#define ParallelRowQueue(queue_space, worker)                                                      \
+	((shm_mq *) ((queue_space) + (2 * (worker)) * PARALLEL_TUPLE_QUEUE_SIZE))
+#define ParallelCompressedQueue(queue_space, worker)                                               \
+	((shm_mq *) ((queue_space) + (2 * (worker) + 1) * PARALLEL_TUPLE_QUEUE_SIZE))
+
+typedef struct ParallelCompressShared
+{
+	Oid in_table;
+	Oid out_table;
+	int32 num_columns;
+	bool has_batch_size;
+	CompressionBatchSize batch_size;
+
+	/* the column infos, followed by the block compression codec of each column */
+	FormData_hypertable_compression columns[FLEXIBLE_ARRAY_MEMBER];
+} ParallelCompressShared;
+
+#define ParallelCompressSharedCodecs(shared)                                                       \
+	((CompressionBlockCodec *) &(shared)->columns[(shared)->num_columns])
+
+struct SegmentPartition
+{
+	int num_keys;
+	AttrNumber *attnos;
+	FmgrInfo *hash_fns;
+	Oid *collations;
+};
+
+/* Returns NULL if there are no segmentby columns or some cannot be hashed */
+static SegmentPartition *
+segment_partition_create(Relation in_rel, int n_keys, const ColumnCompressionInfo **keys)
+{
+	TupleDesc desc = RelationGetDescr(in_rel);
+	SegmentPartition *partition = palloc0(sizeof(*partition));
+	int n;
+
+	partition->attnos = palloc(sizeof(*partition->attnos) * n_keys);
+	partition->hash_fns = palloc(sizeof(*partition->hash_fns) * n_keys);
+	partition->collations = palloc(sizeof(*partition->collations) * n_keys);
+
+	/* the segmentby columns come first in the sort keys */
+	for (n = 0; n < n_keys && COMPRESSIONCOL_IS_SEGMENT_BY(keys[n]); n++)
+	{
+		AttrNumber attno = get_attnum(RelationGetRelid(in_rel), NameStr(keys[n]->attname));
+		Form_pg_attribute attr = TupleDescAttr(desc, AttrNumberGetAttrOffset(attno));
+		TypeCacheEntry *tentry = lookup_type_cache(attr->atttypid, TYPECACHE_HASH_PROC_FINFO);
+
+		if (!OidIsValid(tentry->hash_proc))
+			return NULL;
+
+		partition->attnos[n] = attno;
+		fmgr_info_copy(&partition->hash_fns[n], &tentry->hash_proc_finfo, CurrentMemoryContext);
+		partition->collations[n] = attr->attcollation;
+	}
+
+	if (n == 0)
+		return NULL;
+
+	partition->num_keys = n;
+	return partition;
+}
+
+/* Combined hash of the segmentby values of a row, NULL values hash to 0 */
+static uint32
+segment_partition_hash(const SegmentPartition *partition, TupleTableSlot *slot)
+{
+	uint32 hash = 0;
+	int n;
+
+	for (n = 0; n < partition->num_keys; n++)
+	{
+		bool is_null;
+		Datum value = slot_getattr(slot, partition->attnos[n], &is_null);
+		uint32 value_hash = 0;
+
+		if (!is_null)
+			value_hash = DatumGetUInt32(
+				FunctionCall1Coll(&partition->hash_fns[n], partition->collations[n], value));
+
+		hash ^= value_hash + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+
+	return hash;
+}
+
+static void
+compress_chunk_parallel_end(ParallelContext *pcxt, Snapshot snapshot)
+{
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+	PopActiveSnapshot();
+	UnregisterSnapshot(snapshot);
+}
+
+/*
+ * Scan the chunk and send every row to the worker its segment belongs to. Returns the number
+ * of rows sent.
+ */
+static int64
+compress_chunk_parallel_route_rows(Relation in_rel, const SegmentPartition *partition,
+								   Snapshot snapshot, shm_mq_handle **row_queues, int num_workers)
+{
+	TupleTableSlot *slot = MakeTupleTableSlotCompat(RelationGetDescr(in_rel), TTSOpsHeapTupleP);
+	TableScanDesc scan = table_beginscan(in_rel, snapshot, 0, (ScanKey) NULL);
+	HeapTuple tuple;
+	int64 num_rows = 0;
+
+	while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		uint32 worker;
+
+		ExecStoreHeapTupleCompat(tuple, slot, false);
+		worker = segment_partition_hash(partition, slot) % num_workers;
+
+		/* a worker that failed has usually reported its error while we waited to send */
+		if (shm_mq_send(row_queues[worker], tuple->t_len, tuple->t_data, false /*=nowait*/) !=
+			SHM_MQ_SUCCESS)
+			elog(ERROR, "lost connection to a parallel compression worker");
+
+		num_rows++;
+	}
+
+	heap_endscan(scan);
+	ExecDropSingleTupleTableSlot(slot);
+	return num_rows;
+}
+
+/*
+ * Returns false, without compressing anything, if the chunk should not be compressed in
+ * parallel or no workers could be launched.
+ */
+static bool
+compress_chunk_parallel(Relation in_rel, Relation out_rel, const ColumnCompressionInfo **columns,
+						int num_columns, int n_keys, const ColumnCompressionInfo **keys,
+						const CompressionBatchSize *batch_size,
+						const CompressionBlockCodec *column_codecs, CompressionStats *cstat)
+{
+	int nworkers = ts_guc_max_parallel_compression_workers;
+	CommandId mycid;
+	Snapshot snapshot;
+	SegmentPartition *partition;
+	ParallelContext *pcxt;
+	ParallelCompressShared *shared;
+	Size shared_size;
+	char *queue_space;
+	shm_mq_handle **row_queues;
+	shm_mq_handle **compressed_queues;
+	int num_active;
+	int i;
+	Tuplestorestate *toasted_tuples;
+	TupleTableSlot *slot;
+	MultiInsertBuffer *insert_buffer;
+
+	/* the batches of a chunk column share one dictionary, which needs a single compressor */
+	if (nworkers <= 0 || IsInParallelMode() || ts_guc_enable_shared_dictionary_compression ||
+		RelationGetNumberOfBlocks(in_rel) < (BlockNumber) min_parallel_table_scan_size)
+		return false;
+
+	partition = segment_partition_create(in_rel, n_keys, keys);
+	if (partition == NULL)
+		return false;
+
+	/* neither can be assigned in parallel mode */
+	(void) GetCurrentTransactionId();
+	mycid = GetCurrentCommandId(true);
+
+	/* before registering the snapshot, which only the scan of the chunk uses */
+	insert_buffer = multi_insert_buffer_create(out_rel, NULL);
+	multi_insert_buffer_set_frozen(insert_buffer);
+
+	/* the scan uses the latest snapshot like the serial path, the workers get it as active one */
+	snapshot = RegisterSnapshot(GetLatestSnapshot());
+	PushActiveSnapshot(snapshot);
+
+	EnterParallelMode();
+#if PG12_LT
+	pcxt = CreateParallelContext(EXTENSION_TSL_SO,
+								 "tsl_compress_chunk_parallel_main",
+								 nworkers,
+								 true /*=serializable_okay*/);
+#else
+	pcxt = CreateParallelContext(EXTENSION_TSL_SO, "tsl_compress_chunk_parallel_main", nworkers);
+#endif
+
+	shared_size =
+		add_size(offsetof(ParallelCompressShared, columns),
+				 mul_size(num_columns,
+						  sizeof(FormData_hypertable_compression) + sizeof(CompressionBlockCodec)));
+	shm_toc_estimate_chunk(&pcxt->estimator, shared_size);
+	shm_toc_estimate_chunk(&pcxt->estimator, mul_size(2 * PARALLEL_TUPLE_QUEUE_SIZE, nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+	InitializeParallelDSM(pcxt);
+
+	/* no workers if the dynamic shared memory could not be created */
+	if (pcxt->nworkers == 0)
+	{
+		compress_chunk_parallel_end(pcxt, snapshot);
+		multi_insert_buffer_destroy(insert_buffer);
+		return false;
+	}
+
+	shared = shm_toc_allocate(pcxt->toc, shared_size);
+	shared->in_table = RelationGetRelid(in_rel);
+	shared->out_table = RelationGetRelid(out_rel);
+	shared->num_columns = num_columns;
+	shared->has_batch_size = batch_size != NULL;
+	if (batch_size != NULL)
+		shared->batch_size = *batch_size;
+	for (i = 0; i < num_columns; i++)
+	{
+		shared->columns[i] = *columns[i];
+		ParallelCompressSharedCodecs(shared)[i] =
+			column_codecs != NULL ? column_codecs[i] : COMPRESSION_BLOCK_CODEC_NONE;
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COMPRESS_SHARED, shared);
+
+	queue_space =
+		shm_toc_allocate(pcxt->toc, mul_size(2 * PARALLEL_TUPLE_QUEUE_SIZE, pcxt->nworkers));
+	row_queues = palloc(sizeof(*row_queues) * pcxt->nworkers);
+	compressed_queues = palloc(sizeof(*compressed_queues) * pcxt->nworkers);
+	for (i = 0; i < pcxt->nworkers; i++)
+	{
+		shm_mq *row_mq =
+			shm_mq_create(ParallelRowQueue(queue_space, i), PARALLEL_TUPLE_QUEUE_SIZE);
+		shm_mq *compressed_mq =
+			shm_mq_create(ParallelCompressedQueue(queue_space, i), PARALLEL_TUPLE_QUEUE_SIZE);
+
+		shm_mq_set_sender(row_mq, MyProc);
+		row_queues[i] = shm_mq_attach(row_mq, pcxt->seg, NULL);
+		shm_mq_set_receiver(compressed_mq, MyProc);
+		compressed_queues[i] = shm_mq_attach(compressed_mq, pcxt->seg, NULL);
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_TUPLE_QUEUE, queue_space);
+
+	LaunchParallelWorkers(pcxt);
+
+	if (pcxt->nworkers_launched == 0)
+	{
+		compress_chunk_parallel_end(pcxt, snapshot);
+		multi_insert_buffer_destroy(insert_buffer);
+		return false;
+	}
+
+	/* the rows are only routed to the workers that were launched */
+	for (i = 0; i < pcxt->nworkers; i++)
+	{
+		if (i < pcxt->nworkers_launched)
+		{
+			shm_mq_set_handle(row_queues[i], pcxt->worker[i].bgwhandle);
+			shm_mq_set_handle(compressed_queues[i], pcxt->worker[i].bgwhandle);
+		}
+		else
+		{
+			shm_mq_detach(row_queues[i]);
+			shm_mq_detach(compressed_queues[i]);
+		}
+	}
+
+	cstat->rowcnt_pre_compression = compress_chunk_parallel_route_rows(in_rel,
+																	   partition,
+																	   snapshot,
+																	   row_queues,
+																	   pcxt->nworkers_launched);
+
+	/* detaching tells the workers that they have all their rows */
+	for (i = 0; i < pcxt->nworkers_launched; i++)
+		shm_mq_detach(row_queues[i]);
+
+	cstat->rowcnt_post_compression = 0;
+	toasted_tuples = tuplestore_begin_heap(false, false, work_mem);
+	num_active = pcxt->nworkers_launched;
+	while (num_active > 0)
+	{
+		bool got_tuple = false;
+
+		for (i = 0; i < pcxt->nworkers_launched; i++)
+		{
+			HeapTupleData tuple;
+			Size nbytes;
+			void *data;
+			shm_mq_result result;
+
+			if (compressed_queues[i] == NULL)
+				continue;
+
+			result = shm_mq_receive(compressed_queues[i], &nbytes, &data, true /*=nowait*/);
+			if (result == SHM_MQ_WOULD_BLOCK)
+				continue;
+
+			/* the worker is done, or failed and the error is rethrown below */
+			if (result == SHM_MQ_DETACHED)
+			{
+				shm_mq_detach(compressed_queues[i]);
+				compressed_queues[i] = NULL;
+				num_active--;
+				continue;
+			}
+
+			tuple.t_len = nbytes;
+			ItemPointerSetInvalid(&tuple.t_self);
+			tuple.t_tableOid = RelationGetRelid(out_rel);
+			tuple.t_data = data;
+
+			/* the same test heap_insert uses to decide whether to toast */
+			if (HeapTupleHasExternal(&tuple) || tuple.t_len > TOAST_TUPLE_THRESHOLD)
+				tuplestore_puttuple(toasted_tuples, &tuple);
+			else
+				multi_insert_buffer_add_tuple(insert_buffer, mycid, &tuple);
+
+			cstat->rowcnt_post_compression++;
+			got_tuple = true;
+		}
+
+		if (!got_tuple && num_active > 0)
+		{
+#if PG11
+			WaitLatch(MyLatch, WL_LATCH_SET, -1L, WAIT_EVENT_MQ_RECEIVE);
+#else
+			WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1L, WAIT_EVENT_MQ_RECEIVE);
+#endif
+			ResetLatch(MyLatch);
+		}
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	WaitForParallelWorkersToFinish(pcxt);
+	compress_chunk_parallel_end(pcxt, snapshot);
+
+	slot = MakeTupleTableSlotCompat(RelationGetDescr(out_rel), TTSOpsMinimalTupleP);
+	while (tuplestore_gettupleslot(toasted_tuples, true /*=forward*/, false /*=copy*/, slot))
+	{
+		bool should_free;
+		HeapTuple tuple = ExecFetchSlotHeapTuple(slot, false, &should_free);
+
+		multi_insert_buffer_add_tuple(insert_buffer, mycid, tuple);
+		if (should_free)
+			heap_freetuple(tuple);
+	}
+
+	ExecDropSingleTupleTableSlot(slot);
+	multi_insert_buffer_destroy(insert_buffer);
+	tuplestore_end(toasted_tuples);
+	return true;
+}
+
+void
+tsl_compress_chunk_parallel_main(dsm_segment *seg, shm_toc *toc)
+{
+	ParallelCompressShared *shared = shm_toc_lookup(toc, PARALLEL_KEY_COMPRESS_SHARED, false);
+	char *queue_space = shm_toc_lookup(toc, PARALLEL_KEY_TUPLE_QUEUE, false);
+	shm_mq *row_mq = ParallelRowQueue(queue_space, ParallelWorkerNumber);
+	shm_mq *compressed_mq = ParallelCompressedQueue(queue_space, ParallelWorkerNumber);
+	const CompressionBatchSize *batch_size = shared->has_batch_size ? &shared->batch_size : NULL;
+	const ColumnCompressionInfo **columns = palloc(sizeof(*columns) * shared->num_columns);
+	shm_mq_handle *row_queue;
+	shm_mq_handle *compressed_queue;
+	Relation in_rel;
+	Relation out_rel;
+	int16 *in_column_offsets;
+	int n_keys;
+	const ColumnCompressionInfo **keys;
+	Tuplesortstate *sorted_rel;
+	TupleTableSlot *slot;
+	RowCompressor row_compressor;
+	int i;
+
+	shm_mq_set_receiver(row_mq, MyProc);
+	row_queue = shm_mq_attach(row_mq, seg, NULL);
+	shm_mq_set_sender(compressed_mq, MyProc);
+	compressed_queue = shm_mq_attach(compressed_mq, seg, NULL);
+
+	for (i = 0; i < shared->num_columns; i++)
+		columns[i] = &shared->columns[i];
+
+	/* the leader's locks are shared with its workers, so these do not conflict with them */
+	in_rel = table_open(shared->in_table, AccessShareLock);
+	out_rel = table_open(shared->out_table, AccessShareLock);
+	in_column_offsets = compress_chunk_populate_keys(shared->in_table,
+													 columns,
+													 shared->num_columns,
+													 &n_keys,
+													 &keys);
+
+	sorted_rel = compress_chunk_begin_sort(in_rel, n_keys, keys);
+	slot = MakeTupleTableSlotCompat(RelationGetDescr(in_rel), TTSOpsHeapTupleP);
 
-	*att_nums = att_tup->attnum;
-	*collation = att_tup->attcollation;
-	*nulls_first = (!(COMPRESSIONCOL_IS_SEGMENT_BY(column))) && column->orderby_nullsfirst;
+	/* the leader detaches from the queue once it has sent all rows */
+	for (;;)
+	{
+		HeapTupleData tuple;
+		Size nbytes;
+		void *data;
+
+		if (shm_mq_receive(row_queue, &nbytes, &data, false /*=nowait*/) != SHM_MQ_SUCCESS)
+			break;
+
+		tuple.t_len = nbytes;
+		ItemPointerSetInvalid(&tuple.t_self);
+		tuple.t_tableOid = RelationGetRelid(in_rel);
+		tuple.t_data = data;
+		ExecStoreHeapTupleCompat(&tuple, slot, false);
+		tuplesort_puttupleslot(sorted_rel, slot);
+	}
 
-	tentry = lookup_type_cache(att_tup->atttypid, TYPECACHE_LT_OPR | TYPECACHE_GT_OPR);
+	shm_mq_detach(row_queue);
+	ExecDropSingleTupleTableSlot(slot);
+	tuplesort_performsort(sorted_rel);
 
-	if (COMPRESSIONCOL_IS_SEGMENT_BY(column) || column->orderby_asc)
-		*sort_operator = tentry->lt_opr;
-	else
-		*sort_operator = tentry->gt_opr;
+	row_compressor_init(&row_compressor,
+						RelationGetDescr(in_rel),
+						out_rel,
+						shared->num_columns,
+						columns,
+						in_column_offsets,
+						RelationGetDescr(out_rel)->natts,
+						batch_size,
+						ParallelCompressSharedCodecs(shared));
+	row_compressor.tuple_queue = compressed_queue;
 
-	if (!OidIsValid(*sort_operator))
-		elog(ERROR,
-			 "no valid sort operator for column \"%s\" of type \"%s\"",
-			 NameStr(column->attname),
-			 format_type_be(att_tup->atttypid));
+	row_compressor_append_sorted_rows(&row_compressor, sorted_rel, RelationGetDescr(in_rel));
 
-	ReleaseSysCache(tp);
+	row_compressor_finish(&row_compressor);
+
+	tuplesort_end(sorted_rel);
+
+	shm_mq_detach(compressed_queue);
+	table_close(out_rel, NoLock);
+	table_close(in_rel, NoLock);
 }
 
 /********************
@@ -497,12 +1503,15 @@ static SegmentInfo *segment_info_new(Form_pg_attribute column_attr);
 static void segment_info_update(SegmentInfo *segment_info, Datum val, bool is_null);
 static bool segment_info_datum_is_in_group(SegmentInfo *segment_info, Datum datum, bool is_null);
 
-/* num_compression_infos is the number of columns we will write to in the compressed table */
+/* num_compression_infos is the number of columns we will write to in the compressed table.
+ * column_codecs, if not NULL, has the block compression codec of each column.
+ */
 static void
 row_compressor_init(RowCompressor *row_compressor, TupleDesc uncompressed_tuple_desc,
 					Relation compressed_table, int num_compression_infos,
 					const ColumnCompressionInfo **column_compression_info, int16 *in_column_offsets,
-					int16 num_columns_in_compressed_table)
+					int16 num_columns_in_compressed_table, const CompressionBatchSize *batch_size,
+					const CompressionBlockCodec *column_codecs)
 {
 	TupleDesc out_desc = RelationGetDescr(compressed_table);
 	int col;
@@ -532,7 +1541,7 @@ row_compressor_init(RowCompressor *row_compressor, TupleDesc uncompressed_tuple_
 											 "compress chunk per-row",
 											 ALLOCSET_DEFAULT_SIZES),
 		.compressed_table = compressed_table,
-		.bistate = GetBulkInsertState(),
+		.insert_buffer = multi_insert_buffer_create(compressed_table, NULL),
 		.n_input_columns = uncompressed_tuple_desc->natts,
 		.per_column = palloc0(sizeof(PerColumn) * uncompressed_tuple_desc->natts),
 		.uncompressed_col_to_compressed_col =
@@ -543,11 +1552,23 @@ row_compressor_init(RowCompressor *row_compressor, TupleDesc uncompressed_tuple_
 		.compressed_values = palloc(sizeof(Datum) * num_columns_in_compressed_table),
 		.compressed_is_null = palloc(sizeof(bool) * num_columns_in_compressed_table),
 		.rows_compressed_into_current_value = 0,
+		.max_rows_per_batch =
+			batch_size != NULL ? batch_size->max_rows : COMPRESSION_DEFAULT_BATCH_SIZE,
+		.target_batch_bytes = batch_size != NULL ? batch_size->target_bytes : 0,
 		.rowcnt_pre_compression = 0,
 		.num_compressed_rows = 0,
 		.sequence_num = SEQUENCE_NUM_GAP,
 	};
 
+	multi_insert_buffer_set_frozen(row_compressor->insert_buffer);
+
+	Assert(row_compressor->max_rows_per_batch > 0);
+	/* start out with the default batch size when adapting toward a target size */
+	row_compressor->rows_per_batch =
+		row_compressor->target_batch_bytes > 0 ?
+			Min(row_compressor->max_rows_per_batch, COMPRESSION_DEFAULT_BATCH_SIZE) :
+			row_compressor->max_rows_per_batch;
+
 	memset(row_compressor->compressed_is_null, 1, sizeof(bool) * num_columns_in_compressed_table);
 
 	for (col = 0; col < num_compression_infos; col++)
@@ -569,6 +1590,12 @@ row_compressor_init(RowCompressor *row_compressor, TupleDesc uncompressed_tuple_
 			int16 segment_min_attr_offset = -1;
 			int16 segment_max_attr_offset = -1;
 			SegmentMetaMinMaxBuilder *segment_min_max_builder = NULL;
+			int16 segment_bloom_attr_offset = -1;
+			SegmentMetaBloomBuilder *segment_bloom_builder = NULL;
+			Compressor *compressor;
+			Compressor *shared_dictionary = NULL;
+			char *segment_bloom_col_name =
+				compression_column_segment_bloom_name(NameStr(compression_info->attname));
 			if (compressed_column_attr->atttypid != compressed_data_type_oid)
 				elog(ERROR,
 					 "expected column '%s' to be a compressed data type",
@@ -592,12 +1619,44 @@ row_compressor_init(RowCompressor *row_compressor, TupleDesc uncompressed_tuple_
 					segment_meta_min_max_builder_create(column_attr->atttypid,
 														column_attr->attcollation);
 			}
+
+			/* the bloom filter column only exists if it was configured for this column */
+			if (segment_bloom_col_name != NULL)
+			{
+				AttrNumber segment_bloom_attr_number =
+					get_attnum(compressed_table->rd_id, segment_bloom_col_name);
+				if (segment_bloom_attr_number != InvalidAttrNumber)
+				{
+					segment_bloom_attr_offset = AttrNumberGetAttrOffset(segment_bloom_attr_number);
+					segment_bloom_builder =
+						segment_meta_bloom_builder_create(column_attr->atttypid,
+														  column_attr->attcollation);
+				}
+			}
+
+			/* dictionary compressed columns can share one dictionary for the whole chunk */
+			if (compression_info->algo_id == COMPRESSION_ALGORITHM_DICTIONARY &&
+				ts_guc_enable_shared_dictionary_compression)
+			{
+				shared_dictionary = shared_dictionary_compressor_for_type(column_attr->atttypid);
+				compressor = shared_dictionary;
+			}
+			else
+				compressor = compressor_for_algorithm_and_type(compression_info->algo_id,
+															   column_attr->atttypid);
+
+			/* wrap the output of the column's algorithm if it has a block compression codec */
+			if (column_codecs != NULL && column_codecs[col] != COMPRESSION_BLOCK_CODEC_NONE)
+				compressor = block_compressor_wrap(compressor, column_codecs[col]);
+
 			*column = (PerColumn){
-				.compressor = compressor_for_algorithm_and_type(compression_info->algo_id,
-																column_attr->atttypid),
+				.compressor = compressor,
+				.shared_dictionary = shared_dictionary,
 				.min_metadata_attr_offset = segment_min_attr_offset,
 				.max_metadata_attr_offset = segment_max_attr_offset,
 				.min_max_metadata_builder = segment_min_max_builder,
+				.bloom_metadata_attr_offset = segment_bloom_attr_offset,
+				.bloom_metadata_builder = segment_bloom_builder,
 			};
 		}
 		else
@@ -610,16 +1669,52 @@ row_compressor_init(RowCompressor *row_compressor, TupleDesc uncompressed_tuple_
 				.segment_info = segment_info_new(column_attr),
 				.min_metadata_attr_offset = -1,
 				.max_metadata_attr_offset = -1,
+				.bloom_metadata_attr_offset = -1,
 			};
 		}
 	}
 }
 
+/* append the next row in segmentby and orderby order */
+static void
+row_compressor_append_ordered_row(RowCompressor *row_compressor, TupleTableSlot *slot,
+								  CommandId mycid, bool *first_iteration)
+{
+	bool changed_groups, compressed_row_is_full;
+	MemoryContext old_ctx;
+	slot_getallattrs(slot);
+	old_ctx = MemoryContextSwitchTo(row_compressor->per_row_ctx);
+
+	/* first time through */
+	if (*first_iteration)
+	{
+		row_compressor_update_group(row_compressor, slot);
+		*first_iteration = false;
+	}
+
+	changed_groups = row_compressor_new_row_is_in_new_group(row_compressor, slot);
+	compressed_row_is_full =
+		row_compressor->rows_compressed_into_current_value >= row_compressor->rows_per_batch;
+	if (compressed_row_is_full || changed_groups)
+	{
+		if (row_compressor->rows_compressed_into_current_value > 0)
+			row_compressor_flush(row_compressor, mycid, changed_groups);
+		if (changed_groups)
+			row_compressor_update_group(row_compressor, slot);
+	}
+
+	row_compressor_append_row(row_compressor, slot);
+	MemoryContextSwitchTo(old_ctx);
+	ExecClearTuple(slot);
+}
+
 static void
 row_compressor_append_sorted_rows(RowCompressor *row_compressor, Tuplesortstate *sorted_rel,
 								  TupleDesc sorted_desc)
 {
-	CommandId mycid = GetCurrentCommandId(true);
+	/* parallel workers do not insert, they send the compressed rows to the leader */
+	CommandId mycid =
+		row_compressor->tuple_queue == NULL ? GetCurrentCommandId(true) : InvalidCommandId;
 	TupleTableSlot *slot = MakeTupleTableSlotCompat(sorted_desc, TTSOpsMinimalTupleP);
 	bool got_tuple;
 	bool first_iteration = true;
@@ -635,38 +1730,31 @@ row_compressor_append_sorted_rows(RowCompressor *row_compressor, Tuplesortstate
 											false /*=copy*/,
 											slot,
 											NULL /*=abbrev*/))
-	{
-		bool changed_groups, compressed_row_is_full;
-		MemoryContext old_ctx;
-		slot_getallattrs(slot);
-		old_ctx = MemoryContextSwitchTo(row_compressor->per_row_ctx);
+		row_compressor_append_ordered_row(row_compressor, slot, mycid, &first_iteration);
 
-		/* first time through */
-		if (first_iteration)
-		{
-			row_compressor_update_group(row_compressor, slot);
-			first_iteration = false;
-		}
+	if (row_compressor->rows_compressed_into_current_value > 0)
+		row_compressor_flush(row_compressor, mycid, true);
 
-		changed_groups = row_compressor_new_row_is_in_new_group(row_compressor, slot);
-		compressed_row_is_full =
-			row_compressor->rows_compressed_into_current_value >= MAX_ROWS_PER_COMPRESSION;
-		if (compressed_row_is_full || changed_groups)
-		{
-			if (row_compressor->rows_compressed_into_current_value > 0)
-				row_compressor_flush(row_compressor, mycid, changed_groups);
-			if (changed_groups)
-				row_compressor_update_group(row_compressor, slot);
-		}
+	ExecDropSingleTupleTableSlot(slot);
+}
 
-		row_compressor_append_row(row_compressor, slot);
-		MemoryContextSwitchTo(old_ctx);
-		ExecClearTuple(slot);
-	}
+static void
+row_compressor_append_index_ordered_rows(RowCompressor *row_compressor, Relation in_rel,
+										 Relation index_rel, ScanDirection direction)
+{
+	CommandId mycid = GetCurrentCommandId(true);
+	IndexScanDesc scan = index_beginscan(in_rel, index_rel, GetLatestSnapshot(), 0, 0);
+	TupleTableSlot *slot = table_slot_create(in_rel, NULL);
+	bool first_iteration = true;
+
+	index_rescan(scan, NULL, 0, NULL, 0);
+	while (index_getnext_slot(scan, direction, slot))
+		row_compressor_append_ordered_row(row_compressor, slot, mycid, &first_iteration);
 
 	if (row_compressor->rows_compressed_into_current_value > 0)
 		row_compressor_flush(row_compressor, mycid, true);
 
+	index_endscan(scan);
 	ExecDropSingleTupleTableSlot(slot);
 }
 
@@ -746,6 +1834,9 @@ row_compressor_append_row(RowCompressor *row_compressor, TupleTableSlot *row)
 			if (row_compressor->per_column[col].min_max_metadata_builder != NULL)
 				segment_meta_min_max_builder_update_null(
 					row_compressor->per_column[col].min_max_metadata_builder);
+			if (row_compressor->per_column[col].bloom_metadata_builder != NULL)
+				segment_meta_bloom_builder_update_null(
+					row_compressor->per_column[col].bloom_metadata_builder);
 		}
 		else
 		{
@@ -754,17 +1845,46 @@ row_compressor_append_row(RowCompressor *row_compressor, TupleTableSlot *row)
 				segment_meta_min_max_builder_update_val(row_compressor->per_column[col]
 															.min_max_metadata_builder,
 														val);
+			if (row_compressor->per_column[col].bloom_metadata_builder != NULL)
+				segment_meta_bloom_builder_update_val(row_compressor->per_column[col]
+														  .bloom_metadata_builder,
+													  val);
 		}
 	}
 
 	row_compressor->rows_compressed_into_current_value += 1;
 }
 
+/*
+ * Size the next batch so that it compresses to about target_batch_bytes,
+ * assuming its rows compress as well as the ones of the batch just flushed.
+ * Batches cut short by the end of a segment are too small to tell.
+ */
+static void
+row_compressor_adapt_batch_size(RowCompressor *row_compressor, Size batch_bytes)
+{
+	uint32 rows = row_compressor->rows_compressed_into_current_value;
+	uint32 min_rows = Min(COMPRESSION_MIN_ADAPTIVE_BATCH_SIZE, row_compressor->max_rows_per_batch);
+	double next_rows;
+
+	if (rows < min_rows || batch_bytes == 0)
+		return;
+
+	next_rows = (double) row_compressor->target_batch_bytes * rows / batch_bytes;
+	if (next_rows < min_rows)
+		row_compressor->rows_per_batch = min_rows;
+	else if (next_rows > row_compressor->max_rows_per_batch)
+		row_compressor->rows_per_batch = row_compressor->max_rows_per_batch;
+	else
+		row_compressor->rows_per_batch = (uint32) next_rows;
+}
+
 static void
 row_compressor_flush(RowCompressor *row_compressor, CommandId mycid, bool changed_groups)
 {
 	int16 col;
 	HeapTuple compressed_tuple;
+	Size batch_bytes = 0;
 
 	for (col = 0; col < row_compressor->n_input_columns; col++)
 	{
@@ -789,8 +1909,11 @@ row_compressor_flush(RowCompressor *row_compressor, CommandId mycid, bool change
 			/* non-segment columns are NULL iff all the values are NULL */
 			row_compressor->compressed_is_null[compressed_col] = compressed_data == NULL;
 			if (compressed_data != NULL)
+			{
 				row_compressor->compressed_values[compressed_col] =
 					PointerGetDatum(compressed_data);
+				batch_bytes += VARSIZE(compressed_data);
+			}
 
 			if (column->min_max_metadata_builder != NULL)
 			{
@@ -815,6 +1938,21 @@ row_compressor_flush(RowCompressor *row_compressor, CommandId mycid, bool change
 					row_compressor->compressed_is_null[column->max_metadata_attr_offset] = true;
 				}
 			}
+
+			if (column->bloom_metadata_builder != NULL)
+			{
+				Assert(column->bloom_metadata_attr_offset >= 0);
+
+				/* no filter if all values are NULL, nothing can match it */
+				if (!segment_meta_bloom_builder_empty(column->bloom_metadata_builder))
+				{
+					row_compressor->compressed_is_null[column->bloom_metadata_attr_offset] = false;
+					row_compressor->compressed_values[column->bloom_metadata_attr_offset] =
+						segment_meta_bloom_builder_finish(column->bloom_metadata_builder);
+				}
+				else
+					row_compressor->compressed_is_null[column->bloom_metadata_attr_offset] = true;
+			}
 		}
 		else if (column->segment_info != NULL)
 		{
@@ -837,14 +1975,26 @@ row_compressor_flush(RowCompressor *row_compressor, CommandId mycid, bool change
 
 	row_compressor->sequence_num += SEQUENCE_NUM_GAP;
 
-	compressed_tuple = heap_form_tuple(RelationGetDescr(row_compressor->compressed_table),
+	if (row_compressor->target_batch_bytes > 0)
+		row_compressor_adapt_batch_size(row_compressor, batch_bytes);
+
+	if (row_compressor->tuple_queue != NULL)
+	{
+		compressed_tuple = heap_form_tuple(RelationGetDescr(row_compressor->compressed_table),
+										   row_compressor->compressed_values,
+										   row_compressor->compressed_is_null);
+		if (shm_mq_send(row_compressor->tuple_queue,
+						compressed_tuple->t_len,
+						compressed_tuple->t_data,
+						false /*=nowait*/) != SHM_MQ_SUCCESS)
+			elog(ERROR, "lost connection to the parallel compression leader");
+		heap_freetuple(compressed_tuple);
+	}
+	else
+		multi_insert_buffer_add_values(row_compressor->insert_buffer,
+									   mycid,
 									   row_compressor->compressed_values,
 									   row_compressor->compressed_is_null);
-	heap_insert(row_compressor->compressed_table,
-				compressed_tuple,
-				mycid,
-				0 /*=options*/,
-				row_compressor->bistate);
 
 	/* free the compressed values now that we're done with them (the old compressor is freed in
 	 * finish()) */
@@ -883,6 +2033,18 @@ row_compressor_flush(RowCompressor *row_compressor, CommandId mycid, bool change
 			segment_meta_min_max_builder_reset(column->min_max_metadata_builder);
 		}
 
+		if (column->bloom_metadata_builder != NULL)
+		{
+			if (!row_compressor->compressed_is_null[column->bloom_metadata_attr_offset])
+			{
+				pfree(DatumGetPointer(
+					row_compressor->compressed_values[column->bloom_metadata_attr_offset]));
+				row_compressor->compressed_values[column->bloom_metadata_attr_offset] = 0;
+				row_compressor->compressed_is_null[column->bloom_metadata_attr_offset] = true;
+			}
+			segment_meta_bloom_builder_reset(column->bloom_metadata_builder);
+		}
+
 		row_compressor->compressed_values[compressed_col] = 0;
 		row_compressor->compressed_is_null[compressed_col] = true;
 	}
@@ -895,7 +2057,25 @@ row_compressor_flush(RowCompressor *row_compressor, CommandId mycid, bool change
 static void
 row_compressor_finish(RowCompressor *row_compressor)
 {
-	FreeBulkInsertState(row_compressor->bistate);
+	int32 compressed_chunk_id = 0;
+	int col;
+
+	/* all batches are written, so the shared dictionaries are complete */
+	for (col = 0; col < row_compressor->n_input_columns; col++)
+	{
+		PerColumn *column = &row_compressor->per_column[col];
+
+		if (column->shared_dictionary == NULL)
+			continue;
+
+		if (compressed_chunk_id == 0)
+			compressed_chunk_id =
+				ts_chunk_get_by_relid(RelationGetRelid(row_compressor->compressed_table), true)
+					->fd.id;
+		shared_dictionary_compressor_store(column->shared_dictionary, compressed_chunk_id);
+	}
+
+	multi_insert_buffer_destroy(row_compressor->insert_buffer);
 }
 
 /******************
@@ -1004,7 +2184,9 @@ typedef struct RowDecompressor
 	Relation out_rel;
 
 	CommandId mycid;
-	BulkInsertState bistate;
+	MultiInsertBuffer *insert_buffer;
+
+	int64 tuples_decompressed;
 
 	/* cache memory used to store the decompressed datums/is_null for form_tuple */
 	Datum *decompressed_datums;
@@ -1059,7 +2241,7 @@ decompress_chunk(Oid in_table, Oid out_table)
 			.out_rel = out_rel,
 
 			.mycid = GetCurrentCommandId(true),
-			.bistate = GetBulkInsertState(),
+			.insert_buffer = multi_insert_buffer_create(out_rel, NULL),
 
 			/* cache memory used to store the decompressed datums/is_null for form_tuple */
 			.decompressed_datums = palloc(sizeof(Datum) * out_desc->natts),
@@ -1105,7 +2287,7 @@ decompress_chunk(Oid in_table, Oid out_table)
 		}
 
 		heap_endscan(heapScan);
-		FreeBulkInsertState(decompressor.bistate);
+		multi_insert_buffer_destroy(decompressor.insert_buffer);
 	}
 
 	/* Recreate all indexes on out rel, we already have an exclusive lock on it,
@@ -1116,6 +2298,344 @@ decompress_chunk(Oid in_table, Oid out_table)
 	table_close(in_rel, NoLock);
 }
 
+/********************
+ ** recompress_chunk **
+ ********************/
+
+static int
+segment_hash_cmp(const void *left, const void *right)
+{
+	uint32 l = *(const uint32 *) left;
+	uint32 r = *(const uint32 *) right;
+
+	return l < r ? -1 : (l > r ? 1 : 0);
+}
+
+/*
+ * Collect the sorted, deduplicated segment hashes of the rows staged in the
+ * uncompressed chunk. Returns the number of staged rows.
+ */
+static int64
+recompress_collect_segment_hashes(Relation in_rel, const SegmentPartition *partition,
+								  uint32 **hashes, int *num_hashes)
+{
+	TupleTableSlot *slot = MakeTupleTableSlotCompat(RelationGetDescr(in_rel), TTSOpsHeapTupleP);
+	TableScanDesc heapScan = table_beginscan(in_rel, GetLatestSnapshot(), 0, (ScanKey) NULL);
+	int capacity = 64;
+	int n = 0;
+	int64 num_rows = 0;
+	HeapTuple tuple;
+
+	*hashes = palloc(sizeof(**hashes) * capacity);
+
+	for (tuple = heap_getnext(heapScan, ForwardScanDirection); tuple != NULL;
+		 tuple = heap_getnext(heapScan, ForwardScanDirection))
+	{
+		num_rows++;
+
+		if (partition == NULL)
+			continue;
+
+#if PG12_LT
+		ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+#else
+		ExecStoreHeapTuple(tuple, slot, false);
+#endif
+		if (n == capacity)
+		{
+			capacity *= 2;
+			*hashes = repalloc(*hashes, sizeof(**hashes) * capacity);
+		}
+		(*hashes)[n++] = segment_partition_hash(partition, slot);
+	}
+
+	heap_endscan(heapScan);
+	ExecDropSingleTupleTableSlot(slot);
+
+	if (n > 1)
+	{
+		int unique = 1;
+		int i;
+
+		qsort(*hashes, n, sizeof(**hashes), segment_hash_cmp);
+		for (i = 1; i < n; i++)
+		{
+			if ((*hashes)[i] != (*hashes)[unique - 1])
+				(*hashes)[unique++] = (*hashes)[i];
+		}
+		n = unique;
+	}
+
+	*num_hashes = n;
+	return num_rows;
+}
+
+/*
+ * Merge the rows staged in the uncompressed chunk into the compressed chunk.
+ *
+ * Only the segments that received new rows are rebuilt: their compressed
+ * rows are decompressed into the uncompressed chunk next to the staged rows,
+ * deleted from the compressed chunk, and the uncompressed chunk is then
+ * compressed and appended to the compressed chunk as usual. Segments are
+ * matched by the hash of their segmentby values, so a hash collision only
+ * causes an unaffected segment to be rebuilt as well. Without segmentby
+ * columns the whole chunk is one segment.
+ *
+ * The returned stats are the number of staged rows and the change in the
+ * number of compressed rows.
+ */
+CompressionStats
+recompress_chunk_segments(Oid in_table, Oid out_table,
+						  const ColumnCompressionInfo **column_compression_info,
+						  int num_compression_infos, const CompressionBatchSize *batch_size,
+						  const CompressionBlockCodec *column_codecs)
+{
+	int n_keys;
+	const ColumnCompressionInfo **keys;
+	CompressionStats cstat;
+	/* same locks as compress_chunk, in the same order */
+	Relation in_rel = table_open(in_table, ExclusiveLock);
+	Relation out_rel = relation_open(out_table, ExclusiveLock);
+	int16 *in_column_offsets = compress_chunk_populate_keys(in_table,
+															column_compression_info,
+															num_compression_infos,
+															&n_keys,
+															&keys);
+	TupleDesc in_desc = RelationGetDescr(in_rel);
+	TupleDesc out_desc = RelationGetDescr(out_rel);
+	SegmentPartition *in_partition = segment_partition_create(in_rel, n_keys, keys);
+	SegmentPartition *out_partition =
+		in_partition != NULL ? segment_partition_create(out_rel, n_keys, keys) : NULL;
+	uint32 *segment_hashes;
+	int num_segment_hashes;
+	int64 num_deleted = 0;
+	Oid compressed_data_type_oid = ts_custom_type_cache_get(CUSTOM_TYPE_COMPRESSED_DATA)->type_oid;
+
+	if (out_partition == NULL)
+		in_partition = NULL;
+
+	cstat.rowcnt_pre_compression = recompress_collect_segment_hashes(in_rel,
+																	 in_partition,
+																	 &segment_hashes,
+																	 &num_segment_hashes);
+
+	/* a concurrent recompress already merged the staged rows */
+	if (cstat.rowcnt_pre_compression == 0)
+	{
+		cstat.rowcnt_post_compression = 0;
+		table_close(out_rel, NoLock);
+		table_close(in_rel, NoLock);
+		return cstat;
+	}
+
+	/* decompress the affected segments into the uncompressed chunk */
+	{
+		RowDecompressor decompressor = {
+			.per_compressed_cols = create_per_compressed_column(out_desc,
+																in_desc,
+																in_table,
+																compressed_data_type_oid),
+			.num_compressed_columns = out_desc->natts,
+
+			.out_desc = in_desc,
+			.out_rel = in_rel,
+
+			.mycid = GetCurrentCommandId(true),
+			.insert_buffer = multi_insert_buffer_create(in_rel, NULL),
+
+			.decompressed_datums = palloc(sizeof(Datum) * in_desc->natts),
+			.decompressed_is_nulls = palloc(sizeof(bool) * in_desc->natts),
+		};
+		Datum *compressed_datums = palloc(sizeof(*compressed_datums) * out_desc->natts);
+		bool *compressed_is_nulls = palloc(sizeof(*compressed_is_nulls) * out_desc->natts);
+		TupleTableSlot *slot = MakeTupleTableSlotCompat(out_desc, TTSOpsHeapTupleP);
+		TableScanDesc heapScan = table_beginscan(out_rel, GetLatestSnapshot(), 0, (ScanKey) NULL);
+		MemoryContext per_compressed_row_ctx =
+			AllocSetContextCreate(CurrentMemoryContext,
+								  "recompress chunk per-compressed row",
+								  ALLOCSET_DEFAULT_SIZES);
+		HeapTuple compressed_tuple;
+
+		memset(decompressor.decompressed_is_nulls, true, in_desc->natts);
+
+		for (compressed_tuple = heap_getnext(heapScan, ForwardScanDirection);
+			 compressed_tuple != NULL;
+			 compressed_tuple = heap_getnext(heapScan, ForwardScanDirection))
+		{
+			MemoryContext old_ctx;
+
+			if (out_partition != NULL)
+			{
+				uint32 hash;
+
+#if PG12_LT
+				ExecStoreTuple(compressed_tuple, slot, InvalidBuffer, false);
+#else
+				ExecStoreHeapTuple(compressed_tuple, slot, false);
+#endif
+				hash = segment_partition_hash(out_partition, slot);
+				ExecClearTuple(slot);
+
+				if (bsearch(&hash,
+							segment_hashes,
+							num_segment_hashes,
+							sizeof(*segment_hashes),
+							segment_hash_cmp) == NULL)
+					continue;
+			}
+
+			old_ctx = MemoryContextSwitchTo(per_compressed_row_ctx);
+
+			heap_deform_tuple(compressed_tuple, out_desc, compressed_datums, compressed_is_nulls);
+			populate_per_compressed_columns_from_data(decompressor.per_compressed_cols,
+													  out_desc->natts,
+													  compressed_datums,
+													  compressed_is_nulls);
+			row_decompressor_decompress_row(&decompressor);
+			MemoryContextSwitchTo(old_ctx);
+			MemoryContextReset(per_compressed_row_ctx);
+
+			simple_heap_delete(out_rel, &compressed_tuple->t_self);
+			num_deleted++;
+		}
+
+		heap_endscan(heapScan);
+		ExecDropSingleTupleTableSlot(slot);
+		multi_insert_buffer_destroy(decompressor.insert_buffer);
+		MemoryContextDelete(per_compressed_row_ctx);
+	}
+
+	/* make the decompressed rows visible to the sort below */
+	CommandCounterIncrement();
+
+	/* the decompressed rows are not in the indexes of the uncompressed chunk,
+	 * so always sort instead of scanning an index */
+	{
+		RowCompressor row_compressor;
+		Tuplesortstate *sorted_rel =
+			compress_chunk_sort_relation(in_rel, n_keys, keys, GetLatestSnapshot());
+
+		row_compressor_init(&row_compressor,
+							in_desc,
+							out_rel,
+							num_compression_infos,
+							column_compression_info,
+							in_column_offsets,
+							out_desc->natts,
+							batch_size,
+							column_codecs);
+		row_compressor_append_sorted_rows(&row_compressor, sorted_rel, in_desc);
+		tuplesort_end(sorted_rel);
+		row_compressor_finish(&row_compressor);
+
+		cstat.rowcnt_post_compression = row_compressor.num_compressed_rows - num_deleted;
+	}
+
+	truncate_relation(in_table);
+	reindex_relation(out_table, 0, 0);
+
+	table_close(out_rel, NoLock);
+	table_close(in_rel, NoLock);
+	return cstat;
+}
+
+/*
+ * Decompress the batches of a compressed chunk for which filter holds into
+ * the result relation of estate, which must be the uncompressed chunk, and
+ * delete them from the compressed chunk. This lets UPDATE and DELETE operate
+ * on the rows of the affected batches only. The filter is evaluated against
+ * the compressed tuples in econtext; a NULL filter matches every batch.
+ *
+ * Index entries for the decompressed rows are inserted as well, since the
+ * scan of the uncompressed chunk may use an index to find them. The rows stay
+ * in the uncompressed chunk until the chunk is recompressed.
+ *
+ * Returns the number of decompressed rows and batches.
+ */
+CompressionStats
+decompress_batches_for_dml(Oid compressed_relid, EState *estate, ExprState *filter,
+						   ExprContext *econtext)
+{
+	ResultRelInfo *result_rel_info = estate->es_result_relation_info;
+	Relation out_rel = result_rel_info->ri_RelationDesc;
+	/* serialize with other decompressors and with recompression of this chunk */
+	Relation in_rel = table_open(compressed_relid, ExclusiveLock);
+	TupleDesc in_desc = RelationGetDescr(in_rel);
+	TupleDesc out_desc = RelationGetDescr(out_rel);
+	Oid compressed_data_type_oid = ts_custom_type_cache_get(CUSTOM_TYPE_COMPRESSED_DATA)->type_oid;
+	RowDecompressor decompressor = {
+		.per_compressed_cols = create_per_compressed_column(in_desc,
+															out_desc,
+															RelationGetRelid(out_rel),
+															compressed_data_type_oid),
+		.num_compressed_columns = in_desc->natts,
+
+		.out_desc = out_desc,
+		.out_rel = out_rel,
+
+		.mycid = GetCurrentCommandId(true),
+		.insert_buffer =
+			multi_insert_buffer_create(out_rel, result_rel_info->ri_NumIndices > 0 ? estate : NULL),
+
+		.decompressed_datums = palloc(sizeof(Datum) * out_desc->natts),
+		.decompressed_is_nulls = palloc(sizeof(bool) * out_desc->natts),
+	};
+	Datum *compressed_datums = palloc(sizeof(*compressed_datums) * in_desc->natts);
+	bool *compressed_is_nulls = palloc(sizeof(*compressed_is_nulls) * in_desc->natts);
+	TupleTableSlot *slot = MakeTupleTableSlotCompat(in_desc, TTSOpsHeapTupleP);
+	TableScanDesc heapScan = table_beginscan(in_rel, estate->es_snapshot, 0, (ScanKey) NULL);
+	MemoryContext per_compressed_row_ctx =
+		AllocSetContextCreate(CurrentMemoryContext,
+							  "decompress batches per-compressed row",
+							  ALLOCSET_DEFAULT_SIZES);
+	HeapTuple compressed_tuple;
+	CompressionStats cstat = { 0 };
+
+	memset(decompressor.decompressed_is_nulls, true, out_desc->natts);
+
+	for (compressed_tuple = heap_getnext(heapScan, ForwardScanDirection);
+		 compressed_tuple != NULL;
+		 compressed_tuple = heap_getnext(heapScan, ForwardScanDirection))
+	{
+		MemoryContext old_ctx;
+		bool matches;
+
+		ExecStoreHeapTupleCompat(compressed_tuple, slot, false);
+		econtext->ecxt_scantuple = slot;
+		matches = ExecQual(filter, econtext);
+		ResetExprContext(econtext);
+		ExecClearTuple(slot);
+
+		if (!matches)
+			continue;
+
+		old_ctx = MemoryContextSwitchTo(per_compressed_row_ctx);
+
+		heap_deform_tuple(compressed_tuple, in_desc, compressed_datums, compressed_is_nulls);
+		populate_per_compressed_columns_from_data(decompressor.per_compressed_cols,
+												  in_desc->natts,
+												  compressed_datums,
+												  compressed_is_nulls);
+		row_decompressor_decompress_row(&decompressor);
+		MemoryContextSwitchTo(old_ctx);
+		MemoryContextReset(per_compressed_row_ctx);
+
+		/* errors out if a concurrent transaction already decompressed the batch */
+		simple_heap_delete(in_rel, &compressed_tuple->t_self);
+		cstat.rowcnt_post_compression++;
+	}
+
+	heap_endscan(heapScan);
+	ExecDropSingleTupleTableSlot(slot);
+	/* the scan of the uncompressed chunk must see all decompressed rows */
+	multi_insert_buffer_destroy(decompressor.insert_buffer);
+	MemoryContextDelete(per_compressed_row_ctx);
+
+	cstat.rowcnt_pre_compression = decompressor.tuples_decompressed;
+	table_close(in_rel, NoLock);
+	return cstat;
+}
+
 static PerCompressedColumn *
 create_per_compressed_column(TupleDesc in_desc, TupleDesc out_desc, Oid out_relid,
 							 Oid compressed_data_type_oid)
@@ -1234,16 +2754,11 @@ row_decompressor_decompress_row(RowDecompressor *row_decompressor)
 		 */
 		if (!is_done || !wrote_data)
 		{
-			HeapTuple decompressed_tuple = heap_form_tuple(row_decompressor->out_desc,
-														   row_decompressor->decompressed_datums,
-														   row_decompressor->decompressed_is_nulls);
-			heap_insert(row_decompressor->out_rel,
-						decompressed_tuple,
-						row_decompressor->mycid,
-						0 /*=options*/,
-						row_decompressor->bistate);
-
-			heap_freetuple(decompressed_tuple);
+			multi_insert_buffer_add_values(row_decompressor->insert_buffer,
+										   row_decompressor->mycid,
+										   row_decompressor->decompressed_datums,
+										   row_decompressor->decompressed_is_nulls);
+			row_decompressor->tuples_decompressed++;
 			wrote_data = true;
 		}
 	} while (!is_done);
@@ -10,6 +10,9 @@
 #include <c.h>
 #include <fmgr.h>
 #include <lib/stringinfo.h>
+#include <nodes/execnodes.h>
+#include <storage/dsm.h>
+#include <storage/shm_toc.h>
 
 /*
  * Compressed data starts with a specialized varlen type starting with the usual
@@ -68,6 +71,40 @@ typedef struct DecompressionIterator
 	DecompressResult (*try_next)(struct DecompressionIterator *);
 } DecompressionIterator;
 
+/*
+ * The result of decompressing an entire compressed datum in one call. This is
+ * the bulk counterpart of the DecompressionIterator: instead of one indirect
+ * call per row, the algorithm decodes all rows at once into a flat array of
+ * datums. The validity bitmap has one bit per row, a set bit meaning the row is
+ * not NULL. The contents of `values` for NULL rows are unspecified.
+ */
+typedef struct DecompressedBatch
+{
+	Oid element_type;
+	uint32 num_rows;
+	uint32 num_nulls;
+	Datum *values;
+	uint64 *validity;
+	/*
+	 * Only set for dictionary compressed data, NULL otherwise: the distinct
+	 * values of the batch and for every row the index of its value among them,
+	 * so that filters can be evaluated once per distinct value instead of once
+	 * per row. The codes of NULL rows are unspecified.
+	 */
+	uint32 num_distinct;
+	const Datum *dictionary;
+	uint32 *codes;
+} DecompressedBatch;
+
+#define DECOMPRESSED_BATCH_VALIDITY_WORDS(num_rows) (((num_rows) + 63) / 64)
+
+static inline bool
+decompressed_batch_row_is_valid(const DecompressedBatch *batch, uint32 row)
+{
+	Assert(row < batch->num_rows);
+	return (batch->validity[row / 64] & (UINT64CONST(1) << (row % 64))) != 0;
+}
+
 /*
  * TOAST_STORAGE_EXTENDED for out of line storage.
  * TOAST_STORAGE_EXTERNAL for out of line storage + native PG toast compression
@@ -80,10 +117,23 @@ typedef enum
 	TOAST_STORAGE_EXTENDED
 } CompressionStorage;
 
+/*
+ * General purpose block compression applied on top of the output of the
+ * array and dictionary algorithms, see block.h. The values are stored in the
+ * hypertable_compression_codec catalog table and MUST NEVER CHANGE.
+ */
+typedef enum CompressionBlockCodec
+{
+	COMPRESSION_BLOCK_CODEC_NONE = 0,
+	COMPRESSION_BLOCK_CODEC_LZ4 = 1,
+	COMPRESSION_BLOCK_CODEC_ZSTD = 2,
+} CompressionBlockCodec;
+
 typedef struct CompressionAlgorithmDefinition
 {
 	DecompressionIterator *(*iterator_init_forward)(Datum, Oid element_type);
 	DecompressionIterator *(*iterator_init_reverse)(Datum, Oid element_type);
+	DecompressedBatch *(*decompress_all)(Datum, Oid element_type);
 	void (*compressed_data_send)(CompressedDataHeader *, StringInfo);
 	Datum (*compressed_data_recv)(StringInfo);
 
@@ -100,6 +150,10 @@ typedef enum CompressionAlgorithms
 	COMPRESSION_ALGORITHM_DICTIONARY,
 	COMPRESSION_ALGORITHM_GORILLA,
 	COMPRESSION_ALGORITHM_DELTADELTA,
+	COMPRESSION_ALGORITHM_FOR,
+	COMPRESSION_ALGORITHM_ALP,
+	COMPRESSION_ALGORITHM_BLOCK,
+	COMPRESSION_ALGORITHM_SHARED_DICTIONARY,
 
 	/* When adding an algorithm also add a static assert statement below */
 	/* end of real values */
@@ -113,6 +167,25 @@ typedef struct CompressionStats
 	int64 rowcnt_post_compression;
 } CompressionStats;
 
+/* default and maximum number of rows in a compressed batch */
+#define COMPRESSION_DEFAULT_BATCH_SIZE 1000
+#define COMPRESSION_MAX_BATCH_SIZE 100000
+/* the smallest batches adaptive sizing goes down to */
+#define COMPRESSION_MIN_ADAPTIVE_BATCH_SIZE 64
+
+/*
+ * The number of rows to put into each compressed batch. Without a target size
+ * every batch gets max_rows rows, except the last one of each segment. With a
+ * target size the row compressor sizes batches toward target_bytes of
+ * compressed data, based on the compressed size per row of the previous batch,
+ * but never above max_rows.
+ */
+typedef struct CompressionBatchSize
+{
+	int32 max_rows;
+	int32 target_bytes;
+} CompressionBatchSize;
+
 extern Datum tsl_compressed_data_decompress_forward(PG_FUNCTION_ARGS);
 extern Datum tsl_compressed_data_decompress_reverse(PG_FUNCTION_ARGS);
 extern Datum tsl_compressed_data_send(PG_FUNCTION_ARGS);
@@ -133,22 +206,46 @@ pg_attribute_unused() assert_num_compression_algorithms_sane(void)
 	StaticAssertStmt(COMPRESSION_ALGORITHM_DICTIONARY == 2, "algorithm index has changed");
 	StaticAssertStmt(COMPRESSION_ALGORITHM_GORILLA == 3, "algorithm index has changed");
 	StaticAssertStmt(COMPRESSION_ALGORITHM_DELTADELTA == 4, "algorithm index has changed");
+	StaticAssertStmt(COMPRESSION_ALGORITHM_FOR == 5, "algorithm index has changed");
+	StaticAssertStmt(COMPRESSION_ALGORITHM_ALP == 6, "algorithm index has changed");
+	StaticAssertStmt(COMPRESSION_ALGORITHM_BLOCK == 7, "algorithm index has changed");
+	StaticAssertStmt(COMPRESSION_ALGORITHM_SHARED_DICTIONARY == 8, "algorithm index has changed");
 
 	/* This should change when adding a new algorithm after adding the new algorithm to the assert
 	 * list above. This statement prevents adding a new algorithm without updating the asserts above
 	 */
-	StaticAssertStmt(_END_COMPRESSION_ALGORITHMS == 5,
+	StaticAssertStmt(_END_COMPRESSION_ALGORITHMS == 9,
 					 "number of algorithms have changed, the asserts should be updated");
 }
 
 extern CompressionStorage compression_get_toast_storage(CompressionAlgorithms algo);
 extern CompressionStats compress_chunk(Oid in_table, Oid out_table,
 									   const ColumnCompressionInfo **column_compression_info,
-									   int num_columns);
+									   int num_columns, const CompressionBatchSize *batch_size,
+									   const CompressionBlockCodec *column_codecs);
 extern void decompress_chunk(Oid in_table, Oid out_table);
-
+extern CompressionStats
+recompress_chunk_segments(Oid in_table, Oid out_table,
+						  const ColumnCompressionInfo **column_compression_info, int num_columns,
+						  const CompressionBatchSize *batch_size,
+						  const CompressionBlockCodec *column_codecs);
+extern CompressionStats decompress_batches_for_dml(Oid compressed_relid, EState *estate,
+												   ExprState *filter, ExprContext *econtext);
+/* the entry point of the parallel workers of compress_chunk */
+extern PGDLLEXPORT void tsl_compress_chunk_parallel_main(dsm_segment *seg, shm_toc *toc);
+
+extern Compressor *compressor_for_algorithm_and_type(CompressionAlgorithms algorithm, Oid type);
 extern DecompressionIterator *(*tsl_get_decompression_iterator_init(
 	CompressionAlgorithms algorithm, bool reverse))(Datum, Oid element_type);
+extern DecompressedBatch *(*tsl_get_decompress_all_function(CompressionAlgorithms algorithm))(
+	Datum, Oid element_type);
+extern DecompressedBatch *tsl_decompress_all(Datum compressed, Oid element_type, bool typbyval);
+extern void (*tsl_get_compressed_data_send_function(CompressionAlgorithms algorithm))(
+	CompressedDataHeader *, StringInfo);
+extern Datum (*tsl_get_compressed_data_recv_function(CompressionAlgorithms algorithm))(StringInfo);
+extern DecompressedBatch *decompressed_batch_alloc(Oid element_type, uint32 num_rows);
+extern void decompressed_batch_spread_nulls(DecompressedBatch *batch, const uint64 *nulls,
+											uint32 num_non_null);
 extern void update_compressed_chunk_relstats(Oid uncompressed_relid, Oid compressed_relid);
 
 #endif
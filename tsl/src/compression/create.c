@@ -39,6 +39,7 @@
 #include "compat.h"
 #include "compression_with_clause.h"
 #include "compression.h"
+#include "block.h"
 #include "hypertable_cache.h"
 #include "hypertable_compression.h"
 #include "custom_type_cache.h"
@@ -54,10 +55,13 @@ typedef struct CompressColInfo
 	FormData_hypertable_compression
 		*col_meta;	/* metadata about columns from src hypertable that will be compressed*/
 	List *coldeflist; /*list of ColumnDef for the compressed column */
+	List *bloom_cols; /* names of the columns that get a bloom filter metadata column */
+	List *codecs;	  /* FormData_hypertable_compression_codec of columns with a block codec */
 } CompressColInfo;
 
 static void compresscolinfo_init(CompressColInfo *cc, Oid srctbl_relid, List *segmentby_cols,
-								 List *orderby_cols);
+								 List *orderby_cols, List *bloom_cols, List *lz4_cols,
+								 List *zstd_cols);
 static void compresscolinfo_init_singlecolumn(CompressColInfo *cc, const char *colname, Oid typid);
 static void compresscolinfo_add_catalog_entries(CompressColInfo *compress_cols, int32 htid);
 
@@ -73,8 +77,8 @@ static void compresscolinfo_add_catalog_entries(CompressColInfo *compress_cols,
 		}                                                                                          \
 	} while (0);
 
-static enum CompressionAlgorithms
-get_default_algorithm_id(Oid typeoid)
+enum CompressionAlgorithms
+compression_get_default_algorithm_id(Oid typeoid)
 {
 	switch (typeoid)
 	{
@@ -138,6 +142,108 @@ compression_column_segment_max_name(const FormData_hypertable_compression *fd)
 	return compression_column_segment_metadata_name(fd, "max");
 }
 
+static FormData_hypertable_compression_codec *
+compresscolinfo_get_codec(CompressColInfo *cc, const char *attname)
+{
+	ListCell *lc;
+
+	foreach (lc, cc->codecs)
+	{
+		FormData_hypertable_compression_codec *fd = lfirst(lc);
+		if (namestrcmp(&fd->attname, attname) == 0)
+			return fd;
+	}
+	return NULL;
+}
+
+/*
+ * Record the block compression codec for the columns of a timescaledb.compress_lz4 or
+ * timescaledb.compress_zstd option. The codec compresses the output of the array and
+ * dictionary algorithms; the other algorithms produce dense bit-packed data that a general
+ * purpose compressor cannot shrink further.
+ */
+static void
+compresscolinfo_add_codec_cols(CompressColInfo *cc, Relation rel, const int16 *segorder_colindex,
+							   int seg_attnolen, List *cols, CompressionBlockCodec codec,
+							   const char *option_name)
+{
+	ListCell *lc;
+
+	foreach (lc, cols)
+	{
+		CompressedParsedCol *col = (CompressedParsedCol *) lfirst(lc);
+		AttrNumber col_attno = get_attnum(rel->rd_id, NameStr(col->colname));
+		FormData_hypertable_compression_codec *fd;
+		CompressionAlgorithms algorithm;
+
+		if (col_attno == InvalidAttrNumber)
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("column \"%s\" does not exist", NameStr(col->colname)),
+					 errhint("The %s option must reference a valid column.", option_name)));
+
+		if (!block_codec_is_available(codec))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("%s block compression is not available", block_codec_name(codec)),
+					 errdetail("TimescaleDB was built without %s support.",
+							   block_codec_name(codec)),
+					 errhint("Remove the %s option.", option_name)));
+
+		/* segmentby columns are stored uncompressed */
+		if (segorder_colindex[col_attno - 1] > 0 &&
+			segorder_colindex[col_attno - 1] <= seg_attnolen)
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("cannot use column \"%s\" for both segmenting and block compression",
+							NameStr(col->colname)),
+					 errhint("Remove the column from the %s option.", option_name)));
+
+		algorithm = compression_get_default_algorithm_id(
+			TupleDescAttr(RelationGetDescr(rel), AttrNumberGetAttrOffset(col_attno))->atttypid);
+		if (algorithm != COMPRESSION_ALGORITHM_ARRAY &&
+			algorithm != COMPRESSION_ALGORITHM_DICTIONARY)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("cannot use block compression for column \"%s\"",
+							NameStr(col->colname)),
+					 errdetail("Block compression is only supported for columns that use array "
+							   "or dictionary compression.")));
+
+		if (compresscolinfo_get_codec(cc, NameStr(col->colname)) != NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("column \"%s\" is listed more than once for block compression",
+							NameStr(col->colname)),
+					 errhint("Use either the timescaledb.compress_lz4 or the "
+							 "timescaledb.compress_zstd option for a column.")));
+
+		fd = palloc0(sizeof(FormData_hypertable_compression_codec));
+		namestrcpy(&fd->attname, NameStr(col->colname));
+		fd->codec = codec;
+		cc->codecs = lappend(cc->codecs, fd);
+	}
+}
+
+/*
+ * The bloom filter metadata column is named after the column it belongs to,
+ * so we can tell which columns have one by looking at the compressed table.
+ * Returns NULL if the name of the column is too long to derive a metadata
+ * column name from it.
+ */
+char *
+compression_column_segment_bloom_name(const char *attname)
+{
+	char *buf = palloc(sizeof(char) * NAMEDATALEN);
+	int ret;
+
+	ret = snprintf(buf, NAMEDATALEN, COMPRESSION_COLUMN_METADATA_PREFIX "bloom1_%s", attname);
+	if (ret < 0 || ret >= NAMEDATALEN)
+		return NULL;
+
+	return buf;
+}
+
 static void
 compresscolinfo_add_metadata_columns(CompressColInfo *cc, Relation uncompressed_rel)
 {
@@ -145,6 +251,7 @@ compresscolinfo_add_metadata_columns(CompressColInfo *cc, Relation uncompressed_
 	 * these are not listed in hypertable_compression catalog table
 	 * and so only has a ColDef entry */
 	int colno;
+	ListCell *lc;
 
 	/* count column */
 	cc->coldeflist = lappend(cc->coldeflist,
@@ -194,6 +301,15 @@ compresscolinfo_add_metadata_columns(CompressColInfo *cc, Relation uncompressed_
 									  0 /*collation*/));
 		}
 	}
+
+	/* bloom filter columns */
+	foreach (lc, cc->bloom_cols)
+		cc->coldeflist =
+			lappend(cc->coldeflist,
+					makeColumnDef(compression_column_segment_bloom_name(lfirst(lc)),
+								  BYTEAOID,
+								  -1 /* typemod */,
+								  0 /*collation*/));
 }
 
 /*
@@ -206,7 +322,7 @@ compresscolinfo_add_metadata_columns(CompressColInfo *cc, Relation uncompressed_
  */
 static void
 compresscolinfo_init(CompressColInfo *cc, Oid srctbl_relid, List *segmentby_cols,
-					 List *orderby_cols)
+					 List *orderby_cols, List *bloom_cols, List *lz4_cols, List *zstd_cols)
 {
 	Relation rel;
 	TupleDesc tupdesc;
@@ -270,6 +386,65 @@ compresscolinfo_init(CompressColInfo *cc, Oid srctbl_relid, List *segmentby_cols
 		segorder_colindex[col_attno - 1] = i++;
 	}
 
+	cc->bloom_cols = NIL;
+	foreach (lc, bloom_cols)
+	{
+		CompressedParsedCol *col = (CompressedParsedCol *) lfirst(lc);
+		AttrNumber col_attno = get_attnum(rel->rd_id, NameStr(col->colname));
+		TypeCacheEntry *type;
+
+		if (col_attno == InvalidAttrNumber)
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("column \"%s\" does not exist", NameStr(col->colname)),
+					 errhint("The timescaledb.compress_bloomfilter option must reference a valid "
+							 "column.")));
+
+		/* segmentby columns are stored uncompressed and can be filtered directly */
+		if (segorder_colindex[col_attno - 1] > 0 &&
+			segorder_colindex[col_attno - 1] <= seg_attnolen)
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("cannot use column \"%s\" for both segmenting and bloom filter",
+							NameStr(col->colname)),
+					 errhint("Remove the column from the timescaledb.compress_bloomfilter "
+							 "option.")));
+
+		type = lookup_type_cache(TupleDescAttr(tupdesc, AttrNumberGetAttrOffset(col_attno))
+									 ->atttypid,
+								 TYPECACHE_EQ_OPR | TYPECACHE_HASH_PROC);
+		if (!OidIsValid(type->eq_opr) || !OidIsValid(type->hash_proc))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("cannot use column \"%s\" for bloom filter", NameStr(col->colname)),
+					 errdetail("The type %s has no equality operator with a hash function.",
+							   format_type_be(type->type_id))));
+
+		if (compression_column_segment_bloom_name(NameStr(col->colname)) == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_NAME_TOO_LONG),
+					 errmsg("column name \"%s\" is too long for bloom filter",
+							NameStr(col->colname))));
+
+		cc->bloom_cols = lappend(cc->bloom_cols, pstrdup(NameStr(col->colname)));
+	}
+
+	cc->codecs = NIL;
+	compresscolinfo_add_codec_cols(cc,
+								   rel,
+								   segorder_colindex,
+								   seg_attnolen,
+								   lz4_cols,
+								   COMPRESSION_BLOCK_CODEC_LZ4,
+								   "timescaledb.compress_lz4");
+	compresscolinfo_add_codec_cols(cc,
+								   rel,
+								   segorder_colindex,
+								   seg_attnolen,
+								   zstd_cols,
+								   COMPRESSION_BLOCK_CODEC_ZSTD,
+								   "timescaledb.compress_zstd");
+
 	cc->numcols = 0;
 	cc->col_meta = palloc0(sizeof(FormData_hypertable_compression) * tupdesc->natts);
 	cc->coldeflist = NIL;
@@ -308,7 +483,7 @@ compresscolinfo_init(CompressColInfo *cc, Oid srctbl_relid, List *segmentby_cols
 		if (attroid == InvalidOid)
 		{
 			attroid = compresseddata_oid; /* default type for column */
-			cc->col_meta[colno].algo_id = get_default_algorithm_id(attr->atttypid);
+			cc->col_meta[colno].algo_id = compression_get_default_algorithm_id(attr->atttypid);
 		}
 		else
 		{
@@ -338,8 +513,10 @@ compresscolinfo_init_singlecolumn(CompressColInfo *cc, const char *colname, Oid
 	cc->numcols = 1;
 	cc->col_meta = palloc0(sizeof(FormData_hypertable_compression) * cc->numcols);
 	cc->coldeflist = NIL;
+	cc->bloom_cols = NIL;
+	cc->codecs = NIL;
 	namestrcpy(&cc->col_meta[colno].attname, colname);
-	cc->col_meta[colno].algo_id = get_default_algorithm_id(typid);
+	cc->col_meta[colno].algo_id = compression_get_default_algorithm_id(typid);
 	coldef = makeColumnDef(colname, compresseddata_oid, -1 /*typmod*/, 0 /*collation*/);
 	cc->coldeflist = lappend(cc->coldeflist, coldef);
 }
@@ -355,7 +532,9 @@ modify_compressed_toast_table_storage(CompressColInfo *cc, Oid compress_relid)
 	for (colno = 0; colno < cc->numcols; colno++)
 	{
 		// get storage type for columns which have compression on
-		if (cc->col_meta[colno].algo_id != 0)
+		// block compressed columns are already compressed, so they keep external storage
+		if (cc->col_meta[colno].algo_id != 0 &&
+			compresscolinfo_get_codec(cc, NameStr(cc->col_meta[colno].attname)) == NULL)
 		{
 			CompressionStorage stor = compression_get_toast_storage(cc->col_meta[colno].algo_id);
 			if (stor != TOAST_STORAGE_EXTERNAL)
@@ -425,7 +604,17 @@ create_compressed_table_indexes(Oid compresstable_relid, CompressColInfo *compre
 		.type = T_IndexElem,
 		.name = COMPRESSION_COLUMN_METADATA_SEQUENCE_NUM_NAME,
 	};
+	IndexElem count_elem = {
+		.type = T_IndexElem,
+		.name = COMPRESSION_COLUMN_METADATA_COUNT_NAME,
+	};
 	int i;
+
+	/*
+	 * With the row count of the batches in the index, queries that only
+	 * reference segmentby columns can be answered by an index-only scan.
+	 */
+	stmt.indexIncludingParams = list_make1(&count_elem);
 	for (i = 0; i < compress_cols->numcols; i++)
 	{
 		NameData index_name;
@@ -454,12 +643,13 @@ create_compressed_table_indexes(Oid compresstable_relid, CompressColInfo *compre
 			elog(ERROR, "cache lookup failed for index relid %u", index_addr.objectId);
 		index_name = ((Form_pg_class) GETSTRUCT(index_tuple))->relname;
 		elog(DEBUG1,
-			 "adding index %s ON %s.%s USING BTREE(%s, %s)",
+			 "adding index %s ON %s.%s USING BTREE(%s, %s) INCLUDE (%s)",
 			 NameStr(index_name),
 			 NameStr(ht->fd.schema_name),
 			 NameStr(ht->fd.table_name),
 			 NameStr(col->attname),
-			 COMPRESSION_COLUMN_METADATA_SEQUENCE_NUM_NAME);
+			 COMPRESSION_COLUMN_METADATA_SEQUENCE_NUM_NAME,
+			 COMPRESSION_COLUMN_METADATA_COUNT_NAME);
 		ReleaseSysCache(index_tuple);
 	}
 
@@ -892,6 +1082,8 @@ drop_existing_compression_table(Hypertable *ht)
 	 * thus the column types of compressed hypertable need to change) */
 	ts_hypertable_drop(compressed, DROP_RESTRICT);
 	ts_hypertable_compression_delete_by_hypertable_id(ht->fd.id);
+	ts_hypertable_compression_batch_delete_by_hypertable_id(ht->fd.id);
+	ts_hypertable_compression_codec_delete_by_hypertable_id(ht->fd.id);
 	ts_hypertable_unset_compressed(ht);
 }
 
@@ -900,7 +1092,12 @@ disable_compression(Hypertable *ht, WithClauseResult *with_clause_options)
 {
 	bool compression_already_enabled = TS_HYPERTABLE_HAS_COMPRESSION_ENABLED(ht);
 	if (!with_clause_options[CompressOrderBy].is_default ||
-		!with_clause_options[CompressSegmentBy].is_default)
+		!with_clause_options[CompressSegmentBy].is_default ||
+		!with_clause_options[CompressBloomFilter].is_default ||
+		!with_clause_options[CompressBatchSize].is_default ||
+		!with_clause_options[CompressBatchTargetSize].is_default ||
+		!with_clause_options[CompressLz4].is_default ||
+		!with_clause_options[CompressZstd].is_default)
 		ereport(ERROR,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 				 errmsg("invalid compression configuration"),
@@ -919,11 +1116,65 @@ disable_compression(Hypertable *ht, WithClauseResult *with_clause_options)
 	else
 	{
 		ts_hypertable_compression_delete_by_hypertable_id(ht->fd.id);
+		ts_hypertable_compression_batch_delete_by_hypertable_id(ht->fd.id);
+		ts_hypertable_compression_codec_delete_by_hypertable_id(ht->fd.id);
 		ts_hypertable_unset_compressed(ht);
 	}
 	return true;
 }
 
+/*
+ * Parse the batch size options. Returns false if neither is given, in which
+ * case nothing is recorded in the catalog and compression uses the default
+ * batch size.
+ *
+ * When only a target size is given, batches may grow up to the maximum batch
+ * size for data that compresses well.
+ */
+static bool
+compress_batch_size_parse(Hypertable *ht, WithClauseResult *with_clause_options,
+						  FormData_hypertable_compression_batch *fd)
+{
+	bool has_batch_size = !with_clause_options[CompressBatchSize].is_default;
+	bool has_target_size = !with_clause_options[CompressBatchTargetSize].is_default;
+
+	if (!has_batch_size && !has_target_size)
+		return false;
+
+	fd->hypertable_id = ht->fd.id;
+	fd->batch_size =
+		has_target_size ? COMPRESSION_MAX_BATCH_SIZE : COMPRESSION_DEFAULT_BATCH_SIZE;
+	fd->target_batch_bytes = 0;
+
+	if (has_batch_size)
+	{
+		fd->batch_size = DatumGetInt32(with_clause_options[CompressBatchSize].parsed);
+
+		if (fd->batch_size < 1 || fd->batch_size > COMPRESSION_MAX_BATCH_SIZE)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("invalid value for timescaledb.compress_batch_size \"%d\"",
+							fd->batch_size),
+					 errdetail("The batch size must be between 1 and %d rows.",
+							   COMPRESSION_MAX_BATCH_SIZE)));
+	}
+
+	if (has_target_size)
+	{
+		fd->target_batch_bytes =
+			DatumGetInt32(with_clause_options[CompressBatchTargetSize].parsed);
+
+		if (fd->target_batch_bytes < 1)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("invalid value for timescaledb.compress_batch_target_size \"%d\"",
+							fd->target_batch_bytes),
+					 errdetail("The target batch size must be a positive number of bytes.")));
+	}
+
+	return true;
+}
+
 /* Add column to internal compression table */
 static void
 add_column_to_compression_table(Hypertable *compress_ht, CompressColInfo *compress_cols)
@@ -968,8 +1219,14 @@ tsl_process_compress_table(AlterTableCmd *cmd, Hypertable *ht,
 	Oid ownerid;
 	List *segmentby_cols;
 	List *orderby_cols;
+	List *bloom_cols;
+	List *lz4_cols;
+	List *zstd_cols;
+	FormData_hypertable_compression_batch batch_fd;
+	bool has_batch_options;
 	ContinuousAggHypertableStatus caggstat;
 	List *constraint_list = NIL;
+	ListCell *lc;
 
 	/*check this is not a special internally created hypertable
 	 * i.e. continuous agg table or compression hypertable
@@ -1009,7 +1266,17 @@ tsl_process_compress_table(AlterTableCmd *cmd, Hypertable *ht,
 	segmentby_cols = ts_compress_hypertable_parse_segment_by(with_clause_options, ht);
 	orderby_cols = ts_compress_hypertable_parse_order_by(with_clause_options, ht);
 	orderby_cols = add_time_to_order_by_if_not_included(orderby_cols, segmentby_cols, ht);
-	compresscolinfo_init(&compress_cols, ht->main_table_relid, segmentby_cols, orderby_cols);
+	bloom_cols = ts_compress_hypertable_parse_bloom_filter(with_clause_options, ht);
+	lz4_cols = ts_compress_hypertable_parse_lz4(with_clause_options, ht);
+	zstd_cols = ts_compress_hypertable_parse_zstd(with_clause_options, ht);
+	compresscolinfo_init(&compress_cols,
+						 ht->main_table_relid,
+						 segmentby_cols,
+						 orderby_cols,
+						 bloom_cols,
+						 lz4_cols,
+						 zstd_cols);
+	has_batch_options = compress_batch_size_parse(ht, with_clause_options, &batch_fd);
 	/* check if we can create a compressed hypertable with existing constraints */
 	constraint_list = validate_existing_constraints(ht, &compress_cols);
 
@@ -1024,6 +1291,18 @@ tsl_process_compress_table(AlterTableCmd *cmd, Hypertable *ht,
 		drop_existing_compression_table(ht);
 	}
 
+	ts_hypertable_compression_batch_delete_by_hypertable_id(ht->fd.id);
+	if (has_batch_options)
+		ts_hypertable_compression_batch_insert(&batch_fd);
+
+	ts_hypertable_compression_codec_delete_by_hypertable_id(ht->fd.id);
+	foreach (lc, compress_cols.codecs)
+	{
+		FormData_hypertable_compression_codec *fd = lfirst(lc);
+		fd->hypertable_id = ht->fd.id;
+		ts_hypertable_compression_codec_insert(fd);
+	}
+
 	if (hypertable_is_distributed(ht))
 	{
 		/* On a distributed hypertable, there's no data locally, so don't
@@ -1095,11 +1374,30 @@ tsl_process_compress_table_rename_column(Hypertable *ht, const RenameStmt *stmt)
 		int32 compress_htid = ht->fd.compressed_hypertable_id;
 		Hypertable *compress_ht = ts_hypertable_get_by_id(compress_htid);
 		RenameStmt *compress_col_stmt = (RenameStmt *) copyObject(stmt);
+		char *bloom_name = compression_column_segment_bloom_name(stmt->subname);
+
 		compress_col_stmt->relation = makeRangeVar(NameStr(compress_ht->fd.schema_name),
 												   NameStr(compress_ht->fd.table_name),
 												   -1);
 		ExecRenameStmt(compress_col_stmt);
+
+		/* the bloom filter metadata column is named after the column, so rename it too */
+		if (bloom_name != NULL &&
+			get_attnum(compress_ht->main_table_relid, bloom_name) != InvalidAttrNumber)
+		{
+			RenameStmt *bloom_stmt = (RenameStmt *) copyObject(compress_col_stmt);
+
+			bloom_stmt->subname = bloom_name;
+			bloom_stmt->newname = compression_column_segment_bloom_name(stmt->newname);
+			if (bloom_stmt->newname == NULL)
+				ereport(ERROR,
+						(errcode(ERRCODE_NAME_TOO_LONG),
+						 errmsg("column name \"%s\" is too long for bloom filter",
+								stmt->newname)));
+			ExecRenameStmt(bloom_stmt);
+		}
 	}
 	// update catalog entries for the renamed column for the hypertable
 	ts_hypertable_compression_rename_column(orig_htid, stmt->subname, stmt->newname);
+	ts_hypertable_compression_codec_rename_column(orig_htid, stmt->subname, stmt->newname);
 }
@@ -10,6 +10,7 @@
 
 #include "with_clause_parser.h"
 #include "hypertable.h"
+#include "compression/compression.h"
 
 #define COMPRESSION_COLUMN_METADATA_PREFIX "_ts_meta_"
 #define COMPRESSION_COLUMN_METADATA_COUNT_NAME COMPRESSION_COLUMN_METADATA_PREFIX "count"
@@ -24,5 +25,7 @@ void tsl_process_compress_table_rename_column(Hypertable *ht, const RenameStmt *
 
 char *compression_column_segment_min_name(const FormData_hypertable_compression *fd);
 char *compression_column_segment_max_name(const FormData_hypertable_compression *fd);
+char *compression_column_segment_bloom_name(const char *attname);
+enum CompressionAlgorithms compression_get_default_algorithm_id(Oid typeoid);
 
 #endif /* TIMESCALEDB_TSL_COMPRESSION_CREATE_H */
@@ -21,6 +21,8 @@
 #include <utils.h>
 
 #include "compression/compression.h"
+#include "compression/detoast_reader.h"
+#include "compression/for.h"
 #include "compression/simple8b_rle.h"
 
 static uint64 zig_zag_encode(uint64 value);
@@ -67,6 +69,10 @@ typedef struct DeltaDeltaCompressor
 	Simple8bRleCompressor delta_delta;
 	Simple8bRleCompressor nulls;
 	bool has_nulls;
+	/* range of the values seen, to check if frame-of-reference encodes them smaller */
+	uint32 num_values;
+	int64 min_val;
+	int64 max_val;
 } DeltaDeltaCompressor;
 
 typedef struct ExtendedCompressor
@@ -155,13 +161,13 @@ deltadelta_compressor_append_null_value(Compressor *compressor)
 	delta_delta_compressor_append_null(extended->internal);
 }
 
-static void *delta_delta_compressor_finish(DeltaDeltaCompressor *compressor);
+static void *delta_delta_compressor_finish(DeltaDeltaCompressor *compressor, bool allow_for);
 
 static void *
 deltadelta_compressor_finish_and_reset(Compressor *compressor)
 {
 	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
-	void *compressed = delta_delta_compressor_finish(extended->internal);
+	void *compressed = delta_delta_compressor_finish(extended->internal, true);
 	pfree(extended->internal);
 	extended->internal = NULL;
 	return compressed;
@@ -331,8 +337,36 @@ delta_delta_from_parts(uint64 last_value, uint64 last_delta, Simple8bRleSerializ
 	return compressed;
 }
 
+/* undo the delta-of-delta encoding and re-encode the values with frame-of-reference */
+static ForCompressed *
+delta_delta_to_for(Simple8bRleSerialized *deltas, int64 min_val, int64 max_val,
+				   Simple8bRleSerialized *nulls)
+{
+	uint64 *values = simple8brle_decompress_all(deltas);
+	uint64 prev_val = 0;
+	uint64 prev_delta = 0;
+	uint32 i;
+	ForCompressed *compressed;
+
+	for (i = 0; i < deltas->num_elements; i++)
+	{
+		prev_delta += zig_zag_decode(values[i]);
+		prev_val += prev_delta;
+		values[i] = prev_val;
+	}
+
+	compressed = for_compressed_from_values(values, deltas->num_elements, min_val, max_val, nulls);
+	pfree(values);
+	return compressed;
+}
+
+/*
+ * With allow_for, the result is frame-of-reference compressed instead when
+ * that is smaller. The SQL-level compress_deltadelta aggregate asks for plain
+ * deltadelta.
+ */
 static void *
-delta_delta_compressor_finish(DeltaDeltaCompressor *compressor)
+delta_delta_compressor_finish(DeltaDeltaCompressor *compressor, bool allow_for)
 {
 	Simple8bRleSerialized *deltas = simple8brle_compressor_finish(&compressor->delta_delta);
 	Simple8bRleSerialized *nulls = simple8brle_compressor_finish(&compressor->nulls);
@@ -341,12 +375,33 @@ delta_delta_compressor_finish(DeltaDeltaCompressor *compressor)
 	if (deltas == NULL)
 		return NULL;
 
-	compressed = delta_delta_from_parts(compressor->prev_val,
-										compressor->prev_delta,
-										deltas,
-										compressor->has_nulls ? nulls : NULL);
+	if (!compressor->has_nulls)
+		nulls = NULL;
+
+	compressed =
+		delta_delta_from_parts(compressor->prev_val, compressor->prev_delta, deltas, nulls);
 
 	Assert(compressed->compression_algorithm == COMPRESSION_ALGORITHM_DELTADELTA);
+
+	/*
+	 * Values that do not follow a trend, e.g. counters that reset or quantized
+	 * gauges, have large delta-of-deltas but often span a narrow range. For
+	 * those frame-of-reference encoding is smaller, so switch to it when it
+	 * is. It is also much cheaper to decompress, so we prefer it on a tie.
+	 * Decompression dispatches on the algorithm stored in each datum, so the
+	 * column can mix both.
+	 */
+	if (allow_for &&
+		for_compressed_size(compressor->num_values,
+							for_bit_width(compressor->min_val, compressor->max_val),
+							nulls) <= VARSIZE(compressed))
+	{
+		ForCompressed *for_compressed =
+			delta_delta_to_for(deltas, compressor->min_val, compressor->max_val, nulls);
+		pfree(compressed);
+		return for_compressed;
+	}
+
 	return compressed;
 }
 
@@ -359,7 +414,7 @@ tsl_deltadelta_compressor_finish(PG_FUNCTION_ARGS)
 	if (compressor == NULL)
 		PG_RETURN_NULL();
 
-	compressed = delta_delta_compressor_finish(compressor);
+	compressed = delta_delta_compressor_finish(compressor, false);
 	if (compressed == NULL)
 		PG_RETURN_NULL();
 	PG_RETURN_POINTER(compressed);
@@ -393,6 +448,18 @@ delta_delta_compressor_append_value(DeltaDeltaCompressor *compressor, int64 next
 	compressor->prev_val = next_val;
 	compressor->prev_delta = delta;
 
+	if (compressor->num_values == 0)
+	{
+		compressor->min_val = next_val;
+		compressor->max_val = next_val;
+	}
+	else
+	{
+		compressor->min_val = Min(compressor->min_val, next_val);
+		compressor->max_val = Max(compressor->max_val, next_val);
+	}
+	compressor->num_values++;
+
 	/* step 2: ZigZag encode */
 	encoded = zig_zag_encode(delta_delta);
 
@@ -641,6 +708,110 @@ delta_delta_decompression_iterator_from_datum_reverse(Datum deltadelta_compresse
 	return &iterator->base;
 }
 
+/*
+ * Convert the decompressed 64-bit integers into datums of the requested type,
+ * hoisting the type dispatch out of the per-row loop.
+ */
+static void
+convert_all_from_internal(const uint64 *internal, Datum *values, uint32 num_values,
+						  Oid element_type)
+{
+	uint32 i;
+
+	switch (element_type)
+	{
+		case BOOLOID:
+			for (i = 0; i < num_values; i++)
+				values[i] = BoolGetDatum(internal[i]);
+			break;
+		case INT8OID:
+			for (i = 0; i < num_values; i++)
+				values[i] = Int64GetDatum(internal[i]);
+			break;
+		case INT4OID:
+			for (i = 0; i < num_values; i++)
+				values[i] = Int32GetDatum(internal[i]);
+			break;
+		case INT2OID:
+			for (i = 0; i < num_values; i++)
+				values[i] = Int16GetDatum(internal[i]);
+			break;
+		case DATEOID:
+			for (i = 0; i < num_values; i++)
+				values[i] = DateADTGetDatum(internal[i]);
+			break;
+		case TIMESTAMPTZOID:
+			for (i = 0; i < num_values; i++)
+				values[i] = TimestampTzGetDatum(internal[i]);
+			break;
+		case TIMESTAMPOID:
+			for (i = 0; i < num_values; i++)
+				values[i] = TimestampGetDatum(internal[i]);
+			break;
+		default:
+			elog(ERROR,
+				 "invalid type requested from deltadelta decompression \"%s\"",
+				 format_type_be(element_type));
+	}
+}
+
+/*
+ * The sections are read and decoded one after the other, so a large value that
+ * is still toasted is never fetched as a whole.
+ */
+DecompressedBatch *
+delta_delta_decompress_all(Datum deltadelta_compressed, Oid element_type)
+{
+	DetoastReader reader;
+	Size offset = offsetof(DeltaDeltaCompressed, delta_deltas);
+	Simple8bRleSerialized *serialized;
+	DecompressedBatch *batch;
+	uint64 *decompressed;
+	uint64 *is_null = NULL;
+	uint64 prev_val = 0;
+	uint64 prev_delta = 0;
+	uint32 num_values;
+	uint32 num_rows;
+	uint32 i;
+	uint8 has_nulls;
+
+	detoast_reader_init(&reader, deltadelta_compressed);
+	has_nulls = ((const DeltaDeltaCompressed *) detoast_reader_read(&reader, 0, offset))->has_nulls;
+	Assert(has_nulls == 0 || has_nulls == 1);
+
+	/* undo the delta-of-delta encoding in place */
+	serialized = detoast_reader_read_simple8b(&reader, &offset);
+	num_values = serialized->num_elements;
+	decompressed = simple8brle_decompress_all(serialized);
+	for (i = 0; i < num_values; i++)
+	{
+		prev_delta += zig_zag_decode(decompressed[i]);
+		prev_val += prev_delta;
+		decompressed[i] = prev_val;
+	}
+
+	num_rows = num_values;
+	if (has_nulls)
+	{
+		serialized = detoast_reader_read_simple8b(&reader, &offset);
+		num_rows = serialized->num_elements;
+		is_null = simple8brle_decompress_all(serialized);
+	}
+	detoast_reader_free(&reader);
+
+	batch = decompressed_batch_alloc(element_type, num_rows);
+	convert_all_from_internal(decompressed, batch->values, num_values, element_type);
+	pfree(decompressed);
+
+	if (is_null != NULL)
+	{
+		decompressed_batch_spread_nulls(batch, is_null, num_values);
+		pfree(is_null);
+	}
+
+	return batch;
+}
+
 /**********************************************************************************/
 /**********************************************************************************/
 void
@@ -13,6 +13,9 @@
  * We now describe how to compress the delta-of-deltas:
  * First we zigzag encodes the delta-of-deltas
  * Second, we simple8b_rle encode the zig-zag encoding
+ *
+ * When compressing columns, the compressor switches to frame-of-reference encoding (see for.h)
+ * for batches where that is smaller, e.g. values that vary within a narrow range without a trend.
  */
 #ifndef TIMESCALEDB_TSL_COMPRESSION_DELTA_DELTA_H
 #define TIMESCALEDB_TSL_COMPRESSION_DELTA_DELTA_H
@@ -43,6 +46,8 @@ extern DecompressResult
 delta_delta_decompression_iterator_try_next_forward(DecompressionIterator *iter);
 extern DecompressResult
 delta_delta_decompression_iterator_try_next_reverse(DecompressionIterator *iter);
+extern DecompressedBatch *delta_delta_decompress_all(Datum deltadelta_compressed,
+													 Oid element_type);
 
 extern void deltadelta_compressed_send(CompressedDataHeader *header, StringInfo buffer);
 extern Datum deltadelta_compressed_recv(StringInfo buf);
@@ -54,6 +59,7 @@ extern Datum tsl_deltadelta_compressor_finish(PG_FUNCTION_ARGS);
 	{                                                                                              \
 		.iterator_init_forward = delta_delta_decompression_iterator_from_datum_forward,            \
 		.iterator_init_reverse = delta_delta_decompression_iterator_from_datum_reverse,            \
+		.decompress_all = delta_delta_decompress_all,                                              \
 		.compressed_data_send = deltadelta_compressed_send,                                        \
 		.compressed_data_recv = deltadelta_compressed_recv,                                        \
 		.compressor_for_type = delta_delta_compressor_for_type,                                    \
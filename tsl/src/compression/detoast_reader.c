@@ -0,0 +1,126 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+#include "compression/detoast_reader.h"
+
+#include <fmgr.h>
+
+/*
+ * Smaller values are detoasted whole: a slice costs a TOAST index lookup of its
+ * own, which only pays off when it saves fetching many chunks.
+ */
+#define DETOAST_READER_MIN_SLICED_SIZE (256 * 1024)
+
+/* the least number of bytes fetched by one slice, so short sections share a fetch */
+#define DETOAST_READER_FETCH_SIZE (32 * 1024)
+
+/*
+ * Whether the value would be read in slices: only the chunks of uncompressed
+ * out-of-line values can be fetched separately, a value compressed by
+ * PostgreSQL has to be fetched and decompressed as a whole.
+ */
+bool
+detoast_reader_reads_slices(Datum value)
+{
+	struct varlena *ptr = (struct varlena *) DatumGetPointer(value);
+	struct varatt_external toast_pointer;
+
+	if (!VARATT_IS_EXTERNAL_ONDISK(ptr))
+		return false;
+
+	memcpy(&toast_pointer, VARDATA_EXTERNAL(ptr), sizeof(toast_pointer));
+
+	if (toast_pointer.va_extsize < toast_pointer.va_rawsize - VARHDRSZ)
+		return false;
+
+	return toast_pointer.va_rawsize > DETOAST_READER_MIN_SLICED_SIZE;
+}
+
+void
+detoast_reader_init(DetoastReader *reader, Datum value)
+{
+	*reader = (DetoastReader){ .value = value };
+
+	if (detoast_reader_reads_slices(value))
+	{
+		struct varatt_external toast_pointer;
+
+		memcpy(&toast_pointer,
+			   VARDATA_EXTERNAL(DatumGetPointer(value)),
+			   sizeof(toast_pointer));
+		reader->size = toast_pointer.va_rawsize;
+	}
+	else
+	{
+		reader->whole = (const char *) PG_DETOAST_DATUM(value);
+		reader->size = VARSIZE(reader->whole);
+	}
+}
+
+/*
+ * Replace the window by one that covers [offset, offset + len). The window
+ * starts aligned, so the sections read from it are aligned as in the detoasted
+ * value, and extends to at least DETOAST_READER_FETCH_SIZE bytes.
+ */
+static void
+detoast_reader_fetch(DetoastReader *reader, Size offset, Size len)
+{
+	Size start = TYPEALIGN_DOWN(MAXIMUM_ALIGNOF, offset);
+	Size end = Min(reader->size, Max(offset + len, start + DETOAST_READER_FETCH_SIZE));
+	Size data_start = Max(start, VARHDRSZ);
+
+	if (reader->window != NULL)
+		pfree(reader->window);
+
+	reader->window = palloc(end - start);
+	reader->window_start = start;
+	reader->window_end = end;
+
+	/* slices do not include the varlena header, so the first window recreates it */
+	if (start < VARHDRSZ)
+		SET_VARSIZE(reader->window, reader->size);
+
+	if (end > data_start)
+	{
+		struct varlena *slice =
+			PG_DETOAST_DATUM_SLICE(reader->value, data_start - VARHDRSZ, end - data_start);
+
+		if (VARSIZE(slice) - VARHDRSZ != end - data_start)
+			elog(ERROR, "the compressed data is corrupt: TOAST value is truncated");
+
+		memcpy(reader->window + (data_start - start), VARDATA(slice), end - data_start);
+		pfree(slice);
+	}
+}
+
+const char *
+detoast_reader_read(DetoastReader *reader, Size offset, Size len)
+{
+	if (offset > reader->size || len > reader->size - offset)
+		elog(ERROR, "the compressed data is corrupt: read past the end of the value");
+
+	if (reader->whole != NULL)
+		return reader->whole + offset;
+
+	if (reader->window == NULL || offset < reader->window_start ||
+		offset + len > reader->window_end)
+		detoast_reader_fetch(reader, offset, len);
+
+	return reader->window + (offset - reader->window_start);
+}
+
+void
+detoast_reader_free(DetoastReader *reader)
+{
+	if (reader->window != NULL)
+		pfree(reader->window);
+
+	if (reader->whole != NULL && reader->whole != DatumGetPointer(reader->value))
+		pfree((void *) reader->whole);
+
+	reader->window = NULL;
+	reader->whole = NULL;
+}
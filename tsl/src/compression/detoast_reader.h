@@ -0,0 +1,61 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+/*
+ * Reads the sections of a compressed value one at a time, without detoasting
+ * the whole value first.
+ *
+ * Large values that are stored out of line without PostgreSQL compression,
+ * which is how the types of the integer and float algorithms are stored, are
+ * read in slices, so that only the TOAST chunks covering the section that is
+ * decoded next are fetched and held in memory. All other values are detoasted
+ * as a whole on initialization and read in place.
+ *
+ * Offsets count from the start of the varlena, including its header, so the
+ * fixed header of a compressed value is read at offset 0 as its struct. A
+ * pointer returned by a read is only valid until the next read.
+ */
+#ifndef TIMESCALEDB_TSL_COMPRESSION_DETOAST_READER_H
+#define TIMESCALEDB_TSL_COMPRESSION_DETOAST_READER_H
+
+#include <postgres.h>
+#include <c.h>
+
+#include "compression/simple8b_rle.h"
+
+typedef struct DetoastReader
+{
+	Datum value;
+	Size size;
+	/* the detoasted value, unless it is read in slices */
+	const char *whole;
+	/* the slice that was fetched last, covering [window_start, window_end) */
+	char *window;
+	Size window_start;
+	Size window_end;
+} DetoastReader;
+
+extern bool detoast_reader_reads_slices(Datum value);
+extern void detoast_reader_init(DetoastReader *reader, Datum value);
+extern const char *detoast_reader_read(DetoastReader *reader, Size offset, Size len);
+extern void detoast_reader_free(DetoastReader *reader);
+
+/* read the simple8b_rle section at *offset and advance the offset past it */
+static inline Simple8bRleSerialized *
+detoast_reader_read_simple8b(DetoastReader *reader, Size *offset)
+{
+	const Simple8bRleSerialized *header =
+		(const Simple8bRleSerialized *) detoast_reader_read(reader,
+															*offset,
+															sizeof(Simple8bRleSerialized));
+	Size size = simple8brle_serialized_total_size(header);
+	Simple8bRleSerialized *serialized =
+		(Simple8bRleSerialized *) detoast_reader_read(reader, *offset, size);
+
+	*offset += size;
+	return serialized;
+}
+
+#endif
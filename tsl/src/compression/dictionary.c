@@ -13,12 +13,17 @@
 #include <common/base64.h>
 #include <funcapi.h>
 #include <lib/stringinfo.h>
+#include <storage/proc.h>
 #include <utils/builtins.h>
 #include <utils/datum.h>
+#include <utils/hsearch.h>
 #include <utils/lsyscache.h>
+#include <utils/memutils.h>
 #include <utils/syscache.h>
 #include <utils/typcache.h>
 
+#include "compression_chunk_dictionary.h"
+
 #include "compression/compression.h"
 #include "compression/dictionary.h"
 #include "compression/simple8b_rle.h"
@@ -59,10 +64,47 @@ pg_attribute_unused() assertions(void)
 	StaticAssertStmt(sizeof(DictionaryCompressed) == 16, "CompressedDictionary wrong size");
 }
 
+/*
+ * A batch compressed with a shared dictionary is stored as
+ *     bool has_nulls
+ *     padding
+ *     Oid element_type: the element stored by this compressed dictionary
+ *     int32 dictionary_id: the compression_chunk_dictionary row holding the items
+ *     simple8b_rle dictionary indexes: array of mappings from row to index into dictionary items
+ * simple8b_rle nulls (optional)
+ *
+ * The dictionary items are stored once per chunk column as an ArrayCompressed
+ * in the _timescaledb_catalog.compression_chunk_dictionary table.
+ */
+typedef struct SharedDictionaryCompressed
+{
+	CompressedDataHeaderFields;
+	uint8 has_nulls;
+	uint8 padding[2];
+	Oid element_type;
+	int32 dictionary_id;
+	/* 8-byte alignment sentinel for the following fields */
+	uint64 alignment_sentinel[FLEXIBLE_ARRAY_MEMBER];
+} SharedDictionaryCompressed;
+
+static void
+pg_attribute_unused() shared_assertions(void)
+{
+	SharedDictionaryCompressed test_val = { { 0 } };
+	/* make sure no padding bytes make it to disk */
+	StaticAssertStmt(sizeof(SharedDictionaryCompressed) ==
+						 sizeof(test_val.vl_len_) + sizeof(test_val.compression_algorithm) +
+							 sizeof(test_val.has_nulls) + sizeof(test_val.padding) +
+							 sizeof(test_val.element_type) + sizeof(test_val.dictionary_id),
+					 "SharedDictionaryCompressed wrong size");
+	StaticAssertStmt(sizeof(SharedDictionaryCompressed) == 16,
+					 "SharedDictionaryCompressed wrong size");
+}
+
 struct DictionaryDecompressionIterator
 {
 	DecompressionIterator base;
-	const DictionaryCompressed *compressed;
+	uint32 num_distinct;
 	Datum *values;
 	Simple8bRleDecompressionIterator bitmap;
 	Simple8bRleDecompressionIterator nulls;
@@ -338,10 +380,248 @@ dictionary_compressor_finish(DictionaryCompressor *compressor)
 	return compressed;
 }
 
+////////////////////////////////////
+/// Shared Dictionary Compressor ///
+////////////////////////////////////
+
+/*
+ * Once the dictionary of a chunk column has this many items the remaining
+ * batches of the column get their own dictionaries, so that loading a shared
+ * dictionary stays cheap compared to decompressing a batch.
+ */
+#define SHARED_DICTIONARY_MAX_ITEMS 16384
+
+/*
+ * The dictionary outlives the batches, so it is allocated in the memory
+ * context the compressor was created in. The indexes of the current batch are
+ * allocated in the context of the first append to the batch, which the row
+ * compressor resets after every batch.
+ */
+typedef struct SharedDictionaryCompressor
+{
+	Compressor base;
+	MemoryContext mcxt;
+	Oid type;
+	int16 typlen;
+	bool typbyval;
+	dictionary_hash *dictionary_items;
+	uint32 next_index;
+	/* 0 until the first batch referencing the dictionary is finished */
+	int32 dictionary_id;
+	bool batch_started;
+	bool has_nulls;
+	Simple8bRleCompressor dictionary_indexes;
+	Simple8bRleCompressor nulls;
+	/* per-batch dictionary compressor used once the shared dictionary is full */
+	Compressor *fallback;
+} SharedDictionaryCompressor;
+
+static void
+shared_dictionary_compressor_start_batch(SharedDictionaryCompressor *compressor)
+{
+	if (compressor->batch_started)
+		return;
+
+	simple8brle_compressor_init(&compressor->dictionary_indexes);
+	simple8brle_compressor_init(&compressor->nulls);
+	compressor->has_nulls = false;
+	compressor->batch_started = true;
+}
+
+static void
+shared_dictionary_compressor_append_null(Compressor *compressor_base)
+{
+	SharedDictionaryCompressor *compressor = (SharedDictionaryCompressor *) compressor_base;
+
+	if (compressor->fallback != NULL)
+	{
+		compressor->fallback->append_null(compressor->fallback);
+		return;
+	}
+
+	shared_dictionary_compressor_start_batch(compressor);
+	compressor->has_nulls = true;
+	simple8brle_compressor_append(&compressor->nulls, 1);
+}
+
+static void
+shared_dictionary_compressor_append_val(Compressor *compressor_base, Datum val)
+{
+	SharedDictionaryCompressor *compressor = (SharedDictionaryCompressor *) compressor_base;
+	DictionaryHashItem *dict_item;
+	bool found;
+
+	if (compressor->fallback != NULL)
+	{
+		compressor->fallback->append_val(compressor->fallback, val);
+		return;
+	}
+
+	shared_dictionary_compressor_start_batch(compressor);
+
+	dict_item = dictionary_insert(compressor->dictionary_items, val, &found);
+	if (!found)
+	{
+		MemoryContext old_context = MemoryContextSwitchTo(compressor->mcxt);
+		dict_item->index = compressor->next_index;
+		dict_item->key = datumCopy(val, compressor->typbyval, compressor->typlen);
+		compressor->next_index += 1;
+		MemoryContextSwitchTo(old_context);
+	}
+
+	simple8brle_compressor_append(&compressor->dictionary_indexes, dict_item->index);
+	simple8brle_compressor_append(&compressor->nulls, 0);
+}
+
+static void *
+shared_dictionary_compressor_finish(Compressor *compressor_base)
+{
+	SharedDictionaryCompressor *compressor = (SharedDictionaryCompressor *) compressor_base;
+	Simple8bRleSerialized *indexes;
+	Simple8bRleSerialized *nulls;
+	SharedDictionaryCompressed *compressed;
+	Size indexes_size;
+	Size nulls_size = 0;
+	Size total_size;
+	char *data;
+
+	if (compressor->fallback != NULL)
+		return compressor->fallback->finish(compressor->fallback);
+
+	if (!compressor->batch_started)
+		return NULL;
+
+	compressor->batch_started = false;
+	indexes = simple8brle_compressor_finish(&compressor->dictionary_indexes);
+	nulls = simple8brle_compressor_finish(&compressor->nulls);
+
+	/* all the values are NULL */
+	if (indexes == NULL)
+		return NULL;
+
+	if (compressor->dictionary_id == 0)
+		compressor->dictionary_id = ts_compression_chunk_dictionary_next_id();
+
+	indexes_size = simple8brle_serialized_total_size(indexes);
+	if (compressor->has_nulls)
+		nulls_size = simple8brle_serialized_total_size(nulls);
+	total_size = MAXALIGN(sizeof(SharedDictionaryCompressed)) + indexes_size + nulls_size;
+
+	if (!AllocSizeIsValid(total_size))
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("compressed size exceeds the maximum allowed (%d)", (int) MaxAllocSize)));
+
+	data = palloc0(total_size);
+	compressed = (SharedDictionaryCompressed *) data;
+	SET_VARSIZE(compressed->vl_len_, total_size);
+	compressed->compression_algorithm = COMPRESSION_ALGORITHM_SHARED_DICTIONARY;
+	compressed->has_nulls = compressor->has_nulls ? 1 : 0;
+	compressed->element_type = compressor->type;
+	compressed->dictionary_id = compressor->dictionary_id;
+
+	data += sizeof(SharedDictionaryCompressed);
+	data = bytes_serialize_simple8b_and_advance(data, indexes_size, indexes);
+	if (compressor->has_nulls)
+		data = bytes_serialize_simple8b_and_advance(data, nulls_size, nulls);
+	Assert(data - (char *) compressed == total_size);
+
+	if (compressor->next_index >= SHARED_DICTIONARY_MAX_ITEMS)
+	{
+		MemoryContext old_context = MemoryContextSwitchTo(compressor->mcxt);
+		compressor->fallback = dictionary_compressor_for_type(compressor->type);
+		MemoryContextSwitchTo(old_context);
+	}
+
+	return compressed;
+}
+
+const Compressor shared_dictionary_compressor = {
+	.append_val = shared_dictionary_compressor_append_val,
+	.append_null = shared_dictionary_compressor_append_null,
+	.finish = shared_dictionary_compressor_finish,
+};
+
+Compressor *
+shared_dictionary_compressor_for_type(Oid element_type)
+{
+	SharedDictionaryCompressor *compressor = palloc(sizeof(*compressor));
+	TypeCacheEntry *tentry =
+		lookup_type_cache(element_type, TYPECACHE_EQ_OPR_FINFO | TYPECACHE_HASH_PROC_FINFO);
+
+	*compressor = (SharedDictionaryCompressor){
+		.base = shared_dictionary_compressor,
+		.mcxt = CurrentMemoryContext,
+		.type = element_type,
+		.typlen = tentry->typlen,
+		.typbyval = tentry->typbyval,
+		.dictionary_items = dictionary_hash_alloc(tentry),
+	};
+	return &compressor->base;
+}
+
+/*
+ * Store the dictionary once all the batches of the chunk column have been
+ * compressed. Nothing is stored if no batch references the dictionary.
+ */
+void
+shared_dictionary_compressor_store(Compressor *compressor_base, int32 compressed_chunk_id)
+{
+	SharedDictionaryCompressor *compressor = (SharedDictionaryCompressor *) compressor_base;
+	ArrayCompressor *array_comp;
+	Datum *value_array;
+	dictionary_iterator dictionary_item_iterator;
+
+	if (compressor->dictionary_id == 0)
+		return;
+
+	value_array = palloc(compressor->next_index * sizeof(Datum));
+	dictionary_start_iterate(compressor->dictionary_items, &dictionary_item_iterator);
+	for (DictionaryHashItem *dict_item =
+			 dictionary_iterate(compressor->dictionary_items, &dictionary_item_iterator);
+		 dict_item != NULL;
+		 dict_item = dictionary_iterate(compressor->dictionary_items, &dictionary_item_iterator))
+		value_array[dict_item->index] = dict_item->key;
+
+	array_comp = array_compressor_alloc(compressor->type);
+	for (uint32 i = 0; i < compressor->next_index; i++)
+		array_compressor_append(array_comp, value_array[i]);
+
+	ts_compression_chunk_dictionary_insert(compressor->dictionary_id,
+										   compressed_chunk_id,
+										   PointerGetDatum(array_compressor_finish(array_comp)));
+	pfree(value_array);
+}
+
 ////////////////////
 /// Decompressor ///
 ////////////////////
 
+/*
+ * Set up the iterators over the dictionary indexes, and the nulls if there are
+ * any, starting at *data.
+ */
+static void
+dictionary_decompression_iterator_init_indexes(DictionaryDecompressionIterator *iter,
+											   const char **data, bool scan_forward)
+{
+	Simple8bRleSerialized *s8_bitmap = bytes_deserialize_simple8b_and_advance(data);
+
+	if (scan_forward)
+		simple8brle_decompression_iterator_init_forward(&iter->bitmap, s8_bitmap);
+	else
+		simple8brle_decompression_iterator_init_reverse(&iter->bitmap, s8_bitmap);
+
+	if (iter->has_nulls)
+	{
+		Simple8bRleSerialized *s8_null = bytes_deserialize_simple8b_and_advance(data);
+		if (scan_forward)
+			simple8brle_decompression_iterator_init_forward(&iter->nulls, s8_null);
+		else
+			simple8brle_decompression_iterator_init_reverse(&iter->nulls, s8_null);
+	}
+}
+
 static void
 dictionary_decompression_iterator_init(DictionaryDecompressionIterator *iter, const char *data,
 									   bool scan_forward, Oid element_type)
@@ -349,7 +629,6 @@ dictionary_decompression_iterator_init(DictionaryDecompressionIterator *iter, co
 	const DictionaryCompressed *bitmap = (const DictionaryCompressed *) data;
 	Size total_size = VARSIZE(bitmap);
 	Size remaining_size;
-	Simple8bRleSerialized *s8_bitmap;
 	DecompressionIterator *dictionary_iterator;
 
 	*iter = (DictionaryDecompressionIterator){
@@ -359,27 +638,13 @@ dictionary_decompression_iterator_init(DictionaryDecompressionIterator *iter, co
 			.element_type = element_type,
 			.try_next = (scan_forward ? dictionary_decompression_iterator_try_next_forward : dictionary_decompression_iterator_try_next_reverse),
 		},
-		.compressed = bitmap,
+		.num_distinct = bitmap->num_distinct,
 		.values = palloc(sizeof(Datum) * bitmap->num_distinct),
 		.has_nulls = bitmap->has_nulls == 1,
 	};
 
 	data += sizeof(DictionaryCompressed);
-	s8_bitmap = bytes_deserialize_simple8b_and_advance(&data);
-
-	if (scan_forward)
-		simple8brle_decompression_iterator_init_forward(&iter->bitmap, s8_bitmap);
-	else
-		simple8brle_decompression_iterator_init_reverse(&iter->bitmap, s8_bitmap);
-
-	if (iter->has_nulls)
-	{
-		Simple8bRleSerialized *s8_null = bytes_deserialize_simple8b_and_advance(&data);
-		if (scan_forward)
-			simple8brle_decompression_iterator_init_forward(&iter->nulls, s8_null);
-		else
-			simple8brle_decompression_iterator_init_reverse(&iter->nulls, s8_null);
-	}
+	dictionary_decompression_iterator_init_indexes(iter, &data, scan_forward);
 
 	remaining_size = total_size - (data - (char *) bitmap);
 
@@ -427,7 +692,8 @@ dictionary_decompression_iterator_try_next_forward(DecompressionIterator *iter_b
 	DictionaryDecompressionIterator *iter;
 	Simple8bRleDecompressResult result;
 
-	Assert(iter_base->compression_algorithm == COMPRESSION_ALGORITHM_DICTIONARY &&
+	Assert((iter_base->compression_algorithm == COMPRESSION_ALGORITHM_DICTIONARY ||
+			iter_base->compression_algorithm == COMPRESSION_ALGORITHM_SHARED_DICTIONARY) &&
 		   iter_base->forward);
 	iter = (DictionaryDecompressionIterator *) iter_base;
 
@@ -452,7 +718,7 @@ dictionary_decompression_iterator_try_next_forward(DecompressionIterator *iter_b
 			.is_done = true,
 		};
 
-	Assert(result.val < iter->compressed->num_distinct);
+	Assert(result.val < iter->num_distinct);
 	return (DecompressResult){
 		.val = iter->values[result.val],
 		.is_null = false,
@@ -466,7 +732,8 @@ dictionary_decompression_iterator_try_next_reverse(DecompressionIterator *iter_b
 	DictionaryDecompressionIterator *iter;
 	Simple8bRleDecompressResult result;
 
-	Assert(iter_base->compression_algorithm == COMPRESSION_ALGORITHM_DICTIONARY &&
+	Assert((iter_base->compression_algorithm == COMPRESSION_ALGORITHM_DICTIONARY ||
+			iter_base->compression_algorithm == COMPRESSION_ALGORITHM_SHARED_DICTIONARY) &&
 		   !iter_base->forward);
 	iter = (DictionaryDecompressionIterator *) iter_base;
 
@@ -491,7 +758,7 @@ dictionary_decompression_iterator_try_next_reverse(DecompressionIterator *iter_b
 			.is_done = true,
 		};
 
-	Assert(result.val < iter->compressed->num_distinct);
+	Assert(result.val < iter->num_distinct);
 	return (DecompressResult){
 		.val = iter->values[result.val],
 		.is_null = false,
@@ -499,6 +766,219 @@ dictionary_decompression_iterator_try_next_reverse(DecompressionIterator *iter_b
 	};
 }
 
+/*
+ * Map the dictionary indexes of a batch to the dictionary items.
+ */
+static DecompressedBatch *
+dictionary_decompress_indexes(const Datum *items, uint32 num_distinct,
+							  Simple8bRleSerialized *s8_indexes, Simple8bRleSerialized *s8_nulls,
+							  Oid element_type)
+{
+	DecompressedBatch *batch;
+	uint64 *indexes;
+	uint32 num_values;
+	uint32 i;
+
+	num_values = s8_indexes->num_elements;
+	batch = decompressed_batch_alloc(element_type,
+									 s8_nulls != NULL ? s8_nulls->num_elements : num_values);
+	batch->num_distinct = num_distinct;
+	batch->dictionary = items;
+	batch->codes = palloc(sizeof(uint32) * Max(batch->num_rows, 1));
+
+	indexes = simple8brle_decompress_all(s8_indexes);
+	for (i = 0; i < num_values; i++)
+	{
+		if (indexes[i] >= num_distinct)
+			elog(ERROR, "the compressed data is corrupt: dictionary index out of range");
+		batch->values[i] = items[indexes[i]];
+		batch->codes[i] = indexes[i];
+	}
+	pfree(indexes);
+
+	if (s8_nulls != NULL)
+	{
+		uint64 *is_null = simple8brle_decompress_all(s8_nulls);
+		decompressed_batch_spread_nulls(batch, is_null, num_values);
+		pfree(is_null);
+	}
+
+	return batch;
+}
+
+DecompressedBatch *
+tsl_dictionary_decompress_all(Datum dictionary_compressed, Oid element_type)
+{
+	const char *data = (void *) PG_DETOAST_DATUM(dictionary_compressed);
+	const DictionaryCompressed *compressed = (const DictionaryCompressed *) data;
+	Size total_size = VARSIZE(compressed);
+	Simple8bRleSerialized *s8_indexes;
+	Simple8bRleSerialized *s8_nulls = NULL;
+	DecompressedBatch *dictionary;
+
+	Assert(compressed->compression_algorithm == COMPRESSION_ALGORITHM_DICTIONARY);
+
+	data += sizeof(DictionaryCompressed);
+	s8_indexes = bytes_deserialize_simple8b_and_advance(&data);
+	if (compressed->has_nulls == 1)
+		s8_nulls = bytes_deserialize_simple8b_and_advance(&data);
+
+	dictionary = array_decompress_all_serialized(data,
+												 total_size - (data - (char *) compressed),
+												 compressed->element_type,
+												 /* has_nulls */ false);
+	if (dictionary->num_rows != compressed->num_distinct)
+		elog(ERROR, "the compressed data is corrupt: wrong number of dictionary items");
+
+	return dictionary_decompress_indexes(dictionary->values,
+										 compressed->num_distinct,
+										 s8_indexes,
+										 s8_nulls,
+										 element_type);
+}
+
+//////////////////////////////////////
+/// Shared Dictionary Decompressor ///
+//////////////////////////////////////
+
+typedef struct SharedDictionaryCacheEntry
+{
+	int32 dictionary_id; /* hash key */
+	Oid element_type;
+	uint32 num_distinct;
+	Datum *values;
+} SharedDictionaryCacheEntry;
+
+/*
+ * The shared dictionaries loaded by the current transaction. The decompressed
+ * batches point into the dictionary items, so the cache lives as long as the
+ * transaction and is recreated by the next one. The dictionaries never change
+ * once written, so the cache needs no invalidation.
+ */
+static HTAB *shared_dictionary_cache = NULL;
+static LocalTransactionId shared_dictionary_cache_lxid = InvalidLocalTransactionId;
+
+static const SharedDictionaryCacheEntry *
+shared_dictionary_lookup(int32 dictionary_id, Oid element_type)
+{
+	SharedDictionaryCacheEntry *entry;
+	MemoryContext old_context;
+	Datum dictionary;
+	const CompressedDataHeader *header;
+	DecompressedBatch *items;
+
+	if (shared_dictionary_cache == NULL || shared_dictionary_cache_lxid != MyProc->lxid)
+	{
+		HASHCTL ctl = {
+			.keysize = sizeof(int32),
+			.entrysize = sizeof(SharedDictionaryCacheEntry),
+			.hcxt = TopTransactionContext,
+		};
+
+		shared_dictionary_cache = hash_create("shared compression dictionaries",
+											  16,
+											  &ctl,
+											  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		shared_dictionary_cache_lxid = MyProc->lxid;
+	}
+
+	entry = hash_search(shared_dictionary_cache, &dictionary_id, HASH_FIND, NULL);
+	if (entry != NULL)
+	{
+		if (entry->element_type != element_type)
+			elog(ERROR, "trying to decompress the wrong type");
+		return entry;
+	}
+
+	old_context = MemoryContextSwitchTo(TopTransactionContext);
+	dictionary = ts_compression_chunk_dictionary_get(dictionary_id);
+	header = (const CompressedDataHeader *) DatumGetPointer(dictionary);
+	if (header->compression_algorithm != COMPRESSION_ALGORITHM_ARRAY)
+		elog(ERROR, "the compressed data is corrupt: invalid shared dictionary %d", dictionary_id);
+	items = tsl_array_decompress_all(dictionary, element_type);
+	MemoryContextSwitchTo(old_context);
+
+	entry = hash_search(shared_dictionary_cache, &dictionary_id, HASH_ENTER, NULL);
+	entry->element_type = element_type;
+	entry->num_distinct = items->num_rows;
+	entry->values = items->values;
+	return entry;
+}
+
+static void
+shared_dictionary_decompression_iterator_init(DictionaryDecompressionIterator *iter,
+											  const char *data, bool scan_forward,
+											  Oid element_type)
+{
+	const SharedDictionaryCompressed *compressed = (const SharedDictionaryCompressed *) data;
+	const SharedDictionaryCacheEntry *dictionary =
+		shared_dictionary_lookup(compressed->dictionary_id, compressed->element_type);
+
+	*iter = (DictionaryDecompressionIterator){
+		.base = {
+			.compression_algorithm = COMPRESSION_ALGORITHM_SHARED_DICTIONARY,
+			.forward = scan_forward,
+			.element_type = element_type,
+			.try_next = (scan_forward ? dictionary_decompression_iterator_try_next_forward : dictionary_decompression_iterator_try_next_reverse),
+		},
+		.num_distinct = dictionary->num_distinct,
+		.values = dictionary->values,
+		.has_nulls = compressed->has_nulls == 1,
+	};
+
+	data += sizeof(SharedDictionaryCompressed);
+	dictionary_decompression_iterator_init_indexes(iter, &data, scan_forward);
+}
+
+DecompressionIterator *
+tsl_shared_dictionary_decompression_iterator_from_datum_forward(Datum dictionary_compressed,
+																Oid element_type)
+{
+	DictionaryDecompressionIterator *iterator = palloc(sizeof(*iterator));
+	shared_dictionary_decompression_iterator_init(iterator,
+												  (void *) PG_DETOAST_DATUM(dictionary_compressed),
+												  true,
+												  element_type);
+	return &iterator->base;
+}
+
+DecompressionIterator *
+tsl_shared_dictionary_decompression_iterator_from_datum_reverse(Datum dictionary_compressed,
+																Oid element_type)
+{
+	DictionaryDecompressionIterator *iterator = palloc(sizeof(*iterator));
+	shared_dictionary_decompression_iterator_init(iterator,
+												  (void *) PG_DETOAST_DATUM(dictionary_compressed),
+												  false,
+												  element_type);
+	return &iterator->base;
+}
+
+DecompressedBatch *
+tsl_shared_dictionary_decompress_all(Datum dictionary_compressed, Oid element_type)
+{
+	const char *data = (void *) PG_DETOAST_DATUM(dictionary_compressed);
+	const SharedDictionaryCompressed *compressed = (const SharedDictionaryCompressed *) data;
+	const SharedDictionaryCacheEntry *dictionary;
+	Simple8bRleSerialized *s8_indexes;
+	Simple8bRleSerialized *s8_nulls = NULL;
+
+	Assert(compressed->compression_algorithm == COMPRESSION_ALGORITHM_SHARED_DICTIONARY);
+
+	dictionary = shared_dictionary_lookup(compressed->dictionary_id, compressed->element_type);
+
+	data += sizeof(SharedDictionaryCompressed);
+	s8_indexes = bytes_deserialize_simple8b_and_advance(&data);
+	if (compressed->has_nulls == 1)
+		s8_nulls = bytes_deserialize_simple8b_and_advance(&data);
+
+	return dictionary_decompress_indexes(dictionary->values,
+										 dictionary->num_distinct,
+										 s8_indexes,
+										 s8_nulls,
+										 element_type);
+}
+
 /////////////////////
 /// SQL Functions ///
 /////////////////////
@@ -595,6 +1075,42 @@ dictionary_compressed_send(CompressedDataHeader *header, StringInfo buffer)
 							   false);
 }
 
+/*
+ * The receiving side need not have the dictionary, so a batch compressed with a
+ * shared dictionary is sent as a regular dictionary compressed batch, which is
+ * what dictionary_compressed_recv turns it back into.
+ */
+void
+shared_dictionary_compressed_send(CompressedDataHeader *header, StringInfo buffer)
+{
+	const SharedDictionaryCompressed *compressed = (SharedDictionaryCompressed *) header;
+	DictionaryCompressor *compressor = dictionary_compressor_alloc(compressed->element_type);
+	DictionaryDecompressionIterator iterator;
+	DictionaryCompressorSerializationInfo sizes;
+	DictionaryCompressed *dictionary;
+
+	Assert(header->compression_algorithm == COMPRESSION_ALGORITHM_SHARED_DICTIONARY);
+	shared_dictionary_decompression_iterator_init(&iterator,
+												  (const char *) compressed,
+												  true,
+												  compressed->element_type);
+
+	for (DecompressResult res = dictionary_decompression_iterator_try_next_forward(&iterator.base);
+		 !res.is_done;
+		 res = dictionary_decompression_iterator_try_next_forward(&iterator.base))
+	{
+		if (res.is_null)
+			dictionary_compressor_append_null(compressor);
+		else
+			dictionary_compressor_append(compressor, res.val);
+	}
+
+	sizes = compressor_get_serialization_info(compressor);
+	Assert(!sizes.is_all_null);
+	dictionary = dictionary_compressed_from_serialization_info(sizes, compressed->element_type);
+	dictionary_compressed_send((CompressedDataHeader *) dictionary, buffer);
+}
+
 Datum
 dictionary_compressed_recv(StringInfo buffer)
 {
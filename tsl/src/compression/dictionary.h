@@ -9,6 +9,10 @@
  * object. The row->dictionary item mapping is stored as a series of integer-based indexes into the
  * dictionary array ordered by row number (called dictionary_indexes; compressed using
  * `simple8b_rle`).
+ *
+ * The shared dictionary variant stores the dictionary items once per compressed
+ * chunk column in the compression_chunk_dictionary catalog table, and each
+ * batch only stores its dictionary indexes and the id of the dictionary.
  */
 #ifndef TIMESCALEDB_TSL_DICTIONARY_COMPRESSION_H
 #define TIMESCALEDB_TSL_DICTIONARY_COMPRESSION_H
@@ -41,9 +45,25 @@ tsl_dictionary_decompression_iterator_from_datum_reverse(Datum dictionary_compre
 extern DecompressResult
 dictionary_decompression_iterator_try_next_reverse(DecompressionIterator *iter);
 
+extern DecompressedBatch *tsl_dictionary_decompress_all(Datum dictionary_compressed,
+														Oid element_type);
+
 extern void dictionary_compressed_send(CompressedDataHeader *header, StringInfo buffer);
 extern Datum dictionary_compressed_recv(StringInfo buf);
 
+extern Compressor *shared_dictionary_compressor_for_type(Oid element_type);
+extern void shared_dictionary_compressor_store(Compressor *compressor, int32 compressed_chunk_id);
+
+extern DecompressionIterator *
+tsl_shared_dictionary_decompression_iterator_from_datum_forward(Datum dictionary_compressed,
+																Oid element_oid);
+extern DecompressionIterator *
+tsl_shared_dictionary_decompression_iterator_from_datum_reverse(Datum dictionary_compressed,
+																Oid element_oid);
+extern DecompressedBatch *tsl_shared_dictionary_decompress_all(Datum dictionary_compressed,
+															   Oid element_type);
+extern void shared_dictionary_compressed_send(CompressedDataHeader *header, StringInfo buffer);
+
 extern Datum tsl_dictionary_compressor_append(PG_FUNCTION_ARGS);
 extern Datum tsl_dictionary_compressor_finish(PG_FUNCTION_ARGS);
 
@@ -51,10 +71,23 @@ extern Datum tsl_dictionary_compressor_finish(PG_FUNCTION_ARGS);
 	{                                                                                              \
 		.iterator_init_forward = tsl_dictionary_decompression_iterator_from_datum_forward,         \
 		.iterator_init_reverse = tsl_dictionary_decompression_iterator_from_datum_reverse,         \
+		.decompress_all = tsl_dictionary_decompress_all,                                           \
 		.compressed_data_send = dictionary_compressed_send,                                        \
 		.compressed_data_recv = dictionary_compressed_recv,                                        \
 		.compressor_for_type = dictionary_compressor_for_type,                                     \
 		.compressed_data_storage = TOAST_STORAGE_EXTENDED,                                         \
 	}
 
+/* received shared dictionary batches are regular dictionary batches, see the send function */
+#define SHARED_DICTIONARY_ALGORITHM_DEFINITION                                                     \
+	{                                                                                              \
+		.iterator_init_forward = tsl_shared_dictionary_decompression_iterator_from_datum_forward,  \
+		.iterator_init_reverse = tsl_shared_dictionary_decompression_iterator_from_datum_reverse,  \
+		.decompress_all = tsl_shared_dictionary_decompress_all,                                    \
+		.compressed_data_send = shared_dictionary_compressed_send,                                 \
+		.compressed_data_recv = dictionary_compressed_recv,                                        \
+		.compressor_for_type = shared_dictionary_compressor_for_type,                              \
+		.compressed_data_storage = TOAST_STORAGE_EXTENDED,                                         \
+	}
+
 #endif
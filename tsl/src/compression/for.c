@@ -0,0 +1,798 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+#include "compression/for.h"
+
+#include <catalog/pg_type.h>
+#include <utils/builtins.h>
+#include <utils/date.h>
+#include <utils/timestamp.h>
+#include <funcapi.h>
+#include <lib/stringinfo.h>
+#include <libpq/pqformat.h>
+
+#include <adts/uint64_vec.h>
+
+#include "compression/compression.h"
+#include "compression/detoast_reader.h"
+#include "compression/simple8b_rle.h"
+
+/*
+ * FOR compressed data is stored as
+ *     the compressed data header
+ *     uint8 has_nulls: 1 if we store a NULLs bitmap after the packed values, otherwise 0
+ *     uint8 bit_width: the number of bits each value is packed into, 0 to 64
+ *     uint32 num_elements: the number of non-null values
+ *     uint64 reference: the minimum of the values
+ *     uint64 packed[]: the offsets from the reference, packed bit_width bits each
+ *     optional simple8b_rle nulls bitmap
+ *
+ * Value i is stored at bits [i * bit_width, (i + 1) * bit_width) of the packed array,
+ * starting at the least significant bit of each word. We always store one word more than the
+ * values need (see for_num_packed_words), so that the decoder can read the word after the one
+ * a value starts in without checking whether it exists.
+ */
+typedef struct ForCompressed
+{
+	CompressedDataHeaderFields;
+	uint8 has_nulls;
+	uint8 bit_width;
+	uint8 padding[5];
+	uint32 num_elements;
+	uint64 reference;
+	uint64 packed[FLEXIBLE_ARRAY_MEMBER];
+} ForCompressed;
+
+static void
+pg_attribute_unused() assertions(void)
+{
+	ForCompressed test_val = { { 0 } };
+	/* make sure no padding bytes make it to disk */
+	StaticAssertStmt(sizeof(ForCompressed) ==
+						 sizeof(test_val.vl_len_) + sizeof(test_val.compression_algorithm) +
+							 sizeof(test_val.has_nulls) + sizeof(test_val.bit_width) +
+							 sizeof(test_val.padding) + sizeof(test_val.num_elements) +
+							 sizeof(test_val.reference),
+					 "ForCompressed wrong size");
+	StaticAssertStmt(sizeof(ForCompressed) == 24, "ForCompressed wrong size");
+}
+
+typedef struct ForDecompressionIterator
+{
+	DecompressionIterator base;
+	const uint64 *packed;
+	uint64 reference;
+	uint8 bit_width;
+	uint32 num_elements;
+	/* the index of the next value to return, counting from the end for reverse iteration */
+	uint32 position;
+	Simple8bRleDecompressionIterator nulls;
+	bool has_nulls;
+} ForDecompressionIterator;
+
+typedef struct ForCompressor
+{
+	uint64_vec values;
+	int64 min_val;
+	int64 max_val;
+	Simple8bRleCompressor nulls;
+	bool has_nulls;
+} ForCompressor;
+
+typedef struct ExtendedCompressor
+{
+	Compressor base;
+	ForCompressor *internal;
+} ExtendedCompressor;
+
+/********************
+ *****  UTILS  *****
+ ********************/
+
+static inline uint64
+for_value_mask(uint8 bit_width)
+{
+	Assert(bit_width <= 64);
+	return bit_width == 64 ? ~UINT64CONST(0) : (UINT64CONST(1) << bit_width) - 1;
+}
+
+/* the number of words needed to pack num_values values, including the trailing word */
+static inline uint64
+for_num_packed_words(uint32 num_values, uint8 bit_width)
+{
+	if (bit_width == 0)
+		return 0;
+
+	return ((uint64) num_values * bit_width + 63) / 64 + 1;
+}
+
+/*
+ * Extract value i from the packed array. The high part is shifted in two
+ * steps, since shifting a 64-bit word by 64 is undefined: when the value does
+ * not cross into the next word, the next word is shifted out entirely. There
+ * are no branches and no dependencies between values, so loops calling this
+ * vectorize.
+ */
+static inline uint64
+for_unpack_one(const uint64 *packed, uint8 bit_width, uint64 mask, uint32 i)
+{
+	const uint64 bit = (uint64) i * bit_width;
+	const uint64 word = bit / 64;
+	const uint32 shift = bit % 64;
+	const uint64 low = packed[word] >> shift;
+	const uint64 high = (packed[word + 1] << 1) << (63 - shift);
+
+	return (low | high) & mask;
+}
+
+uint8
+for_bit_width(int64 min_val, int64 max_val)
+{
+	/* unsigned arithmetic so that the range of any two int64 fits */
+	uint64 range = ((uint64) max_val) - ((uint64) min_val);
+	uint8 bit_width = 0;
+
+	Assert(min_val <= max_val);
+
+	while (range != 0)
+	{
+		bit_width++;
+		range >>= 1;
+	}
+
+	return bit_width;
+}
+
+Size
+for_compressed_size(uint32 num_values, uint8 bit_width, const Simple8bRleSerialized *nulls)
+{
+	Size size =
+		sizeof(ForCompressed) + for_num_packed_words(num_values, bit_width) * sizeof(uint64);
+
+	if (nulls != NULL)
+		size += simple8brle_serialized_total_size(nulls);
+
+	return size;
+}
+
+static ForCompressed *
+for_from_parts(uint8 bit_width, uint32 num_elements, uint64 reference, Simple8bRleSerialized *nulls)
+{
+	Size compressed_size = for_compressed_size(num_elements, bit_width, nulls);
+	ForCompressed *compressed;
+
+	if (!AllocSizeIsValid(compressed_size))
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("compressed size exceeds the maximum allowed (%d)", (int) MaxAllocSize)));
+
+	/* zeroed, since values are OR'ed into the packed words */
+	compressed = palloc0(compressed_size);
+	SET_VARSIZE(&compressed->vl_len_, compressed_size);
+
+	compressed->compression_algorithm = COMPRESSION_ALGORITHM_FOR;
+	compressed->has_nulls = nulls != NULL ? 1 : 0;
+	compressed->bit_width = bit_width;
+	compressed->num_elements = num_elements;
+	compressed->reference = reference;
+
+	if (nulls != NULL)
+	{
+		char *nulls_data =
+			(char *) &compressed->packed[for_num_packed_words(num_elements, bit_width)];
+		Assert(nulls->num_elements > num_elements);
+		bytes_serialize_simple8b_and_advance(nulls_data,
+											 simple8brle_serialized_total_size(nulls),
+											 nulls);
+	}
+
+	return compressed;
+}
+
+/*
+ * Build FOR compressed data from the non-null values, given as int64 cast to
+ * uint64, and their minimum and maximum. This is also used by deltadelta to
+ * switch to FOR when that is smaller.
+ */
+ForCompressed *
+for_compressed_from_values(const uint64 *values, uint32 num_values, int64 min_val, int64 max_val,
+						   Simple8bRleSerialized *nulls)
+{
+	uint8 bit_width = for_bit_width(min_val, max_val);
+	ForCompressed *compressed = for_from_parts(bit_width, num_values, (uint64) min_val, nulls);
+	uint32 i;
+
+	if (bit_width == 0)
+		return compressed;
+
+	for (i = 0; i < num_values; i++)
+	{
+		const uint64 offset = values[i] - compressed->reference;
+		const uint64 bit = (uint64) i * bit_width;
+		const uint64 word = bit / 64;
+		const uint32 shift = bit % 64;
+
+		Assert(offset <= for_value_mask(bit_width));
+
+		compressed->packed[word] |= offset << shift;
+		/* same as in for_unpack_one, the two-step shift avoids shifting by 64 */
+		compressed->packed[word + 1] |= (offset >> 1) >> (63 - shift);
+	}
+
+	return compressed;
+}
+
+/*******************
+ ***  Compressor  ***
+ *******************/
+
+ForCompressor *
+for_compressor_alloc(void)
+{
+	ForCompressor *compressor = palloc0(sizeof(*compressor));
+	uint64_vec_init(&compressor->values, CurrentMemoryContext, 0);
+	simple8brle_compressor_init(&compressor->nulls);
+	return compressor;
+}
+
+void
+for_compressor_append_null(ForCompressor *compressor)
+{
+	compressor->has_nulls = true;
+	simple8brle_compressor_append(&compressor->nulls, 1);
+}
+
+void
+for_compressor_append_value(ForCompressor *compressor, int64 next_val)
+{
+	if (compressor->values.num_elements == 0)
+	{
+		compressor->min_val = next_val;
+		compressor->max_val = next_val;
+	}
+	else
+	{
+		compressor->min_val = Min(compressor->min_val, next_val);
+		compressor->max_val = Max(compressor->max_val, next_val);
+	}
+
+	uint64_vec_append(&compressor->values, (uint64) next_val);
+	simple8brle_compressor_append(&compressor->nulls, 0);
+}
+
+void *
+for_compressor_finish(ForCompressor *compressor)
+{
+	Simple8bRleSerialized *nulls = simple8brle_compressor_finish(&compressor->nulls);
+
+	if (compressor->values.num_elements == 0)
+		return NULL;
+
+	return for_compressed_from_values(compressor->values.data,
+									  compressor->values.num_elements,
+									  compressor->min_val,
+									  compressor->max_val,
+									  compressor->has_nulls ? nulls : NULL);
+}
+
+static void
+for_compressor_append_bool(Compressor *compressor, Datum val)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = for_compressor_alloc();
+
+	for_compressor_append_value(extended->internal, DatumGetBool(val) ? 1 : 0);
+}
+
+static void
+for_compressor_append_int16(Compressor *compressor, Datum val)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = for_compressor_alloc();
+
+	for_compressor_append_value(extended->internal, DatumGetInt16(val));
+}
+
+static void
+for_compressor_append_int32(Compressor *compressor, Datum val)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = for_compressor_alloc();
+
+	for_compressor_append_value(extended->internal, DatumGetInt32(val));
+}
+
+static void
+for_compressor_append_int64(Compressor *compressor, Datum val)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = for_compressor_alloc();
+
+	for_compressor_append_value(extended->internal, DatumGetInt64(val));
+}
+
+static void
+for_compressor_append_date(Compressor *compressor, Datum val)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = for_compressor_alloc();
+
+	for_compressor_append_value(extended->internal, DatumGetDateADT(val));
+}
+
+static void
+for_compressor_append_timestamp(Compressor *compressor, Datum val)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = for_compressor_alloc();
+
+	for_compressor_append_value(extended->internal, DatumGetTimestamp(val));
+}
+
+static void
+for_compressor_append_timestamptz(Compressor *compressor, Datum val)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = for_compressor_alloc();
+
+	for_compressor_append_value(extended->internal, DatumGetTimestampTz(val));
+}
+
+static void
+for_compressor_append_null_value(Compressor *compressor)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	if (extended->internal == NULL)
+		extended->internal = for_compressor_alloc();
+
+	for_compressor_append_null(extended->internal);
+}
+
+static void *
+for_compressor_finish_and_reset(Compressor *compressor)
+{
+	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	void *compressed = for_compressor_finish(extended->internal);
+	uint64_vec_free_data(&extended->internal->values);
+	pfree(extended->internal);
+	extended->internal = NULL;
+	return compressed;
+}
+
+const Compressor for_bool_compressor = {
+	.append_val = for_compressor_append_bool,
+	.append_null = for_compressor_append_null_value,
+	.finish = for_compressor_finish_and_reset,
+};
+
+const Compressor for_uint16_compressor = {
+	.append_val = for_compressor_append_int16,
+	.append_null = for_compressor_append_null_value,
+	.finish = for_compressor_finish_and_reset,
+};
+const Compressor for_uint32_compressor = {
+	.append_val = for_compressor_append_int32,
+	.append_null = for_compressor_append_null_value,
+	.finish = for_compressor_finish_and_reset,
+};
+const Compressor for_uint64_compressor = {
+	.append_val = for_compressor_append_int64,
+	.append_null = for_compressor_append_null_value,
+	.finish = for_compressor_finish_and_reset,
+};
+
+const Compressor for_date_compressor = {
+	.append_val = for_compressor_append_date,
+	.append_null = for_compressor_append_null_value,
+	.finish = for_compressor_finish_and_reset,
+};
+
+const Compressor for_timestamp_compressor = {
+	.append_val = for_compressor_append_timestamp,
+	.append_null = for_compressor_append_null_value,
+	.finish = for_compressor_finish_and_reset,
+};
+
+const Compressor for_timestamptz_compressor = {
+	.append_val = for_compressor_append_timestamptz,
+	.append_null = for_compressor_append_null_value,
+	.finish = for_compressor_finish_and_reset,
+};
+
+Compressor *
+for_compressor_for_type(Oid element_type)
+{
+	ExtendedCompressor *compressor = palloc(sizeof(*compressor));
+	switch (element_type)
+	{
+		case BOOLOID:
+			*compressor = (ExtendedCompressor){ .base = for_bool_compressor };
+			return &compressor->base;
+		case INT2OID:
+			*compressor = (ExtendedCompressor){ .base = for_uint16_compressor };
+			return &compressor->base;
+		case INT4OID:
+			*compressor = (ExtendedCompressor){ .base = for_uint32_compressor };
+			return &compressor->base;
+		case INT8OID:
+			*compressor = (ExtendedCompressor){ .base = for_uint64_compressor };
+			return &compressor->base;
+		case DATEOID:
+			*compressor = (ExtendedCompressor){ .base = for_date_compressor };
+			return &compressor->base;
+		case TIMESTAMPOID:
+			*compressor = (ExtendedCompressor){ .base = for_timestamp_compressor };
+			return &compressor->base;
+		case TIMESTAMPTZOID:
+			*compressor = (ExtendedCompressor){ .base = for_timestamptz_compressor };
+			return &compressor->base;
+		default:
+			elog(ERROR,
+				 "invalid type for frame-of-reference compressor \"%s\"",
+				 format_type_be(element_type));
+	}
+
+	pg_unreachable();
+}
+
+/**********************************************************************************/
+/**********************************************************************************/
+
+static Datum
+convert_from_internal(uint64 val, Oid element_type)
+{
+	switch (element_type)
+	{
+		case BOOLOID:
+			return BoolGetDatum(val);
+		case INT8OID:
+			return Int64GetDatum(val);
+		case INT4OID:
+			return Int32GetDatum(val);
+		case INT2OID:
+			return Int16GetDatum(val);
+		case DATEOID:
+			return DateADTGetDatum(val);
+		case TIMESTAMPTZOID:
+			return TimestampTzGetDatum(val);
+		case TIMESTAMPOID:
+			return TimestampGetDatum(val);
+		default:
+			elog(ERROR,
+				 "invalid type requested from frame-of-reference decompression \"%s\"",
+				 format_type_be(element_type));
+	}
+
+	pg_unreachable();
+}
+
+static ForDecompressionIterator *
+for_decompression_iterator_init(Datum for_compressed, Oid element_type, bool forward)
+{
+	ForCompressed *compressed = (ForCompressed *) PG_DETOAST_DATUM(for_compressed);
+	ForDecompressionIterator *iter = palloc(sizeof(*iter));
+
+	Assert(compressed->has_nulls == 0 || compressed->has_nulls == 1);
+
+	*iter = (ForDecompressionIterator){
+		.base = {
+			.compression_algorithm = COMPRESSION_ALGORITHM_FOR,
+			.forward = forward,
+			.element_type = element_type,
+			.try_next = forward ? for_decompression_iterator_try_next_forward :
+								  for_decompression_iterator_try_next_reverse,
+		},
+		.packed = compressed->packed,
+		.reference = compressed->reference,
+		.bit_width = compressed->bit_width,
+		.num_elements = compressed->num_elements,
+		.position = 0,
+		.has_nulls = compressed->has_nulls == 1,
+	};
+
+	if (iter->has_nulls)
+	{
+		const char *data =
+			(char *) &compressed->packed[for_num_packed_words(compressed->num_elements,
+															  compressed->bit_width)];
+		Simple8bRleSerialized *nulls = bytes_deserialize_simple8b_and_advance(&data);
+
+		if (forward)
+			simple8brle_decompression_iterator_init_forward(&iter->nulls, nulls);
+		else
+			simple8brle_decompression_iterator_init_reverse(&iter->nulls, nulls);
+	}
+
+	return iter;
+}
+
+DecompressionIterator *
+for_decompression_iterator_from_datum_forward(Datum for_compressed, Oid element_type)
+{
+	return &for_decompression_iterator_init(for_compressed, element_type, true)->base;
+}
+
+DecompressionIterator *
+for_decompression_iterator_from_datum_reverse(Datum for_compressed, Oid element_type)
+{
+	return &for_decompression_iterator_init(for_compressed, element_type, false)->base;
+}
+
+static DecompressResult
+for_decompression_iterator_try_next(ForDecompressionIterator *iter)
+{
+	uint32 index;
+	uint64 offset = 0;
+
+	/* check for a null value */
+	if (iter->has_nulls)
+	{
+		Simple8bRleDecompressResult result =
+			iter->base.forward ? simple8brle_decompression_iterator_try_next_forward(&iter->nulls) :
+								 simple8brle_decompression_iterator_try_next_reverse(&iter->nulls);
+		if (result.is_done)
+			return (DecompressResult){
+				.is_done = true,
+			};
+
+		if (result.val != 0)
+		{
+			Assert(result.val == 1);
+			return (DecompressResult){
+				.is_null = true,
+			};
+		}
+	}
+
+	if (iter->position >= iter->num_elements)
+		return (DecompressResult){
+			.is_done = true,
+		};
+
+	index = iter->base.forward ? iter->position : iter->num_elements - 1 - iter->position;
+	iter->position++;
+
+	if (iter->bit_width > 0)
+		offset = for_unpack_one(iter->packed,
+								iter->bit_width,
+								for_value_mask(iter->bit_width),
+								index);
+
+	return (DecompressResult){
+		.val = convert_from_internal(iter->reference + offset, iter->base.element_type),
+	};
+}
+
+DecompressResult
+for_decompression_iterator_try_next_forward(DecompressionIterator *iter)
+{
+	Assert(iter->compression_algorithm == COMPRESSION_ALGORITHM_FOR && iter->forward);
+	return for_decompression_iterator_try_next((ForDecompressionIterator *) iter);
+}
+
+DecompressResult
+for_decompression_iterator_try_next_reverse(DecompressionIterator *iter)
+{
+	Assert(iter->compression_algorithm == COMPRESSION_ALGORITHM_FOR && !iter->forward);
+	return for_decompression_iterator_try_next((ForDecompressionIterator *) iter);
+}
+
+/*
+ * Unpack all values directly into the datum array. The type dispatch is
+ * hoisted out of the loops, and on 64-bit platforms every conversion is a
+ * plain integer cast, so each loop is a straight run of shifts and masks.
+ *
+ * The packed words are passed separately from the header, since they need not
+ * follow it in memory when the value is read in slices.
+ */
+static void
+for_unpack_all(const ForCompressed *compressed, const uint64 *packed, Datum *values,
+			   Oid element_type)
+{
+	const uint8 bit_width = compressed->bit_width;
+	const uint64 mask = for_value_mask(bit_width);
+	const uint64 reference = compressed->reference;
+	const uint32 num_values = compressed->num_elements;
+	uint32 i;
+
+	if (bit_width == 0)
+	{
+		Datum value = convert_from_internal(reference, element_type);
+		for (i = 0; i < num_values; i++)
+			values[i] = value;
+		return;
+	}
+
+#define UNPACK_LOOP(TO_DATUM)                                                                      \
+	for (i = 0; i < num_values; i++)                                                               \
+		values[i] = TO_DATUM(reference + for_unpack_one(packed, bit_width, mask, i));
+
+	switch (element_type)
+	{
+		case BOOLOID:
+			UNPACK_LOOP(BoolGetDatum);
+			break;
+		case INT8OID:
+			UNPACK_LOOP(Int64GetDatum);
+			break;
+		case INT4OID:
+			UNPACK_LOOP(Int32GetDatum);
+			break;
+		case INT2OID:
+			UNPACK_LOOP(Int16GetDatum);
+			break;
+		case DATEOID:
+			UNPACK_LOOP(DateADTGetDatum);
+			break;
+		case TIMESTAMPTZOID:
+			UNPACK_LOOP(TimestampTzGetDatum);
+			break;
+		case TIMESTAMPOID:
+			UNPACK_LOOP(TimestampGetDatum);
+			break;
+		default:
+			elog(ERROR,
+				 "invalid type requested from frame-of-reference decompression \"%s\"",
+				 format_type_be(element_type));
+	}
+
+#undef UNPACK_LOOP
+}
+
+uint32
+for_compressed_num_values(const ForCompressed *compressed)
+{
+	return compressed->num_elements;
+}
+
+/*
+ * Unpack the non-null values as int64 cast to uint64. This is used by
+ * algorithms that store an integer stream with frame-of-reference.
+ */
+void
+for_unpack_values(const ForCompressed *compressed, uint64 *values)
+{
+	const uint64 *packed = compressed->packed;
+	const uint8 bit_width = compressed->bit_width;
+	const uint64 mask = for_value_mask(bit_width);
+	const uint64 reference = compressed->reference;
+	const uint32 num_values = compressed->num_elements;
+	uint32 i;
+
+	if (bit_width == 0)
+	{
+		for (i = 0; i < num_values; i++)
+			values[i] = reference;
+		return;
+	}
+
+	for (i = 0; i < num_values; i++)
+		values[i] = reference + for_unpack_one(packed, bit_width, mask, i);
+}
+
+/*
+ * The nulls follow the packed values, but they are read first to size the
+ * batch, and the packed values are then unpacked straight into it. A large
+ * value that is still toasted is read in slices.
+ */
+DecompressedBatch *
+for_decompress_all(Datum for_compressed, Oid element_type)
+{
+	DetoastReader reader;
+	ForCompressed header;
+	DecompressedBatch *batch;
+	uint64 *is_null = NULL;
+	Size packed_size;
+	uint32 num_rows;
+
+	detoast_reader_init(&reader, for_compressed);
+	header = *(const ForCompressed *) detoast_reader_read(&reader, 0, sizeof(ForCompressed));
+	Assert(header.has_nulls == 0 || header.has_nulls == 1);
+
+	packed_size = sizeof(uint64) * for_num_packed_words(header.num_elements, header.bit_width);
+
+	num_rows = header.num_elements;
+	if (header.has_nulls)
+	{
+		Size offset = sizeof(ForCompressed) + packed_size;
+		Simple8bRleSerialized *nulls = detoast_reader_read_simple8b(&reader, &offset);
+
+		num_rows = nulls->num_elements;
+		is_null = simple8brle_decompress_all(nulls);
+	}
+
+	batch = decompressed_batch_alloc(element_type, num_rows);
+	for_unpack_all(&header,
+				   (const uint64 *) detoast_reader_read(&reader, sizeof(ForCompressed), packed_size),
+				   batch->values,
+				   element_type);
+	detoast_reader_free(&reader);
+
+	if (is_null != NULL)
+	{
+		decompressed_batch_spread_nulls(batch, is_null, header.num_elements);
+		pfree(is_null);
+	}
+
+	return batch;
+}
+
+/**********************************************************************************/
+/**********************************************************************************/
+
+void
+for_compressed_send(CompressedDataHeader *header, StringInfo buffer)
+{
+	const ForCompressed *data = (ForCompressed *) header;
+	uint64 num_words = for_num_packed_words(data->num_elements, data->bit_width);
+	uint64 i;
+
+	Assert(header->compression_algorithm == COMPRESSION_ALGORITHM_FOR);
+	pq_sendbyte(buffer, data->has_nulls);
+	pq_sendbyte(buffer, data->bit_width);
+	pq_sendint32(buffer, data->num_elements);
+	pq_sendint64(buffer, data->reference);
+	for (i = 0; i < num_words; i++)
+		pq_sendint64(buffer, data->packed[i]);
+
+	if (data->has_nulls)
+	{
+		Simple8bRleSerialized *nulls = (Simple8bRleSerialized *) &data->packed[num_words];
+		simple8brle_serialized_send(buffer, nulls);
+	}
+}
+
+Datum
+for_compressed_recv(StringInfo buffer)
+{
+	uint8 has_nulls;
+	uint8 bit_width;
+	uint32 num_elements;
+	uint64 reference;
+	uint64 num_words;
+	uint64 *packed;
+	Simple8bRleSerialized *nulls = NULL;
+	ForCompressed *compressed;
+	uint64 i;
+
+	has_nulls = pq_getmsgbyte(buffer);
+	if (has_nulls != 0 && has_nulls != 1)
+		elog(ERROR, "invalid recv in frame-of-reference: bad bool");
+
+	bit_width = pq_getmsgbyte(buffer);
+	if (bit_width > 64)
+		elog(ERROR, "invalid recv in frame-of-reference: bad bit width");
+
+	num_elements = pq_getmsgint32(buffer);
+	reference = pq_getmsgint64(buffer);
+
+	num_words = for_num_packed_words(num_elements, bit_width);
+	if (!AllocSizeIsValid(num_words * sizeof(uint64)))
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("compressed size exceeds the maximum allowed (%d)", (int) MaxAllocSize)));
+
+	packed = palloc(num_words * sizeof(uint64));
+	for (i = 0; i < num_words; i++)
+		packed[i] = pq_getmsgint64(buffer);
+
+	if (has_nulls)
+		nulls = simple8brle_serialized_recv(buffer);
+
+	compressed = for_from_parts(bit_width, num_elements, reference, nulls);
+	if (num_words > 0)
+		memcpy(compressed->packed, packed, num_words * sizeof(uint64));
+	pfree(packed);
+
+	PG_RETURN_POINTER(compressed);
+}
@@ -0,0 +1,71 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+/*
+ * Frame-of-reference (FOR) is used to encode integers or integer-like objects whose values
+ * are spread over a narrow range but do not follow a trend, e.g. counters that reset or
+ * quantized gauges. We store the minimum of the series as the reference value, and every
+ * value as its (unsigned) offset from the reference, bit-packed at a fixed width: the number
+ * of bits needed to represent the largest offset. Because every value has the same width and
+ * does not depend on the previous one, decompressing is a branch-free loop the compiler can
+ * vectorize.
+ *
+ * NULLs are stored the same way as in deltadelta, as a simple8b_rle bitmap following the
+ * packed values.
+ */
+#ifndef TIMESCALEDB_TSL_COMPRESSION_FOR_H
+#define TIMESCALEDB_TSL_COMPRESSION_FOR_H
+
+#include <postgres.h>
+#include <c.h>
+#include <fmgr.h>
+#include <lib/stringinfo.h>
+
+#include "compression/compression.h"
+#include "compression/simple8b_rle.h"
+
+typedef struct ForCompressor ForCompressor;
+typedef struct ForCompressed ForCompressed;
+typedef struct ForDecompressionIterator ForDecompressionIterator;
+
+extern Compressor *for_compressor_for_type(Oid element_type);
+extern ForCompressor *for_compressor_alloc(void);
+extern void for_compressor_append_null(ForCompressor *compressor);
+extern void for_compressor_append_value(ForCompressor *compressor, int64 next_val);
+extern void *for_compressor_finish(ForCompressor *compressor);
+
+extern uint8 for_bit_width(int64 min_val, int64 max_val);
+extern Size for_compressed_size(uint32 num_values, uint8 bit_width,
+								const Simple8bRleSerialized *nulls);
+extern ForCompressed *for_compressed_from_values(const uint64 *values, uint32 num_values,
+												 int64 min_val, int64 max_val,
+												 Simple8bRleSerialized *nulls);
+
+extern uint32 for_compressed_num_values(const ForCompressed *compressed);
+extern void for_unpack_values(const ForCompressed *compressed, uint64 *values);
+
+extern DecompressionIterator *for_decompression_iterator_from_datum_forward(Datum for_compressed,
+																			Oid element_type);
+extern DecompressionIterator *for_decompression_iterator_from_datum_reverse(Datum for_compressed,
+																			Oid element_type);
+extern DecompressResult for_decompression_iterator_try_next_forward(DecompressionIterator *iter);
+extern DecompressResult for_decompression_iterator_try_next_reverse(DecompressionIterator *iter);
+extern DecompressedBatch *for_decompress_all(Datum for_compressed, Oid element_type);
+
+extern void for_compressed_send(CompressedDataHeader *header, StringInfo buffer);
+extern Datum for_compressed_recv(StringInfo buf);
+
+#define FOR_ALGORITHM_DEFINITION                                                                   \
+	{                                                                                              \
+		.iterator_init_forward = for_decompression_iterator_from_datum_forward,                    \
+		.iterator_init_reverse = for_decompression_iterator_from_datum_reverse,                    \
+		.decompress_all = for_decompress_all,                                                      \
+		.compressed_data_send = for_compressed_send,                                               \
+		.compressed_data_recv = for_compressed_recv,                                               \
+		.compressor_for_type = for_compressor_for_type,                                            \
+		.compressed_data_storage = TOAST_STORAGE_EXTERNAL,                                         \
+	}
+
+#endif
@@ -19,9 +19,11 @@
 #endif
 
 #include "compression/gorilla.h"
+#include "compression/alp.h"
 #include "utils.h"
 #include "adts/bit_array.h"
 #include "compression/compression.h"
+#include "compression/detoast_reader.h"
 #include "compression/simple8b_rle.h"
 
 /*
@@ -99,6 +101,13 @@ typedef struct ExtendedCompressor
 {
 	Compressor base;
 	GorillaCompressor *internal;
+	/*
+	 * For floating point columns we also feed the values to an ALP compressor
+	 * and keep whichever encoding of the batch is smaller. InvalidOid for
+	 * integer columns.
+	 */
+	Oid alp_element_type;
+	AlpCompressor *alp;
 } ExtendedCompressor;
 
 typedef struct GorillaDecompressionIterator
@@ -205,6 +214,18 @@ pg_rightmost_one_pos64(uint64 word)
  ***  Compressor  ***
  ********************/
 
+static AlpCompressor *
+gorilla_alp_compressor(ExtendedCompressor *extended)
+{
+	if (!OidIsValid(extended->alp_element_type))
+		return NULL;
+
+	if (extended->alp == NULL)
+		extended->alp = alp_compressor_alloc(extended->alp_element_type);
+
+	return extended->alp;
+}
+
 static void
 gorilla_compressor_append_float(Compressor *compressor, Datum val)
 {
@@ -214,6 +235,7 @@ gorilla_compressor_append_float(Compressor *compressor, Datum val)
 		extended->internal = gorilla_compressor_alloc();
 
 	gorilla_compressor_append_value(extended->internal, value);
+	alp_compressor_append_value(gorilla_alp_compressor(extended), DatumGetFloat4(val));
 }
 
 static void
@@ -225,6 +247,7 @@ gorilla_compressor_append_double(Compressor *compressor, Datum val)
 		extended->internal = gorilla_compressor_alloc();
 
 	gorilla_compressor_append_value(extended->internal, value);
+	alp_compressor_append_value(gorilla_alp_compressor(extended), DatumGetFloat8(val));
 }
 
 static void
@@ -261,10 +284,13 @@ static void
 gorilla_compressor_append_null_value(Compressor *compressor)
 {
 	ExtendedCompressor *extended = (ExtendedCompressor *) compressor;
+	AlpCompressor *alp = gorilla_alp_compressor(extended);
 	if (extended->internal == NULL)
 		extended->internal = gorilla_compressor_alloc();
 
 	gorilla_compressor_append_null(extended->internal);
+	if (alp != NULL)
+		alp_compressor_append_null(alp);
 }
 
 static void *
@@ -274,6 +300,24 @@ gorilla_compressor_finish_and_reset(Compressor *compressor)
 	void *compressed = gorilla_compressor_finish(extended->internal);
 	pfree(extended->internal);
 	extended->internal = NULL;
+
+	if (extended->alp != NULL)
+	{
+		void *alp_compressed = compressed != NULL ? alp_compressor_finish(extended->alp) : NULL;
+
+		alp_compressor_free(extended->alp);
+		extended->alp = NULL;
+
+		/* ALP is much cheaper to decompress, so we prefer it on a tie */
+		if (alp_compressed != NULL && VARSIZE(alp_compressed) <= VARSIZE(compressed))
+		{
+			pfree(compressed);
+			compressed = alp_compressed;
+		}
+		else if (alp_compressed != NULL)
+			pfree(alp_compressed);
+	}
+
 	return compressed;
 }
 
@@ -311,10 +355,12 @@ gorilla_compressor_for_type(Oid element_type)
 	switch (element_type)
 	{
 		case FLOAT4OID:
-			*compressor = (ExtendedCompressor){ .base = gorilla_float_compressor };
+			*compressor = (ExtendedCompressor){ .base = gorilla_float_compressor,
+												.alp_element_type = FLOAT4OID };
 			return &compressor->base;
 		case FLOAT8OID:
-			*compressor = (ExtendedCompressor){ .base = gorilla_double_compressor };
+			*compressor = (ExtendedCompressor){ .base = gorilla_double_compressor,
+												.alp_element_type = FLOAT8OID };
 			return &compressor->base;
 		case INT2OID:
 			*compressor = (ExtendedCompressor){ .base = gorilla_uint16_compressor };
@@ -866,6 +912,176 @@ gorilla_decompression_iterator_try_next_reverse(DecompressionIterator *iter_base
 								 iter_base->element_type);
 }
 
+/****************************
+ ***  Bulk decompression  ***
+ ****************************/
+
+static void
+convert_all_from_internal(const uint64 *internal, Datum *values, uint32 num_values,
+						  Oid element_type)
+{
+	uint32 i;
+
+	switch (element_type)
+	{
+		case FLOAT8OID:
+			for (i = 0; i < num_values; i++)
+				values[i] = Float8GetDatum(bits_get_double(internal[i]));
+			break;
+		case FLOAT4OID:
+			for (i = 0; i < num_values; i++)
+				values[i] = Float4GetDatum(bits_get_float(internal[i]));
+			break;
+		case INT8OID:
+			for (i = 0; i < num_values; i++)
+				values[i] = Int64GetDatum(internal[i]);
+			break;
+		case INT4OID:
+			for (i = 0; i < num_values; i++)
+				values[i] = Int32GetDatum(internal[i]);
+			break;
+		case INT2OID:
+			for (i = 0; i < num_values; i++)
+				values[i] = Int16GetDatum(internal[i]);
+			break;
+		default:
+			elog(ERROR, "invalid type requested from gorilla decompression");
+	}
+}
+
+/*
+ * The sections are read and decoded one after the other, so a large value that
+ * is still toasted is never fetched as a whole. The leading zeros are decoded
+ * before the main loop, so that the xors are the only bit array it reads from.
+ */
+DecompressedBatch *
+gorilla_decompress_all(Datum gorilla_compressed, Oid element_type)
+{
+	DetoastReader reader;
+	GorillaCompressed header;
+	Size offset = sizeof(GorillaCompressed);
+	Simple8bRleSerialized *serialized;
+	DecompressedBatch *batch;
+	BitArray bit_array;
+	BitArrayIterator xors;
+	uint64 *tag0s;
+	uint64 *tag1s;
+	uint64 *num_bits_used;
+	uint64 *decompressed;
+	uint64 *is_null = NULL;
+	uint8 *leading_zeros;
+	uint32 num_leading_zeros = 0;
+	uint32 num_values;
+	uint32 num_tag1s;
+	uint32 num_num_bits_used;
+	uint32 num_rows;
+	uint32 tag1_pos = 0;
+	uint32 num_bits_used_pos = 0;
+	uint64 prev_val = 0;
+	uint8 prev_leading_zeroes = 0;
+	uint8 prev_xor_bits_used = 0;
+	uint32 i;
+
+	detoast_reader_init(&reader, gorilla_compressed);
+	header = *(const GorillaCompressed *) detoast_reader_read(&reader, 0, sizeof(header));
+	if (header.compression_algorithm != COMPRESSION_ALGORITHM_GORILLA)
+		elog(ERROR, "unknown compression algorithm");
+
+	serialized = detoast_reader_read_simple8b(&reader, &offset);
+	num_values = serialized->num_elements;
+	tag0s = simple8brle_decompress_all(serialized);
+
+	serialized = detoast_reader_read_simple8b(&reader, &offset);
+	num_tag1s = serialized->num_elements;
+	tag1s = simple8brle_decompress_all(serialized);
+
+	bytes_attach_bit_array_and_advance(&bit_array,
+									   detoast_reader_read(&reader,
+														   offset,
+														   sizeof(uint64) *
+															   header.num_leading_zeroes_buckets),
+									   header.num_leading_zeroes_buckets,
+									   header.bits_used_in_last_leading_zeros_bucket);
+	offset += sizeof(uint64) * header.num_leading_zeroes_buckets;
+	if (header.num_leading_zeroes_buckets > 0)
+		num_leading_zeros = bit_array_num_bits(&bit_array) / BITS_PER_LEADING_ZEROS;
+	leading_zeros = palloc(sizeof(uint8) * Max(num_leading_zeros, 1));
+	{
+		BitArrayIterator iter;
+
+		bit_array_iterator_init(&iter, &bit_array);
+		for (i = 0; i < num_leading_zeros; i++)
+			leading_zeros[i] = bit_array_iter_next(&iter, BITS_PER_LEADING_ZEROS);
+	}
+
+	serialized = detoast_reader_read_simple8b(&reader, &offset);
+	num_num_bits_used = serialized->num_elements;
+	num_bits_used = simple8brle_decompress_all(serialized);
+
+	bytes_attach_bit_array_and_advance(&bit_array,
+									   detoast_reader_read(&reader,
+														   offset,
+														   sizeof(uint64) * header.num_xor_buckets),
+									   header.num_xor_buckets,
+									   header.bits_used_in_last_xor_bucket);
+	offset += sizeof(uint64) * header.num_xor_buckets;
+	bit_array_iterator_init(&xors, &bit_array);
+
+	/* we reuse the tag0s array for the decompressed values */
+	decompressed = tag0s;
+	for (i = 0; i < num_values; i++)
+	{
+		uint64 xor ;
+
+		if (tag0s[i] == 0)
+		{
+			decompressed[i] = prev_val;
+			continue;
+		}
+
+		Assert(tag1_pos < num_tag1s);
+		if (tag1s[tag1_pos++] != 0)
+		{
+			/* get new xor sizes */
+			Assert(num_bits_used_pos < num_num_bits_used);
+			if (num_bits_used_pos >= num_leading_zeros)
+				elog(ERROR, "the compressed data is corrupt: missing leading zeros");
+			prev_leading_zeroes = leading_zeros[num_bits_used_pos];
+			prev_xor_bits_used = num_bits_used[num_bits_used_pos++];
+		}
+
+		xor = bit_array_iter_next(&xors, prev_xor_bits_used);
+		if (prev_leading_zeroes + prev_xor_bits_used < 64)
+			xor <<= 64 - (prev_leading_zeroes + prev_xor_bits_used);
+		prev_val ^= xor;
+		decompressed[i] = prev_val;
+	}
+	pfree(tag1s);
+	pfree(num_bits_used);
+	pfree(leading_zeros);
+
+	num_rows = num_values;
+	if (header.has_nulls)
+	{
+		serialized = detoast_reader_read_simple8b(&reader, &offset);
+		num_rows = serialized->num_elements;
+		is_null = simple8brle_decompress_all(serialized);
+	}
+	detoast_reader_free(&reader);
+
+	batch = decompressed_batch_alloc(element_type, num_rows);
+	convert_all_from_internal(decompressed, batch->values, num_values, element_type);
+	pfree(tag0s);
+
+	if (is_null != NULL)
+	{
+		decompressed_batch_spread_nulls(batch, is_null, num_values);
+		pfree(is_null);
+	}
+
+	return batch;
+}
+
 /*************
  ***  I/O  ***
  **************/
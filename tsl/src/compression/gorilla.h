@@ -12,6 +12,9 @@
  * and the series of xor values, getting the floats back is trivial. So, our goal becomes to
  * compress the series of xors.
  *
+ * When compressing float columns, the compressor also encodes each batch with ALP (see alp.h)
+ * and keeps that instead when it is smaller, which is the case for decimals of a fixed precision.
+ *
  * The logic for compressing xors is as follows:
  *
  * The compression depends on the observation that a lot of xors will be mostly 0s, and that the
@@ -88,6 +91,8 @@ gorilla_decompression_iterator_from_datum_reverse(Datum gorilla_compressed, Oid
 extern DecompressResult
 gorilla_decompression_iterator_try_next_reverse(DecompressionIterator *iter);
 
+extern DecompressedBatch *gorilla_decompress_all(Datum gorilla_compressed, Oid element_type);
+
 extern void gorilla_compressed_send(CompressedDataHeader *compressed, StringInfo buffer);
 extern Datum gorilla_compressed_recv(StringInfo buf);
 
@@ -98,6 +103,7 @@ extern Datum tsl_gorilla_compressor_finish(PG_FUNCTION_ARGS);
 	{                                                                                              \
 		.iterator_init_forward = gorilla_decompression_iterator_from_datum_forward,                \
 		.iterator_init_reverse = gorilla_decompression_iterator_from_datum_reverse,                \
+		.decompress_all = gorilla_decompress_all,                                                  \
 		.compressed_data_send = gorilla_compressed_send,                                           \
 		.compressed_data_recv = gorilla_compressed_recv,                                           \
 		.compressor_for_type = gorilla_compressor_for_type,                                        \
@@ -9,6 +9,7 @@
 #include <utils/typcache.h>
 #include <utils/builtins.h>
 #include <utils/datum.h>
+#include <utils/lsyscache.h>
 #include <libpq/pqformat.h>
 
 #include "segment_meta.h"
@@ -144,3 +145,218 @@ segment_meta_min_max_builder_empty(SegmentMetaMinMaxBuilder *builder)
 {
 	return builder->empty;
 }
+
+/*
+ * Bloom filter over the values of a column in a compressed batch. It lets us
+ * skip decompressing batches for equality conditions on columns that are
+ * neither segmentby nor orderby, where the min/max metadata is of little use.
+ *
+ * The filter is stored as a bytea of 2^n bits, sized for about 10 bits per
+ * distinct value which gives a false positive rate of about 1% with the
+ * BLOOM1_HASHES probes. The probes are derived from the 32-bit hash of the
+ * type's default hash opclass using double hashing, so the filter can be
+ * checked without knowing anything about the number of values it was built
+ * from.
+ */
+#define BLOOM1_HASHES 6
+#define BLOOM1_BITS_PER_VALUE 10
+#define BLOOM1_MIN_BITS 64
+
+typedef struct SegmentMetaBloomBuilder
+{
+	FmgrInfo hash_proc;
+	Oid collation;
+	uint32 *hashes;
+	int num_hashes;
+	int max_hashes;
+} SegmentMetaBloomBuilder;
+
+static inline uint32
+bloom1_second_hash(uint32 h)
+{
+	/* murmur3 finalizer, the second hash has to be odd to visit all bits */
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h | 1;
+}
+
+static inline uint32
+bloom1_bit(uint32 h1, uint32 h2, int i, uint32 mask)
+{
+	return (h1 + i * h2) & mask;
+}
+
+SegmentMetaBloomBuilder *
+segment_meta_bloom_builder_create(Oid type_oid, Oid collation)
+{
+	SegmentMetaBloomBuilder *builder = palloc(sizeof(*builder));
+	TypeCacheEntry *type = lookup_type_cache(type_oid, TYPECACHE_HASH_PROC_FINFO);
+
+	if (!OidIsValid(type->hash_proc))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_FUNCTION),
+				 errmsg("could not identify a hash function for type %s",
+						format_type_be(type_oid))));
+
+	*builder = (SegmentMetaBloomBuilder){
+		.collation = collation,
+		.num_hashes = 0,
+		.max_hashes = 1024,
+	};
+	fmgr_info_copy(&builder->hash_proc, &type->hash_proc_finfo, CurrentMemoryContext);
+	builder->hashes = palloc(sizeof(uint32) * builder->max_hashes);
+
+	return builder;
+}
+
+void
+segment_meta_bloom_builder_update_val(SegmentMetaBloomBuilder *builder, Datum val)
+{
+	if (builder->num_hashes >= builder->max_hashes)
+	{
+		builder->max_hashes *= 2;
+		builder->hashes = repalloc(builder->hashes, sizeof(uint32) * builder->max_hashes);
+	}
+
+	builder->hashes[builder->num_hashes++] =
+		DatumGetUInt32(FunctionCall1Coll(&builder->hash_proc, builder->collation, val));
+}
+
+void
+segment_meta_bloom_builder_update_null(SegmentMetaBloomBuilder *builder)
+{
+	/* NULLs never match an equality condition, so they are not recorded */
+}
+
+static int
+uint32_cmp(const void *a, const void *b)
+{
+	uint32 ua = *(const uint32 *) a;
+	uint32 ub = *(const uint32 *) b;
+
+	return ua < ub ? -1 : (ua > ub ? 1 : 0);
+}
+
+Datum
+segment_meta_bloom_builder_finish(SegmentMetaBloomBuilder *builder)
+{
+	int num_distinct = 0;
+	uint32 nbits = BLOOM1_MIN_BITS;
+	uint32 mask;
+	bytea *bloom;
+	uint8 *bits;
+	int i;
+
+	if (builder->num_hashes == 0)
+		elog(ERROR, "trying to get bloom filter from an empty builder");
+
+	/* size the filter by the number of distinct hashes */
+	qsort(builder->hashes, builder->num_hashes, sizeof(uint32), uint32_cmp);
+	for (i = 0; i < builder->num_hashes; i++)
+	{
+		if (i == 0 || builder->hashes[i] != builder->hashes[num_distinct - 1])
+			builder->hashes[num_distinct++] = builder->hashes[i];
+	}
+
+	while (nbits < (uint32) num_distinct * BLOOM1_BITS_PER_VALUE)
+		nbits *= 2;
+	mask = nbits - 1;
+
+	bloom = palloc0(VARHDRSZ + nbits / 8);
+	SET_VARSIZE(bloom, VARHDRSZ + nbits / 8);
+	bits = (uint8 *) VARDATA(bloom);
+
+	for (i = 0; i < num_distinct; i++)
+	{
+		uint32 h1 = builder->hashes[i];
+		uint32 h2 = bloom1_second_hash(h1);
+		int j;
+
+		for (j = 0; j < BLOOM1_HASHES; j++)
+		{
+			uint32 bit = bloom1_bit(h1, h2, j, mask);
+
+			bits[bit / 8] |= 1 << (bit % 8);
+		}
+	}
+
+	return PointerGetDatum(bloom);
+}
+
+bool
+segment_meta_bloom_builder_empty(SegmentMetaBloomBuilder *builder)
+{
+	return builder->num_hashes == 0;
+}
+
+void
+segment_meta_bloom_builder_reset(SegmentMetaBloomBuilder *builder)
+{
+	builder->num_hashes = 0;
+}
+
+/*
+ * bloom1_contains(bloom bytea, value anyelement) returns false if the value
+ * is definitely not in the batch the filter was built for. It is used as a
+ * pushed down filter on the compressed chunk, the original condition is still
+ * rechecked on the decompressed rows.
+ */
+Datum
+tsl_bloom1_contains(PG_FUNCTION_ARGS)
+{
+	FmgrInfo *hash_proc = fcinfo->flinfo->fn_extra;
+	bytea *bloom;
+	uint8 *bits;
+	uint32 nbits;
+	uint32 mask;
+	uint32 h1;
+	uint32 h2;
+	int i;
+
+	/* a batch without a filter has no non-null values */
+	if (PG_ARGISNULL(0))
+		PG_RETURN_BOOL(false);
+
+	if (PG_ARGISNULL(1))
+		PG_RETURN_NULL();
+
+	if (hash_proc == NULL)
+	{
+		Oid type_oid = get_fn_expr_argtype(fcinfo->flinfo, 1);
+		TypeCacheEntry *type = lookup_type_cache(type_oid, TYPECACHE_HASH_PROC_FINFO);
+
+		if (!OidIsValid(type->hash_proc))
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_FUNCTION),
+					 errmsg("could not identify a hash function for type %s",
+							format_type_be(type_oid))));
+
+		hash_proc = MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, sizeof(FmgrInfo));
+		fmgr_info_copy(hash_proc, &type->hash_proc_finfo, fcinfo->flinfo->fn_mcxt);
+		fcinfo->flinfo->fn_extra = hash_proc;
+	}
+
+	bloom = PG_GETARG_BYTEA_PP(0);
+	bits = (uint8 *) VARDATA_ANY(bloom);
+	nbits = VARSIZE_ANY_EXHDR(bloom) * 8;
+
+	if (nbits < BLOOM1_MIN_BITS || (nbits & (nbits - 1)) != 0)
+		elog(ERROR, "invalid bloom filter of %u bits", nbits);
+
+	mask = nbits - 1;
+	h1 = DatumGetUInt32(FunctionCall1Coll(hash_proc, PG_GET_COLLATION(), PG_GETARG_DATUM(1)));
+	h2 = bloom1_second_hash(h1);
+
+	for (i = 0; i < BLOOM1_HASHES; i++)
+	{
+		uint32 bit = bloom1_bit(h1, h2, i, mask);
+
+		if ((bits[bit / 8] & (1 << (bit % 8))) == 0)
+			PG_RETURN_BOOL(false);
+	}
+
+	PG_RETURN_BOOL(true);
+}
@@ -21,4 +21,17 @@ Datum segment_meta_min_max_builder_max(SegmentMetaMinMaxBuilder *builder);
 bool segment_meta_min_max_builder_empty(SegmentMetaMinMaxBuilder *builder);
 
 void segment_meta_min_max_builder_reset(SegmentMetaMinMaxBuilder *builder);
+
+typedef struct SegmentMetaBloomBuilder SegmentMetaBloomBuilder;
+
+SegmentMetaBloomBuilder *segment_meta_bloom_builder_create(Oid type, Oid collation);
+void segment_meta_bloom_builder_update_val(SegmentMetaBloomBuilder *builder, Datum val);
+void segment_meta_bloom_builder_update_null(SegmentMetaBloomBuilder *builder);
+
+Datum segment_meta_bloom_builder_finish(SegmentMetaBloomBuilder *builder);
+bool segment_meta_bloom_builder_empty(SegmentMetaBloomBuilder *builder);
+
+void segment_meta_bloom_builder_reset(SegmentMetaBloomBuilder *builder);
+
+extern Datum tsl_bloom1_contains(PG_FUNCTION_ARGS);
 #endif
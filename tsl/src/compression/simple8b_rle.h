@@ -148,6 +148,7 @@ static inline Simple8bRleDecompressResult
 simple8brle_decompression_iterator_try_next_forward(Simple8bRleDecompressionIterator *iter);
 static inline Simple8bRleDecompressResult
 simple8brle_decompression_iterator_try_next_reverse(Simple8bRleDecompressionIterator *iter);
+static inline uint64 *simple8brle_decompress_all(Simple8bRleSerialized *compressed);
 
 static inline void simple8brle_serialized_send(StringInfo buffer,
 											   const Simple8bRleSerialized *data);
@@ -186,6 +187,8 @@ static inline Simple8bRleBlock simple8brle_block_create_rle(uint32 rle_count, ui
 static inline Simple8bRleBlock simple8brle_block_create(uint8 selector, uint64 data);
 static inline uint64 simple8brle_block_get_element(Simple8bRleBlock block,
 												   uint32 position_in_value);
+static inline uint32 simple8brle_block_unpack_all(uint64 *dest, uint8 selector, uint64 data,
+												  uint32 max_rle_elements);
 static inline void simple8brle_block_append_element(Simple8bRleBlock *block, uint64 val);
 static inline uint32 simple8brle_block_append_rle(Simple8bRleBlock *compressed_block,
 												  const uint64 *data, uint32 data_len);
@@ -674,6 +677,148 @@ simple8brle_decompression_iterator_try_next_reverse(Simple8bRleDecompressionIter
 	};
 }
 
+/****************************
+ ***  Bulk Decompression  ***
+ ****************************/
+
+/*
+ * Unpack all the elements of a bit-packed block. This is always inlined with
+ * constant arguments (see simple8brle_block_unpack_all below), so every
+ * selector gets its own loop with a fixed trip count, shift and mask that the
+ * compiler can fully unroll and vectorize, instead of recomputing the shift and
+ * mask per element as simple8brle_block_get_element() does.
+ */
+static pg_attribute_always_inline void
+simple8brle_block_unpack(uint64 *dest, uint64 data, uint32 num_elements, uint32 bits_per_val)
+{
+	const uint64 mask = bits_per_val < 64 ? (1ULL << bits_per_val) - 1 : PG_UINT64_MAX;
+	uint32 i;
+
+	for (i = 0; i < num_elements; i++)
+		dest[i] = (data >> (bits_per_val * i)) & mask;
+}
+
+/*
+ * Decompress a whole block into dest, returning the number of elements stored
+ * in the block. Bit-packed blocks are always unpacked completely, so dest must
+ * have room for SIMPLE8B_MAX_VALUES_PER_SLOT elements even if fewer are used;
+ * RLE runs are expanded up to max_rle_elements.
+ */
+static inline uint32
+simple8brle_block_unpack_all(uint64 *dest, uint8 selector, uint64 data, uint32 max_rle_elements)
+{
+	switch (selector)
+	{
+		case 1:
+			simple8brle_block_unpack(dest, data, 64, 1);
+			return 64;
+		case 2:
+			simple8brle_block_unpack(dest, data, 32, 2);
+			return 32;
+		case 3:
+			simple8brle_block_unpack(dest, data, 21, 3);
+			return 21;
+		case 4:
+			simple8brle_block_unpack(dest, data, 16, 4);
+			return 16;
+		case 5:
+			simple8brle_block_unpack(dest, data, 12, 5);
+			return 12;
+		case 6:
+			simple8brle_block_unpack(dest, data, 10, 6);
+			return 10;
+		case 7:
+			simple8brle_block_unpack(dest, data, 9, 7);
+			return 9;
+		case 8:
+			simple8brle_block_unpack(dest, data, 8, 8);
+			return 8;
+		case 9:
+			simple8brle_block_unpack(dest, data, 6, 10);
+			return 6;
+		case 10:
+			simple8brle_block_unpack(dest, data, 5, 12);
+			return 5;
+		case 11:
+			simple8brle_block_unpack(dest, data, 4, 16);
+			return 4;
+		case 12:
+			simple8brle_block_unpack(dest, data, 3, 21);
+			return 3;
+		case 13:
+			simple8brle_block_unpack(dest, data, 2, 32);
+			return 2;
+		case 14:
+			simple8brle_block_unpack(dest, data, 1, 64);
+			return 1;
+		case SIMPLE8B_RLE_SELECTOR:
+		{
+			uint64 repeated_value = simple8brle_rledata_value(data);
+			uint32 repeat_count = simple8brle_rledata_repeatcount(data);
+			uint32 num_to_fill = Min(repeat_count, max_rle_elements);
+			uint32 i;
+
+			for (i = 0; i < num_to_fill; i++)
+				dest[i] = repeated_value;
+			return repeat_count;
+		}
+		default:
+			elog(ERROR, "invalid selector %d", selector);
+	}
+
+	pg_unreachable();
+}
+
+/*
+ * Decompress all the elements at once into a newly palloc'd array of
+ * compressed->num_elements values. Rather than going through the iterator's
+ * per-element bookkeeping, this reads the selectors straight from the
+ * selector slots and unpacks a whole block at a time.
+ */
+static uint64 *
+simple8brle_decompress_all(Simple8bRleSerialized *compressed)
+{
+	uint32 num_selector_slots =
+		simple8brle_num_selector_slots_for_num_blocks(compressed->num_blocks);
+	const uint64 *compressed_data = compressed->slots + num_selector_slots;
+	uint32 num_elements = compressed->num_elements;
+	uint32 num_decompressed = 0;
+	/* the last bit-packed block is unpacked completely, including its padding */
+	uint64 *decompressed = palloc(sizeof(uint64) * (num_elements + SIMPLE8B_MAX_VALUES_PER_SLOT));
+	uint32 block_index;
+
+	StaticAssertStmt(SIMPLE8B_BITS_PER_SELECTOR * SIMPLE8B_SELECTORS_PER_SELECTOR_SLOT ==
+						 SIMPLE8B_BITSIZE,
+					 "selectors must not straddle selector slots");
+
+	for (block_index = 0; block_index < compressed->num_blocks; block_index++)
+	{
+		const uint64 selector_slot =
+			compressed->slots[block_index / SIMPLE8B_SELECTORS_PER_SELECTOR_SLOT];
+		const uint32 selector_shift =
+			(block_index % SIMPLE8B_SELECTORS_PER_SELECTOR_SLOT) * SIMPLE8B_BITS_PER_SELECTOR;
+		const uint8 selector =
+			(selector_slot >> selector_shift) & ((1 << SIMPLE8B_BITS_PER_SELECTOR) - 1);
+		uint32 num_in_block;
+
+		if (num_decompressed >= num_elements)
+			elog(ERROR, "the number of elements in simple8brle does not match its blocks");
+
+		num_in_block = simple8brle_block_unpack_all(decompressed + num_decompressed,
+													selector,
+													compressed_data[block_index],
+													num_elements - num_decompressed);
+
+		/* the last block may be padded */
+		num_decompressed += Min(num_in_block, num_elements - num_decompressed);
+	}
+
+	if (num_decompressed != num_elements)
+		elog(ERROR, "the number of elements in simple8brle does not match its blocks");
+
+	return decompressed;
+}
+
 /********************************************
  ***  Simple8bRlePartiallyCompressedData  ***
  ********************************************/
@@ -14,6 +14,7 @@
 #include "bgw_policy/reorder_api.h"
 #include "chunk_api.h"
 #include "chunk.h"
+#include "compression/advisor.h"
 #include "compression/array.h"
 #include "compression/compression.h"
 #include "compression/compress_utils.h"
@@ -38,6 +39,7 @@
 #include "nodes/decompress_chunk/planner.h"
 #include "nodes/skip_scan/skip_scan.h"
 #include "nodes/gapfill/gapfill.h"
+#include "nodes/vector_agg/vector_agg.h"
 #include "partialize_finalize.h"
 #include "planner.h"
 #include "process_utility.h"
@@ -141,11 +143,14 @@ CrossModuleFunctions tsl_cm_functions = {
 	.dictionary_compressor_finish = tsl_dictionary_compressor_finish,
 	.array_compressor_append = tsl_array_compressor_append,
 	.array_compressor_finish = tsl_array_compressor_finish,
+	.bloom1_contains = tsl_bloom1_contains,
 	.process_compress_table = tsl_process_compress_table,
 	.process_altertable_cmd = tsl_process_altertable_cmd,
 	.process_rename_cmd = tsl_process_rename_cmd,
 	.compress_chunk = tsl_compress_chunk,
 	.decompress_chunk = tsl_decompress_chunk,
+	.recompress_chunk = tsl_recompress_chunk,
+	.compression_advisor = tsl_compression_advisor,
 	.data_node_add = data_node_add,
 	.data_node_delete = data_node_delete,
 	.data_node_attach = data_node_attach,
@@ -202,6 +207,7 @@ ts_module_init(PG_FUNCTION_ARGS)
 	_continuous_aggs_cache_inval_init();
 	_decompress_chunk_init();
 	_skip_scan_init();
+	_vector_agg_init();
 	_remote_connection_cache_init();
 	_remote_dist_txn_init();
 	_tsl_process_utility_init();
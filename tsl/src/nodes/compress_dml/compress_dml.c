@@ -5,23 +5,44 @@
  */
 
 #include <postgres.h>
+#include <access/xact.h>
+#include <executor/executor.h>
 #include <nodes/extensible.h>
+#include <nodes/nodeFuncs.h>
 #include <optimizer/pathnode.h>
 #include <optimizer/paths.h>
+#include <optimizer/restrictinfo.h>
+#include <utils/lsyscache.h>
+#include <utils/snapmgr.h>
 
 #include "compat.h"
 #include "chunk.h"
+#include "compression_chunk_size.h"
+#include "guc.h"
 #include "hypertable.h"
 #include "hypertable_compression.h"
 #include "compress_dml.h"
+#include "compression/compression.h"
+#include "nodes/decompress_chunk/qual_pushdown.h"
 #include "utils.h"
 
 /*Path, Plan and State node for processing dml on compressed chunks
- * For now, this just blocks updates/deletes on compressed chunks
- * since trigger based approach does not work
+ * Updates/deletes are executed by decompressing the batches that can contain
+ * affected rows into the uncompressed chunk before the chunk is scanned. The
+ * batches are selected with the quals on segmentby columns and segment
+ * metadata. The decompressed rows stay in the uncompressed chunk, which is
+ * marked as partially compressed, until the chunk is recompressed.
+ *
+ * When timescaledb.enable_compressed_dml is off, or the statement might scan
+ * the hypertable elsewhere, this just blocks updates/deletes on compressed
+ * chunks since trigger based approach does not work
  */
 
-static Path *compress_chunk_dml_path_create(Path *subpath, Oid chunk_relid);
+/* varno of the compressed chunk in the batch filter */
+#define COMPRESSED_VARNO 1
+
+static Path *compress_chunk_dml_path_create(Path *subpath, Oid chunk_relid, Oid compressed_relid,
+											List *filters);
 static Plan *compress_chunk_dml_plan_create(PlannerInfo *root, RelOptInfo *relopt,
 											CustomPath *best_path, List *tlist, List *clauses,
 											List *custom_plans);
@@ -50,31 +71,125 @@ static CustomExecMethods compress_chunk_dml_state_methods = {
 	.ReScanCustomScan = compress_chunk_dml_rescan,
 };
 
+static void
+compress_chunk_dml_decompress_batches(CompressChunkDmlState *state, EState *estate)
+{
+	ResultRelInfo *result_rel_info = estate->es_result_relation_info;
+	ExprState *filter;
+	ExprContext *econtext;
+	CompressionStats cstat;
+	Chunk *chunk;
+
+	/* the chunk is scanned as part of the statement but is not the target of
+	 * the modification, e.g., in a self-join */
+	if (result_rel_info == NULL ||
+		RelationGetRelid(result_rel_info->ri_RelationDesc) != state->chunk_relid)
+		elog(ERROR,
+			 "cannot update/delete rows from chunk \"%s\" as it is compressed",
+			 get_rel_name(state->chunk_relid));
+
+	/* DELETE does not open the indexes of the result relation */
+	if (result_rel_info->ri_RelationDesc->rd_rel->relhasindex &&
+		result_rel_info->ri_IndexRelationDescs == NULL)
+		ExecOpenIndices(result_rel_info, false);
+
+	filter = ExecInitQual(state->filters, &state->cscan_state.ss.ps);
+	econtext = CreateExprContext(estate);
+	cstat = decompress_batches_for_dml(state->compressed_relid, estate, filter, econtext);
+	FreeExprContext(econtext, true);
+
+	if (cstat.rowcnt_post_compression == 0)
+		return;
+
+	chunk = ts_chunk_get_by_relid(state->chunk_relid, true);
+	ts_compression_chunk_size_remove_rows(chunk->fd.id,
+										  cstat.rowcnt_pre_compression,
+										  cstat.rowcnt_post_compression);
+	ts_chunk_set_partial(chunk);
+
+	/*
+	 * Make the decompressed rows visible to the scan of the chunk. The scan
+	 * gets its own copy of the statement's snapshot with the new command id,
+	 * the snapshot shared by the rest of the statement is not changed.
+	 */
+	CommandCounterIncrement();
+	PushCopiedSnapshot(estate->es_snapshot);
+	UpdateActiveSnapshotCommandId();
+	state->snapshot = RegisterSnapshot(GetActiveSnapshot());
+	PopActiveSnapshot();
+
+	/* the rows are updated or deleted by a later command than their insert */
+	estate->es_output_cid = GetCurrentCommandId(true);
+}
+
+/*
+ * Make the scan of the chunk use the snapshot that sees the decompressed rows
+ * and return the snapshot to restore afterwards. Scans take the snapshot from
+ * the EState when they start, which can be on their first tuple, so the
+ * snapshot is swapped in for every call into the scan of the chunk.
+ */
+static Snapshot
+compress_chunk_dml_enter_scan(CompressChunkDmlState *state, EState *estate)
+{
+	Snapshot statement_snapshot = estate->es_snapshot;
+
+	if (state->snapshot != NULL)
+		estate->es_snapshot = state->snapshot;
+
+	return statement_snapshot;
+}
+
 static void
 compress_chunk_dml_begin(CustomScanState *node, EState *estate, int eflags)
 {
+	CompressChunkDmlState *state = (CompressChunkDmlState *) node;
 	CustomScan *cscan = castNode(CustomScan, node->ss.ps.plan);
 	Plan *subplan = linitial(cscan->custom_plans);
+	Snapshot statement_snapshot;
+
+	if (OidIsValid(state->compressed_relid) && !(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+		compress_chunk_dml_decompress_batches(state, estate);
+
+	statement_snapshot = compress_chunk_dml_enter_scan(state, estate);
 	node->custom_ps = list_make1(ExecInitNode(subplan, estate, eflags));
+	estate->es_snapshot = statement_snapshot;
 }
 
 /*
- * nothing to reset for rescan in dml blocker
+ * the batches are only decompressed once, so only the scan of the chunk is
+ * reset
  */
 static void
 compress_chunk_dml_rescan(CustomScanState *node)
 {
+	EState *estate = node->ss.ps.state;
+	Snapshot statement_snapshot =
+		compress_chunk_dml_enter_scan((CompressChunkDmlState *) node, estate);
+
+	ExecReScan(linitial(node->custom_ps));
+	estate->es_snapshot = statement_snapshot;
 }
 
-/* we cannot update/delete rows if we have a compressed chunk. so
- * throw an error. Note this subplan will return 0 tuples as the chunk is empty
- * and all rows are saved in the compressed chunk.
+/* if dml on compressed chunks is disabled we cannot update/delete rows if we
+ * have a compressed chunk. so throw an error. Otherwise the affected batches
+ * have been decompressed into the chunk and the subplan returns their rows.
  */
 static TupleTableSlot *
 compress_chunk_dml_exec(CustomScanState *node)
 {
 	CompressChunkDmlState *state = (CompressChunkDmlState *) node;
 	Oid chunk_relid = state->chunk_relid;
+
+	if (OidIsValid(state->compressed_relid))
+	{
+		EState *estate = node->ss.ps.state;
+		Snapshot statement_snapshot = compress_chunk_dml_enter_scan(state, estate);
+		TupleTableSlot *slot = ExecProcNode(linitial(node->custom_ps));
+
+		estate->es_snapshot = statement_snapshot;
+		return slot;
+	}
+
 	elog(ERROR,
 		 "cannot update/delete rows from chunk \"%s\" as it is compressed",
 		 get_rel_name(chunk_relid));
@@ -84,13 +199,17 @@ compress_chunk_dml_exec(CustomScanState *node)
 static void
 compress_chunk_dml_end(CustomScanState *node)
 {
-	// CompressChunkDmlState *state = (CompressChunkDmlState *) node;
+	CompressChunkDmlState *state = (CompressChunkDmlState *) node;
 	PlanState *substate = linitial(node->custom_ps);
 	ExecEndNode(substate);
+
+	if (state->snapshot != NULL)
+		UnregisterSnapshot(state->snapshot);
 }
 
 static Path *
-compress_chunk_dml_path_create(Path *subpath, Oid chunk_relid)
+compress_chunk_dml_path_create(Path *subpath, Oid chunk_relid, Oid compressed_relid,
+							   List *filters)
 {
 	CompressChunkDmlPath *path = (CompressChunkDmlPath *) palloc0(sizeof(CompressChunkDmlPath));
 
@@ -103,6 +222,8 @@ compress_chunk_dml_path_create(Path *subpath, Oid chunk_relid)
 	path->cpath.methods = &compress_chunk_dml_path_methods;
 	path->cpath.custom_paths = list_make1(subpath);
 	path->chunk_relid = chunk_relid;
+	path->compressed_relid = compressed_relid;
+	path->filters = filters;
 
 	return &path->cpath.path;
 }
@@ -121,7 +242,9 @@ compress_chunk_dml_plan_create(PlannerInfo *root, RelOptInfo *relopt, CustomPath
 	cscan->scan.scanrelid = relopt->relid;
 	cscan->scan.plan.targetlist = tlist;
 	cscan->custom_scan_tlist = NIL;
-	cscan->custom_private = list_make1_oid(cdpath->chunk_relid);
+	cscan->custom_private =
+		list_make2(list_make2_oid(cdpath->chunk_relid, cdpath->compressed_relid),
+				   cdpath->filters);
 	return &cscan->scan.plan;
 }
 
@@ -131,14 +254,97 @@ compress_chunk_dml_state_create(CustomScan *scan)
 	CompressChunkDmlState *state;
 
 	state = (CompressChunkDmlState *) newNode(sizeof(CompressChunkDmlState), T_CustomScanState);
-	state->chunk_relid = linitial_oid(scan->custom_private);
+	state->chunk_relid = linitial_oid(linitial(scan->custom_private));
+	state->compressed_relid = lsecond_oid(linitial(scan->custom_private));
+	state->filters = lsecond(scan->custom_private);
 	state->cscan_state.methods = &compress_chunk_dml_state_methods;
 	return (Node *) state;
 }
 
+static bool
+contains_exec_param_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param) && castNode(Param, node)->paramkind == PARAM_EXEC)
+		return true;
+	return expression_tree_walker(node, contains_exec_param_walker, context);
+}
+
+/*
+ * Decompressing batches modifies the chunk while the statement is started,
+ * so any other scan of the hypertable or the chunk in the statement would not
+ * see consistent data. Only allow it if the chunk is referenced as the target
+ * of the modification alone. Subqueries and subplans are not inspected, so
+ * statements that have any are rejected as well.
+ */
+static bool
+compress_chunk_dml_is_safe(PlannerInfo *root, Hypertable *ht, Chunk *chunk)
+{
+	ListCell *lc;
+	int ht_refs = 0;
+	int chunk_refs = 0;
+
+	if (root->glob->subplans != NIL)
+		return false;
+
+	foreach (lc, root->parse->rtable)
+	{
+		RangeTblEntry *rte = lfirst(lc);
+
+		if (rte->rtekind == RTE_SUBQUERY)
+			return false;
+		if (rte->rtekind != RTE_RELATION)
+			continue;
+		/* the inheritance expansion adds the parent as a child of itself */
+		if (rte->relid == ht->main_table_relid && rte->inh)
+			ht_refs++;
+		else if (rte->relid == chunk->table_id)
+			chunk_refs++;
+	}
+	return ht_refs <= 1 && chunk_refs <= 1;
+}
+
+/*
+ * Translate the restrictions on the chunk into a filter on the compressed
+ * chunk that selects the batches that can contain affected rows. Clauses that
+ * reference values only known during execution are not used.
+ */
+static List *
+compress_chunk_dml_batch_filters(RelOptInfo *rel, Hypertable *ht, Chunk *chunk,
+								 Oid compressed_relid)
+{
+	List *clauses = NIL;
+	ListCell *lc;
+
+	foreach (lc, extract_actual_clauses(rel->baserestrictinfo, false))
+	{
+		if (!contains_exec_param_walker(lfirst(lc), NULL))
+			clauses = lappend(clauses, lfirst(lc));
+	}
+
+	return pushdown_quals_to_compressed_chunk(clauses,
+											  rel->relid,
+											  chunk->table_id,
+											  COMPRESSED_VARNO,
+											  compressed_relid,
+											  ts_hypertable_compression_get(ht->fd.id));
+}
+
 Path *
-compress_chunk_dml_generate_paths(Path *subpath, Chunk *chunk)
+compress_chunk_dml_generate_paths(PlannerInfo *root, RelOptInfo *rel, Path *subpath, Chunk *chunk,
+								  Hypertable *ht)
 {
+	Oid compressed_relid = InvalidOid;
+	List *filters = NIL;
+
 	Assert(chunk->fd.compressed_chunk_id > 0);
-	return compress_chunk_dml_path_create(subpath, chunk->table_id);
+
+	if (ts_guc_enable_compressed_dml && compress_chunk_dml_is_safe(root, ht, chunk))
+	{
+		compressed_relid = ts_chunk_get_by_id(chunk->fd.compressed_chunk_id, true)->table_id;
+		filters = compress_chunk_dml_batch_filters(rel, ht, chunk, compressed_relid);
+	}
+
+	return compress_chunk_dml_path_create(subpath, chunk->table_id, compressed_relid, filters);
 }
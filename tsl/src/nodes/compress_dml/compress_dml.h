@@ -16,15 +16,24 @@ typedef struct CompressChunkDmlPath
 {
 	CustomPath cpath;
 	Oid chunk_relid;
+	/* InvalidOid if dml on the chunk is blocked */
+	Oid compressed_relid;
+	/* quals on the compressed chunk selecting the batches to decompress */
+	List *filters;
 } CompressChunkDmlPath;
 
 typedef struct CompressChunkDmlState
 {
 	CustomScanState cscan_state;
 	Oid chunk_relid;
+	Oid compressed_relid;
+	List *filters;
+	/* sees the decompressed batches, NULL if none were decompressed */
+	Snapshot snapshot;
 } CompressChunkDmlState;
 
-Path *compress_chunk_dml_generate_paths(Path *subpath, Chunk *chunk);
+Path *compress_chunk_dml_generate_paths(PlannerInfo *root, RelOptInfo *rel, Path *subpath,
+										Chunk *chunk, Hypertable *ht);
 
 #define COMPRESS_CHUNK_DML_STATE_NAME "CompressChunkDmlState"
 #endif
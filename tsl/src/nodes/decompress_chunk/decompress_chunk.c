@@ -5,6 +5,10 @@
  */
 
 #include <postgres.h>
+#include <math.h>
+#include <access/htup_details.h>
+#include <access/sysattr.h>
+#include <catalog/pg_attribute.h>
 #include <catalog/pg_operator.h>
 #include <miscadmin.h>
 #include <nodes/bitmapset.h>
@@ -13,9 +17,11 @@
 #include <optimizer/cost.h>
 #include <optimizer/pathnode.h>
 #include <optimizer/paths.h>
+#include <optimizer/planmain.h>
 #include <parser/parsetree.h>
 #include <utils/builtins.h>
 #include <utils/lsyscache.h>
+#include <utils/syscache.h>
 #include <utils/typcache.h>
 
 #include "compat.h"
@@ -29,14 +35,17 @@
 #endif
 
 #include "hypertable_compression.h"
+#include "compression_chunk_size.h"
 #include "import/planner.h"
 #include "compression/create.h"
+#include "guc.h"
 #include "nodes/decompress_chunk/decompress_chunk.h"
 #include "nodes/decompress_chunk/planner.h"
 #include "nodes/decompress_chunk/qual_pushdown.h"
 #include "utils.h"
 
 #define DECOMPRESS_CHUNK_CPU_TUPLE_COST 0.01
+/* rows per batch assumed for chunks without recorded row counts */
 #define DECOMPRESS_CHUNK_BATCH_SIZE 1000
 
 static CustomPathMethods decompress_chunk_path_methods = {
@@ -50,6 +59,9 @@ typedef struct SortInfo
 	bool needs_sequence_num;
 	bool can_pushdown_sort; /* sort can be pushed below DecompressChunk */
 	bool reverse;
+	bool use_batch_merge; /* batches of all segments can be merged on the pathkeys */
+	List *batch_merge_pathkeys;
+	Var *batch_bound_var;
 } SortInfo;
 
 static RangeTblEntry *decompress_chunk_make_rte(Oid compressed_relid, LOCKMODE lockmode);
@@ -65,6 +77,12 @@ static void decompress_chunk_add_plannerinfo(PlannerInfo *root, CompressionInfo
 											 RelOptInfo *chunk_rel, bool needs_sequence_num);
 
 static SortInfo build_sortinfo(RelOptInfo *chunk_rel, CompressionInfo *info, List *pathkeys);
+static void decompress_chunk_add_staging_paths(PlannerInfo *root, RelOptInfo *chunk_rel);
+static void decompress_chunk_add_batch_distribution_path(PlannerInfo *root,
+														 CompressionInfo *info);
+static bool decompress_chunk_needs_compressed_columns(CompressionInfo *info);
+static bool decompress_chunk_allow_index_only(Path *child_path, bool needs_compressed_columns);
+static Path *make_index_scan_path(PlannerInfo *root, Path *child_path);
 
 /*
  * Like ts_make_pathkey_from_sortop but passes down the compressed relid so that existing
@@ -268,6 +286,50 @@ build_compressed_scan_pathkeys(SortInfo *sort_info, PlannerInfo *root, List *chu
 	sort_info->compressed_pathkeys = compressed_pathkeys;
 }
 
+/*
+ * Order the compressed scan for batch merge by the min metadata of the first
+ * orderby column for ascending output or by the max metadata for descending
+ * output. No row of a batch sorts before this bound, so a batch only has to
+ * be opened once the merge reaches its bound.
+ */
+static void
+build_batch_merge_pathkeys(SortInfo *sort_info, PlannerInfo *root, List *chunk_pathkeys,
+						   CompressionInfo *info)
+{
+	PathKey *pk = linitial(chunk_pathkeys);
+	Var *var = (Var *) ts_find_em_expr_for_rel(pk->pk_eclass, info->chunk_rel);
+	char *column_name;
+	FormData_hypertable_compression *ci;
+	char *meta_name;
+	Oid sortop;
+
+	/* we validated the pathkeys in build_sortinfo */
+	Assert(var != NULL && IsA(var, Var));
+
+	column_name = get_attname(info->chunk_rte->relid, var->varattno, false);
+	ci = get_column_compressioninfo(info->hypertable_compression_info, column_name);
+	meta_name = pk->pk_strategy == BTLessStrategyNumber ?
+					compression_column_segment_min_name(ci) :
+					compression_column_segment_max_name(ci);
+
+	sort_info->batch_bound_var = makeVar(info->compressed_rel->relid,
+										 get_attnum(info->compressed_rte->relid, meta_name),
+										 var->vartype,
+										 var->vartypmod,
+										 var->varcollid,
+										 0);
+	if (!AttributeNumberIsValid(sort_info->batch_bound_var->varattno))
+		elog(ERROR, "could not find metadata column \"%s\"", meta_name);
+
+	sortop = get_opfamily_member(pk->pk_opfamily, var->vartype, var->vartype, pk->pk_strategy);
+	sort_info->batch_merge_pathkeys =
+		list_make1(make_pathkey_from_compressed(root,
+												info->compressed_rel->relid,
+												(Expr *) sort_info->batch_bound_var,
+												sortop,
+												pk->pk_nulls_first));
+}
+
 static DecompressChunkPath *
 copy_decompress_chunk_path(DecompressChunkPath *src)
 {
@@ -277,6 +339,13 @@ copy_decompress_chunk_path(DecompressChunkPath *src)
 	return dst;
 }
 
+bool
+ts_is_decompress_chunk_path(Path *path)
+{
+	return IsA(path, CustomPath) &&
+		   castNode(CustomPath, path)->methods == &decompress_chunk_path_methods;
+}
+
 static CompressionInfo *
 build_compressioninfo(PlannerInfo *root, Hypertable *ht, RelOptInfo *chunk_rel)
 {
@@ -310,6 +379,16 @@ build_compressioninfo(PlannerInfo *root, Hypertable *ht, RelOptInfo *chunk_rel)
 	return info;
 }
 
+/*
+ * add the cost of merging the open batches to a batch merge path, every row
+ * is compared against the current rows of the other open batches
+ */
+static void
+cost_batch_merge(Path *path, double num_batches)
+{
+	path->total_cost += path->rows * cpu_operator_cost * log2(Max(num_batches, 2.0));
+}
+
 /*
  * calculate cost for DecompressChunkPath
  *
@@ -317,7 +396,7 @@ build_compressioninfo(PlannerInfo *root, Hypertable *ht, RelOptInfo *chunk_rel)
  * we put cost of 1 tuple of compressed_scan as startup cost
  */
 static void
-cost_decompress_chunk(Path *path, Path *compressed_path)
+cost_decompress_chunk(Path *path, Path *compressed_path, double rows_per_batch)
 {
 	/* startup_cost is cost before fetching first tuple */
 	if (compressed_path->rows > 0)
@@ -325,7 +404,7 @@ cost_decompress_chunk(Path *path, Path *compressed_path)
 
 	/* total_cost is cost for fetching all tuples */
 	path->total_cost = compressed_path->total_cost + path->rows * DECOMPRESS_CHUNK_CPU_TUPLE_COST;
-	path->rows = compressed_path->rows * DECOMPRESS_CHUNK_BATCH_SIZE;
+	path->rows = compressed_path->rows * rows_per_batch;
 }
 
 void
@@ -336,6 +415,7 @@ ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *chunk_rel, Hyp
 	RelOptInfo *hypertable_rel;
 	ListCell *lc;
 	double new_row_estimate;
+	bool needs_compressed_columns;
 
 	CompressionInfo *info = build_compressioninfo(root, ht, chunk_rel);
 	Index ht_index;
@@ -343,7 +423,8 @@ ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *chunk_rel, Hyp
 	/*
 	 * since we rely on parallel coordination from the scan below
 	 * this node it is probably not beneficial to have more
-	 * than a single worker per chunk
+	 * than a single worker per chunk, with batch distribution
+	 * the number of workers is chosen separately
 	 */
 	int parallel_workers = 1;
 	AppendRelInfo *chunk_info = ts_get_appendrelinfo(root, chunk_rel->relid, false);
@@ -356,6 +437,11 @@ ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *chunk_rel, Hyp
 
 	Assert(chunk->fd.compressed_chunk_id > 0);
 
+	/* batches can be sized per hypertable, so use what the chunk was compressed with */
+	info->rows_per_batch = ts_compression_chunk_size_rows_per_batch(chunk->fd.id);
+	if (info->rows_per_batch <= 0)
+		info->rows_per_batch = DECOMPRESS_CHUNK_BATCH_SIZE;
+
 	chunk_rel->pathlist = NIL;
 	chunk_rel->partial_pathlist = NIL;
 
@@ -367,7 +453,7 @@ ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *chunk_rel, Hyp
 	/* translate chunk_rel->baserestrictinfo */
 	pushdown_quals(root, chunk_rel, compressed_rel, info->hypertable_compression_info);
 	set_baserel_size_estimates(root, compressed_rel);
-	new_row_estimate = compressed_rel->rows * DECOMPRESS_CHUNK_BATCH_SIZE;
+	new_row_estimate = compressed_rel->rows * info->rows_per_batch;
 	/* adjust the parent's estimate by the diff of new and old estimate */
 	hypertable_rel->rows += (new_row_estimate - chunk_rel->rows);
 	chunk_rel->rows = new_row_estimate;
@@ -376,6 +462,7 @@ ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *chunk_rel, Hyp
 								 compressed_rel->consider_parallel ? parallel_workers : 0,
 								 info,
 								 &sort_info);
+	needs_compressed_columns = decompress_chunk_needs_compressed_columns(info);
 
 	/* create non-parallel paths */
 	foreach (lc, compressed_rel->pathlist)
@@ -393,6 +480,10 @@ ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *chunk_rel, Hyp
 			 bms_is_member(ht_index, child_path->param_info->ppi_req_outer)))
 			continue;
 
+		if (child_path->pathtype == T_IndexOnlyScan &&
+			!decompress_chunk_allow_index_only(child_path, needs_compressed_columns))
+			child_path = make_index_scan_path(root, child_path);
+
 		path = decompress_chunk_path_create(root, info, 0, child_path);
 
 		/* If we can push down the sort below the DecompressChunk node, we set the pathkeys of the
@@ -425,11 +516,38 @@ ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *chunk_rel, Hyp
 						  0.0,
 						  work_mem,
 						  -1);
-				cost_decompress_chunk(&dcpath->cpath.path, &sort_path);
+				cost_decompress_chunk(&dcpath->cpath.path, &sort_path, info->rows_per_batch);
 			}
 			add_path(chunk_rel, &dcpath->cpath.path);
 		}
 
+		/* Merge the batches of all segments to produce the query pathkeys. The compressed scan
+		 * is always sorted by the batch bound during plan creation. */
+		if (sort_info.use_batch_merge)
+		{
+			DecompressChunkPath *dcpath = copy_decompress_chunk_path((DecompressChunkPath *) path);
+			Path sort_path; /* dummy for result of cost_sort */
+
+			dcpath->reverse = sort_info.reverse;
+			dcpath->batch_merge = true;
+			dcpath->batch_bound_var = sort_info.batch_bound_var;
+			dcpath->compressed_pathkeys = sort_info.batch_merge_pathkeys;
+			dcpath->cpath.path.pathkeys = root->query_pathkeys;
+
+			cost_sort(&sort_path,
+					  root,
+					  dcpath->compressed_pathkeys,
+					  child_path->total_cost,
+					  child_path->rows,
+					  child_path->pathtarget->width,
+					  0.0,
+					  work_mem,
+					  -1);
+			cost_decompress_chunk(&dcpath->cpath.path, &sort_path, info->rows_per_batch);
+			cost_batch_merge(&dcpath->cpath.path, child_path->rows);
+			add_path(chunk_rel, &dcpath->cpath.path);
+		}
+
 		/* this has to go after the path is copied for the ordered path since path can get freed in
 		 * add_path */
 		add_path(chunk_rel, &path->cpath.path);
@@ -438,7 +556,9 @@ ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *chunk_rel, Hyp
 	 * if it's planned */
 	compressed_rel->pathlist = NIL;
 	/* create parallel paths */
-	if (compressed_rel->consider_parallel)
+	if (compressed_rel->consider_parallel && ts_guc_enable_decompression_batch_distribution)
+		decompress_chunk_add_batch_distribution_path(root, info);
+	else if (compressed_rel->consider_parallel)
 	{
 		foreach (lc, compressed_rel->partial_pathlist)
 		{
@@ -448,6 +568,12 @@ ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *chunk_rel, Hyp
 				(bms_is_member(chunk_rel->relid, child_path->param_info->ppi_req_outer) ||
 				 bms_is_member(ht_index, child_path->param_info->ppi_req_outer)))
 				continue;
+			if (child_path->pathtype == T_IndexOnlyScan &&
+				!decompress_chunk_allow_index_only(child_path, needs_compressed_columns))
+				child_path = make_index_scan_path(root, child_path);
+			/* the plain index scan gets no parallel workers */
+			if (child_path == NULL)
+				continue;
 			path = decompress_chunk_path_create(root, info, parallel_workers, child_path);
 			add_partial_path(chunk_rel, &path->cpath.path);
 		}
@@ -457,6 +583,230 @@ ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *chunk_rel, Hyp
 	}
 	/* set reloptkind to RELOPT_DEADREL to prevent postgresql from replanning this relation */
 	compressed_rel->reloptkind = RELOPT_DEADREL;
+
+	if (ts_chunk_is_partial(chunk))
+		decompress_chunk_add_staging_paths(root, chunk_rel);
+}
+
+/*
+ * An index-only scan can only be used if the query references no compressed
+ * columns, the quals that are not pushed down are not taken into account when
+ * the index-only paths are created.
+ *
+ * The segmentby indexes INCLUDE the batch row count, which makes them cover
+ * queries on segmentby columns only. Index-only scans through such an index
+ * are only used with timescaledb.enable_compressed_metadata_scan, so that the
+ * plans do not change otherwise.
+ */
+static bool
+decompress_chunk_allow_index_only(Path *child_path, bool needs_compressed_columns)
+{
+	IndexOptInfo *index = castNode(IndexPath, child_path)->indexinfo;
+
+	if (needs_compressed_columns)
+		return false;
+
+	return ts_guc_enable_compressed_metadata_scan || index->nkeycolumns == index->ncolumns;
+}
+
+/*
+ * Equivalent of get_loop_count() in indxpath.c, which is not exported, without
+ * its adjustment for semijoins.
+ */
+static double
+decompress_chunk_loop_count(PlannerInfo *root, Relids outer_relids)
+{
+	double result = 0.0;
+	int outer_relid = -1;
+
+	while ((outer_relid = bms_next_member(outer_relids, outer_relid)) >= 0)
+	{
+		RelOptInfo *outer_rel;
+
+		if (outer_relid >= root->simple_rel_array_size)
+			continue;
+
+		outer_rel = root->simple_rel_array[outer_relid];
+		if (outer_rel == NULL || outer_rel->rows <= 0)
+			continue;
+
+		if (result == 0.0 || result > outer_rel->rows)
+			result = outer_rel->rows;
+	}
+
+	return result > 0.0 ? result : 1.0;
+}
+
+/*
+ * Copy an index-only path as a regular index scan of the same index. The copy
+ * is costed again, since an index scan also fetches every heap tuple. Returns
+ * NULL for a partial path if the index scan would get no parallel workers.
+ */
+static Path *
+make_index_scan_path(PlannerInfo *root, Path *child_path)
+{
+	IndexPath *index_path = makeNode(IndexPath);
+	bool partial_path = child_path->parallel_aware;
+
+	memcpy(index_path, castNode(IndexPath, child_path), sizeof(IndexPath));
+	index_path->path.pathtype = T_IndexScan;
+	index_path->path.parallel_aware = false;
+	index_path->path.parallel_workers = 0;
+
+	cost_index(index_path,
+			   root,
+			   decompress_chunk_loop_count(root, PATH_REQ_OUTER(child_path)),
+			   partial_path);
+
+	if (partial_path && index_path->path.parallel_workers <= 0)
+		return NULL;
+
+	return &index_path->path;
+}
+
+/*
+ * Check if the scan of the compressed chunk has to return any compressed
+ * column. This uses the same columns as the targetlist built for the
+ * compressed scan, see build_scan_tlist().
+ */
+static bool
+decompress_chunk_needs_compressed_columns(CompressionInfo *info)
+{
+	Bitmapset *attrs_used = info->ht_rte->selectedCols;
+	int bit = -1;
+
+	/* a whole row reference needs all columns */
+	if (bms_is_member(InvalidAttrNumber - FirstLowInvalidHeapAttributeNumber, attrs_used))
+		return true;
+
+	while ((bit = bms_next_member(attrs_used, bit)) >= 0)
+	{
+		AttrNumber ht_attno = bit + FirstLowInvalidHeapAttributeNumber;
+		FormData_hypertable_compression *column_info;
+
+		/* system columns are not read from the compressed chunk */
+		if (ht_attno <= 0)
+			continue;
+
+		column_info =
+			get_column_compressioninfo(info->hypertable_compression_info,
+									   get_attname(info->ht_rte->relid, ht_attno, false));
+		if (column_info->segmentby_column_index <= 0)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Equivalent of get_parallel_divisor() in costsize.c, which is not exported.
+ */
+static double
+decompress_chunk_parallel_divisor(Path *path)
+{
+	double parallel_divisor = path->parallel_workers;
+
+	if (parallel_leader_participation)
+	{
+		double leader_contribution = 1.0 - (0.3 * path->parallel_workers);
+
+		if (leader_contribution > 0)
+			parallel_divisor += leader_contribution;
+	}
+
+	return parallel_divisor;
+}
+
+/*
+ * Add a parallel aware DecompressChunk path that distributes whole batches
+ * to the participants.
+ *
+ * A parallel seq scan of the compressed chunk hands out heap pages, but the
+ * compressed chunk usually only has a few pages, each holding the TOAST
+ * pointers of many batches, so a single worker can end up decompressing
+ * most of the chunk. Instead only the decompression is distributed: every
+ * participant reads every compressed heap tuple with its own non-parallel
+ * scan and skips the batches that another participant already claimed in
+ * shared memory, see decompress_chunk_claim_batch(). Since each participant
+ * claims the next unclaimed batch as soon as it is done with its current
+ * one the decompression work, which is proportional to the number of rows
+ * of the batches, is spread evenly.
+ *
+ * Reading the compressed chunk is repeated by every participant, which is
+ * why the full cost of the compressed scan is charged to each of them. This
+ * is cheap compared to the decompression, since the compressed tuples only
+ * hold the TOAST pointers of the batches.
+ */
+static void
+decompress_chunk_add_batch_distribution_path(PlannerInfo *root, CompressionInfo *info)
+{
+	RelOptInfo *compressed_rel = info->compressed_rel;
+	Path *compressed_path = create_seqscan_path(root, compressed_rel, NULL, 0);
+	DecompressChunkPath *path;
+	int parallel_workers;
+
+	/* there is no point in having more workers than batches */
+	parallel_workers = (int) Min(compressed_rel->rows, (double) max_parallel_workers_per_gather);
+	if (parallel_workers <= 0)
+		return;
+
+	path = decompress_chunk_path_create(root, info, parallel_workers, compressed_path);
+	path->cpath.path.parallel_aware = true;
+
+	/* the rows are per participant, like for any other partial path */
+	path->cpath.path.rows =
+		clamp_row_est(path->cpath.path.rows / decompress_chunk_parallel_divisor(&path->cpath.path));
+	path->cpath.path.total_cost =
+		compressed_path->total_cost + path->cpath.path.rows * DECOMPRESS_CHUNK_CPU_TUPLE_COST;
+
+	add_partial_path(info->chunk_rel, &path->cpath.path);
+}
+
+/*
+ * Rows inserted into a compressed chunk are staged in the uncompressed chunk
+ * until the chunk is recompressed, so every DecompressChunk path is combined
+ * with a scan of the uncompressed chunk. Paths with sort pushdown are
+ * combined with a MergeAppend to keep their ordering.
+ *
+ * Parallel paths are not combined, the partial DecompressChunk paths would
+ * miss the staged rows.
+ */
+static void
+decompress_chunk_add_staging_paths(PlannerInfo *root, RelOptInfo *chunk_rel)
+{
+	List *decompress_paths = chunk_rel->pathlist;
+	ListCell *lc;
+
+	chunk_rel->pathlist = NIL;
+	chunk_rel->partial_pathlist = NIL;
+
+	foreach (lc, decompress_paths)
+	{
+		Path *path = lfirst(lc);
+		Relids required_outer = PATH_REQ_OUTER(path);
+		Path *staging_path = create_seqscan_path(root, chunk_rel, required_outer, 0);
+		Path *combined_path;
+
+		if (path->pathkeys != NIL)
+			combined_path = (Path *) create_merge_append_path(root,
+															  chunk_rel,
+															  list_make2(path, staging_path),
+															  path->pathkeys,
+															  required_outer,
+															  NIL);
+		else
+			combined_path = (Path *) create_append_path_compat(root,
+															   chunk_rel,
+															   list_make2(path, staging_path),
+															   NIL,
+															   NIL,
+															   required_outer,
+															   0,
+															   false,
+															   NIL,
+															   -1);
+		add_path(chunk_rel, combined_path);
+	}
 }
 
 static void
@@ -987,7 +1337,9 @@ decompress_chunk_path_create(PlannerInfo *root, CompressionInfo *info, int paral
 	path->cpath.custom_paths = list_make1(compressed_path);
 	path->reverse = false;
 	path->compressed_pathkeys = NIL;
-	cost_decompress_chunk(&path->cpath.path, compressed_path);
+	path->batch_merge = false;
+	path->batch_bound_var = NULL;
+	cost_decompress_chunk(&path->cpath.path, compressed_path, info->rows_per_batch);
 
 	return path;
 }
@@ -1012,8 +1364,9 @@ create_compressed_scan_paths(PlannerInfo *root, RelOptInfo *compressed_rel, int
 	compressed_path = create_seqscan_path(root, compressed_rel, NULL, 0);
 	add_path(compressed_rel, compressed_path);
 
-	/* create parallel scan path */
-	if (compressed_rel->consider_parallel && parallel_workers > 0)
+	/* create parallel scan path, batch distribution uses a non parallel scan */
+	if (compressed_rel->consider_parallel && parallel_workers > 0 &&
+		!ts_guc_enable_decompression_batch_distribution)
 	{
 		compressed_path = create_seqscan_path(root, compressed_rel, NULL, parallel_workers);
 		Assert(compressed_path->parallel_aware);
@@ -1036,6 +1389,8 @@ create_compressed_scan_paths(PlannerInfo *root, RelOptInfo *compressed_rel, int
 	}
 	else
 	{
+		if (sort_info->use_batch_merge)
+			build_batch_merge_pathkeys(sort_info, root, root->query_pathkeys, info);
 		check_index_predicates(root, compressed_rel);
 		create_index_paths(root, compressed_rel);
 	}
@@ -1198,6 +1553,108 @@ find_restrictinfo_equality(RelOptInfo *chunk_rel, CompressionInfo *info)
 	info->chunk_segmentby_ri = segmentby_columns;
 }
 
+/*
+ * Check that the pathkeys starting at lc exactly match the configured
+ * compress_orderby, all in the same direction. reverse is set if the batches
+ * have to be read backwards.
+ */
+static bool
+pathkeys_match_orderby(CompressionInfo *info, List *pathkeys, ListCell *lc, bool *reverse)
+{
+	int pk_index;
+	PathKey *pk;
+	Var *var;
+	Expr *expr;
+	char *column_name;
+	FormData_hypertable_compression *ci;
+
+	for (pk_index = 1; lc != NULL; lc = lnext_compat(pathkeys, lc), pk_index++)
+	{
+		bool pk_reverse = false;
+		pk = lfirst(lc);
+		expr = ts_find_em_expr_for_rel(pk->pk_eclass, info->chunk_rel);
+
+		if (expr == NULL || !IsA(expr, Var))
+			return false;
+
+		var = castNode(Var, expr);
+
+		if (var->varattno <= 0)
+			return false;
+
+		column_name = get_attname(info->chunk_rte->relid, var->varattno, false);
+		ci = get_column_compressioninfo(info->hypertable_compression_info, column_name);
+
+		if (ci->orderby_column_index != pk_index)
+			return false;
+
+		/*
+		 * pk_strategy is either BTLessStrategyNumber (for ASC) or
+		 * BTGreaterStrategyNumber (for DESC)
+		 */
+		if (pk->pk_strategy == BTLessStrategyNumber)
+		{
+			if (ci->orderby_asc && ci->orderby_nullsfirst == pk->pk_nulls_first)
+				pk_reverse = false;
+			else if (!ci->orderby_asc && ci->orderby_nullsfirst != pk->pk_nulls_first)
+				pk_reverse = true;
+			else
+				return false;
+		}
+		else if (pk->pk_strategy == BTGreaterStrategyNumber)
+		{
+			if (!ci->orderby_asc && ci->orderby_nullsfirst == pk->pk_nulls_first)
+				pk_reverse = false;
+			else if (ci->orderby_asc && ci->orderby_nullsfirst != pk->pk_nulls_first)
+				pk_reverse = true;
+			else
+				return false;
+		}
+
+		/*
+		 * first pathkey match determines if this is forward or backward scan
+		 * any further pathkey items need to have same direction
+		 */
+		if (pk_index == 1)
+			*reverse = pk_reverse;
+		else if (pk_reverse != *reverse)
+			return false;
+	}
+
+	/* all pathkeys should be processed */
+	Assert(lc == NULL);
+
+	return true;
+}
+
+/*
+ * The batches of a segment are opened once the merge reaches the min or max
+ * metadata of their first orderby column. NULL values are not part of the
+ * metadata, so this is only correct if NULLs sort last or cannot occur.
+ */
+static bool
+batch_merge_bound_is_safe(CompressionInfo *info, PathKey *pk)
+{
+	Var *var = (Var *) ts_find_em_expr_for_rel(pk->pk_eclass, info->chunk_rel);
+	HeapTuple tuple;
+	bool notnull;
+
+	if (!pk->pk_nulls_first)
+		return true;
+
+	tuple = SearchSysCache2(ATTNUM,
+							ObjectIdGetDatum(info->chunk_rte->relid),
+							Int16GetDatum(var->varattno));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for attribute %d of relation %u",
+			 var->varattno,
+			 info->chunk_rte->relid);
+	notnull = ((Form_pg_attribute) GETSTRUCT(tuple))->attnotnull;
+	ReleaseSysCache(tuple);
+
+	return notnull;
+}
+
 /*
  * Check if we can push down the sort below the DecompressChunk node and fill
  * SortInfo accordingly
@@ -1207,11 +1664,14 @@ find_restrictinfo_equality(RelOptInfo *chunk_rel, CompressionInfo *info)
  *  - the rest of pathkeys needs to match compress_orderby
  *
  * If query pathkeys is shorter than segmentby + compress_orderby pushdown can still be done
+ *
+ * If the pathkeys start with the compress_orderby columns instead of the
+ * segmentby columns the sort cannot be pushed down, but the batches of all
+ * segments can be merged on the pathkeys.
  */
 static SortInfo
 build_sortinfo(RelOptInfo *chunk_rel, CompressionInfo *info, List *pathkeys)
 {
-	int pk_index;
 	PathKey *pk;
 	Var *var;
 	Expr *expr;
@@ -1263,10 +1723,20 @@ build_sortinfo(RelOptInfo *chunk_rel, CompressionInfo *info, List *pathkeys)
 
 		/*
 		 * if pathkeys still has items but we didnt find all segmentby columns
-		 * we cannot push down sort
+		 * we cannot push down sort, but the batches of all segments might
+		 * still be merged if the pathkeys only reference orderby columns
 		 */
 		if (lc != NULL && bms_num_members(segmentby_columns) != info->num_segmentby_columns)
+		{
+			sort_info.use_batch_merge = ts_guc_enable_decompression_batch_merge &&
+										lc == list_head(pathkeys) &&
+										pathkeys_match_orderby(info,
+															   pathkeys,
+															   lc,
+															   &sort_info.reverse) &&
+										batch_merge_bound_is_safe(info, linitial(pathkeys));
 			return sort_info;
+		}
 	}
 
 	/*
@@ -1276,65 +1746,8 @@ build_sortinfo(RelOptInfo *chunk_rel, CompressionInfo *info, List *pathkeys)
 	if (lc != NULL)
 		sort_info.needs_sequence_num = true;
 
-	/*
-	 * loop over the rest of pathkeys
-	 * this needs to exactly match the configured compress_orderby
-	 */
-	for (pk_index = 1; lc != NULL; lc = lnext_compat(pathkeys, lc), pk_index++)
-	{
-		bool reverse = false;
-		pk = lfirst(lc);
-		expr = ts_find_em_expr_for_rel(pk->pk_eclass, info->chunk_rel);
-
-		if (expr == NULL || !IsA(expr, Var))
-			return sort_info;
-
-		var = castNode(Var, expr);
-
-		if (var->varattno <= 0)
-			return sort_info;
-
-		column_name = get_attname(info->chunk_rte->relid, var->varattno, false);
-		ci = get_column_compressioninfo(info->hypertable_compression_info, column_name);
-
-		if (ci->orderby_column_index != pk_index)
-			return sort_info;
-
-		/*
-		 * pk_strategy is either BTLessStrategyNumber (for ASC) or
-		 * BTGreaterStrategyNumber (for DESC)
-		 */
-		if (pk->pk_strategy == BTLessStrategyNumber)
-		{
-			if (ci->orderby_asc && ci->orderby_nullsfirst == pk->pk_nulls_first)
-				reverse = false;
-			else if (!ci->orderby_asc && ci->orderby_nullsfirst != pk->pk_nulls_first)
-				reverse = true;
-			else
-				return sort_info;
-		}
-		else if (pk->pk_strategy == BTGreaterStrategyNumber)
-		{
-			if (!ci->orderby_asc && ci->orderby_nullsfirst == pk->pk_nulls_first)
-				reverse = false;
-			else if (ci->orderby_asc && ci->orderby_nullsfirst != pk->pk_nulls_first)
-				reverse = true;
-			else
-				return sort_info;
-		}
-
-		/*
-		 * first pathkey match determines if this is forward or backward scan
-		 * any further pathkey items need to have same direction
-		 */
-		if (pk_index == 1)
-			sort_info.reverse = reverse;
-		else if (reverse != sort_info.reverse)
-			return sort_info;
-	}
-
-	/* all pathkeys should be processed */
-	Assert(lc == NULL);
+	if (!pathkeys_match_orderby(info, pathkeys, lc, &sort_info.reverse))
+		return sort_info;
 
 	sort_info.can_pushdown_sort = true;
 	return sort_info;
@@ -27,6 +27,9 @@ typedef struct CompressionInfo
 	int num_orderby_columns;
 	int num_segmentby_columns;
 
+	/* average number of rows in the compressed batches of the chunk */
+	double rows_per_batch;
+
 	/* chunk attribute numbers that are segmentby columns */
 	Bitmapset *chunk_segmentby_attnos;
 	/* chunk attribute numbers that have equality constraint in baserestrictinfo */
@@ -50,10 +53,18 @@ typedef struct DecompressChunkPath
 	List *compressed_pathkeys;
 	bool needs_sequence_num;
 	bool reverse;
+	/*
+	 * the batches of all segments are merged on the pathkeys, the compressed
+	 * scan is ordered by batch_bound_var, the min or max metadata of the
+	 * first orderby column
+	 */
+	bool batch_merge;
+	Var *batch_bound_var;
 } DecompressChunkPath;
 
 void ts_decompress_chunk_generate_paths(PlannerInfo *root, RelOptInfo *rel, Hypertable *ht,
 										Chunk *chunk);
+bool ts_is_decompress_chunk_path(Path *path);
 
 FormData_hypertable_compression *get_column_compressioninfo(List *hypertable_compression_info,
 															char *column_name);
@@ -6,6 +6,8 @@
 
 #include <postgres.h>
 #include <miscadmin.h>
+#include <access/htup_details.h>
+#include <access/parallel.h>
 #include <access/sysattr.h>
 #include <executor/executor.h>
 #include <nodes/bitmapset.h>
@@ -13,74 +15,53 @@
 #include <nodes/nodeFuncs.h>
 #include <parser/parsetree.h>
 #include <rewrite/rewriteManip.h>
+#include <storage/bufmgr.h>
 #include <utils/builtins.h>
 #include <utils/datum.h>
 #include <utils/memutils.h>
+#include <utils/sortsupport.h>
 #include <utils/typcache.h>
 
 #include "compat.h"
+#if PG12_LT
+#include <optimizer/var.h>
+#else
+#include <optimizer/optimizer.h>
+#endif
+
 #include "compression/array.h"
 #include "compression/compression.h"
 #include "nodes/decompress_chunk/decompress_chunk.h"
 #include "nodes/decompress_chunk/exec.h"
 #include "nodes/decompress_chunk/planner.h"
+#include "nodes/decompress_chunk/vector_qual.h"
 #include "hypertable_compression.h"
 
-typedef enum DecompressChunkColumnType
-{
-	SEGMENTBY_COLUMN,
-	COMPRESSED_COLUMN,
-	COUNT_COLUMN,
-	SEQUENCE_NUM_COLUMN,
-} DecompressChunkColumnType;
-
-typedef struct DecompressChunkColumnState
-{
-	DecompressChunkColumnType type;
-	Oid typid;
-	AttrNumber attno;
-	union
-	{
-		struct
-		{
-			Datum value;
-			bool isnull;
-			int count;
-		} segmentby;
-		struct
-		{
-			DecompressionIterator *iterator;
-		} compressed;
-	};
-} DecompressChunkColumnState;
-
-typedef struct DecompressChunkState
-{
-	CustomScanState csstate;
-	List *varattno_map;
-	int num_columns;
-	DecompressChunkColumnState *columns;
-
-	bool initialized;
-	bool reverse;
-	int hypertable_id;
-	Oid chunk_relid;
-	List *hypertable_compression_info;
-	int counter;
-	MemoryContext per_batch_context;
-} DecompressChunkState;
-
 static TupleTableSlot *decompress_chunk_exec(CustomScanState *node);
 static void decompress_chunk_begin(CustomScanState *node, EState *estate, int eflags);
 static void decompress_chunk_end(CustomScanState *node);
 static void decompress_chunk_rescan(CustomScanState *node);
 static TupleTableSlot *decompress_chunk_create_tuple(DecompressChunkState *state);
+static TupleTableSlot *decompress_chunk_merge_next(DecompressChunkState *state);
+static void decompress_chunk_decompress_lazy_columns(DecompressChunkState *state);
+static TupleTableSlot *decompress_chunk_fetch_compressed(DecompressChunkState *state);
+static Size decompress_chunk_estimate_dsm(CustomScanState *node, ParallelContext *pcxt);
+static void decompress_chunk_initialize_dsm(CustomScanState *node, ParallelContext *pcxt,
+											void *coordinate);
+static void decompress_chunk_reinitialize_dsm(CustomScanState *node, ParallelContext *pcxt,
+											  void *coordinate);
+static void decompress_chunk_initialize_worker(CustomScanState *node, shm_toc *toc,
+											   void *coordinate);
 
 static CustomExecMethods decompress_chunk_state_methods = {
 	.BeginCustomScan = decompress_chunk_begin,
 	.ExecCustomScan = decompress_chunk_exec,
 	.EndCustomScan = decompress_chunk_end,
 	.ReScanCustomScan = decompress_chunk_rescan,
+	.EstimateDSMCustomScan = decompress_chunk_estimate_dsm,
+	.InitializeDSMCustomScan = decompress_chunk_initialize_dsm,
+	.ReInitializeDSMCustomScan = decompress_chunk_reinitialize_dsm,
+	.InitializeWorkerCustomScan = decompress_chunk_initialize_worker,
 };
 
 Node *
@@ -97,7 +78,9 @@ decompress_chunk_state_create(CustomScan *cscan)
 	state->hypertable_id = linitial_int(settings);
 	state->chunk_relid = lsecond_int(settings);
 	state->reverse = lthird_int(settings);
+	state->batch_merge = lfourth_int(settings);
 	state->varattno_map = lsecond(cscan->custom_private);
+	state->proof_info = lfourth(cscan->custom_private);
 
 	return (Node *) state;
 }
@@ -108,10 +91,16 @@ decompress_chunk_state_create(CustomScan *cscan)
  * the column state indexes are based on the index
  * of the columns of the uncompressed chunk because
  * that is the tuple layout we are creating
+ *
+ * qual_attnos are the attribute numbers referenced by the
+ * quals of the scan, offset by FirstLowInvalidHeapAttributeNumber,
+ * compressed columns not referenced there are decompressed lazily
  */
 static void
-initialize_column_state(DecompressChunkState *state)
+initialize_column_state(DecompressChunkState *state, Bitmapset *qual_attnos)
 {
+	bool whole_row_qual =
+		bms_is_member(InvalidAttrNumber - FirstLowInvalidHeapAttributeNumber, qual_attnos);
 	ScanState *ss = (ScanState *) state;
 	TupleDesc desc = ss->ss_ScanTupleSlot->tts_tupleDescriptor;
 	ListCell *lc;
@@ -137,11 +126,18 @@ initialize_column_state(DecompressChunkState *state)
 										   NameStr(attribute->attname));
 
 			column->typid = attribute->atttypid;
+			column->typbyval = attribute->attbyval;
 
 			if (ht_info->segmentby_column_index > 0)
 				column->type = SEGMENTBY_COLUMN;
 			else
+			{
 				column->type = COMPRESSED_COLUMN;
+				column->compressed.lazy =
+					!whole_row_qual &&
+					!bms_is_member(column->attno - FirstLowInvalidHeapAttributeNumber,
+								   qual_attnos);
+			}
 		}
 		else
 		{
@@ -154,6 +150,17 @@ initialize_column_state(DecompressChunkState *state)
 				case DECOMPRESS_CHUNK_SEQUENCE_NUM_ID:
 					column->type = SEQUENCE_NUM_COLUMN;
 					break;
+				case DECOMPRESS_CHUNK_BATCH_BOUND_ID:
+					column->type = BATCH_BOUND_COLUMN;
+					state->bound_column = i;
+					break;
+				case DECOMPRESS_CHUNK_CTID_ID:
+					column->type = CTID_COLUMN;
+					state->ctid_column = i;
+					break;
+				case DECOMPRESS_CHUNK_METADATA_ID:
+					column->type = METADATA_COLUMN;
+					break;
 				default:
 					elog(ERROR, "Invalid column attno \"%d\"", column->attno);
 					break;
@@ -209,6 +216,81 @@ constify_tableoid(List *node, Index chunk_index, Oid chunk_relid)
 	return (List *) constify_tableoid_walker((Node *) node, &ctx);
 }
 
+/*
+ * Set up the sort keys the batches are merged on. The planner passes lists of
+ * the attribute numbers, sort operators, collations and nulls first flags.
+ */
+static void
+initialize_batch_merge(DecompressChunkState *state, List *sortinfo)
+{
+	List *attnos = linitial(sortinfo);
+	List *sortops = lsecond(sortinfo);
+	List *collations = lthird(sortinfo);
+	List *nulls_first = lfourth(sortinfo);
+	ListCell *lc_attno, *lc_sortop;
+	int i = 0;
+
+	state->n_sortkeys = list_length(attnos);
+	state->sortkeys = palloc0(sizeof(SortSupportData) * state->n_sortkeys);
+
+	forboth (lc_attno, attnos, lc_sortop, sortops)
+	{
+		SortSupport sortkey = &state->sortkeys[i];
+
+		sortkey->ssup_cxt = CurrentMemoryContext;
+		sortkey->ssup_collation = list_nth_oid(collations, i);
+		sortkey->ssup_nulls_first = list_nth_int(nulls_first, i);
+		sortkey->ssup_attno = lfirst_int(lc_attno);
+		PrepareSortSupportFromOrderingOp(lfirst_oid(lc_sortop), sortkey);
+		i++;
+	}
+
+	state->n_batches = 0;
+	state->batches = NULL;
+	state->free_batches = NULL;
+	state->merge_heap = NULL;
+	state->merge_top = -1;
+	state->merge_next_compressed = NULL;
+	state->merge_input_done = false;
+	state->merge_context = CurrentMemoryContext;
+}
+
+/*
+ * Set up the checks for batches whose metadata proves the quals on compressed
+ * columns. Compressed columns that are only referenced by those quals are not
+ * decompressed for proven batches, unless the scan tuple is returned without
+ * projection.
+ */
+static void
+initialize_batch_proofs(DecompressChunkState *state, Index scanrelid)
+{
+	PlanState *ps = &state->csstate.ss.ps;
+	List *proven_quals = lsecond(state->proof_info);
+	Bitmapset *tlist_attnos = NULL;
+	int i;
+
+	/* the proofs are evaluated on the compressed tuple, so they have no parent */
+	state->batch_proofs = ExecInitQual(linitial(state->proof_info), NULL);
+	proven_quals = constify_tableoid(proven_quals, scanrelid, state->chunk_relid);
+	state->proven_qual = ExecInitQual(proven_quals, ps);
+
+	if (ps->ps_ProjInfo == NULL)
+		return;
+
+	pull_varattnos((Node *) ps->plan->targetlist, scanrelid, &tlist_attnos);
+	if (bms_is_member(InvalidAttrNumber - FirstLowInvalidHeapAttributeNumber, tlist_attnos))
+		return;
+
+	for (i = 0; i < state->num_columns; i++)
+	{
+		DecompressChunkColumnState *column = &state->columns[i];
+
+		if (column->type == COMPRESSED_COLUMN && !column->compressed.lazy)
+			column->compressed.qual_only =
+				!bms_is_member(column->attno - FirstLowInvalidHeapAttributeNumber, tlist_attnos);
+	}
+}
+
 /*
  * Complete initialization of the supplied CustomScanState.
  *
@@ -221,6 +303,7 @@ decompress_chunk_begin(CustomScanState *node, EState *estate, int eflags)
 	DecompressChunkState *state = (DecompressChunkState *) node;
 	CustomScan *cscan = castNode(CustomScan, node->ss.ps.plan);
 	Plan *compressed_scan = linitial(cscan->custom_plans);
+	Bitmapset *qual_attnos = NULL;
 	Assert(list_length(cscan->custom_plans) == 1);
 
 	if (node->ss.ps.ps_ProjInfo)
@@ -247,13 +330,81 @@ decompress_chunk_begin(CustomScanState *node, EState *estate, int eflags)
 
 	state->hypertable_compression_info = ts_hypertable_compression_get(state->hypertable_id);
 
-	initialize_column_state(state);
+	pull_varattnos((Node *) node->ss.ps.plan->qual, cscan->scan.scanrelid, &qual_attnos);
+	initialize_column_state(state, qual_attnos);
+
+	/*
+	 * Quals that can be evaluated on whole batches are removed from the per
+	 * tuple qual. We only replace the qual that was set up by
+	 * ExecInitCustomScan when there is something to vectorize.
+	 */
+	if (node->ss.ps.plan->qual != NIL)
+	{
+		List *remaining_quals;
+
+		state->vectorized_quals = vector_qual_split(state,
+													node->ss.ps.plan->qual,
+													cscan->scan.scanrelid,
+													&remaining_quals);
+		if (state->vectorized_quals != NIL)
+		{
+			remaining_quals =
+				constify_tableoid(remaining_quals, cscan->scan.scanrelid, state->chunk_relid);
+			node->ss.ps.qual = ExecInitQual(remaining_quals, &node->ss.ps);
+		}
+	}
+
+	if (state->proof_info != NIL)
+		initialize_batch_proofs(state, cscan->scan.scanrelid);
 
 	node->custom_ps = lappend(node->custom_ps, ExecInitNode(compressed_scan, estate, eflags));
 
 	state->per_batch_context = AllocSetContextCreate(CurrentMemoryContext,
 													 "DecompressChunk per_batch",
 													 ALLOCSET_DEFAULT_SIZES);
+
+	if (state->batch_merge)
+		initialize_batch_merge(state, lthird(cscan->custom_private));
+}
+
+/*
+ * Decompress all rows of a compressed column of the current batch
+ *
+ * The compressed value is only detoasted here, so columns that are never
+ * reached, because no row of the batch passes the quals, are never fetched
+ * from the TOAST table. Large values are read in slices by the algorithms that
+ * support it, and the detoasted copy of a by-value column is not kept until the
+ * end of the batch, which keeps memory low also when many batches are open for
+ * a merge.
+ */
+static void
+decompress_column(DecompressChunkState *state, DecompressChunkColumnState *column)
+{
+	if (column->compressed.decompressed)
+		return;
+
+	column->compressed.batch =
+		tsl_decompress_all(column->compressed.value, column->typid, column->typbyval);
+	column->compressed.decompressed = true;
+
+	/* all compressed columns must agree with the count column about the number of rows */
+	if (column->compressed.batch->num_rows != (uint32) state->batch_rows)
+		elog(ERROR, "compressed column out of sync with batch counter");
+}
+
+static bool
+selection_is_empty(const uint64 *selection, int num_rows)
+{
+	int num_words = DECOMPRESSED_BATCH_VALIDITY_WORDS(num_rows);
+	int word;
+
+	for (word = 0; word < num_words; word++)
+	{
+		if (selection[word] != 0)
+			return false;
+	}
+
+	return true;
 }
 
 static void
@@ -261,10 +412,24 @@ initialize_batch(DecompressChunkState *state, TupleTableSlot *slot)
 {
 	Datum value;
 	bool isnull;
+	bool proven = false;
 	int i;
 	MemoryContext old_context = MemoryContextSwitchTo(state->per_batch_context);
 	MemoryContextReset(state->per_batch_context);
 
+	if (state->batch_proofs != NULL)
+	{
+		ExprContext *econtext = state->csstate.ss.ps.ps_ExprContext;
+
+		econtext->ecxt_scantuple = slot;
+		proven = ExecQual(state->batch_proofs, econtext);
+	}
+	state->batch_qual = proven ? state->proven_qual : state->csstate.ss.ps.qual;
+
+	state->batch_rows = 0;
+	state->batch_rows_returned = 0;
+	state->selection = NULL;
+
 	for (i = 0; i < state->num_columns; i++)
 	{
 		DecompressChunkColumnState *column = &state->columns[i];
@@ -274,18 +439,11 @@ initialize_batch(DecompressChunkState *state, TupleTableSlot *slot)
 			case COMPRESSED_COLUMN:
 			{
 				value = slot_getattr(slot, AttrOffsetGetAttrNumber(i), &isnull);
-				if (!isnull)
-				{
-					CompressedDataHeader *header = (CompressedDataHeader *) PG_DETOAST_DATUM(value);
-
-					column->compressed.iterator =
-						tsl_get_decompression_iterator_init(header->compression_algorithm,
-															state->reverse)(PointerGetDatum(header),
-																			column->typid);
-				}
-				else
-					column->compressed.iterator = NULL;
-
+				column->compressed.batch = NULL;
+				column->compressed.value = value;
+				/* columns not needed for proven batches are left NULL */
+				column->compressed.decompressed =
+					isnull || (proven && column->compressed.qual_only);
 				break;
 			}
 			case SEGMENTBY_COLUMN:
@@ -299,168 +457,764 @@ initialize_batch(DecompressChunkState *state, TupleTableSlot *slot)
 				break;
 			case COUNT_COLUMN:
 				value = slot_getattr(slot, AttrOffsetGetAttrNumber(i), &isnull);
-				state->counter = DatumGetInt32(value);
+				state->batch_rows = DatumGetInt32(value);
 				/* count column should never be NULL */
 				Assert(!isnull);
 				break;
 			case SEQUENCE_NUM_COLUMN:
+			case BATCH_BOUND_COLUMN:
+			case CTID_COLUMN:
+			case METADATA_COLUMN:
 				/*
-				 * nothing to do here for sequence number
-				 * we only needed this for sorting in node below
+				 * nothing to do here for sequence number, batch bound,
+				 * ctid and metadata we only needed these for sorting in
+				 * node below, for claiming the batch and for the proofs
 				 */
 				break;
 		}
 	}
+
+	/* the columns referenced by quals are needed for every batch */
+	for (i = 0; i < state->num_columns; i++)
+	{
+		DecompressChunkColumnState *column = &state->columns[i];
+
+		if (column->type == COMPRESSED_COLUMN && !column->compressed.lazy)
+			decompress_column(state, column);
+	}
+	state->lazy_columns_decompressed = false;
+
+	/* the vectorized quals reference compressed columns, so proven batches skip them */
+	if (state->vectorized_quals != NIL && !proven)
+	{
+		state->selection = vector_qual_compute(state, state->vectorized_quals);
+
+		/*
+		 * If no row passes the vectorized quals we skip the whole batch
+		 * without ever decompressing the remaining columns.
+		 */
+		if (selection_is_empty(state->selection, state->batch_rows))
+		{
+			InstrCountFiltered1(&state->csstate, state->batch_rows);
+			state->batch_rows_returned = state->batch_rows;
+		}
+	}
+
 	state->initialized = true;
 	MemoryContextSwitchTo(old_context);
 }
 
+/*
+ * Decompress the lazy columns of the current batch. This is done once the
+ * first row of the batch passes the quals.
+ */
+static void
+decompress_chunk_decompress_lazy_columns(DecompressChunkState *state)
+{
+	MemoryContext old_context;
+	int i;
+
+	if (state->lazy_columns_decompressed)
+		return;
+
+	old_context = MemoryContextSwitchTo(state->per_batch_context);
+
+	for (i = 0; i < state->num_columns; i++)
+	{
+		DecompressChunkColumnState *column = &state->columns[i];
+
+		if (column->type == COMPRESSED_COLUMN && column->compressed.lazy)
+			decompress_column(state, column);
+	}
+
+	state->lazy_columns_decompressed = true;
+	MemoryContextSwitchTo(old_context);
+}
+
 static TupleTableSlot *
 decompress_chunk_exec(CustomScanState *node)
 {
 	DecompressChunkState *state = (DecompressChunkState *) node;
 	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	TupleTableSlot *slot;
 
 	if (node->custom_ps == NIL)
 		return NULL;
 
 	ResetExprContext(econtext);
 
-	while (true)
-	{
-		TupleTableSlot *slot = decompress_chunk_create_tuple(state);
+	/* the scan qual is already checked by decompress_chunk_create_tuple */
+	if (state->batch_merge)
+		slot = decompress_chunk_merge_next(state);
+	else
+		slot = decompress_chunk_create_tuple(state);
 
-		if (TupIsNull(slot))
-			return NULL;
+	if (TupIsNull(slot))
+		return NULL;
 
-		econtext->ecxt_scantuple = slot;
+	if (!node->ss.ps.ps_ProjInfo)
+		return slot;
 
-		if (node->ss.ps.qual && !ExecQual(node->ss.ps.qual, econtext))
-		{
-			InstrCountFiltered1(node, 1);
-			ExecClearTuple(slot);
-			continue;
-		}
+	econtext->ecxt_scantuple = slot;
+	return ExecProject(node->ss.ps.ps_ProjInfo);
+}
 
-		if (!node->ss.ps.ps_ProjInfo)
-			return slot;
+/*
+ * Close all open batches of a batch merge
+ */
+static void
+batch_merge_reset(DecompressChunkState *state)
+{
+	int i;
+
+	for (i = 0; i < state->n_batches; i++)
+	{
+		if (bms_is_member(i, state->free_batches))
+			continue;
 
-		return ExecProject(node->ss.ps.ps_ProjInfo);
+		MemoryContextReset(state->batches[i].per_batch_context);
+		ExecClearTuple(state->batches[i].slot);
+		ExecClearTuple(state->batches[i].compressed_slot);
+		state->free_batches = bms_add_member(state->free_batches, i);
 	}
+
+	if (state->merge_heap != NULL)
+		binaryheap_reset(state->merge_heap);
+	state->merge_top = -1;
+	state->merge_next_compressed = NULL;
+	state->merge_input_done = false;
 }
 
 static void
 decompress_chunk_rescan(CustomScanState *node)
 {
-	((DecompressChunkState *) node)->initialized = false;
+	DecompressChunkState *state = (DecompressChunkState *) node;
+
+	state->initialized = false;
+	if (state->batch_merge)
+		batch_merge_reset(state);
 	ExecReScan(linitial(node->custom_ps));
 }
 
 static void
 decompress_chunk_end(CustomScanState *node)
 {
-	MemoryContextReset(((DecompressChunkState *) node)->per_batch_context);
+	DecompressChunkState *state = (DecompressChunkState *) node;
+	int i;
+
+	MemoryContextReset(state->per_batch_context);
+
+	for (i = 0; i < state->n_batches; i++)
+	{
+		MemoryContextDelete(state->batches[i].per_batch_context);
+		ExecDropSingleTupleTableSlot(state->batches[i].slot);
+		ExecDropSingleTupleTableSlot(state->batches[i].compressed_slot);
+	}
+
 	ExecEndNode(linitial(node->custom_ps));
 }
 
+static inline void
+store_compressed_column(DecompressChunkColumnState *column, TupleTableSlot *slot, int row)
+{
+	AttrNumber attr = AttrNumberGetAttrOffset(column->attno);
+	DecompressedBatch *batch = column->compressed.batch;
+
+	if (batch != NULL && decompressed_batch_row_is_valid(batch, row))
+	{
+		slot->tts_values[attr] = batch->values[row];
+		slot->tts_isnull[attr] = false;
+	}
+	else
+		slot->tts_isnull[attr] = true;
+}
+
+/*
+ * Fill the scan slot with the values of the given row of the current batch.
+ *
+ * Lazy columns are set to NULL here, they are filled in by
+ * decompress_chunk_store_lazy_columns once the row passed the quals.
+ */
+static void
+decompress_chunk_store_row(DecompressChunkState *state, TupleTableSlot *slot, int row)
+{
+	int i;
+
+	ExecClearTuple(slot);
+
+	for (i = 0; i < state->num_columns; i++)
+	{
+		DecompressChunkColumnState *column = &state->columns[i];
+		switch (column->type)
+		{
+			case COMPRESSED_COLUMN:
+				if (column->compressed.lazy)
+					slot->tts_isnull[AttrNumberGetAttrOffset(column->attno)] = true;
+				else
+					store_compressed_column(column, slot, row);
+				break;
+			case SEGMENTBY_COLUMN:
+			{
+				AttrNumber attr = AttrNumberGetAttrOffset(column->attno);
+
+				slot->tts_values[attr] = column->segmentby.value;
+				slot->tts_isnull[attr] = column->segmentby.isnull;
+				break;
+			}
+			case COUNT_COLUMN:
+			case SEQUENCE_NUM_COLUMN:
+			case BATCH_BOUND_COLUMN:
+			case CTID_COLUMN:
+			case METADATA_COLUMN:
+				/*
+				 * nothing to do here for count, sequence number,
+				 * batch bound, ctid and metadata we only needed these
+				 * for the batch size, for sorting in node below, for
+				 * claiming the batch and for the proofs
+				 */
+				break;
+		}
+	}
+
+	ExecStoreVirtualTuple(slot);
+}
+
+static void
+decompress_chunk_store_lazy_columns(DecompressChunkState *state, TupleTableSlot *slot, int row)
+{
+	int i;
+
+	for (i = 0; i < state->num_columns; i++)
+	{
+		DecompressChunkColumnState *column = &state->columns[i];
+
+		if (column->type == COMPRESSED_COLUMN && column->compressed.lazy)
+			store_compressed_column(column, slot, row);
+	}
+}
+
+/*
+ * Store the next row of the current batch that passes the scan qual in slot.
+ * Returns NULL when the batch is exhausted.
+ */
+static TupleTableSlot *
+decompress_chunk_next_row(DecompressChunkState *state, TupleTableSlot *slot)
+{
+	PlanState *ps = &state->csstate.ss.ps;
+	ExprContext *econtext = ps->ps_ExprContext;
+	int row;
+
+	while (state->batch_rows_returned < state->batch_rows)
+	{
+		row = state->reverse ? state->batch_rows - 1 - state->batch_rows_returned :
+							   state->batch_rows_returned;
+		state->batch_rows_returned++;
+
+		/* skip rows filtered out by the vectorized quals */
+		if (state->selection != NULL &&
+			(state->selection[row / 64] & (UINT64CONST(1) << (row % 64))) == 0)
+		{
+			InstrCountFiltered1(&state->csstate, 1);
+			continue;
+		}
+
+		decompress_chunk_store_row(state, slot, row);
+
+		if (state->batch_qual)
+		{
+			econtext->ecxt_scantuple = slot;
+
+			if (!ExecQual(state->batch_qual, econtext))
+			{
+				InstrCountFiltered1(&state->csstate, 1);
+				ExecClearTuple(slot);
+				ResetExprContext(econtext);
+				continue;
+			}
+		}
+
+		decompress_chunk_decompress_lazy_columns(state);
+		decompress_chunk_store_lazy_columns(state, slot, row);
+
+		return slot;
+	}
+
+	return NULL;
+}
+
 /*
- * Create generated tuple according to column state
+ * Create generated tuple according to column state and check the
+ * scan qual on it
  */
 static TupleTableSlot *
 decompress_chunk_create_tuple(DecompressChunkState *state)
 {
-	TupleTableSlot *slot = state->csstate.ss.ss_ScanTupleSlot;
-	bool batch_done = false;
-	int i;
+	TupleTableSlot *slot;
 
 	while (true)
 	{
 		if (!state->initialized)
 		{
-			TupleTableSlot *subslot = ExecProcNode(linitial(state->csstate.custom_ps));
+			TupleTableSlot *subslot = decompress_chunk_fetch_compressed(state);
 
 			if (TupIsNull(subslot))
 				return NULL;
 
-			batch_done = false;
 			initialize_batch(state, subslot);
 		}
 
-		ExecClearTuple(slot);
+		slot = decompress_chunk_next_row(state, state->csstate.ss.ss_ScanTupleSlot);
+		if (slot != NULL)
+			return slot;
+
+		state->initialized = false;
+	}
+}
 
-		for (i = 0; i < state->num_columns; i++)
+/*
+ * Exchange the current batch of the scan state with an open batch of the
+ * batch merge, so the batch can be processed by the functions working on
+ * the current batch. Calling it a second time restores the original state.
+ */
+static void
+batch_merge_swap(DecompressChunkState *state, DecompressBatchState *batch)
+{
+	DecompressBatchState current = {
+		.columns = state->columns,
+		.batch_rows = state->batch_rows,
+		.batch_rows_returned = state->batch_rows_returned,
+		.selection = state->selection,
+		.lazy_columns_decompressed = state->lazy_columns_decompressed,
+		.per_batch_context = state->per_batch_context,
+	};
+
+	state->columns = batch->columns;
+	state->batch_rows = batch->batch_rows;
+	state->batch_rows_returned = batch->batch_rows_returned;
+	state->selection = batch->selection;
+	state->lazy_columns_decompressed = batch->lazy_columns_decompressed;
+	state->per_batch_context = batch->per_batch_context;
+
+	batch->columns = current.columns;
+	batch->batch_rows = current.batch_rows;
+	batch->batch_rows_returned = current.batch_rows_returned;
+	batch->selection = current.selection;
+	batch->lazy_columns_decompressed = current.lazy_columns_decompressed;
+	batch->per_batch_context = current.per_batch_context;
+}
+
+/*
+ * Compare the current rows of two open batches. The binary heap keeps the
+ * largest element on top so the result is inverted to get the first row
+ * in sort order there.
+ */
+static int
+batch_merge_compare(Datum a, Datum b, void *arg)
+{
+	DecompressChunkState *state = (DecompressChunkState *) arg;
+	TupleTableSlot *slot_a = state->batches[DatumGetInt32(a)].slot;
+	TupleTableSlot *slot_b = state->batches[DatumGetInt32(b)].slot;
+	int i;
+
+	for (i = 0; i < state->n_sortkeys; i++)
+	{
+		SortSupport sortkey = &state->sortkeys[i];
+		bool isnull_a, isnull_b;
+		Datum value_a = slot_getattr(slot_a, sortkey->ssup_attno, &isnull_a);
+		Datum value_b = slot_getattr(slot_b, sortkey->ssup_attno, &isnull_b);
+		int compare = ApplySortComparator(value_a, isnull_a, value_b, isnull_b, sortkey);
+
+		if (compare != 0)
 		{
-			DecompressChunkColumnState *column = &state->columns[i];
-			switch (column->type)
-			{
-				case COUNT_COLUMN:
-					if (state->counter <= 0)
-						/*
-						 * we continue checking other columns even if counter
-						 * reaches zero to sanity check all columns are in sync
-						 * and agree about batch end
-						 */
-						batch_done = true;
-					else
-						state->counter--;
-					break;
-				case COMPRESSED_COLUMN:
-				{
-					AttrNumber attr = AttrNumberGetAttrOffset(column->attno);
-
-					if (column->compressed.iterator != NULL)
-					{
-						DecompressResult result;
-						result = column->compressed.iterator->try_next(column->compressed.iterator);
-
-						if (result.is_done)
-						{
-							batch_done = true;
-							continue;
-						}
-						else if (batch_done)
-						{
-							/*
-							 * since the count column is the first column batch_done
-							 * might be true if compressed column is out of sync with
-							 * the batch counter.
-							 */
-							elog(ERROR, "compressed column out of sync with batch counter");
-						}
-
-						slot->tts_values[attr] = result.val;
-						slot->tts_isnull[attr] = result.is_null;
-					}
-					else
-						slot->tts_isnull[attr] = true;
+			INVERT_COMPARE_RESULT(compare);
+			return compare;
+		}
+	}
 
-					break;
-				}
-				case SEGMENTBY_COLUMN:
-				{
-					AttrNumber attr = AttrNumberGetAttrOffset(column->attno);
+	return 0;
+}
 
-					slot->tts_values[attr] = column->segmentby.value;
-					slot->tts_isnull[attr] = column->segmentby.isnull;
-					break;
-				}
-				case SEQUENCE_NUM_COLUMN:
-					/*
-					 * nothing to do here for sequence number
-					 * we only needed this for sorting in node below
-					 */
-					break;
+/*
+ * Get an unused batch for the batch merge, growing the batch array and the
+ * heap when all batches are in use.
+ */
+static int
+batch_merge_get_free_batch(DecompressChunkState *state)
+{
+	int batch_index;
+
+	if (bms_is_empty(state->free_batches))
+	{
+		MemoryContext old_context = MemoryContextSwitchTo(state->merge_context);
+		TupleDesc desc = state->csstate.ss.ss_ScanTupleSlot->tts_tupleDescriptor;
+		TupleDesc compressed_desc = ExecGetResultType(linitial(state->csstate.custom_ps));
+		int n_batches = state->n_batches == 0 ? 16 : state->n_batches * 2;
+		binaryheap *heap = binaryheap_allocate(n_batches, batch_merge_compare, state);
+		int i;
+
+		if (state->batches == NULL)
+			state->batches = palloc(sizeof(DecompressBatchState) * n_batches);
+		else
+			state->batches = repalloc(state->batches, sizeof(DecompressBatchState) * n_batches);
+
+		for (i = state->n_batches; i < n_batches; i++)
+		{
+			DecompressBatchState *batch = &state->batches[i];
+
+			batch->columns = palloc(sizeof(DecompressChunkColumnState) * state->num_columns);
+			memcpy(batch->columns,
+				   state->columns,
+				   sizeof(DecompressChunkColumnState) * state->num_columns);
+			batch->batch_rows = 0;
+			batch->batch_rows_returned = 0;
+			batch->selection = NULL;
+			batch->lazy_columns_decompressed = false;
+			batch->per_batch_context = AllocSetContextCreate(state->merge_context,
+															 "DecompressChunk batch merge",
+															 ALLOCSET_DEFAULT_SIZES);
+			batch->compressed_slot =
+				MakeSingleTupleTableSlotCompat(compressed_desc, TTSOpsVirtualP);
+			batch->slot = MakeSingleTupleTableSlotCompat(desc, TTSOpsVirtualP);
+			state->free_batches = bms_add_member(state->free_batches, i);
+		}
+
+		if (state->merge_heap != NULL)
+		{
+			for (i = 0; i < state->merge_heap->bh_size; i++)
+				binaryheap_add_unordered(heap, state->merge_heap->bh_nodes[i]);
+			binaryheap_build(heap);
+			binaryheap_free(state->merge_heap);
+		}
+
+		state->merge_heap = heap;
+		state->n_batches = n_batches;
+		MemoryContextSwitchTo(old_context);
+	}
+
+	batch_index = bms_first_member(state->free_batches);
+	Assert(batch_index >= 0);
+
+	return batch_index;
+}
+
+static void
+batch_merge_free_batch(DecompressChunkState *state, int batch_index)
+{
+	DecompressBatchState *batch = &state->batches[batch_index];
+
+	MemoryContextReset(batch->per_batch_context);
+	ExecClearTuple(batch->slot);
+	ExecClearTuple(batch->compressed_slot);
+	state->free_batches = bms_add_member(state->free_batches, batch_index);
+}
+
+/*
+ * Advance an open batch to its next row. Returns false when the batch is
+ * exhausted, in which case the batch has been freed.
+ */
+static bool
+batch_merge_advance(DecompressChunkState *state, int batch_index)
+{
+	DecompressBatchState *batch = &state->batches[batch_index];
+	TupleTableSlot *slot;
+
+	batch_merge_swap(state, batch);
+	slot = decompress_chunk_next_row(state, batch->slot);
+	batch_merge_swap(state, batch);
+
+	if (slot == NULL)
+	{
+		batch_merge_free_batch(state, batch_index);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Open the compressed tuple in merge_next_compressed as a new batch and add
+ * it to the heap unless none of its rows pass the scan qual.
+ */
+static void
+batch_merge_open_batch(DecompressChunkState *state)
+{
+	int batch_index = batch_merge_get_free_batch(state);
+	DecompressBatchState *batch = &state->batches[batch_index];
+
+	/*
+	 * The decompressed batch references the compressed tuple, so we need our
+	 * own copy of it as the child node moves on to the next tuple.
+	 */
+	ExecCopySlot(batch->compressed_slot, state->merge_next_compressed);
+	state->merge_next_compressed = NULL;
+
+	batch_merge_swap(state, batch);
+	initialize_batch(state, batch->compressed_slot);
+	batch_merge_swap(state, batch);
+
+	if (batch_merge_advance(state, batch_index))
+		binaryheap_add(state->merge_heap, Int32GetDatum(batch_index));
+}
+
+/*
+ * Return the next row of the batch merge.
+ *
+ * The compressed tuples arrive sorted by the min (or max for descending
+ * order) metadata of the first sort key, which is a bound for all rows of
+ * the batch. A batch whose bound is ordered after the current top row of
+ * the heap cannot contain a row that has to be returned before it, so we
+ * only need to open new batches until the bound of the next compressed
+ * tuple is past the top row.
+ */
+static TupleTableSlot *
+decompress_chunk_merge_next(DecompressChunkState *state)
+{
+	SortSupport first_key = &state->sortkeys[0];
+
+	/* move on from the row returned last */
+	if (state->merge_top >= 0)
+	{
+		if (batch_merge_advance(state, state->merge_top))
+			binaryheap_replace_first(state->merge_heap, Int32GetDatum(state->merge_top));
+		else
+			binaryheap_remove_first(state->merge_heap);
+
+		state->merge_top = -1;
+	}
+
+	while (!state->merge_input_done)
+	{
+		if (state->merge_next_compressed == NULL)
+		{
+			TupleTableSlot *subslot = decompress_chunk_fetch_compressed(state);
+
+			if (TupIsNull(subslot))
+			{
+				state->merge_input_done = true;
+				break;
 			}
+
+			state->merge_next_compressed = subslot;
 		}
 
-		if (batch_done)
+		if (state->merge_heap != NULL && !binaryheap_empty(state->merge_heap))
 		{
-			state->initialized = false;
-			continue;
+			TupleTableSlot *top =
+				state->batches[DatumGetInt32(binaryheap_first(state->merge_heap))].slot;
+			bool bound_isnull, top_isnull;
+			Datum bound = slot_getattr(state->merge_next_compressed,
+									   AttrOffsetGetAttrNumber(state->bound_column),
+									   &bound_isnull);
+			Datum top_value = slot_getattr(top, first_key->ssup_attno, &top_isnull);
+
+			if (ApplySortComparator(bound, bound_isnull, top_value, top_isnull, first_key) > 0)
+				break;
 		}
 
-		ExecStoreVirtualTuple(slot);
+		batch_merge_open_batch(state);
+	}
+
+	if (state->merge_heap == NULL || binaryheap_empty(state->merge_heap))
+		return NULL;
 
-		return slot;
+	state->merge_top = DatumGetInt32(binaryheap_first(state->merge_heap));
+
+	return state->batches[state->merge_top].slot;
+}
+
+/*
+ * Load the next batch for a parent node that consumes whole batches instead of
+ * tuples, like VectorAgg. Returns false when there are no more batches.
+ *
+ * On return state->selection, if not NULL, has a bit set for every row that
+ * passes all quals of the scan. Quals that cannot be evaluated vectorized are
+ * evaluated here row by row, so the caller never has to look at the scan qual.
+ * The compressed columns hold the decompressed batch unless no row passes
+ * the quals, in which case columns not referenced by the quals may not have
+ * been decompressed.
+ */
+bool
+decompress_chunk_next_batch(DecompressChunkState *state)
+{
+	PlanState *ps = &state->csstate.ss.ps;
+	TupleTableSlot *subslot = decompress_chunk_fetch_compressed(state);
+	int row;
+
+	if (TupIsNull(subslot))
+		return false;
+
+	initialize_batch(state, subslot);
+
+	/* the batch is consumed as a whole, so it is not available for tuple retrieval */
+	state->initialized = false;
+
+	if (state->batch_qual != NULL)
+	{
+		ExprContext *econtext = ps->ps_ExprContext;
+		TupleTableSlot *slot = state->csstate.ss.ss_ScanTupleSlot;
+
+		if (state->selection == NULL)
+		{
+			int num_words = DECOMPRESSED_BATCH_VALIDITY_WORDS(state->batch_rows);
+
+			state->selection =
+				MemoryContextAlloc(state->per_batch_context, sizeof(uint64) * Max(num_words, 1));
+			memset(state->selection, 0xFF, sizeof(uint64) * num_words);
+			if (state->batch_rows % 64 != 0)
+				state->selection[num_words - 1] = (UINT64CONST(1) << (state->batch_rows % 64)) - 1;
+		}
+
+		for (row = 0; row < state->batch_rows; row++)
+		{
+			uint64 bit = UINT64CONST(1) << (row % 64);
+
+			if ((state->selection[row / 64] & bit) == 0)
+				continue;
+
+			ResetExprContext(econtext);
+			decompress_chunk_store_row(state, slot, row);
+			econtext->ecxt_scantuple = slot;
+
+			if (!ExecQual(state->batch_qual, econtext))
+			{
+				InstrCountFiltered1(&state->csstate, 1);
+				state->selection[row / 64] &= ~bit;
+			}
+		}
+
+		ExecClearTuple(slot);
 	}
+
+	if (state->selection == NULL || !selection_is_empty(state->selection, state->batch_rows))
+		decompress_chunk_decompress_lazy_columns(state);
+
+	return true;
+}
+
+/*
+ * Number of words of the claim bitmap for a compressed chunk of nblocks blocks
+ */
+static Size
+claim_bitmap_words(BlockNumber nblocks)
+{
+	return (Size) (((uint64) nblocks * MaxHeapTuplesPerPage + 31) / 32);
+}
+
+/*
+ * Try to claim the batch of a compressed tuple for this participant. Without
+ * shared state every batch belongs to us.
+ *
+ * Claiming works independently of the order in which the participants see
+ * the compressed tuples, so it does not matter if their scans start at
+ * different blocks. A participant that is busy decompressing a large batch
+ * does not claim any new ones, so the batches go to whichever participant
+ * is free.
+ */
+static bool
+decompress_chunk_claim_batch(DecompressChunkState *state, TupleTableSlot *slot)
+{
+	ParallelDecompressChunkState *pstate = state->pstate;
+	ItemPointer tid;
+	bool isnull;
+	uint64 bit;
+	uint32 mask;
+
+	if (pstate == NULL)
+		return true;
+
+	/* the compressed scan projects, so the TID is part of its targetlist */
+	tid = DatumGetItemPointer(
+		slot_getattr(slot, AttrOffsetGetAttrNumber(state->ctid_column), &isnull));
+	Assert(!isnull);
+
+	/*
+	 * Tuples visible to our snapshot existed when the shared state was
+	 * sized, so they are always within the bitmap.
+	 */
+	if (!ItemPointerIsValid(tid) || ItemPointerGetBlockNumber(tid) >= pstate->nblocks)
+		elog(ERROR, "unexpected compressed tuple in parallel decompression");
+
+	bit = (uint64) ItemPointerGetBlockNumber(tid) * MaxHeapTuplesPerPage +
+		  (ItemPointerGetOffsetNumber(tid) - FirstOffsetNumber);
+	mask = UINT32CONST(1) << (bit % 32);
+
+	return (pg_atomic_fetch_or_u32(&pstate->claimed[bit / 32], mask) & mask) == 0;
+}
+
+/*
+ * Fetch the next compressed tuple whose batch we should decompress
+ */
+static TupleTableSlot *
+decompress_chunk_fetch_compressed(DecompressChunkState *state)
+{
+	while (true)
+	{
+		TupleTableSlot *subslot = ExecProcNode(linitial(state->csstate.custom_ps));
+
+		if (TupIsNull(subslot) || decompress_chunk_claim_batch(state, subslot))
+			return subslot;
+	}
+}
+
+/*
+ * Estimate the amount of dynamic shared memory needed for the claim bitmap.
+ *
+ * This is only called for the parallel aware plans with a non-parallel seq
+ * scan of the compressed chunk below, see
+ * decompress_chunk_add_batch_distribution_path(). The estimate happens after
+ * the query snapshot was taken, so every compressed tuple we can see is in
+ * one of the current blocks of the compressed chunk.
+ */
+static Size
+decompress_chunk_estimate_dsm(CustomScanState *node, ParallelContext *pcxt)
+{
+	DecompressChunkState *state = (DecompressChunkState *) node;
+	ScanState *compressed_scan = linitial(node->custom_ps);
+	Size words;
+
+	Assert(IsA(compressed_scan, SeqScanState));
+	state->parallel_nblocks = RelationGetNumberOfBlocks(compressed_scan->ss_currentRelation);
+	words = claim_bitmap_words(state->parallel_nblocks);
+
+	return add_size(offsetof(ParallelDecompressChunkState, claimed),
+					mul_size(sizeof(pg_atomic_uint32), words));
+}
+
+static void
+decompress_chunk_initialize_dsm(CustomScanState *node, ParallelContext *pcxt, void *coordinate)
+{
+	DecompressChunkState *state = (DecompressChunkState *) node;
+	ParallelDecompressChunkState *pstate = (ParallelDecompressChunkState *) coordinate;
+	Size words = claim_bitmap_words(state->parallel_nblocks);
+	Size i;
+
+	pstate->nblocks = state->parallel_nblocks;
+	for (i = 0; i < words; i++)
+		pg_atomic_init_u32(&pstate->claimed[i], 0);
+
+	/* the leader claims batches like the workers */
+	state->pstate = pstate;
+}
+
+/*
+ * Only the shared state is reset here, the local state is reset by
+ * decompress_chunk_rescan.
+ */
+static void
+decompress_chunk_reinitialize_dsm(CustomScanState *node, ParallelContext *pcxt, void *coordinate)
+{
+	ParallelDecompressChunkState *pstate = (ParallelDecompressChunkState *) coordinate;
+	Size words = claim_bitmap_words(pstate->nblocks);
+	Size i;
+
+	for (i = 0; i < words; i++)
+		pg_atomic_write_u32(&pstate->claimed[i], 0);
+}
+
+static void
+decompress_chunk_initialize_worker(CustomScanState *node, shm_toc *toc, void *coordinate)
+{
+	DecompressChunkState *state = (DecompressChunkState *) node;
+
+	state->pstate = (ParallelDecompressChunkState *) coordinate;
 }
@@ -8,10 +8,168 @@
 #define TIMESCALEDB_DECOMPRESS_CHUNK_EXEC_H
 
 #include <postgres.h>
+#include <lib/binaryheap.h>
+#include <nodes/execnodes.h>
+#include <port/atomics.h>
+#include <storage/block.h>
+#include <utils/sortsupport.h>
+
+#include "compression/compression.h"
 
 #define DECOMPRESS_CHUNK_COUNT_ID -9
 #define DECOMPRESS_CHUNK_SEQUENCE_NUM_ID -10
+#define DECOMPRESS_CHUNK_BATCH_BOUND_ID -11
+#define DECOMPRESS_CHUNK_CTID_ID -12
+#define DECOMPRESS_CHUNK_METADATA_ID -13
+
+typedef enum DecompressChunkColumnType
+{
+	SEGMENTBY_COLUMN,
+	COMPRESSED_COLUMN,
+	COUNT_COLUMN,
+	SEQUENCE_NUM_COLUMN,
+	BATCH_BOUND_COLUMN,
+	CTID_COLUMN,
+	METADATA_COLUMN,
+} DecompressChunkColumnType;
+
+typedef struct DecompressChunkColumnState
+{
+	DecompressChunkColumnType type;
+	Oid typid;
+	bool typbyval;
+	AttrNumber attno;
+	union
+	{
+		struct
+		{
+			Datum value;
+			bool isnull;
+			int count;
+		} segmentby;
+		struct
+		{
+			/* all rows of the current batch, NULL if the whole column is NULL */
+			DecompressedBatch *batch;
+			/*
+			 * Columns that are not referenced by any qual are only decompressed
+			 * once a row of the batch passes the quals, until then we keep the
+			 * compressed value here.
+			 */
+			bool lazy;
+			/*
+			 * Only referenced by quals that are proven by the batch metadata,
+			 * so not needed for proven batches.
+			 */
+			bool qual_only;
+			bool decompressed;
+			Datum value;
+		} compressed;
+	};
+} DecompressChunkColumnState;
+
+/*
+ * State of a batch that is kept open while merging the batches of different
+ * segments. The fields mirror the current batch fields of DecompressChunkState
+ * and are swapped into it whenever the batch is accessed.
+ */
+typedef struct DecompressBatchState
+{
+	DecompressChunkColumnState *columns;
+	int batch_rows;
+	int batch_rows_returned;
+	uint64 *selection;
+	bool lazy_columns_decompressed;
+	MemoryContext per_batch_context;
+	/* copy of the compressed tuple the batch was created from */
+	TupleTableSlot *compressed_slot;
+	/* the current row of the batch */
+	TupleTableSlot *slot;
+} DecompressBatchState;
+
+/*
+ * Shared state of a parallel aware DecompressChunk. Every participant scans all
+ * compressed tuples and decompresses the batches it could claim. A batch is
+ * identified by the TID of its compressed tuple, the bitmap has one bit for
+ * every possible TID of the first nblocks blocks of the compressed chunk.
+ */
+typedef struct ParallelDecompressChunkState
+{
+	BlockNumber nblocks;
+	pg_atomic_uint32 claimed[FLEXIBLE_ARRAY_MEMBER];
+} ParallelDecompressChunkState;
+
+typedef struct DecompressChunkState
+{
+	CustomScanState csstate;
+	List *varattno_map;
+	int num_columns;
+	DecompressChunkColumnState *columns;
+
+	bool initialized;
+	bool reverse;
+	int hypertable_id;
+	Oid chunk_relid;
+	List *hypertable_compression_info;
+
+	/* number of rows in the current batch and the number of rows already returned from it */
+	int batch_rows;
+	int batch_rows_returned;
+
+	/*
+	 * Quals that are evaluated on all rows of a batch at once, see vector_qual.c.
+	 * The remaining quals are evaluated row by row as part of the scan's qual.
+	 */
+	List *vectorized_quals;
+	/* bitmap of the rows in the current batch passing vectorized_quals, NULL if none */
+	uint64 *selection;
+	/* true if the lazy columns of the current batch have been decompressed */
+	bool lazy_columns_decompressed;
+
+	/*
+	 * Batches whose min and max metadata satisfy batch_proofs only have to be
+	 * checked against proven_qual, the quals not referencing compressed
+	 * columns. batch_qual is the qual to check for the rows of the current
+	 * batch. proof_info is built by the planner, see build_batch_proofs().
+	 */
+	List *proof_info;
+	ExprState *batch_proofs;
+	ExprState *proven_qual;
+	ExprState *batch_qual;
+
+	MemoryContext per_batch_context;
+
+	/*
+	 * Batch merge: the output is ordered across the batches of all segments by
+	 * keeping one batch open per overlapping segment and merging their rows.
+	 */
+	bool batch_merge;
+	/* index of the column holding the min or max metadata the batches arrive sorted by */
+	int bound_column;
+	int n_sortkeys;
+	SortSupport sortkeys;
+	/* open batches, unused ones are tracked in free_batches */
+	int n_batches;
+	DecompressBatchState *batches;
+	Bitmapset *free_batches;
+	/* heap of the indexes of the open batches, ordered by their current row */
+	binaryheap *merge_heap;
+	/* batch whose row was returned last, -1 if none */
+	int merge_top;
+	/* next compressed tuple that has not been opened as a batch yet */
+	TupleTableSlot *merge_next_compressed;
+	bool merge_input_done;
+	MemoryContext merge_context;
+
+	/* index of the column holding the TID of the compressed tuple */
+	int ctid_column;
+	/* size of the compressed chunk when the shared state was sized */
+	BlockNumber parallel_nblocks;
+	/* shared state when running parallel aware, NULL otherwise */
+	ParallelDecompressChunkState *pstate;
+} DecompressChunkState;
 
 extern Node *decompress_chunk_state_create(CustomScan *cscan);
+extern bool decompress_chunk_next_batch(DecompressChunkState *state);
 
 #endif /* TIMESCALEDB_DECOMPRESS_CHUNK_EXEC_H */
@@ -5,9 +5,12 @@
  */
 
 #include <postgres.h>
+#include <access/htup_details.h>
+#include <access/stratnum.h>
 #include <access/sysattr.h>
 #include <catalog/pg_namespace.h>
 #include <catalog/pg_operator.h>
+#include <catalog/pg_type.h>
 #include <nodes/bitmapset.h>
 #include <nodes/extensible.h>
 #include <nodes/makefuncs.h>
@@ -17,6 +20,8 @@
 #include <optimizer/tlist.h>
 #include <parser/parsetree.h>
 #include <utils/builtins.h>
+#include <utils/lsyscache.h>
+#include <utils/syscache.h>
 #include <utils/typcache.h>
 
 #include "compat.h"
@@ -40,6 +45,7 @@
 #include "import/planner.h"
 #include "guc.h"
 #include "custom_type_cache.h"
+#include "utils.h"
 
 static CustomScanMethods decompress_chunk_plan_methods = {
 	.CustomName = "DecompressChunk",
@@ -151,6 +157,32 @@ build_scan_tlist(DecompressChunkPath *path)
 		scan_tlist = lappend(scan_tlist, tle);
 	}
 
+	/* add the min or max metadata the compressed scan is sorted by for batch merge */
+	if (path->batch_merge)
+	{
+		tle = makeTargetEntry((Expr *) copyObject(path->batch_bound_var),
+							  list_length(scan_tlist) + 1,
+							  NULL,
+							  false);
+		path->varattno_map = lappend_int(path->varattno_map, DECOMPRESS_CHUNK_BATCH_BOUND_ID);
+		scan_tlist = lappend(scan_tlist, tle);
+	}
+
+	/* add the TID of the compressed tuple, parallel aware scans claim the batches by it */
+	if (path->cpath.path.parallel_aware)
+	{
+		Var *ctid_var = makeVar(path->info->compressed_rel->relid,
+								SelfItemPointerAttributeNumber,
+								TIDOID,
+								-1,
+								InvalidOid,
+								0);
+
+		tle = makeTargetEntry((Expr *) ctid_var, list_length(scan_tlist) + 1, NULL, false);
+		path->varattno_map = lappend_int(path->varattno_map, DECOMPRESS_CHUNK_CTID_ID);
+		scan_tlist = lappend(scan_tlist, tle);
+	}
+
 	/* check for system columns */
 	bit = bms_next_member(attrs_used, -1);
 	if (bit > 0 && bit + FirstLowInvalidHeapAttributeNumber < 0)
@@ -206,6 +238,195 @@ build_scan_tlist(DecompressChunkPath *path)
 	return scan_tlist;
 }
 
+static bool
+qual_references_compressed_columns(CompressionInfo *info, Node *qual)
+{
+	Bitmapset *attnos = NULL;
+	int bit = -1;
+
+	pull_varattnos(qual, info->chunk_rel->relid, &attnos);
+
+	while ((bit = bms_next_member(attnos, bit)) >= 0)
+	{
+		AttrNumber attno = bit + FirstLowInvalidHeapAttributeNumber;
+		FormData_hypertable_compression *column_info;
+
+		if (attno == InvalidAttrNumber)
+			return true;
+		if (attno < 0)
+			continue;
+
+		column_info =
+			get_column_compressioninfo(info->hypertable_compression_info,
+									   get_attname(info->chunk_rte->relid, attno, false));
+		if (column_info->segmentby_column_index <= 0)
+			return true;
+	}
+
+	return false;
+}
+
+static bool
+column_is_not_null(Oid relid, const char *attname)
+{
+	HeapTuple tuple = SearchSysCacheAttName(relid, attname);
+	bool attnotnull;
+
+	if (!HeapTupleIsValid(tuple))
+		return false;
+
+	attnotnull = ((Form_pg_attribute) GETSTRUCT(tuple))->attnotnull;
+	ReleaseSysCache(tuple);
+
+	return attnotnull;
+}
+
+/*
+ * Build the proof that a qual holds for all rows of a batch from the min or
+ * max metadata of the batch. This works for quals comparing a NOT NULL orderby
+ * column with a pseudo-constant, e.g. time > now() - '30d' holds for all rows
+ * if _ts_meta_min_1 > now() - '30d' holds.
+ *
+ * The proof is evaluated on the compressed tuple, so the metadata column is
+ * added to the compressed scan targetlist and referenced by its position.
+ * Returns NULL if the qual cannot be proven from the metadata.
+ */
+static Expr *
+make_batch_proof(DecompressChunkPath *dcpath, Expr *qual, List **scan_tlist)
+{
+	CompressionInfo *info = dcpath->info;
+	OpExpr *op;
+	OpExpr *proof;
+	Var *var;
+	Var *meta_var;
+	Node *other;
+	bool var_on_left;
+	bool use_max;
+	char *column_name;
+	FormData_hypertable_compression *column_info;
+	TypeCacheEntry *tce;
+	AttrNumber meta_attno;
+	TargetEntry *tle;
+
+	if (!IsA(qual, OpExpr) || list_length(castNode(OpExpr, qual)->args) != 2)
+		return NULL;
+
+	op = castNode(OpExpr, qual);
+	var_on_left = IsA(linitial(op->args), Var);
+	var = var_on_left ? linitial(op->args) : lsecond(op->args);
+	other = var_on_left ? lsecond(op->args) : linitial(op->args);
+
+	if (!IsA(var, Var) || var->varno != info->chunk_rel->relid || var->varattno <= 0 ||
+		!is_pseudo_constant_clause(other))
+		return NULL;
+
+	column_name = get_attname(info->chunk_rte->relid, var->varattno, false);
+	column_info = get_column_compressioninfo(info->hypertable_compression_info, column_name);
+
+	/* min and max ignore NULLs, so they only describe all rows of NOT NULL columns */
+	if (column_info->orderby_column_index <= 0 ||
+		!column_is_not_null(info->chunk_rte->relid, column_name))
+		return NULL;
+
+	tce = lookup_type_cache(var->vartype, TYPECACHE_BTREE_OPFAMILY);
+	if (!OidIsValid(tce->btree_opf))
+		return NULL;
+
+	switch (get_op_opfamily_strategy(op->opno, tce->btree_opf))
+	{
+		case BTLessStrategyNumber:
+		case BTLessEqualStrategyNumber:
+			/* column < value, or value < column */
+			use_max = var_on_left;
+			break;
+		case BTGreaterStrategyNumber:
+		case BTGreaterEqualStrategyNumber:
+			use_max = !var_on_left;
+			break;
+		default:
+			return NULL;
+	}
+
+	meta_attno = get_attnum(info->compressed_rte->relid,
+							use_max ? compression_column_segment_max_name(column_info) :
+									  compression_column_segment_min_name(column_info));
+	if (meta_attno == InvalidAttrNumber)
+		return NULL;
+
+	tle = makeTargetEntry((Expr *) makeVar(info->compressed_rel->relid,
+										   meta_attno,
+										   var->vartype,
+										   var->vartypmod,
+										   var->varcollid,
+										   0),
+						  list_length(*scan_tlist) + 1,
+						  NULL,
+						  false);
+	*scan_tlist = lappend(*scan_tlist, tle);
+	dcpath->varattno_map = lappend_int(dcpath->varattno_map, DECOMPRESS_CHUNK_METADATA_ID);
+
+	meta_var = makeVar(info->chunk_rel->relid,
+					   tle->resno,
+					   var->vartype,
+					   var->vartypmod,
+					   var->varcollid,
+					   0);
+	proof = copyObject(op);
+	proof->args = var_on_left ? list_make2(meta_var, copyObject(other)) :
+								list_make2(copyObject(other), meta_var);
+
+	return (Expr *) proof;
+}
+
+/*
+ * Split the quals of the scan for batches that are proven by their metadata.
+ *
+ * If every qual referencing compressed columns can be proven from the batch
+ * metadata, this returns a list of the proofs and of the remaining quals. For
+ * batches satisfying all proofs only the remaining quals have to be checked,
+ * so the compressed columns only referenced by quals are never decompressed.
+ * Returns NIL if the quals cannot be proven.
+ */
+static List *
+build_batch_proofs(DecompressChunkPath *dcpath, List *quals, List **scan_tlist)
+{
+	int scan_tlist_length = list_length(*scan_tlist);
+	int varattno_map_length = list_length(dcpath->varattno_map);
+	List *proofs = NIL;
+	List *remaining_quals = NIL;
+	ListCell *lc;
+
+	foreach (lc, quals)
+	{
+		Expr *qual = lfirst(lc);
+		Expr *proof;
+
+		if (!qual_references_compressed_columns(dcpath->info, (Node *) qual))
+		{
+			remaining_quals = lappend(remaining_quals, qual);
+			continue;
+		}
+
+		proof = make_batch_proof(dcpath, qual, scan_tlist);
+		if (proof == NULL)
+		{
+			/* remove the metadata columns added for the other quals again */
+			*scan_tlist = list_truncate(*scan_tlist, scan_tlist_length);
+			dcpath->varattno_map = list_truncate(dcpath->varattno_map, varattno_map_length);
+			return NIL;
+		}
+		proofs = lappend(proofs, proof);
+	}
+
+	if (proofs == NIL)
+		return NIL;
+
+	/* the proofs are not processed by set_plan_references */
+	fix_opfuncids((Node *) proofs);
+
+	return list_make2(proofs, remaining_quals);
+}
+
 /* replace vars that reference the compressed table with ones that reference the
  * uncompressed one. Based on replace_nestloop_params
  */
@@ -280,6 +501,42 @@ clause_has_compressed_attrs(Node *node, void *context)
 	return expression_tree_walker(node, clause_has_compressed_attrs, context);
 }
 
+/*
+ * build the sort keys the executor merges the batches on from the pathkeys of
+ * a batch merge path: lists of chunk attribute numbers, sort operators,
+ * collations and nulls first flags
+ */
+static List *
+build_batch_merge_sortinfo(DecompressChunkPath *path)
+{
+	List *attnos = NIL;
+	List *sortops = NIL;
+	List *collations = NIL;
+	List *nulls_first = NIL;
+	ListCell *lc;
+
+	foreach (lc, path->cpath.path.pathkeys)
+	{
+		PathKey *pk = lfirst(lc);
+		Var *var = (Var *) ts_find_em_expr_for_rel(pk->pk_eclass, path->info->chunk_rel);
+		Oid sortop;
+
+		if (var == NULL || !IsA(var, Var))
+			elog(ERROR, "invalid pathkey for batch merge");
+
+		sortop = get_opfamily_member(pk->pk_opfamily, var->vartype, var->vartype, pk->pk_strategy);
+		if (!OidIsValid(sortop))
+			elog(ERROR, "missing operator for batch merge");
+
+		attnos = lappend_int(attnos, var->varattno);
+		sortops = lappend_oid(sortops, sortop);
+		collations = lappend_oid(collations, pk->pk_eclass->ec_collation);
+		nulls_first = lappend_int(nulls_first, pk->pk_nulls_first);
+	}
+
+	return list_make4(attnos, sortops, collations, nulls_first);
+}
+
 Plan *
 decompress_chunk_plan_create(PlannerInfo *root, RelOptInfo *rel, CustomPath *path, List *tlist,
 							 List *clauses, List *custom_plans)
@@ -289,6 +546,7 @@ decompress_chunk_plan_create(PlannerInfo *root, RelOptInfo *rel, CustomPath *pat
 	Scan *compressed_scan = linitial(custom_plans);
 	Path *compressed_path = linitial(path->custom_paths);
 	List *settings;
+	List *batch_proofs = NIL;
 
 	Assert(list_length(custom_plans) == 1);
 	Assert(list_length(path->custom_paths) == 1);
@@ -357,6 +615,10 @@ decompress_chunk_plan_create(PlannerInfo *root, RelOptInfo *rel, CustomPath *pat
 		(List *) replace_compressed_vars((Node *) cscan->scan.plan.qual, dcpath->info);
 
 	compressed_scan->plan.targetlist = build_scan_tlist(dcpath);
+
+	if (ts_guc_enable_compressed_metadata_scan && !dcpath->batch_merge)
+		batch_proofs =
+			build_batch_proofs(dcpath, cscan->scan.plan.qual, &compressed_scan->plan.targetlist);
 	if (!pathkeys_contained_in(dcpath->compressed_pathkeys, compressed_path->pathkeys))
 	{
 		List *compressed_pks = dcpath->compressed_pathkeys;
@@ -372,10 +634,15 @@ decompress_chunk_plan_create(PlannerInfo *root, RelOptInfo *rel, CustomPath *pat
 
 	Assert(list_length(custom_plans) == 1);
 
-	settings = list_make3_int(dcpath->info->hypertable_id,
+	settings = list_make4_int(dcpath->info->hypertable_id,
 							  dcpath->info->chunk_rte->relid,
-							  dcpath->reverse);
-	cscan->custom_private = list_make2(settings, dcpath->varattno_map);
+							  dcpath->reverse,
+							  dcpath->batch_merge);
+	cscan->custom_private = list_make4(settings,
+									   dcpath->varattno_map,
+									   dcpath->batch_merge ? build_batch_merge_sortinfo(dcpath) :
+															 NIL,
+									   batch_proofs);
 
 	return &cscan->scan.plan;
 }
@@ -9,7 +9,9 @@
 #include <optimizer/restrictinfo.h>
 #include <parser/parsetree.h>
 #include <parser/parse_func.h>
+#include <utils/array.h>
 #include <utils/builtins.h>
+#include <utils/lsyscache.h>
 #include <utils/typcache.h>
 
 #include "compat.h"
@@ -27,14 +29,15 @@
 #include "hypertable_compression.h"
 #include "compression/create.h"
 #include "custom_type_cache.h"
+#include "extension_constants.h"
 #include "compression/segment_meta.h"
 
 typedef struct QualPushdownContext
 {
-	RelOptInfo *chunk_rel;
-	RelOptInfo *compressed_rel;
-	RangeTblEntry *chunk_rte;
-	RangeTblEntry *compressed_rte;
+	Index chunk_varno;
+	Oid chunk_relid;
+	Index compressed_varno;
+	Oid compressed_relid;
 	List *compression_info;
 	bool can_pushdown;
 	bool needs_recheck;
@@ -49,10 +52,10 @@ pushdown_quals(PlannerInfo *root, RelOptInfo *chunk_rel, RelOptInfo *compressed_
 	ListCell *lc;
 	List *decompress_clauses = NIL;
 	QualPushdownContext context = {
-		.chunk_rel = chunk_rel,
-		.compressed_rel = compressed_rel,
-		.chunk_rte = planner_rt_fetch(chunk_rel->relid, root),
-		.compressed_rte = planner_rt_fetch(compressed_rel->relid, root),
+		.chunk_varno = chunk_rel->relid,
+		.chunk_relid = planner_rt_fetch(chunk_rel->relid, root)->relid,
+		.compressed_varno = compressed_rel->relid,
+		.compressed_relid = planner_rt_fetch(compressed_rel->relid, root)->relid,
 		.compression_info = compression_info,
 	};
 
@@ -99,19 +102,63 @@ pushdown_quals(PlannerInfo *root, RelOptInfo *chunk_rel, RelOptInfo *compressed_
 	chunk_rel->baserestrictinfo = decompress_clauses;
 }
 
+/*
+ * Translate plain restriction clauses on an uncompressed chunk into clauses
+ * on its compressed chunk. Only clauses that can be evaluated against the
+ * segmentby columns and segment metadata are returned; clauses that cannot be
+ * pushed down are dropped, so the result selects a superset of the batches
+ * containing matching rows.
+ */
+List *
+pushdown_quals_to_compressed_chunk(List *clauses, Index chunk_varno, Oid chunk_relid,
+								   Index compressed_varno, Oid compressed_relid,
+								   List *compression_info)
+{
+	ListCell *lc;
+	List *pushed = NIL;
+	QualPushdownContext context = {
+		.chunk_varno = chunk_varno,
+		.chunk_relid = chunk_relid,
+		.compressed_varno = compressed_varno,
+		.compressed_relid = compressed_relid,
+		.compression_info = compression_info,
+	};
+
+	foreach (lc, clauses)
+	{
+		Node *clause = lfirst(lc);
+		Expr *expr;
+
+		if (contain_volatile_functions(clause))
+			continue;
+
+		context.can_pushdown = true;
+		context.needs_recheck = false;
+		expr = (Expr *) modify_expression(clause, &context);
+		if (!context.can_pushdown)
+			continue;
+
+		if (IsA(expr, BoolExpr) && ((BoolExpr *) expr)->boolop == AND_EXPR)
+			pushed = list_concat(pushed, list_copy(((BoolExpr *) expr)->args));
+		else
+			pushed = lappend(pushed, expr);
+	}
+	return pushed;
+}
+
 static inline FormData_hypertable_compression *
 get_compression_info_from_var(QualPushdownContext *context, Var *var)
 {
 	char *column_name;
 	/* Not on the chunk we expect */
-	if (var->varno != context->chunk_rel->relid)
+	if (var->varno != context->chunk_varno)
 		return NULL;
 
 	/* ignore system attibutes or whole row references */
 	if (var->varattno <= 0)
 		return NULL;
 
-	column_name = get_attname(context->chunk_rte->relid, var->varattno, false);
+	column_name = get_attname(context->chunk_relid, var->varattno, false);
 	return get_column_compressioninfo(context->compression_info, column_name);
 }
 
@@ -119,7 +166,7 @@ static OpExpr *
 make_segment_meta_opexpr(QualPushdownContext *context, Oid opno, AttrNumber meta_column_attno,
 						 Var *uncompressed_var, Expr *compare_to_expr, StrategyNumber strategy)
 {
-	Var *meta_var = makeVar(context->compressed_rel->relid,
+	Var *meta_var = makeVar(context->compressed_varno,
 							meta_column_attno,
 							uncompressed_var->vartype,
 							-1,
@@ -276,16 +323,16 @@ pushdown_op_to_segment_meta_min_max(QualPushdownContext *context, List *expr_arg
 				make_segment_meta_opexpr(context,
 										 opno_le,
 										 get_segment_meta_min_attr_number(compression_info,
-																		  context->compressed_rte
-																			  ->relid),
+																		  context
+																			  ->compressed_relid),
 										 var_with_segment_meta,
 										 expr,
 										 BTLessEqualStrategyNumber),
 				make_segment_meta_opexpr(context,
 										 opno_ge,
 										 get_segment_meta_max_attr_number(compression_info,
-																		  context->compressed_rte
-																			  ->relid),
+																		  context
+																			  ->compressed_relid),
 										 var_with_segment_meta,
 										 expr,
 										 BTGreaterEqualStrategyNumber)));
@@ -338,6 +385,193 @@ pushdown_op_to_segment_meta_min_max(QualPushdownContext *context, List *expr_arg
 	}
 }
 
+/*
+ * Returns the attribute number of the bloom filter metadata column of the
+ * given var in the compressed chunk or InvalidAttrNumber if the column has
+ * no bloom filter.
+ */
+static AttrNumber
+get_segment_meta_bloom_attr_number(QualPushdownContext *context, Expr *expr)
+{
+	FormData_hypertable_compression *compression_info;
+	char *meta_col_name;
+
+	if (!IsA(expr, Var))
+		return InvalidAttrNumber;
+
+	compression_info = get_compression_info_from_var(context, (Var *) expr);
+	if (compression_info == NULL || compression_info->segmentby_column_index > 0)
+		return InvalidAttrNumber;
+
+	meta_col_name = compression_column_segment_bloom_name(NameStr(compression_info->attname));
+	if (meta_col_name == NULL)
+		return InvalidAttrNumber;
+
+	return get_attnum(context->compressed_relid, meta_col_name);
+}
+
+static Expr *
+make_segment_meta_bloom_funcexpr(QualPushdownContext *context, AttrNumber bloom_attno,
+								 Var *uncompressed_var, Expr *value)
+{
+	Oid argtypes[] = { BYTEAOID, ANYELEMENTOID };
+	Oid funcid =
+		LookupFuncName(list_make2(makeString(INTERNAL_SCHEMA_NAME), makeString("bloom1_contains")),
+					   lengthof(argtypes),
+					   argtypes,
+					   false);
+	Var *bloom_var =
+		makeVar(context->compressed_varno, bloom_attno, BYTEAOID, -1, InvalidOid, 0);
+
+	return (Expr *) makeFuncExpr(funcid,
+								 BOOLOID,
+								 list_make2(bloom_var, copyObject(value)),
+								 InvalidOid,
+								 uncompressed_var->varcollid,
+								 COERCE_EXPLICIT_CALL);
+}
+
+/*
+ * Check whether the operator is the equality operator of the default hash
+ * opclass of the var type and the collation matches the one the bloom filter
+ * was built with. Only then a value that is not in the filter cannot match.
+ */
+static bool
+bloom_filter_can_check_op(Var *var, Oid op_oid, Oid op_collation, Oid expr_type_id)
+{
+	TypeCacheEntry *tce = lookup_type_cache(var->vartype, TYPECACHE_EQ_OPR | TYPECACHE_HASH_PROC);
+
+	return OidIsValid(tce->hash_proc) && op_oid == tce->eq_opr && expr_type_id == var->vartype &&
+		   op_collation == var->varcollid;
+}
+
+/*
+ * var = expr implies bloom1_contains(bloom, expr) for columns that have a
+ * bloom filter.
+ */
+static Expr *
+pushdown_op_to_segment_meta_bloom(QualPushdownContext *context, List *expr_args, Oid op_oid,
+								  Oid op_collation)
+{
+	Expr *leftop, *rightop, *expr;
+	Var *var;
+	AttrNumber bloom_attno;
+
+	if (list_length(expr_args) != 2)
+		return NULL;
+
+	leftop = linitial(expr_args);
+	rightop = lsecond(expr_args);
+
+	if (IsA(leftop, RelabelType))
+		leftop = ((RelabelType *) leftop)->arg;
+	if (IsA(rightop, RelabelType))
+		rightop = ((RelabelType *) rightop)->arg;
+
+	if ((bloom_attno = get_segment_meta_bloom_attr_number(context, leftop)) != InvalidAttrNumber)
+	{
+		var = (Var *) leftop;
+		expr = rightop;
+	}
+	else if ((bloom_attno = get_segment_meta_bloom_attr_number(context, rightop)) !=
+			 InvalidAttrNumber)
+	{
+		var = (Var *) rightop;
+		expr = leftop;
+	}
+	else
+		return NULL;
+
+	if (!bloom_filter_can_check_op(var, op_oid, op_collation, exprType((Node *) expr)))
+		return NULL;
+
+	expr = get_pushdownsafe_expr(context, expr);
+	if (expr == NULL)
+		return NULL;
+
+	return make_segment_meta_bloom_funcexpr(context, bloom_attno, var, expr);
+}
+
+/*
+ * var = ANY(const array) implies that one of the array elements is in the
+ * bloom filter.
+ */
+static Expr *
+pushdown_saop_to_segment_meta_bloom(QualPushdownContext *context, ScalarArrayOpExpr *saop)
+{
+	Expr *leftop, *rightop;
+	Var *var;
+	AttrNumber bloom_attno;
+	Const *array_const;
+	ArrayType *array;
+	int16 elmlen;
+	bool elmbyval;
+	char elmalign;
+	Datum *elem_values;
+	bool *elem_nulls;
+	int num_elems;
+	int i;
+	List *checks = NIL;
+
+	if (!saop->useOr || list_length(saop->args) != 2)
+		return NULL;
+
+	leftop = linitial(saop->args);
+	rightop = lsecond(saop->args);
+
+	if (IsA(leftop, RelabelType))
+		leftop = ((RelabelType *) leftop)->arg;
+
+	if ((bloom_attno = get_segment_meta_bloom_attr_number(context, leftop)) == InvalidAttrNumber)
+		return NULL;
+
+	var = (Var *) leftop;
+
+	if (!IsA(rightop, Const) || castNode(Const, rightop)->constisnull)
+		return NULL;
+
+	array_const = castNode(Const, rightop);
+	if (get_element_type(array_const->consttype) != var->vartype ||
+		!bloom_filter_can_check_op(var, saop->opno, saop->inputcollid, var->vartype))
+		return NULL;
+
+	array = DatumGetArrayTypeP(array_const->constvalue);
+	get_typlenbyvalalign(var->vartype, &elmlen, &elmbyval, &elmalign);
+	deconstruct_array(array,
+					  var->vartype,
+					  elmlen,
+					  elmbyval,
+					  elmalign,
+					  &elem_values,
+					  &elem_nulls,
+					  &num_elems);
+
+	for (i = 0; i < num_elems; i++)
+	{
+		/* NULL elements never match */
+		if (elem_nulls[i])
+			continue;
+
+		checks = lappend(checks,
+						 make_segment_meta_bloom_funcexpr(context,
+														  bloom_attno,
+														  var,
+														  (Expr *) makeConst(var->vartype,
+																			 var->vartypmod,
+																			 var->varcollid,
+																			 elmlen,
+																			 elem_values[i],
+																			 false,
+																			 elmbyval)));
+	}
+
+	if (checks == NIL)
+		return (Expr *) makeBoolConst(false, false);
+	if (list_length(checks) == 1)
+		return linitial(checks);
+	return make_orclause(checks);
+}
+
 static Node *
 modify_expression(Node *node, QualPushdownContext *context)
 {
@@ -355,6 +589,11 @@ modify_expression(Node *node, QualPushdownContext *context)
 															   opexpr->args,
 															   opexpr->opno,
 															   opexpr->inputcollid);
+				if (pd == NULL)
+					pd = pushdown_op_to_segment_meta_bloom(context,
+														   opexpr->args,
+														   opexpr->opno,
+														   opexpr->inputcollid);
 				if (pd != NULL)
 				{
 					context->needs_recheck = true;
@@ -366,6 +605,16 @@ modify_expression(Node *node, QualPushdownContext *context)
 			break;
 		}
 		case T_ScalarArrayOpExpr:
+		{
+			Expr *pd = pushdown_saop_to_segment_meta_bloom(context, (ScalarArrayOpExpr *) node);
+			if (pd != NULL)
+			{
+				context->needs_recheck = true;
+				return (Node *) pd;
+			}
+			/* the array op will still be checked for segment by columns */
+			break;
+		}
 		case T_List:
 		case T_Const:
 		case T_NullTest:
@@ -393,8 +642,8 @@ modify_expression(Node *node, QualPushdownContext *context)
 
 			var = copyObject(var);
 			compressed_attno =
-				get_attnum(context->compressed_rte->relid, compressioninfo->attname.data);
-			var->varno = context->compressed_rel->relid;
+				get_attnum(context->compressed_relid, compressioninfo->attname.data);
+			var->varno = context->compressed_varno;
 			var->varattno = compressed_attno;
 
 			return (Node *) var;
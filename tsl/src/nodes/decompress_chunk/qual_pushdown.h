@@ -8,3 +8,6 @@
 
 void pushdown_quals(PlannerInfo *root, RelOptInfo *chunk_rel, RelOptInfo *compressed_rel,
 					List *compression_info);
+List *pushdown_quals_to_compressed_chunk(List *clauses, Index chunk_varno, Oid chunk_relid,
+										 Index compressed_varno, Oid compressed_relid,
+										 List *compression_info);
@@ -0,0 +1,630 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+/*
+ * Vectorized evaluation of filters in DecompressChunk.
+ *
+ * Filters of the form `column op constant` on compressed columns, and AND/OR
+ * combinations of them, are evaluated once per batch over the bulk
+ * decompressed column values instead of once per decompressed tuple. The
+ * result is a bitmap with one bit per row of the batch, and only the rows
+ * that have their bit set are materialized into tuples. All other filters are
+ * left to the regular per-tuple qual evaluation.
+ *
+ * Since only the rows for which the filter is true are returned, AND and OR
+ * map to bitwise operations on the bitmaps even in the presence of NULLs. NOT
+ * does not have this property and is therefore not vectorized.
+ *
+ * Filters of the form `column op ANY/ALL (constant array)`, e.g. IN lists,
+ * are vectorized as well. For dictionary compressed batches the filter is
+ * evaluated once per distinct value of the batch and the rows are then
+ * selected by their dictionary code, so the comparison function is not
+ * called for every row.
+ */
+#include <postgres.h>
+#include <access/stratnum.h>
+#include <catalog/pg_proc.h>
+#include <catalog/pg_type.h>
+#include <fmgr.h>
+#include <nodes/nodeFuncs.h>
+#include <nodes/primnodes.h>
+#include <utils/array.h>
+#include <utils/lsyscache.h>
+#include <utils/typcache.h>
+
+#include "compat.h"
+#include "compression/compression.h"
+#include "nodes/decompress_chunk/exec.h"
+#include "nodes/decompress_chunk/vector_qual.h"
+
+typedef enum VectorQualType
+{
+	VQ_COMPARE,
+	VQ_ARRAY_COMPARE,
+	VQ_AND,
+	VQ_OR,
+} VectorQualType;
+
+/*
+ * Integer-like types that we compare with specialized loops instead of
+ * calling the comparison function for every row.
+ */
+typedef enum VectorQualIntKind
+{
+	VQ_INT_NONE,
+	VQ_INT16,
+	VQ_INT32,
+	VQ_INT64,
+} VectorQualIntKind;
+
+typedef struct VectorQual
+{
+	VectorQualType type;
+
+	/* VQ_AND and VQ_OR */
+	List *args;
+
+	/* VQ_COMPARE and VQ_ARRAY_COMPARE */
+	int column_index;
+	Datum constvalue;
+	bool constisnull;
+	/* true if the constant is the left operand of the operator */
+	bool const_is_left;
+	/* the btree strategy of the operator with the column on the left, for specialized loops */
+	StrategyNumber strategy;
+	VectorQualIntKind int_kind;
+	FmgrInfo flinfo;
+	FunctionCallInfo fcinfo;
+
+	/* VQ_ARRAY_COMPARE: the column is compared with ANY or ALL of the array elements */
+	bool use_or;
+	int num_elements;
+	Datum *elements;
+	bool *elements_isnull;
+} VectorQual;
+
+#define ROW_WORD(row) ((row) / 64)
+#define ROW_BIT(row) (UINT64CONST(1) << ((row) % 64))
+
+static int
+find_compressed_column(DecompressChunkState *state, AttrNumber attno)
+{
+	int i;
+
+	for (i = 0; i < state->num_columns; i++)
+	{
+		if (state->columns[i].type == COMPRESSED_COLUMN && state->columns[i].attno == attno)
+			return i;
+	}
+
+	return -1;
+}
+
+static StrategyNumber
+commute_strategy(StrategyNumber strategy)
+{
+	switch (strategy)
+	{
+		case BTLessStrategyNumber:
+			return BTGreaterStrategyNumber;
+		case BTLessEqualStrategyNumber:
+			return BTGreaterEqualStrategyNumber;
+		case BTGreaterStrategyNumber:
+			return BTLessStrategyNumber;
+		case BTGreaterEqualStrategyNumber:
+			return BTLessEqualStrategyNumber;
+		default:
+			return strategy;
+	}
+}
+
+static VectorQualIntKind
+int_kind_for_type(Oid typid)
+{
+	switch (typid)
+	{
+		case INT2OID:
+			return VQ_INT16;
+		case INT4OID:
+		case DATEOID:
+			return VQ_INT32;
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			/* on platforms where 64-bit values are passed by reference use the generic path */
+			return FLOAT8PASSBYVAL ? VQ_INT64 : VQ_INT_NONE;
+		default:
+			return VQ_INT_NONE;
+	}
+}
+
+static VectorQual *
+make_vector_compare(DecompressChunkState *state, OpExpr *opexpr, Index scanrelid)
+{
+	VectorQual *vq;
+	Expr *left;
+	Expr *right;
+	Var *var;
+	Const *constant;
+	bool const_is_left;
+	Oid lefttype;
+	Oid righttype;
+	int column_index;
+
+	if (list_length(opexpr->args) != 2 || opexpr->opretset)
+		return NULL;
+
+	left = linitial(opexpr->args);
+	right = lsecond(opexpr->args);
+
+	if (IsA(left, Var) && IsA(right, Const))
+	{
+		var = castNode(Var, left);
+		constant = castNode(Const, right);
+		const_is_left = false;
+	}
+	else if (IsA(left, Const) && IsA(right, Var))
+	{
+		var = castNode(Var, right);
+		constant = castNode(Const, left);
+		const_is_left = true;
+	}
+	else
+		return NULL;
+
+	if (var->varno != scanrelid || var->varlevelsup != 0 || var->varattno <= 0)
+		return NULL;
+
+	column_index = find_compressed_column(state, var->varattno);
+	if (column_index < 0)
+		return NULL;
+
+	set_opfuncid(opexpr);
+
+	/*
+	 * NULL rows are never passed to the function, which is only correct for
+	 * strict functions. Volatile functions must be called once per tuple.
+	 */
+	if (!func_strict(opexpr->opfuncid) ||
+		func_volatile(opexpr->opfuncid) == PROVOLATILE_VOLATILE)
+		return NULL;
+
+	vq = palloc(sizeof(VectorQual));
+	*vq = (VectorQual){
+		.type = VQ_COMPARE,
+		.column_index = column_index,
+		.constvalue = constant->constvalue,
+		.constisnull = constant->constisnull,
+		.const_is_left = const_is_left,
+		.strategy = InvalidStrategy,
+		.int_kind = VQ_INT_NONE,
+	};
+
+	/* use a specialized loop for btree comparisons of integer-like types */
+	op_input_types(opexpr->opno, &lefttype, &righttype);
+	if (lefttype == var->vartype && righttype == var->vartype &&
+		int_kind_for_type(var->vartype) != VQ_INT_NONE)
+	{
+		TypeCacheEntry *tce = lookup_type_cache(var->vartype, TYPECACHE_BTREE_OPFAMILY);
+
+		if (OidIsValid(tce->btree_opf))
+		{
+			StrategyNumber strategy = get_op_opfamily_strategy(opexpr->opno, tce->btree_opf);
+
+			if (strategy != InvalidStrategy)
+			{
+				vq->strategy = const_is_left ? commute_strategy(strategy) : strategy;
+				vq->int_kind = int_kind_for_type(var->vartype);
+			}
+		}
+	}
+
+	fmgr_info(opexpr->opfuncid, &vq->flinfo);
+	vq->fcinfo = HEAP_FCINFO(2);
+	InitFunctionCallInfoData(*vq->fcinfo,
+							 &vq->flinfo /*=Flinfo*/,
+							 2 /*=Nargs*/,
+							 opexpr->inputcollid /*=Collation*/,
+							 NULL, /*=Context*/
+							 NULL  /*=ResultInfo*/
+	);
+
+	return vq;
+}
+
+static VectorQual *
+make_vector_array_compare(DecompressChunkState *state, ScalarArrayOpExpr *saop, Index scanrelid)
+{
+	VectorQual *vq;
+	Var *var;
+	Const *constant;
+	int column_index;
+
+	if (list_length(saop->args) != 2 || !IsA(linitial(saop->args), Var) ||
+		!IsA(lsecond(saop->args), Const))
+		return NULL;
+
+	var = castNode(Var, linitial(saop->args));
+	constant = castNode(Const, lsecond(saop->args));
+
+	if (var->varno != scanrelid || var->varlevelsup != 0 || var->varattno <= 0)
+		return NULL;
+
+	column_index = find_compressed_column(state, var->varattno);
+	if (column_index < 0)
+		return NULL;
+
+	set_sa_opfuncid(saop);
+
+	/* same restrictions as for the regular comparisons */
+	if (!func_strict(saop->opfuncid) || func_volatile(saop->opfuncid) == PROVOLATILE_VOLATILE)
+		return NULL;
+
+	vq = palloc0(sizeof(VectorQual));
+	vq->type = VQ_ARRAY_COMPARE;
+	vq->column_index = column_index;
+	vq->constisnull = constant->constisnull;
+	vq->use_or = saop->useOr;
+
+	if (!constant->constisnull)
+	{
+		ArrayType *array = DatumGetArrayTypeP(constant->constvalue);
+		int16 elmlen;
+		bool elmbyval;
+		char elmalign;
+
+		get_typlenbyvalalign(ARR_ELEMTYPE(array), &elmlen, &elmbyval, &elmalign);
+		deconstruct_array(array,
+						  ARR_ELEMTYPE(array),
+						  elmlen,
+						  elmbyval,
+						  elmalign,
+						  &vq->elements,
+						  &vq->elements_isnull,
+						  &vq->num_elements);
+
+		/*
+		 * col op ALL('{}') is true even for NULL rows, which the strict
+		 * evaluation below would filter out, so leave empty arrays to the
+		 * regular qual.
+		 */
+		if (vq->num_elements == 0)
+			return NULL;
+	}
+
+	fmgr_info(saop->opfuncid, &vq->flinfo);
+	vq->fcinfo = HEAP_FCINFO(2);
+	InitFunctionCallInfoData(*vq->fcinfo,
+							 &vq->flinfo /*=Flinfo*/,
+							 2 /*=Nargs*/,
+							 saop->inputcollid /*=Collation*/,
+							 NULL, /*=Context*/
+							 NULL  /*=ResultInfo*/
+	);
+
+	return vq;
+}
+
+static VectorQual *
+make_vector_qual(DecompressChunkState *state, Expr *qual, Index scanrelid)
+{
+	switch (nodeTag(qual))
+	{
+		case T_OpExpr:
+			return make_vector_compare(state, castNode(OpExpr, qual), scanrelid);
+		case T_ScalarArrayOpExpr:
+			return make_vector_array_compare(state, castNode(ScalarArrayOpExpr, qual), scanrelid);
+		case T_BoolExpr:
+		{
+			BoolExpr *boolexpr = castNode(BoolExpr, qual);
+			VectorQual *vq;
+			List *args = NIL;
+			ListCell *lc;
+
+			if (boolexpr->boolop == NOT_EXPR)
+				return NULL;
+
+			foreach (lc, boolexpr->args)
+			{
+				VectorQual *arg = make_vector_qual(state, lfirst(lc), scanrelid);
+
+				if (arg == NULL)
+					return NULL;
+
+				args = lappend(args, arg);
+			}
+
+			vq = palloc0(sizeof(VectorQual));
+			vq->type = boolexpr->boolop == AND_EXPR ? VQ_AND : VQ_OR;
+			vq->args = args;
+			return vq;
+		}
+		default:
+			return NULL;
+	}
+}
+
+/*
+ * Split the quals of the scan into the ones we can evaluate vectorized, which
+ * are returned, and the remaining ones that have to be evaluated per tuple.
+ */
+List *
+vector_qual_split(DecompressChunkState *state, List *quals, Index scanrelid,
+				  List **remaining_quals)
+{
+	List *vectorized = NIL;
+	ListCell *lc;
+
+	*remaining_quals = NIL;
+
+	foreach (lc, quals)
+	{
+		VectorQual *vq = make_vector_qual(state, lfirst(lc), scanrelid);
+
+		if (vq != NULL)
+			vectorized = lappend(vectorized, vq);
+		else
+			*remaining_quals = lappend(*remaining_quals, lfirst(lc));
+	}
+
+	return vectorized;
+}
+
+/*
+ * Compare every value with the constant, building the result one 64-row word
+ * at a time. The values of NULL rows are compared as well, the result for
+ * them is masked out with the validity bitmap afterwards.
+ */
+#define VECTOR_COMPARE_LOOP(GETTER, OP)                                                            \
+	do                                                                                             \
+	{                                                                                              \
+		uint32 word;                                                                               \
+		for (word = 0; word < num_words; word++)                                                   \
+		{                                                                                          \
+			uint32 first_row = word * 64;                                                          \
+			uint32 word_rows = Min(64, num_rows - first_row);                                      \
+			uint64 word_result = 0;                                                                \
+			uint32 bit;                                                                            \
+			for (bit = 0; bit < word_rows; bit++)                                                  \
+				word_result |= ((uint64) (GETTER(values[first_row + bit]) OP constval)) << bit;    \
+			result[word] &= word_result;                                                           \
+		}                                                                                          \
+	} while (0)
+
+#define VECTOR_COMPARE_BY_STRATEGY(GETTER)                                                         \
+	do                                                                                             \
+	{                                                                                              \
+		switch (vq->strategy)                                                                      \
+		{                                                                                          \
+			case BTLessStrategyNumber:                                                             \
+				VECTOR_COMPARE_LOOP(GETTER, <);                                                    \
+				break;                                                                             \
+			case BTLessEqualStrategyNumber:                                                        \
+				VECTOR_COMPARE_LOOP(GETTER, <=);                                                   \
+				break;                                                                             \
+			case BTEqualStrategyNumber:                                                            \
+				VECTOR_COMPARE_LOOP(GETTER, ==);                                                   \
+				break;                                                                             \
+			case BTGreaterEqualStrategyNumber:                                                     \
+				VECTOR_COMPARE_LOOP(GETTER, >=);                                                   \
+				break;                                                                             \
+			case BTGreaterStrategyNumber:                                                          \
+				VECTOR_COMPARE_LOOP(GETTER, >);                                                    \
+				break;                                                                             \
+			default:                                                                               \
+				elog(ERROR, "invalid strategy %d for vectorized comparison", vq->strategy);        \
+		}                                                                                          \
+	} while (0)
+
+static void
+vector_compare_int(VectorQual *vq, const DecompressedBatch *batch, uint64 *result)
+{
+	const Datum *values = batch->values;
+	uint32 num_rows = batch->num_rows;
+	uint32 num_words = DECOMPRESSED_BATCH_VALIDITY_WORDS(num_rows);
+
+	switch (vq->int_kind)
+	{
+		case VQ_INT16:
+		{
+			int16 constval = DatumGetInt16(vq->constvalue);
+			VECTOR_COMPARE_BY_STRATEGY(DatumGetInt16);
+			break;
+		}
+		case VQ_INT32:
+		{
+			int32 constval = DatumGetInt32(vq->constvalue);
+			VECTOR_COMPARE_BY_STRATEGY(DatumGetInt32);
+			break;
+		}
+		case VQ_INT64:
+		{
+			int64 constval = DatumGetInt64(vq->constvalue);
+			VECTOR_COMPARE_BY_STRATEGY(DatumGetInt64);
+			break;
+		}
+		case VQ_INT_NONE:
+			pg_unreachable();
+	}
+}
+
+static bool
+vector_compare_value(VectorQual *vq, Datum value, Datum constvalue, bool const_is_left)
+{
+	FunctionCallInfo fcinfo = vq->fcinfo;
+	Datum pass;
+
+	FC_SET_ARG(fcinfo, const_is_left ? 0 : 1, constvalue);
+	FC_SET_ARG(fcinfo, const_is_left ? 1 : 0, value);
+	fcinfo->isnull = false;
+	pass = FunctionCallInvoke(fcinfo);
+
+	return !fcinfo->isnull && DatumGetBool(pass);
+}
+
+/*
+ * Check a single non-NULL value. Since the functions are strict, comparisons
+ * with NULL array elements are never true, which makes ANY skip them and ALL
+ * fail on them.
+ */
+static bool
+vector_qual_value_passes(VectorQual *vq, Datum value)
+{
+	int i;
+
+	if (vq->type == VQ_COMPARE)
+		return vector_compare_value(vq, value, vq->constvalue, vq->const_is_left);
+
+	for (i = 0; i < vq->num_elements; i++)
+	{
+		bool pass = !vq->elements_isnull[i] &&
+					vector_compare_value(vq, value, vq->elements[i], /* const_is_left = */ false);
+
+		if (pass == vq->use_or)
+			return pass;
+	}
+
+	/* no element matched for ANY, all of them matched for ALL */
+	return !vq->use_or;
+}
+
+static void
+vector_compare_generic(VectorQual *vq, const DecompressedBatch *batch, uint64 *result)
+{
+	uint32 row;
+
+	for (row = 0; row < batch->num_rows; row++)
+	{
+		/* skip rows that are already filtered out or NULL */
+		if ((result[ROW_WORD(row)] & ROW_BIT(row)) == 0 ||
+			!decompressed_batch_row_is_valid(batch, row))
+			continue;
+
+		if (!vector_qual_value_passes(vq, batch->values[row]))
+			result[ROW_WORD(row)] &= ~ROW_BIT(row);
+	}
+}
+
+/*
+ * Evaluate the qual once for every distinct value of a dictionary compressed
+ * batch, then select the rows by their dictionary code.
+ */
+static void
+vector_compare_dictionary(VectorQual *vq, const DecompressedBatch *batch, uint64 *result)
+{
+	bool *passes = palloc(sizeof(bool) * batch->num_distinct);
+	uint32 num_words = DECOMPRESSED_BATCH_VALIDITY_WORDS(batch->num_rows);
+	uint32 word;
+	uint32 code;
+
+	for (code = 0; code < batch->num_distinct; code++)
+		passes[code] = vector_qual_value_passes(vq, batch->dictionary[code]);
+
+	for (word = 0; word < num_words; word++)
+	{
+		uint32 first_row = word * 64;
+		uint32 word_rows = Min(64, batch->num_rows - first_row);
+		uint64 word_result = 0;
+		uint32 bit;
+
+		/* the codes of NULL rows are masked out with the validity bitmap afterwards */
+		for (bit = 0; bit < word_rows; bit++)
+		{
+			code = batch->codes[first_row + bit];
+			word_result |= ((uint64) (code < batch->num_distinct && passes[code])) << bit;
+		}
+		result[word] &= word_result;
+	}
+
+	pfree(passes);
+}
+
+/*
+ * Clear the bits in result for the rows that do not pass the qual.
+ */
+static void
+vector_qual_apply(DecompressChunkState *state, VectorQual *vq, uint64 *result)
+{
+	uint32 num_words = DECOMPRESSED_BATCH_VALIDITY_WORDS(state->batch_rows);
+	uint32 word;
+
+	switch (vq->type)
+	{
+		case VQ_COMPARE:
+		case VQ_ARRAY_COMPARE:
+		{
+			DecompressedBatch *batch = state->columns[vq->column_index].compressed.batch;
+
+			/* strict operators return NULL for NULL input, so nothing passes */
+			if (batch == NULL || vq->constisnull)
+			{
+				memset(result, 0, sizeof(uint64) * num_words);
+				return;
+			}
+
+			if (vq->int_kind != VQ_INT_NONE)
+				vector_compare_int(vq, batch, result);
+			else if (batch->dictionary != NULL && batch->num_distinct < batch->num_rows)
+				vector_compare_dictionary(vq, batch, result);
+			else
+				vector_compare_generic(vq, batch, result);
+
+			for (word = 0; word < num_words; word++)
+				result[word] &= batch->validity[word];
+			break;
+		}
+		case VQ_AND:
+		{
+			ListCell *lc;
+
+			foreach (lc, vq->args)
+				vector_qual_apply(state, lfirst(lc), result);
+			break;
+		}
+		case VQ_OR:
+		{
+			uint64 *any_passed = palloc0(sizeof(uint64) * num_words);
+			uint64 *arg_result = palloc(sizeof(uint64) * num_words);
+			ListCell *lc;
+
+			foreach (lc, vq->args)
+			{
+				memcpy(arg_result, result, sizeof(uint64) * num_words);
+				vector_qual_apply(state, lfirst(lc), arg_result);
+				for (word = 0; word < num_words; word++)
+					any_passed[word] |= arg_result[word];
+			}
+
+			memcpy(result, any_passed, sizeof(uint64) * num_words);
+			pfree(any_passed);
+			pfree(arg_result);
+			break;
+		}
+	}
+}
+
+/*
+ * Evaluate the vectorized quals on the current batch. Returns a bitmap with a
+ * bit set for every row of the batch that passes all of them.
+ */
+uint64 *
+vector_qual_compute(DecompressChunkState *state, List *vectorized_quals)
+{
+	uint32 num_rows = state->batch_rows;
+	uint32 num_words = DECOMPRESSED_BATCH_VALIDITY_WORDS(num_rows);
+	uint64 *result = palloc(sizeof(uint64) * Max(num_words, 1));
+	ListCell *lc;
+
+	/* start with all rows of the batch selected */
+	memset(result, 0xFF, sizeof(uint64) * num_words);
+	if (num_rows % 64 != 0)
+		result[num_words - 1] = ROW_BIT(num_rows) - 1;
+
+	foreach (lc, vectorized_quals)
+		vector_qual_apply(state, lfirst(lc), result);
+
+	return result;
+}
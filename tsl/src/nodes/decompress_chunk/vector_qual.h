@@ -0,0 +1,18 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_DECOMPRESS_CHUNK_VECTOR_QUAL_H
+#define TIMESCALEDB_DECOMPRESS_CHUNK_VECTOR_QUAL_H
+
+#include <postgres.h>
+#include <nodes/pg_list.h>
+
+#include "nodes/decompress_chunk/exec.h"
+
+extern List *vector_qual_split(DecompressChunkState *state, List *quals, Index scanrelid,
+							   List **remaining_quals);
+extern uint64 *vector_qual_compute(DecompressChunkState *state, List *vectorized_quals);
+
+#endif /* TIMESCALEDB_DECOMPRESS_CHUNK_VECTOR_QUAL_H */
@@ -0,0 +1,510 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+/*
+ * VectorAgg computes partial aggregates directly on the batches produced by
+ * its DecompressChunk child node instead of on individual tuples.
+ *
+ * The output of the node is described by its custom_scan_tlist: Vars for the
+ * grouping columns, which are all segmentby columns, and partial Aggrefs for
+ * the aggregates. Since the segmentby columns are constant within a batch, a
+ * batch always belongs to exactly one group, and we emit a partial aggregate
+ * row whenever the grouping columns of the next batch differ from the current
+ * ones. Batches of the same segment are usually stored next to each other, but
+ * this is not required for correctness: the Finalize Aggregate node above us
+ * combines partial rows that belong to the same group.
+ *
+ * When the aggregates can be answered from the metadata of the compressed
+ * chunk alone (count(*) and min/max of orderby columns without quals that
+ * have to be checked on the decompressed rows), the planner puts the scan of
+ * the compressed chunk directly below us instead of DecompressChunk. In that
+ * case custom_private holds the offsets of the columns we need in the tuples
+ * of the compressed scan and nothing is decompressed at all.
+ */
+#include <postgres.h>
+#include <executor/executor.h>
+#include <nodes/extensible.h>
+#include <nodes/nodeFuncs.h>
+#include <utils/datum.h>
+#include <utils/lsyscache.h>
+#include <utils/memutils.h>
+
+#include "compat.h"
+#include "nodes/decompress_chunk/exec.h"
+#include "nodes/vector_agg/functions.h"
+#include "nodes/vector_agg/vector_agg.h"
+
+typedef struct VectorAggGroupingColumn
+{
+	/*
+	 * index of the column in the DecompressChunk column state, or the offset
+	 * of the column in the compressed tuple when using metadata only
+	 */
+	int input_column;
+	/* offset of the column in the output tuple */
+	int output_offset;
+	int16 typlen;
+	bool typbyval;
+} VectorAggGroupingColumn;
+
+typedef struct VectorAggAggregate
+{
+	VectorAggregate agg;
+	/*
+	 * index of the input column in the DecompressChunk column state, -1 for
+	 * count(*), or the offset of the metadata column in the compressed tuple
+	 * when using metadata only
+	 */
+	int input_column;
+	/* offset of the aggregate in the output tuple */
+	int output_offset;
+} VectorAggAggregate;
+
+typedef struct VectorAggState
+{
+	CustomScanState csstate;
+	DecompressChunkState *decompress_state;
+
+	/* aggregate the metadata of the compressed tuples instead of decompressed batches */
+	bool metadata_only;
+	/* current compressed tuple and offset of its count column when using metadata only */
+	TupleTableSlot *compressed_slot;
+	int count_column;
+
+	int num_grouping_columns;
+	VectorAggGroupingColumn *grouping_columns;
+	int num_aggregates;
+	VectorAggAggregate *aggregates;
+
+	/* grouping column values of the current group */
+	Datum *group_values;
+	bool *group_isnull;
+	/* grouping column values of the current batch */
+	Datum *batch_values;
+	bool *batch_isnull;
+	/* true if there is a current group that has not been returned yet */
+	bool group_started;
+	/* true if the current batch of the child has not been aggregated yet */
+	bool batch_pending;
+	bool input_done;
+
+	/* memory for the grouping column values of the current group */
+	MemoryContext group_context;
+	/* memory for the output tuple */
+	MemoryContext output_context;
+} VectorAggState;
+
+static int
+find_input_column(DecompressChunkState *decompress_state, Var *var)
+{
+	int i;
+
+	for (i = 0; i < decompress_state->num_columns; i++)
+	{
+		if (decompress_state->columns[i].attno == var->varattno)
+			return i;
+	}
+
+	elog(ERROR, "column %d not found in DecompressChunk", var->varattno);
+	pg_unreachable();
+}
+
+static void
+vector_agg_begin(CustomScanState *node, EState *estate, int eflags)
+{
+	VectorAggState *state = (VectorAggState *) node;
+	CustomScan *cscan = castNode(CustomScan, node->ss.ps.plan);
+	Plan *child_plan = linitial(cscan->custom_plans);
+	ListCell *lc_offset = NULL;
+	ListCell *lc;
+
+	if (cscan->custom_private != NIL)
+	{
+		/* the first offset is the count column, followed by one per output column */
+		List *offsets = linitial(cscan->custom_private);
+
+		state->metadata_only = true;
+		state->count_column = linitial_int(offsets);
+		lc_offset = lnext_compat(offsets, list_head(offsets));
+		node->custom_ps = list_make1(ExecInitNode(child_plan, estate, eflags));
+	}
+	else
+	{
+		if (!IsA(child_plan, CustomScan) ||
+			strcmp(castNode(CustomScan, child_plan)->methods->CustomName, "DecompressChunk") != 0)
+			elog(ERROR, "VectorAgg requires DecompressChunk as its child node");
+
+		state->decompress_state = (DecompressChunkState *) ExecInitNode(child_plan, estate, eflags);
+		node->custom_ps = list_make1(state->decompress_state);
+	}
+
+	state->grouping_columns =
+		palloc0(sizeof(VectorAggGroupingColumn) * list_length(cscan->custom_scan_tlist));
+	state->aggregates = palloc0(sizeof(VectorAggAggregate) * list_length(cscan->custom_scan_tlist));
+
+	foreach (lc, cscan->custom_scan_tlist)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		int metadata_offset = -1;
+
+		if (state->metadata_only)
+		{
+			metadata_offset = lfirst_int(lc_offset);
+			lc_offset = lnext_compat(linitial(cscan->custom_private), lc_offset);
+		}
+
+		if (IsA(tle->expr, Var))
+		{
+			Var *var = castNode(Var, tle->expr);
+			VectorAggGroupingColumn *column =
+				&state->grouping_columns[state->num_grouping_columns++];
+
+			if (state->metadata_only)
+				column->input_column = metadata_offset;
+			else
+			{
+				column->input_column = find_input_column(state->decompress_state, var);
+
+				if (state->decompress_state->columns[column->input_column].type !=
+					SEGMENTBY_COLUMN)
+					elog(ERROR, "VectorAgg can only group by segmentby columns");
+			}
+
+			column->output_offset = AttrNumberGetAttrOffset(tle->resno);
+			get_typlenbyval(var->vartype, &column->typlen, &column->typbyval);
+		}
+		else if (IsA(tle->expr, Aggref))
+		{
+			Aggref *aggref = castNode(Aggref, tle->expr);
+			VectorAggAggregate *aggregate = &state->aggregates[state->num_aggregates++];
+
+			vector_aggregate_init(&aggregate->agg, aggref);
+			aggregate->output_offset = AttrNumberGetAttrOffset(tle->resno);
+
+			if (state->metadata_only)
+			{
+				if (aggregate->agg.kind != VECTOR_AGG_COUNT_STAR &&
+					aggregate->agg.kind != VECTOR_AGG_MIN && aggregate->agg.kind != VECTOR_AGG_MAX)
+					elog(ERROR, "aggregate cannot be computed from compressed chunk metadata");
+
+				aggregate->input_column = metadata_offset;
+			}
+			else if (aggref->aggstar)
+				aggregate->input_column = -1;
+			else
+			{
+				TargetEntry *arg = linitial_node(TargetEntry, aggref->args);
+
+				aggregate->input_column =
+					find_input_column(state->decompress_state, castNode(Var, arg->expr));
+			}
+		}
+		else
+			elog(ERROR, "unsupported expression in VectorAgg target list");
+	}
+
+	state->group_values = palloc0(sizeof(Datum) * Max(state->num_grouping_columns, 1));
+	state->group_isnull = palloc0(sizeof(bool) * Max(state->num_grouping_columns, 1));
+	state->batch_values = palloc0(sizeof(Datum) * Max(state->num_grouping_columns, 1));
+	state->batch_isnull = palloc0(sizeof(bool) * Max(state->num_grouping_columns, 1));
+
+	state->group_context =
+		AllocSetContextCreate(CurrentMemoryContext, "VectorAgg group", ALLOCSET_DEFAULT_SIZES);
+	state->output_context =
+		AllocSetContextCreate(CurrentMemoryContext, "VectorAgg output", ALLOCSET_DEFAULT_SIZES);
+
+	/* without grouping columns there is exactly one group, even for empty input */
+	state->group_started = state->num_grouping_columns == 0;
+}
+
+/*
+ * Fetch the next batch from the child node and load its grouping column
+ * values. Returns false when there are no more batches.
+ */
+static bool
+vector_agg_next_batch(VectorAggState *state)
+{
+	int i;
+
+	if (state->metadata_only)
+	{
+		TupleTableSlot *slot = ExecProcNode(linitial(state->csstate.custom_ps));
+
+		if (TupIsNull(slot))
+			return false;
+
+		slot_getallattrs(slot);
+		state->compressed_slot = slot;
+
+		for (i = 0; i < state->num_grouping_columns; i++)
+		{
+			int offset = state->grouping_columns[i].input_column;
+
+			state->batch_values[i] = slot->tts_values[offset];
+			state->batch_isnull[i] = slot->tts_isnull[offset];
+		}
+
+		return true;
+	}
+
+	if (!decompress_chunk_next_batch(state->decompress_state))
+		return false;
+
+	for (i = 0; i < state->num_grouping_columns; i++)
+	{
+		DecompressChunkColumnState *input =
+			&state->decompress_state->columns[state->grouping_columns[i].input_column];
+
+		state->batch_values[i] = input->segmentby.value;
+		state->batch_isnull[i] = input->segmentby.isnull;
+	}
+
+	return true;
+}
+
+/*
+ * Number of rows of the current batch that pass the quals of the scan
+ */
+static int64
+batch_num_selected(VectorAggState *state)
+{
+	DecompressChunkState *decompress_state = state->decompress_state;
+
+	if (state->metadata_only)
+	{
+		Assert(!state->compressed_slot->tts_isnull[state->count_column]);
+		return DatumGetInt32(state->compressed_slot->tts_values[state->count_column]);
+	}
+
+	return vector_agg_count_selected(decompress_state->selection, decompress_state->batch_rows);
+}
+
+static bool
+batch_matches_group(VectorAggState *state)
+{
+	int i;
+
+	for (i = 0; i < state->num_grouping_columns; i++)
+	{
+		VectorAggGroupingColumn *column = &state->grouping_columns[i];
+
+		if (state->batch_isnull[i] != state->group_isnull[i])
+			return false;
+
+		if (!state->batch_isnull[i] && !datumIsEqual(state->batch_values[i],
+													 state->group_values[i],
+													 column->typbyval,
+													 column->typlen))
+			return false;
+	}
+
+	return true;
+}
+
+static void
+start_group(VectorAggState *state)
+{
+	MemoryContext old_context;
+	int i;
+
+	MemoryContextReset(state->group_context);
+	old_context = MemoryContextSwitchTo(state->group_context);
+
+	for (i = 0; i < state->num_grouping_columns; i++)
+	{
+		VectorAggGroupingColumn *column = &state->grouping_columns[i];
+
+		state->group_isnull[i] = state->batch_isnull[i];
+		state->group_values[i] =
+			state->batch_isnull[i] ?
+				(Datum) 0 :
+				datumCopy(state->batch_values[i], column->typbyval, column->typlen);
+	}
+
+	MemoryContextSwitchTo(old_context);
+
+	for (i = 0; i < state->num_aggregates; i++)
+		vector_aggregate_reset(&state->aggregates[i].agg);
+
+	state->group_started = true;
+}
+
+static void
+aggregate_batch(VectorAggState *state, int64 num_selected)
+{
+	DecompressChunkState *decompress_state = state->decompress_state;
+	int i;
+
+	for (i = 0; i < state->num_aggregates; i++)
+	{
+		VectorAggAggregate *aggregate = &state->aggregates[i];
+		DecompressChunkColumnState *input;
+
+		if (state->metadata_only)
+		{
+			TupleTableSlot *slot = state->compressed_slot;
+
+			/* the min and max metadata stand in for all rows of the batch */
+			vector_aggregate_add_repeated(&aggregate->agg,
+										  slot->tts_values[aggregate->input_column],
+										  slot->tts_isnull[aggregate->input_column],
+										  aggregate->agg.kind == VECTOR_AGG_COUNT_STAR ?
+											  num_selected :
+											  1);
+			continue;
+		}
+
+		if (aggregate->input_column < 0)
+		{
+			vector_aggregate_add_repeated(&aggregate->agg, (Datum) 0, true, num_selected);
+			continue;
+		}
+
+		input = &decompress_state->columns[aggregate->input_column];
+		if (input->type == SEGMENTBY_COLUMN)
+			vector_aggregate_add_repeated(&aggregate->agg,
+										  input->segmentby.value,
+										  input->segmentby.isnull,
+										  num_selected);
+		else
+			vector_aggregate_add_batch(&aggregate->agg,
+									   input->compressed.batch,
+									   decompress_state->selection,
+									   decompress_state->batch_rows);
+	}
+}
+
+static TupleTableSlot *
+emit_group(VectorAggState *state)
+{
+	TupleTableSlot *slot = state->csstate.ss.ss_ScanTupleSlot;
+	MemoryContext old_context = MemoryContextSwitchTo(state->output_context);
+	int i;
+
+	ExecClearTuple(slot);
+
+	for (i = 0; i < state->num_grouping_columns; i++)
+	{
+		VectorAggGroupingColumn *column = &state->grouping_columns[i];
+
+		slot->tts_isnull[column->output_offset] = state->group_isnull[i];
+		slot->tts_values[column->output_offset] =
+			state->group_isnull[i] ?
+				(Datum) 0 :
+				datumCopy(state->group_values[i], column->typbyval, column->typlen);
+	}
+
+	for (i = 0; i < state->num_aggregates; i++)
+	{
+		VectorAggAggregate *aggregate = &state->aggregates[i];
+
+		slot->tts_values[aggregate->output_offset] =
+			vector_aggregate_get_partial(&aggregate->agg,
+										 &slot->tts_isnull[aggregate->output_offset]);
+	}
+
+	MemoryContextSwitchTo(old_context);
+
+	ExecStoreVirtualTuple(slot);
+	state->group_started = false;
+
+	if (state->csstate.ss.ps.ps_ProjInfo == NULL)
+		return slot;
+
+	state->csstate.ss.ps.ps_ExprContext->ecxt_scantuple = slot;
+	return ExecProject(state->csstate.ss.ps.ps_ProjInfo);
+}
+
+static TupleTableSlot *
+vector_agg_exec(CustomScanState *node)
+{
+	VectorAggState *state = (VectorAggState *) node;
+
+	MemoryContextReset(state->output_context);
+
+	while (true)
+	{
+		int64 num_selected;
+
+		if (!state->batch_pending)
+		{
+			if (state->input_done)
+				return NULL;
+
+			if (!vector_agg_next_batch(state))
+			{
+				state->input_done = true;
+
+				if (state->group_started)
+					return emit_group(state);
+
+				return NULL;
+			}
+
+			state->batch_pending = true;
+		}
+
+		/* batches without any matching rows must not start a group */
+		num_selected = batch_num_selected(state);
+		if (num_selected == 0)
+		{
+			state->batch_pending = false;
+			continue;
+		}
+
+		if (state->num_grouping_columns > 0)
+		{
+			if (state->group_started && !batch_matches_group(state))
+				return emit_group(state);
+
+			if (!state->group_started)
+				start_group(state);
+		}
+
+		aggregate_batch(state, num_selected);
+		state->batch_pending = false;
+	}
+}
+
+static void
+vector_agg_rescan(CustomScanState *node)
+{
+	VectorAggState *state = (VectorAggState *) node;
+	int i;
+
+	state->batch_pending = false;
+	state->input_done = false;
+	state->group_started = state->num_grouping_columns == 0;
+
+	for (i = 0; i < state->num_aggregates; i++)
+		vector_aggregate_reset(&state->aggregates[i].agg);
+
+	ExecReScan(linitial(node->custom_ps));
+}
+
+static void
+vector_agg_end(CustomScanState *node)
+{
+	ExecEndNode(linitial(node->custom_ps));
+}
+
+static CustomExecMethods vector_agg_state_methods = {
+	.CustomName = "VectorAgg",
+	.BeginCustomScan = vector_agg_begin,
+	.ExecCustomScan = vector_agg_exec,
+	.EndCustomScan = vector_agg_end,
+	.ReScanCustomScan = vector_agg_rescan,
+};
+
+Node *
+vector_agg_state_create(CustomScan *cscan)
+{
+	VectorAggState *state = (VectorAggState *) newNode(sizeof(VectorAggState), T_CustomScanState);
+
+	state->csstate.methods = &vector_agg_state_methods;
+
+	return (Node *) state;
+}
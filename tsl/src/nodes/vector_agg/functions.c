@@ -0,0 +1,652 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+/*
+ * Partial aggregation of decompressed batches.
+ *
+ * Each supported aggregate keeps its transition state in a VectorAggregate in
+ * native C types and updates it from the value arrays of a decompressed batch
+ * without forming tuples or calling the transition function for every row.
+ * When a group is complete the state is converted into the datum the
+ * aggregate's own transition function would have produced, so the regular
+ * Finalize Aggregate node can combine it with the partial states of other
+ * chunks.
+ */
+#include <postgres.h>
+#include <access/htup_details.h>
+#include <access/stratnum.h>
+#include <catalog/pg_aggregate.h>
+#include <catalog/pg_type.h>
+#include <nodes/nodeFuncs.h>
+#include <utils/array.h>
+#include <utils/fmgroids.h>
+#include <utils/lsyscache.h>
+#include <utils/syscache.h>
+#include <utils/typcache.h>
+
+#include <math.h>
+
+#include "compat.h"
+#if PG12_GE
+#include <utils/float.h>
+#endif
+
+#include "nodes/vector_agg/functions.h"
+
+#define ROW_BIT(row) (UINT64CONST(1) << ((row) % 64))
+
+static void
+vector_agg_float_overflow_error(void)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE), errmsg("value out of range: overflow")));
+}
+
+/*
+ * Length of the integer representation of types that min and max can compare
+ * as plain integers, 0 for all other types.
+ */
+static int
+int_len_for_type(Oid typid)
+{
+	switch (typid)
+	{
+		case INT2OID:
+			return sizeof(int16);
+		case INT4OID:
+		case DATEOID:
+			return sizeof(int32);
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return FLOAT8PASSBYVAL ? sizeof(int64) : 0;
+		default:
+			return 0;
+	}
+}
+
+static Oid
+aggref_input_type(Aggref *aggref)
+{
+	if (aggref->aggstar)
+		return InvalidOid;
+
+	return exprType((Node *) castNode(TargetEntry, linitial(aggref->args))->expr);
+}
+
+/*
+ * Check if the aggregate can be computed by VectorAgg and return its kind.
+ *
+ * Only plain aggregates of a single column reference are supported, the
+ * executor reads the input values directly from the decompressed batches.
+ */
+bool
+vector_agg_get_kind(Aggref *aggref, VectorAggKind *kind)
+{
+	HeapTuple tuple;
+	Form_pg_aggregate aggform;
+	Oid input_type;
+	bool supported = true;
+
+	if (aggref->aggkind != AGGKIND_NORMAL || aggref->agglevelsup != 0 ||
+		aggref->aggdirectargs != NIL || aggref->aggorder != NIL || aggref->aggdistinct != NIL ||
+		aggref->aggfilter != NULL)
+		return false;
+
+	if (aggref->aggstar)
+	{
+		if (aggref->args != NIL)
+			return false;
+	}
+	else
+	{
+		TargetEntry *tle;
+
+		if (list_length(aggref->args) != 1)
+			return false;
+
+		tle = linitial_node(TargetEntry, aggref->args);
+		if (!IsA(tle->expr, Var))
+			return false;
+	}
+
+	input_type = aggref_input_type(aggref);
+
+	tuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggref->aggfnoid));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for aggregate %u", aggref->aggfnoid);
+	aggform = (Form_pg_aggregate) GETSTRUCT(tuple);
+
+	switch (aggform->aggtransfn)
+	{
+		case F_INT8INC:
+			*kind = VECTOR_AGG_COUNT_STAR;
+			supported = aggref->aggstar;
+			break;
+		case F_INT8INC_ANY:
+			*kind = VECTOR_AGG_COUNT;
+			break;
+		case F_INT2_SUM:
+		case F_INT4_SUM:
+			*kind = VECTOR_AGG_SUM_INT;
+			break;
+		case F_FLOAT4PL:
+			*kind = VECTOR_AGG_SUM_FLOAT4;
+			break;
+		case F_FLOAT8PL:
+			*kind = VECTOR_AGG_SUM_FLOAT8;
+			break;
+		case F_INT2_AVG_ACCUM:
+		case F_INT4_AVG_ACCUM:
+			*kind = VECTOR_AGG_AVG_INT;
+			break;
+		case F_FLOAT4_ACCUM:
+		case F_FLOAT8_ACCUM:
+			*kind = VECTOR_AGG_ACCUM_FLOAT;
+			break;
+		default:
+		{
+			/*
+			 * min and max are recognized by their sort operator, which works
+			 * for any type. The transition function is called for types we
+			 * cannot compare natively, so we need a pass-by-value state to
+			 * not have to manage its memory.
+			 */
+			TypeCacheEntry *tce;
+			int strategy;
+
+			supported = false;
+
+			if (aggref->aggstar || !OidIsValid(aggform->aggsortop) ||
+				aggform->aggtranstype != input_type || !get_typbyval(input_type))
+				break;
+
+			tce = lookup_type_cache(input_type, TYPECACHE_BTREE_OPFAMILY);
+			if (!OidIsValid(tce->btree_opf))
+				break;
+
+			strategy = get_op_opfamily_strategy(aggform->aggsortop, tce->btree_opf);
+			if (strategy == BTLessStrategyNumber)
+			{
+				*kind = VECTOR_AGG_MIN;
+				supported = true;
+			}
+			else if (strategy == BTGreaterStrategyNumber)
+			{
+				*kind = VECTOR_AGG_MAX;
+				supported = true;
+			}
+			break;
+		}
+	}
+
+	ReleaseSysCache(tuple);
+
+	return supported;
+}
+
+void
+vector_aggregate_init(VectorAggregate *agg, Aggref *aggref)
+{
+	if (!vector_agg_get_kind(aggref, &agg->kind))
+		elog(ERROR, "aggregate %u not supported by VectorAgg", aggref->aggfnoid);
+
+	agg->input_type = aggref_input_type(aggref);
+	agg->input_int_len = 0;
+	agg->collation = aggref->inputcollid;
+
+	if (agg->kind == VECTOR_AGG_MIN || agg->kind == VECTOR_AGG_MAX)
+	{
+		agg->input_int_len = int_len_for_type(agg->input_type);
+
+		if (agg->input_int_len == 0)
+		{
+			HeapTuple tuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggref->aggfnoid));
+
+			if (!HeapTupleIsValid(tuple))
+				elog(ERROR, "cache lookup failed for aggregate %u", aggref->aggfnoid);
+			fmgr_info(((Form_pg_aggregate) GETSTRUCT(tuple))->aggtransfn, &agg->transfn);
+			ReleaseSysCache(tuple);
+		}
+	}
+
+	vector_aggregate_reset(agg);
+}
+
+void
+vector_aggregate_reset(VectorAggregate *agg)
+{
+	agg->has_value = false;
+	agg->count = 0;
+	agg->isum = 0;
+	agg->fsum4 = 0;
+	agg->fsum8 = 0;
+	agg->accum[0] = 0;
+	agg->accum[1] = 0;
+	agg->accum[2] = 0;
+	agg->value = (Datum) 0;
+}
+
+/*
+ * Same as float8_accum and float4_accum
+ */
+static inline void
+vector_aggregate_accum_float(VectorAggregate *agg, float8 newval)
+{
+	float8 N = agg->accum[0];
+	float8 Sx = agg->accum[1];
+	float8 Sxx = agg->accum[2];
+
+#if PG12_LT
+	N += 1.0;
+	Sx += newval;
+	if (isinf(Sx) && !isinf(agg->accum[1]) && !isinf(newval))
+		vector_agg_float_overflow_error();
+	Sxx += newval * newval;
+	if (isinf(Sxx) && !isinf(agg->accum[2]) && !isinf(newval))
+		vector_agg_float_overflow_error();
+#else
+	/* Youngs-Cramer algorithm */
+	N += 1.0;
+	Sx += newval;
+	if (agg->accum[0] > 0.0)
+	{
+		float8 tmp = newval * N - Sx;
+
+		Sxx += tmp * tmp / (N * agg->accum[0]);
+
+		if (isinf(Sx) || isinf(Sxx))
+		{
+			if (!isinf(agg->accum[1]) && !isinf(newval))
+				vector_agg_float_overflow_error();
+
+			Sxx = get_float8_nan();
+		}
+	}
+	else if (isnan(newval) || isinf(newval))
+		Sxx = get_float8_nan();
+#endif
+
+	agg->accum[0] = N;
+	agg->accum[1] = Sx;
+	agg->accum[2] = Sxx;
+}
+
+static inline int64
+datum_get_int(Datum value, int len)
+{
+	switch (len)
+	{
+		case sizeof(int16):
+			return DatumGetInt16(value);
+		case sizeof(int32):
+			return DatumGetInt32(value);
+		default:
+			return DatumGetInt64(value);
+	}
+}
+
+/*
+ * Add a single non-null value to the aggregate
+ */
+static void
+vector_aggregate_add_value(VectorAggregate *agg, Datum value)
+{
+	switch (agg->kind)
+	{
+		case VECTOR_AGG_COUNT_STAR:
+		case VECTOR_AGG_COUNT:
+			agg->count++;
+			break;
+		case VECTOR_AGG_SUM_INT:
+			agg->isum += datum_get_int(value, agg->input_type == INT2OID ? 2 : 4);
+			break;
+		case VECTOR_AGG_AVG_INT:
+			agg->count++;
+			agg->isum += datum_get_int(value, agg->input_type == INT2OID ? 2 : 4);
+			break;
+		case VECTOR_AGG_SUM_FLOAT4:
+		{
+			float4 newval = DatumGetFloat4(value);
+			float4 result = agg->has_value ? agg->fsum4 + newval : newval;
+
+			if (isinf(result) && !isinf(agg->fsum4) && !isinf(newval))
+				vector_agg_float_overflow_error();
+			agg->fsum4 = result;
+			break;
+		}
+		case VECTOR_AGG_SUM_FLOAT8:
+		{
+			float8 newval = DatumGetFloat8(value);
+			float8 result = agg->has_value ? agg->fsum8 + newval : newval;
+
+			if (isinf(result) && !isinf(agg->fsum8) && !isinf(newval))
+				vector_agg_float_overflow_error();
+			agg->fsum8 = result;
+			break;
+		}
+		case VECTOR_AGG_ACCUM_FLOAT:
+			if (agg->input_type == FLOAT4OID)
+				vector_aggregate_accum_float(agg, (float8) DatumGetFloat4(value));
+			else
+				vector_aggregate_accum_float(agg, DatumGetFloat8(value));
+			break;
+		case VECTOR_AGG_MIN:
+		case VECTOR_AGG_MAX:
+			if (!agg->has_value)
+				agg->value = value;
+			else if (agg->input_int_len > 0)
+			{
+				int64 current = datum_get_int(agg->value, agg->input_int_len);
+				int64 newval = datum_get_int(value, agg->input_int_len);
+
+				if (agg->kind == VECTOR_AGG_MIN ? newval < current : newval > current)
+					agg->value = value;
+			}
+			else
+				agg->value = FunctionCall2Coll(&agg->transfn, agg->collation, agg->value, value);
+			break;
+	}
+
+	agg->has_value = true;
+}
+
+static inline int
+popcount64(uint64 word)
+{
+	int count = 0;
+
+	for (; word != 0; word &= word - 1)
+		count++;
+
+	return count;
+}
+
+/*
+ * Number of rows in the batch that pass the selection, all rows if there is
+ * no selection
+ */
+int64
+vector_agg_count_selected(const uint64 *selection, uint32 num_rows)
+{
+	uint32 num_words = DECOMPRESSED_BATCH_VALIDITY_WORDS(num_rows);
+	int64 count = 0;
+	uint32 word;
+
+	if (selection == NULL)
+		return num_rows;
+
+	for (word = 0; word < num_words; word++)
+	{
+		uint64 mask = selection[word];
+
+		if (word == num_words - 1 && num_rows % 64 != 0)
+			mask &= ROW_BIT(num_rows) - 1;
+
+		count += popcount64(mask);
+	}
+
+	return count;
+}
+
+/*
+ * Sum up all selected rows of an integer column. The loop over a full word
+ * does not have any branches, so the compiler can vectorize it.
+ */
+#define SUM_SELECTED_INT(GETTER)                                                                   \
+	do                                                                                             \
+	{                                                                                              \
+		uint32 bit;                                                                                \
+		if (mask == ~UINT64CONST(0))                                                               \
+			for (bit = 0; bit < word_rows; bit++)                                                  \
+				sum += GETTER(values[bit]);                                                        \
+		else                                                                                       \
+			for (bit = 0; bit < word_rows; bit++)                                                  \
+				sum += ((int64) GETTER(values[bit])) & -((int64) ((mask >> bit) & 1));             \
+	} while (0)
+
+#define MINMAX_SELECTED_INT(GETTER, OP)                                                            \
+	do                                                                                             \
+	{                                                                                              \
+		uint32 bit;                                                                                \
+		for (bit = 0; bit < word_rows; bit++)                                                      \
+		{                                                                                          \
+			int64 newval = GETTER(values[bit]);                                                    \
+			if ((mask & ROW_BIT(bit)) != 0 && (!has_value || newval OP current))                   \
+			{                                                                                      \
+				current = newval;                                                                  \
+				current_datum = values[bit];                                                       \
+				has_value = true;                                                                  \
+			}                                                                                      \
+		}                                                                                          \
+	} while (0)
+
+static void
+vector_aggregate_add_word_int(VectorAggregate *agg, const Datum *values, uint64 mask,
+							  uint32 word_rows)
+{
+	switch (agg->kind)
+	{
+		case VECTOR_AGG_SUM_INT:
+		case VECTOR_AGG_AVG_INT:
+		{
+			int64 sum = 0;
+
+			if (agg->input_type == INT2OID)
+				SUM_SELECTED_INT(DatumGetInt16);
+			else
+				SUM_SELECTED_INT(DatumGetInt32);
+
+			agg->isum += sum;
+			if (agg->kind == VECTOR_AGG_AVG_INT)
+				agg->count += popcount64(mask);
+			break;
+		}
+		case VECTOR_AGG_MIN:
+		case VECTOR_AGG_MAX:
+		{
+			bool has_value = agg->has_value;
+			Datum current_datum = agg->value;
+			int64 current = has_value ? datum_get_int(current_datum, agg->input_int_len) : 0;
+
+			switch (agg->input_int_len)
+			{
+				case sizeof(int16):
+					if (agg->kind == VECTOR_AGG_MIN)
+						MINMAX_SELECTED_INT(DatumGetInt16, <);
+					else
+						MINMAX_SELECTED_INT(DatumGetInt16, >);
+					break;
+				case sizeof(int32):
+					if (agg->kind == VECTOR_AGG_MIN)
+						MINMAX_SELECTED_INT(DatumGetInt32, <);
+					else
+						MINMAX_SELECTED_INT(DatumGetInt32, >);
+					break;
+				default:
+					if (agg->kind == VECTOR_AGG_MIN)
+						MINMAX_SELECTED_INT(DatumGetInt64, <);
+					else
+						MINMAX_SELECTED_INT(DatumGetInt64, >);
+					break;
+			}
+
+			agg->value = current_datum;
+			/* has_value is only set by the loop above if a row was selected */
+			agg->has_value = has_value;
+			return;
+		}
+		default:
+			pg_unreachable();
+	}
+
+	agg->has_value = true;
+}
+
+static bool
+vector_aggregate_has_int_loop(VectorAggregate *agg)
+{
+	switch (agg->kind)
+	{
+		case VECTOR_AGG_SUM_INT:
+		case VECTOR_AGG_AVG_INT:
+			return true;
+		case VECTOR_AGG_MIN:
+		case VECTOR_AGG_MAX:
+			return agg->input_int_len > 0;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Add the rows of a decompressed batch that are set in selection, or all rows
+ * if selection is NULL. A NULL batch stands for a column that is NULL in all
+ * rows of the batch.
+ */
+void
+vector_aggregate_add_batch(VectorAggregate *agg, const DecompressedBatch *batch,
+						   const uint64 *selection, uint32 num_rows)
+{
+	uint32 num_words = DECOMPRESSED_BATCH_VALIDITY_WORDS(num_rows);
+	bool int_loop = vector_aggregate_has_int_loop(agg);
+	uint32 word;
+
+	if (agg->kind == VECTOR_AGG_COUNT_STAR)
+	{
+		agg->count += vector_agg_count_selected(selection, num_rows);
+		return;
+	}
+
+	/* NULL values are ignored by all supported aggregates */
+	if (batch == NULL)
+		return;
+
+	Assert(batch->num_rows == num_rows);
+
+	for (word = 0; word < num_words; word++)
+	{
+		uint32 first_row = word * 64;
+		uint32 word_rows = Min(64, num_rows - first_row);
+		uint64 mask = batch->validity[word];
+		uint32 bit;
+
+		if (selection != NULL)
+			mask &= selection[word];
+		if (word_rows < 64)
+			mask &= ROW_BIT(word_rows) - 1;
+
+		if (mask == 0)
+			continue;
+
+		if (agg->kind == VECTOR_AGG_COUNT)
+			agg->count += popcount64(mask);
+		else if (int_loop)
+			vector_aggregate_add_word_int(agg, &batch->values[first_row], mask, word_rows);
+		else
+		{
+			for (bit = 0; bit < word_rows; bit++)
+			{
+				if ((mask & ROW_BIT(bit)) != 0)
+					vector_aggregate_add_value(agg, batch->values[first_row + bit]);
+			}
+		}
+	}
+}
+
+/*
+ * Add the same value num_rows times, this is used for aggregates over segmentby
+ * columns.
+ */
+void
+vector_aggregate_add_repeated(VectorAggregate *agg, Datum value, bool isnull, int64 num_rows)
+{
+	int64 i;
+
+	if (num_rows == 0)
+		return;
+
+	if (agg->kind == VECTOR_AGG_COUNT_STAR)
+	{
+		agg->count += num_rows;
+		return;
+	}
+
+	if (isnull)
+		return;
+
+	switch (agg->kind)
+	{
+		case VECTOR_AGG_COUNT:
+			agg->count += num_rows;
+			break;
+		case VECTOR_AGG_SUM_INT:
+		case VECTOR_AGG_AVG_INT:
+			agg->isum += datum_get_int(value, agg->input_type == INT2OID ? 2 : 4) * num_rows;
+			if (agg->kind == VECTOR_AGG_AVG_INT)
+				agg->count += num_rows;
+			break;
+		case VECTOR_AGG_MIN:
+		case VECTOR_AGG_MAX:
+			vector_aggregate_add_value(agg, value);
+			break;
+		default:
+			/* floating point results depend on the number of additions */
+			for (i = 0; i < num_rows; i++)
+				vector_aggregate_add_value(agg, value);
+			break;
+	}
+
+	agg->has_value = true;
+}
+
+/*
+ * Return the partial aggregate state in the representation of the aggregate's
+ * transition type. The result is allocated in the current memory context.
+ */
+Datum
+vector_aggregate_get_partial(VectorAggregate *agg, bool *isnull)
+{
+	*isnull = false;
+
+	switch (agg->kind)
+	{
+		case VECTOR_AGG_COUNT_STAR:
+		case VECTOR_AGG_COUNT:
+			return Int64GetDatum(agg->count);
+		case VECTOR_AGG_SUM_INT:
+			*isnull = !agg->has_value;
+			return Int64GetDatum(agg->isum);
+		case VECTOR_AGG_SUM_FLOAT4:
+			*isnull = !agg->has_value;
+			return Float4GetDatum(agg->fsum4);
+		case VECTOR_AGG_SUM_FLOAT8:
+			*isnull = !agg->has_value;
+			return Float8GetDatum(agg->fsum8);
+		case VECTOR_AGG_AVG_INT:
+		{
+			/* same layout as Int8TransTypeData */
+			Datum elems[2] = { Int64GetDatum(agg->count), Int64GetDatum(agg->isum) };
+
+			return PointerGetDatum(construct_array(elems, 2, INT8OID, 8, FLOAT8PASSBYVAL, 'd'));
+		}
+		case VECTOR_AGG_ACCUM_FLOAT:
+		{
+			Datum elems[3] = { Float8GetDatum(agg->accum[0]),
+							   Float8GetDatum(agg->accum[1]),
+							   Float8GetDatum(agg->accum[2]) };
+
+			return PointerGetDatum(construct_array(elems, 3, FLOAT8OID, 8, FLOAT8PASSBYVAL, 'd'));
+		}
+		case VECTOR_AGG_MIN:
+		case VECTOR_AGG_MAX:
+			*isnull = !agg->has_value;
+			return agg->value;
+	}
+
+	pg_unreachable();
+	return (Datum) 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_TSL_NODES_VECTOR_AGG_FUNCTIONS_H
+#define TIMESCALEDB_TSL_NODES_VECTOR_AGG_FUNCTIONS_H
+
+#include <postgres.h>
+#include <fmgr.h>
+#include <nodes/primnodes.h>
+
+#include "compression/compression.h"
+
+/*
+ * The aggregates we can compute on decompressed batches. They are identified
+ * by their transition function, so that the partial state we produce is
+ * exactly the one the combine and final functions of the aggregate expect:
+ *
+ * count(*), count(any): int8
+ * sum(int2), sum(int4): int8
+ * sum(float4): float4, sum(float8): float8
+ * avg(int2), avg(int4): int8[] {count, sum}
+ * avg, variance and stddev of float4 and float8: float8[] {N, Sx, Sxx}
+ * min and max of pass-by-value types: the input type
+ */
+typedef enum VectorAggKind
+{
+	VECTOR_AGG_COUNT_STAR,
+	VECTOR_AGG_COUNT,
+	VECTOR_AGG_SUM_INT,
+	VECTOR_AGG_SUM_FLOAT4,
+	VECTOR_AGG_SUM_FLOAT8,
+	VECTOR_AGG_AVG_INT,
+	VECTOR_AGG_ACCUM_FLOAT,
+	VECTOR_AGG_MIN,
+	VECTOR_AGG_MAX,
+} VectorAggKind;
+
+/*
+ * Running partial aggregation state of a single aggregate
+ */
+typedef struct VectorAggregate
+{
+	VectorAggKind kind;
+	Oid input_type;
+	/* length of integer-like input types compared natively by min and max, 0 otherwise */
+	int input_int_len;
+	/* transition function used for min and max of other types */
+	FmgrInfo transfn;
+	Oid collation;
+
+	/* true once a non-null input was seen */
+	bool has_value;
+	int64 count;
+	int64 isum;
+	float4 fsum4;
+	float8 fsum8;
+	/* float8 accumulator {N, Sx, Sxx} */
+	float8 accum[3];
+	/* current minimum or maximum */
+	Datum value;
+} VectorAggregate;
+
+extern bool vector_agg_get_kind(Aggref *aggref, VectorAggKind *kind);
+extern void vector_aggregate_init(VectorAggregate *agg, Aggref *aggref);
+extern void vector_aggregate_reset(VectorAggregate *agg);
+extern void vector_aggregate_add_batch(VectorAggregate *agg, const DecompressedBatch *batch,
+									   const uint64 *selection, uint32 num_rows);
+extern void vector_aggregate_add_repeated(VectorAggregate *agg, Datum value, bool isnull,
+										  int64 num_rows);
+extern Datum vector_aggregate_get_partial(VectorAggregate *agg, bool *isnull);
+extern int64 vector_agg_count_selected(const uint64 *selection, uint32 num_rows);
+
+#endif /* TIMESCALEDB_TSL_NODES_VECTOR_AGG_FUNCTIONS_H */
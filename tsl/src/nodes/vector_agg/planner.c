@@ -0,0 +1,529 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+#include <postgres.h>
+#include <nodes/extensible.h>
+#include <nodes/makefuncs.h>
+#include <nodes/nodeFuncs.h>
+#include <optimizer/cost.h>
+#include <optimizer/pathnode.h>
+#include <optimizer/paths.h>
+#include <optimizer/tlist.h>
+#include <parser/parsetree.h>
+#include <utils/lsyscache.h>
+#include <utils/selfuncs.h>
+
+#include "compat.h"
+#if PG12_LT
+#include <optimizer/clauses.h>
+#include <optimizer/prep.h>
+#include <optimizer/var.h>
+#else
+#include <optimizer/appendinfo.h>
+#include <optimizer/clauses.h>
+#include <optimizer/optimizer.h>
+#endif
+
+#include "compression/create.h"
+#include "guc.h"
+#include "hypertable_compression.h"
+#include "import/planner.h"
+#include "nodes/decompress_chunk/decompress_chunk.h"
+#include "nodes/vector_agg/functions.h"
+#include "nodes/vector_agg/vector_agg.h"
+#include "plan_partialize.h"
+#include "utils.h"
+
+/*
+ * Computing an aggregate on the decompressed column arrays is much cheaper than
+ * passing every tuple to an Agg node, we charge this fraction of
+ * cpu_operator_cost per row and aggregate.
+ */
+#define VECTOR_AGG_CPU_OPERATOR_COST_FACTOR 0.1
+
+static CustomScanMethods vector_agg_plan_methods = {
+	.CustomName = "VectorAgg",
+	.CreateCustomScanState = vector_agg_state_create,
+};
+
+void
+_vector_agg_init(void)
+{
+	/*
+	 * Because we reinitialize the tsl stuff when the license
+	 * changes the init function may be called multiple times
+	 * per session so we check if the VectorAgg node has been
+	 * registered already here to prevent registering it twice.
+	 */
+	if (GetCustomScanMethods(vector_agg_plan_methods.CustomName, true) == NULL)
+		RegisterCustomScanMethods(&vector_agg_plan_methods);
+}
+
+/*
+ * Find the offset of a column of the compressed chunk in the output tuples of
+ * the compressed scan.
+ */
+static int
+find_compressed_column_offset(Plan *compressed_plan, AttrNumber compressed_attno)
+{
+	ListCell *lc;
+
+	foreach (lc, compressed_plan->targetlist)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+
+		if (IsA(tle->expr, Var) && castNode(Var, tle->expr)->varattno == compressed_attno)
+			return AttrNumberGetAttrOffset(tle->resno);
+	}
+
+	elog(ERROR, "column %d not found in compressed scan", compressed_attno);
+	pg_unreachable();
+}
+
+static Plan *
+vector_agg_plan_create(PlannerInfo *root, RelOptInfo *rel, CustomPath *best_path, List *tlist,
+					   List *clauses, List *custom_plans)
+{
+	CustomScan *cscan = makeNode(CustomScan);
+
+	Assert(list_length(custom_plans) == 1);
+
+	/*
+	 * When aggregating metadata only, translate the attribute numbers of the
+	 * compressed chunk columns we need to offsets in the compressed tuple.
+	 */
+	if (best_path->custom_private != NIL)
+	{
+		List *offsets = NIL;
+		ListCell *lc;
+
+		foreach (lc, linitial(best_path->custom_private))
+			offsets =
+				lappend_int(offsets,
+							find_compressed_column_offset(linitial(custom_plans), lfirst_int(lc)));
+
+		cscan->custom_private = list_make1(offsets);
+	}
+
+	/*
+	 * The restrictions of the chunk are evaluated by the DecompressChunk
+	 * node below us, so we ignore the clauses here.
+	 */
+	cscan->methods = &vector_agg_plan_methods;
+	cscan->scan.scanrelid = 0;
+	cscan->scan.plan.targetlist = tlist;
+	cscan->scan.plan.qual = NIL;
+	/* our output tuple contains the grouping columns and the partial aggregates */
+	cscan->custom_scan_tlist = list_copy(tlist);
+	cscan->custom_plans = custom_plans;
+
+	return &cscan->scan.plan;
+}
+
+static CustomPathMethods vector_agg_path_methods = {
+	.CustomName = "VectorAgg",
+	.PlanCustomPath = vector_agg_plan_create,
+};
+
+/*
+ * Check that the partial grouping target of a chunk only contains segmentby
+ * columns and aggregates that VectorAgg can compute.
+ */
+static bool
+vector_agg_target_supported(DecompressChunkPath *dcpath, PathTarget *target)
+{
+	Bitmapset *segmentby_attnos = dcpath->info->chunk_segmentby_attnos;
+	Index chunk_relid = dcpath->info->chunk_rel->relid;
+	ListCell *lc;
+
+	/* batch merge returns rows of several batches interleaved */
+	if (dcpath->batch_merge)
+		return false;
+
+	foreach (lc, target->exprs)
+	{
+		Expr *expr = lfirst(lc);
+
+		if (IsA(expr, Var))
+		{
+			Var *var = castNode(Var, expr);
+
+			if (var->varno != chunk_relid || !bms_is_member(var->varattno, segmentby_attnos))
+				return false;
+		}
+		else if (IsA(expr, Aggref))
+		{
+			Aggref *aggref = castNode(Aggref, expr);
+			VectorAggKind kind;
+
+			if (!vector_agg_get_kind(aggref, &kind))
+				return false;
+
+			if (!aggref->aggstar)
+			{
+				Var *var = castNode(Var, linitial_node(TargetEntry, aggref->args)->expr);
+
+				if (var->varno != chunk_relid || var->varattno <= 0)
+					return false;
+			}
+		}
+		else
+			return false;
+	}
+
+	return true;
+}
+
+static AttrNumber
+get_compressed_attno_by_name(CompressionInfo *info, const char *column_name)
+{
+	AttrNumber attno = get_attnum(info->compressed_rte->relid, column_name);
+
+	if (attno == InvalidAttrNumber)
+		elog(ERROR, "column \"%s\" not found in compressed chunk", column_name);
+
+	return attno;
+}
+
+/*
+ * Check whether the partial aggregates of a chunk can be computed from the
+ * metadata of the compressed chunk alone. This is the case for count(*) and
+ * for min and max of orderby columns, as long as there are no quals that
+ * have to be checked on the decompressed rows.
+ *
+ * Returns the attribute numbers of the compressed chunk columns needed: the
+ * count column first and then one for each entry of the target, or NIL if
+ * the metadata is not sufficient.
+ */
+static List *
+vector_agg_metadata_attnos(DecompressChunkPath *dcpath, PathTarget *target)
+{
+	CompressionInfo *info = dcpath->info;
+	List *attnos;
+	ListCell *lc;
+
+	/* quals that were not pushed down to the compressed scan need the decompressed rows */
+	if (info->chunk_rel->baserestrictinfo != NIL || dcpath->cpath.path.param_info != NULL)
+		return NIL;
+
+	attnos = list_make1_int(
+		get_compressed_attno_by_name(info, COMPRESSION_COLUMN_METADATA_COUNT_NAME));
+
+	foreach (lc, target->exprs)
+	{
+		Expr *expr = lfirst(lc);
+		Var *var;
+		VectorAggKind kind;
+		FormData_hypertable_compression *column_info;
+
+		if (IsA(expr, Var))
+		{
+			var = castNode(Var, expr);
+			attnos = lappend_int(attnos,
+								 get_compressed_attno_by_name(info,
+															  get_attname(info->chunk_rte->relid,
+																		  var->varattno,
+																		  false)));
+			continue;
+		}
+
+		if (!vector_agg_get_kind(castNode(Aggref, expr), &kind))
+			return NIL;
+
+		if (kind == VECTOR_AGG_COUNT_STAR)
+		{
+			attnos = lappend_int(attnos, linitial_int(attnos));
+			continue;
+		}
+
+		if (kind != VECTOR_AGG_MIN && kind != VECTOR_AGG_MAX)
+			return NIL;
+
+		var = castNode(Var, linitial_node(TargetEntry, castNode(Aggref, expr)->args)->expr);
+		column_info =
+			get_column_compressioninfo(info->hypertable_compression_info,
+									   get_attname(info->chunk_rte->relid, var->varattno, false));
+
+		/* only orderby columns have min and max metadata */
+		if (column_info == NULL || column_info->orderby_column_index <= 0)
+			return NIL;
+
+		attnos = lappend_int(attnos,
+							 get_compressed_attno_by_name(info,
+														  kind == VECTOR_AGG_MIN ?
+															  compression_column_segment_min_name(
+																  column_info) :
+															  compression_column_segment_max_name(
+																  column_info)));
+	}
+
+	return attnos;
+}
+
+static Path *
+vector_agg_path_create(PlannerInfo *root, DecompressChunkPath *dcpath, PathTarget *target,
+					   double num_groups)
+{
+	CustomPath *path = (CustomPath *) newNode(sizeof(CustomPath), T_CustomPath);
+	Path *subpath = &dcpath->cpath.path;
+	Path *compressed_path = linitial(dcpath->cpath.custom_paths);
+	List *metadata_attnos = vector_agg_metadata_attnos(dcpath, target);
+	int num_aggregates = 0;
+	ListCell *lc;
+
+	/*
+	 * If the metadata is sufficient we scan the compressed chunk directly and
+	 * skip the decompression.
+	 */
+	if (metadata_attnos != NIL)
+		subpath = compressed_path;
+
+	foreach (lc, target->exprs)
+	{
+		if (IsA(lfirst(lc), Aggref))
+			num_aggregates++;
+	}
+
+	path->path.pathtype = T_CustomScan;
+	path->path.parent = dcpath->cpath.path.parent;
+	path->path.pathtarget = target;
+	path->path.param_info = NULL;
+	path->path.parallel_aware = false;
+	path->path.parallel_safe = subpath->parallel_safe;
+	path->path.parallel_workers = 0;
+	path->path.pathkeys = NIL;
+
+	/* we produce at most one row per compressed batch */
+	path->path.rows = clamp_row_est(Min(num_groups, compressed_path->rows));
+	path->path.startup_cost = subpath->total_cost + cpu_operator_cost * subpath->rows *
+														num_aggregates *
+														VECTOR_AGG_CPU_OPERATOR_COST_FACTOR;
+	path->path.total_cost = path->path.startup_cost + cpu_tuple_cost * path->path.rows;
+
+	path->flags = 0;
+	path->custom_paths = list_make1(subpath);
+	path->custom_private = metadata_attnos != NIL ? list_make1(metadata_attnos) : NIL;
+	path->methods = &vector_agg_path_methods;
+
+	return &path->path;
+}
+
+/*
+ * Build a regular partial aggregation path for a chunk we cannot use
+ * VectorAgg for.
+ */
+static Path *
+partial_agg_path_create(PlannerInfo *root, Path *subpath, PathTarget *target,
+						AggClauseCosts *agg_partial_costs, double num_groups)
+{
+	Query *parse = root->parse;
+	RelOptInfo *rel = subpath->parent;
+
+	if (parse->groupClause == NIL)
+		return (Path *) create_agg_path(root,
+										rel,
+										subpath,
+										target,
+										AGG_PLAIN,
+										AGGSPLIT_INITIAL_SERIAL,
+										NIL,
+										NIL,
+										agg_partial_costs,
+										1);
+
+	/*
+	 * The grouping columns are identified by their sortgroupref, so the input
+	 * of the aggregation needs to have them labeled. The chunk scan paths have
+	 * the unlabeled chunk target, so we put a (trivial) projection on top.
+	 */
+	if (subpath->pathtarget->sortgrouprefs == NULL)
+	{
+		PathTarget *labeled = copy_pathtarget(subpath->pathtarget);
+		ListCell *lc;
+		int i = 0;
+
+		labeled->sortgrouprefs = palloc0(sizeof(Index) * list_length(labeled->exprs));
+
+		foreach (lc, labeled->exprs)
+		{
+			int j = 0;
+			ListCell *lc_target;
+
+			foreach (lc_target, target->exprs)
+			{
+				Index sgref = get_pathtarget_sortgroupref(target, j);
+
+				if (sgref != 0 && equal(lfirst(lc), lfirst(lc_target)))
+					labeled->sortgrouprefs[i] = sgref;
+				j++;
+			}
+			i++;
+		}
+
+		subpath = (Path *) create_projection_path(root, rel, subpath, labeled);
+	}
+
+	return (Path *) create_agg_path(root,
+									rel,
+									subpath,
+									target,
+									AGG_HASHED,
+									AGGSPLIT_INITIAL_SERIAL,
+									parse->groupClause,
+									NIL,
+									agg_partial_costs,
+									clamp_row_est(Min(num_groups, subpath->rows)));
+}
+
+/*
+ * Push partial aggregation below the Append of a hypertable, using VectorAgg
+ * for compressed chunks.
+ *
+ * For a query like
+ *
+ *  SELECT device, sum(value) FROM metrics GROUP BY device
+ *
+ * on a hypertable with compressed chunks segmented by device, we produce a
+ * plan like this:
+ *
+ *  Finalize HashAggregate
+ *    Group Key: device
+ *    ->  Append
+ *          ->  Custom Scan (VectorAgg)
+ *                ->  Custom Scan (DecompressChunk) on _hyper_1_1_chunk
+ *                      ->  Seq Scan on compress_hyper_2_3_chunk
+ *          ->  Partial HashAggregate
+ *                Group Key: _hyper_1_2_chunk.device
+ *                ->  Seq Scan on _hyper_1_2_chunk
+ *
+ * VectorAgg can only be used if all grouping columns are segmentby columns
+ * and all aggregates are supported (see functions.c), chunks that don't
+ * qualify get a regular partial aggregation. For count(*) and min/max of
+ * orderby columns VectorAgg reads the compressed chunk directly and computes
+ * the aggregates from the metadata columns without any decompression.
+ */
+void
+tsl_vector_agg_paths_add(PlannerInfo *root, RelOptInfo *input_rel, RelOptInfo *output_rel,
+						 void *extra)
+{
+	Query *parse = root->parse;
+	GroupPathExtraData *group_extra = (GroupPathExtraData *) extra;
+	PathTarget *target = output_rel->reltarget;
+	PathTarget *partial_target;
+	AppendPath *append;
+	Path *append_path;
+	AggClauseCosts agg_partial_costs;
+	AggClauseCosts agg_final_costs;
+	List *subpaths = NIL;
+	bool found_vector_agg = false;
+	double num_groups = 1;
+	ListCell *lc;
+
+	if (!ts_guc_enable_vectorized_aggregation || group_extra == NULL)
+		return;
+
+	if (parse->commandType != CMD_SELECT || !parse->hasAggs || parse->groupingSets != NIL ||
+		(group_extra->flags & GROUPING_CAN_PARTIAL_AGG) == 0)
+		return;
+
+	if (parse->groupClause != NIL && !grouping_is_hashable(parse->groupClause))
+		return;
+
+	/* aggregates wrapped in partialize_agg are already partial */
+	if (has_partialize_function(parse, TS_DO_NOT_FIX_AGGREF))
+		return;
+
+	if (input_rel->cheapest_total_path == NULL ||
+		!IsA(input_rel->cheapest_total_path, AppendPath))
+		return;
+
+	append = castNode(AppendPath, input_rel->cheapest_total_path);
+	if (append->path.param_info != NULL || append->path.parallel_workers > 0 ||
+		append->subpaths == NIL)
+		return;
+
+	partial_target = ts_make_partial_grouping_target(root, target);
+
+	if (parse->groupClause != NIL)
+		num_groups =
+			estimate_num_groups(root,
+								get_sortgrouplist_exprs(parse->groupClause, parse->targetList),
+								append->path.rows,
+								NULL);
+
+	MemSet(&agg_partial_costs, 0, sizeof(AggClauseCosts));
+	MemSet(&agg_final_costs, 0, sizeof(AggClauseCosts));
+	get_agg_clause_costs(root,
+						 (Node *) partial_target->exprs,
+						 AGGSPLIT_INITIAL_SERIAL,
+						 &agg_partial_costs);
+	get_agg_clause_costs(root, (Node *) target->exprs, AGGSPLIT_FINAL_DESERIAL, &agg_final_costs);
+	get_agg_clause_costs(root, parse->havingQual, AGGSPLIT_FINAL_DESERIAL, &agg_final_costs);
+
+	foreach (lc, append->subpaths)
+	{
+		Path *subpath = lfirst(lc);
+		AppendRelInfo *appinfo;
+		PathTarget *child_target;
+
+		if (subpath->param_info != NULL)
+			return;
+
+		appinfo = ts_get_appendrelinfo(root, subpath->parent->relid, true);
+		if (appinfo == NULL)
+			return;
+
+		child_target = copy_pathtarget(partial_target);
+		child_target->exprs =
+			(List *) adjust_appendrel_attrs(root, (Node *) child_target->exprs, 1, &appinfo);
+
+		if (ts_is_decompress_chunk_path(subpath) &&
+			vector_agg_target_supported((DecompressChunkPath *) subpath, child_target))
+		{
+			subpath = vector_agg_path_create(root,
+											 (DecompressChunkPath *) subpath,
+											 child_target,
+											 num_groups);
+			found_vector_agg = true;
+		}
+		else
+			subpath = partial_agg_path_create(root,
+											  subpath,
+											  child_target,
+											  &agg_partial_costs,
+											  num_groups);
+
+		subpaths = lappend(subpaths, subpath);
+	}
+
+	/* nothing to gain if we cannot use VectorAgg for any of the chunks */
+	if (!found_vector_agg)
+		return;
+
+	append_path = (Path *) create_append_path_compat(root,
+													 input_rel,
+													 subpaths,
+													 NIL,
+													 NIL,
+													 NULL,
+													 0,
+													 false,
+													 NIL,
+													 -1);
+	append_path->pathtarget = partial_target;
+
+	add_path(output_rel,
+			 (Path *) create_agg_path(root,
+									  output_rel,
+									  append_path,
+									  target,
+									  parse->groupClause != NIL ? AGG_HASHED : AGG_PLAIN,
+									  AGGSPLIT_FINAL_DESERIAL,
+									  parse->groupClause,
+									  group_extra->havingQual,
+									  &agg_final_costs,
+									  num_groups));
+}
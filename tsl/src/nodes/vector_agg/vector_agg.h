@@ -0,0 +1,18 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_TSL_NODES_VECTOR_AGG_H
+#define TIMESCALEDB_TSL_NODES_VECTOR_AGG_H
+
+#include <postgres.h>
+#include <nodes/extensible.h>
+#include <nodes/plannodes.h>
+
+extern void tsl_vector_agg_paths_add(PlannerInfo *root, RelOptInfo *input_rel,
+									 RelOptInfo *output_rel, void *extra);
+extern Node *vector_agg_state_create(CustomScan *cscan);
+extern void _vector_agg_init(void);
+
+#endif /* TIMESCALEDB_TSL_NODES_VECTOR_AGG_H */
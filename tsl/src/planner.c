@@ -24,6 +24,7 @@
 #include "nodes/compress_dml/compress_dml.h"
 #include "nodes/decompress_chunk/decompress_chunk.h"
 #include "nodes/gapfill/planner.h"
+#include "nodes/vector_agg/vector_agg.h"
 #include "planner.h"
 
 #include <math.h>
@@ -66,6 +67,9 @@ tsl_create_upper_paths_hook(PlannerInfo *root, UpperRelationKind stage, RelOptIn
 	switch (stage)
 	{
 		case UPPERREL_GROUP_AGG:
+			if (input_reltype == TS_REL_HYPERTABLE && !dist_ht &&
+				TS_HYPERTABLE_HAS_COMPRESSION_TABLE(ht))
+				tsl_vector_agg_paths_add(root, input_rel, output_rel, extra);
 			if (input_reltype != TS_REL_HYPERTABLE_CHILD)
 				plan_add_gapfill(root, output_rel);
 			break;
@@ -113,7 +117,7 @@ tsl_set_rel_pathlist_dml(PlannerInfo *root, RelOptInfo *rel, Index rti, RangeTbl
 			foreach (lc, rel->pathlist)
 			{
 				Path **pathptr = (Path **) &lfirst(lc);
-				*pathptr = compress_chunk_dml_generate_paths(*pathptr, chunk);
+				*pathptr = compress_chunk_dml_generate_paths(root, rel, *pathptr, chunk, ht);
 			}
 		}
 	}
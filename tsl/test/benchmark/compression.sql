@@ -0,0 +1,33 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+-- Throughput of the compression algorithms as CSV, one row per data set,
+-- algorithm and operation. Run it with the compression-benchmark target or
+-- with psql, setting NUM_VALUES and ITERATIONS to override the defaults.
+
+\if :{?NUM_VALUES}
+\else
+\set NUM_VALUES 1000000
+\endif
+\if :{?ITERATIONS}
+\else
+\set ITERATIONS 5
+\endif
+
+SET client_min_messages TO error;
+CREATE EXTENSION IF NOT EXISTS timescaledb;
+
+CREATE OR REPLACE FUNCTION pg_temp.ts_compression_benchmark(
+    benchmark_values INTEGER,
+    iterations INTEGER,
+    batch_size INTEGER = 1000
+) RETURNS TABLE(data TEXT, algorithm TEXT, stored_algorithm TEXT, operation TEXT,
+    num_values BIGINT, uncompressed_bytes BIGINT, compressed_bytes BIGINT, seconds FLOAT8,
+    mb_per_second FLOAT8, values_per_second FLOAT8)
+AS :TSL_MODULE_PATHNAME LANGUAGE C STRICT VOLATILE;
+
+\pset format unaligned
+\pset fieldsep ','
+\pset footer off
+SELECT * FROM pg_temp.ts_compression_benchmark(:NUM_VALUES, :ITERATIONS);
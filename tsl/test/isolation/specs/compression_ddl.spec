@@ -70,7 +70,7 @@ step "Dc"   { COMMIT; }
 #if insert in progress, compress  is blocked
 permutation "LockChunk1" "I1" "C1" "UnlockChunk" "Ic" "Cc" "SC1" "S1" 
 
-#Compress in progress, insert is blocked
+#Compress in progress, insert is blocked and then staged in the compressed chunk
 permutation "LockChunk1" "C1" "I1" "UnlockChunk" "Cc" "Ic"  
 
 #if ddl in progress, compress_chunk blocked
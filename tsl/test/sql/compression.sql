@@ -3,6 +3,7 @@
 -- LICENSE-TIMESCALE for a copy of the license.
 
 SET timescaledb.enable_transparent_decompression to OFF;
+SET timescaledb.enable_compressed_dml TO OFF;
 
 \ir include/rand_generator.sql
 
@@ -55,7 +56,10 @@ where ch1.compressed_chunk_id = ch2.id;
 select compress_chunk( '_timescaledb_internal._hyper_1_2_chunk');
 
 --TEST2a try DML on a compressed chunk
+--inserts are not staged since foo has a unique index, (10, 10) is already compressed
+insert into foo values( 10 , 10 , 30, 130);
 insert into foo values( 11 , 10 , 20, 120);
+select id, status from _timescaledb_catalog.chunk where table_name = '_hyper_1_2_chunk';
 update foo set b =20 where a = 10;
 delete from foo where a = 10;
 
@@ -89,14 +93,19 @@ insert into _timescaledb_internal._hyper_1_2_chunk values(10, 12, 12, 12);
 update _timescaledb_internal._hyper_1_2_chunk
 set b = 12;
 delete from _timescaledb_internal._hyper_1_2_chunk;
+--nothing was staged, so there is nothing to merge
+select recompress_chunk( '_timescaledb_internal._hyper_1_2_chunk');
+select id, status from _timescaledb_catalog.chunk where table_name = '_hyper_1_2_chunk';
+select numrows_pre_compression, numrows_post_compression
+from _timescaledb_catalog.compression_chunk_size where chunk_id = 2;
 
 --TEST2d decompress the chunk and try DML
 select decompress_chunk( '_timescaledb_internal._hyper_1_2_chunk');
 insert into foo values( 11 , 10 , 20, 120);
 update foo set b =20 where a = 10;
-select * from _timescaledb_internal._hyper_1_2_chunk order by a;
+select * from _timescaledb_internal._hyper_1_2_chunk order by a, b;
 delete from foo where a = 10;
-select * from _timescaledb_internal._hyper_1_2_chunk order by a;
+select * from _timescaledb_internal._hyper_1_2_chunk order by a, b;
 
 -- TEST3 check if compress data from views is accurate
 CREATE TABLE conditions (
@@ -656,3 +665,414 @@ SELECT approximate_row_count('approx_count');
 ANALYZE approx_count;
 SELECT approximate_row_count('approx_count');
 DROP TABLE approx_count;
+
+\c :TEST_DBNAME :ROLE_SUPERUSER
+\ir include/compression_utils.sql
+\c :TEST_DBNAME :ROLE_DEFAULT_PERM_USER
+
+-- The rows of the tests below, three devices with hourly readings for a day
+CREATE TABLE readings(time timestamptz NOT NULL, device int, val float);
+INSERT INTO readings SELECT t, d, extract(hour from t)
+FROM generate_series('2020-01-03 0:00'::timestamptz, '2020-01-04 0:00', '1 hour') t,
+  generate_series(1, 3) d;
+
+-- Test UPDATE/DELETE on compressed chunks only decompress the batches that
+-- can contain affected rows
+SET timescaledb.enable_compressed_dml TO ON;
+CREATE TABLE dml_test(LIKE readings);
+SELECT table_name FROM create_hypertable('dml_test', 'time');
+INSERT INTO dml_test SELECT time, device, device FROM readings;
+ALTER TABLE dml_test SET (timescaledb.compress, timescaledb.compress_segmentby = 'device');
+SELECT show_chunks('dml_test') AS "DML_CHUNK" \gset
+SELECT count(compress_chunk(ch)) FROM show_chunks('dml_test') ch;
+SELECT * FROM compressed_chunk_status('dml_test');
+
+-- only the batch of device 1 is decompressed
+DELETE FROM dml_test WHERE device = 1;
+SELECT * FROM compressed_chunk_status('dml_test');
+SELECT device, count(*), sum(val) FROM dml_test GROUP BY device ORDER BY device;
+
+-- the quals on the orderby column use the segment metadata
+UPDATE dml_test SET val = 20 WHERE device = 2 AND time < '2020-01-03 12:00';
+SELECT * FROM compressed_chunk_status('dml_test');
+SELECT device, count(*), sum(val) FROM dml_test GROUP BY device ORDER BY device;
+SELECT recompress_chunk(:'DML_CHUNK') IS NOT NULL AS recompressed;
+SELECT * FROM compressed_chunk_status('dml_test');
+SELECT device, count(*), sum(val) FROM dml_test GROUP BY device ORDER BY device;
+DROP TABLE dml_test;
+
+-- Test the batches of a chunk column share one dictionary
+SET timescaledb.enable_shared_dictionary_compression TO ON;
+CREATE TABLE shared_dict(time timestamptz NOT NULL, device int, label text);
+SELECT table_name FROM create_hypertable('shared_dict', 'time');
+INSERT INTO shared_dict SELECT time, device, 'label ' || val::int % 4 FROM readings;
+ALTER TABLE shared_dict SET (timescaledb.compress, timescaledb.compress_segmentby = 'device');
+-- the insertions of the transaction count the dictionaries
+BEGIN;
+SELECT count(compress_chunk(ch)) FROM show_chunks('shared_dict') ch;
+SELECT n_tup_ins FROM pg_stat_xact_user_tables
+WHERE relid = '_timescaledb_catalog.compression_chunk_dictionary'::regclass;
+COMMIT;
+-- the dictionaries hold the values of the column, so only the catalog owner can read them
+\set ON_ERROR_STOP 0
+SELECT count(*) FROM _timescaledb_catalog.compression_chunk_dictionary;
+\set ON_ERROR_STOP 1
+SELECT label, count(*) FROM shared_dict GROUP BY label ORDER BY label;
+SELECT label FROM shared_dict WHERE device = 2 ORDER BY time DESC LIMIT 3;
+-- the dictionaries are dropped with the compressed chunk
+BEGIN;
+SELECT count(decompress_chunk(ch)) FROM show_chunks('shared_dict') ch;
+SELECT n_tup_del FROM pg_stat_xact_user_tables
+WHERE relid = '_timescaledb_catalog.compression_chunk_dictionary'::regclass;
+COMMIT;
+RESET timescaledb.enable_shared_dictionary_compression;
+DROP TABLE shared_dict;
+
+-- Test the compression advisor trial compresses without writing anything
+CREATE TABLE advisor_test(LIKE readings);
+SELECT table_name FROM create_hypertable('advisor_test', 'time');
+INSERT INTO advisor_test SELECT * FROM readings;
+SELECT show_chunks('advisor_test') AS "ADVISOR_CHUNK" \gset
+SELECT segmentby, orderby, compression_ratio > 0 AS compressed,
+  round(batch_fill_rate::numeric, 4) AS batch_fill_rate,
+  coalesce(decompression_rows_per_second > 0, true) AS decompressed
+FROM compression_advisor(:'ADVISOR_CHUNK');
+SELECT segmentby, orderby, round(batch_fill_rate::numeric, 4) AS batch_fill_rate
+FROM compression_advisor(:'ADVISOR_CHUNK', ARRAY['device'], ARRAY['val', 'time']);
+SELECT count(*) FROM _timescaledb_catalog.hypertable_compression hc
+JOIN _timescaledb_catalog.hypertable ht ON ht.id = hc.hypertable_id
+WHERE ht.table_name = 'advisor_test';
+\set ON_ERROR_STOP 0
+SELECT * FROM compression_advisor('advisor_test');
+SELECT * FROM compression_advisor(:'ADVISOR_CHUNK', sample_size => 0);
+\set ON_ERROR_STOP 1
+DROP TABLE advisor_test;
+
+-- Test compressed chunks created in the same transaction are written frozen.
+-- Frozen rows keep their xmin, but they are visible to any snapshot. A STABLE
+-- function reads with the snapshot of the statement calling it, which only
+-- sees the rows that statement inserted if they were written frozen.
+SET timescaledb.enable_frozen_compression TO ON;
+CREATE TABLE frozen_test(LIKE readings);
+SELECT table_name FROM create_hypertable('frozen_test', 'time');
+INSERT INTO frozen_test SELECT * FROM readings;
+ALTER TABLE frozen_test SET (timescaledb.compress, timescaledb.compress_segmentby = 'device');
+CREATE FUNCTION frozen_test_rows() RETURNS bigint LANGUAGE plpgsql STABLE AS
+$$
+DECLARE
+  compressed_chunk text;
+  frozen bigint;
+BEGIN
+  -- the catalog rows of the new compressed chunk are not visible yet, but it
+  -- got the last chunk id
+  SELECT format('_timescaledb_internal.compress%s_%s_chunk', comp.associated_table_prefix, s.last_value)
+  INTO compressed_chunk
+  FROM _timescaledb_catalog.hypertable ht
+  JOIN _timescaledb_catalog.hypertable comp ON comp.id = ht.compressed_hypertable_id,
+    _timescaledb_catalog.chunk_id_seq s
+  WHERE ht.table_name = 'frozen_test';
+  EXECUTE 'SELECT count(*) FROM ' || compressed_chunk INTO frozen;
+  RETURN frozen;
+END
+$$;
+SELECT count(compress_chunk(ch)) AS compressed, frozen_test_rows() AS frozen
+FROM show_chunks('frozen_test') ch;
+SELECT device, count(*), sum(val) FROM frozen_test GROUP BY device ORDER BY device;
+SELECT count(decompress_chunk(ch)) FROM show_chunks('frozen_test') ch;
+-- an open cursor holds an older snapshot, so the rows are inserted normally
+BEGIN;
+DECLARE frozen_cursor CURSOR FOR SELECT 1;
+SELECT count(compress_chunk(ch)) AS compressed, frozen_test_rows() AS frozen
+FROM show_chunks('frozen_test') ch;
+CLOSE frozen_cursor;
+COMMIT;
+SELECT device, count(*), sum(val) FROM frozen_test GROUP BY device ORDER BY device;
+RESET timescaledb.enable_frozen_compression;
+DROP FUNCTION frozen_test_rows();
+DROP TABLE frozen_test;
+
+-- Test parallel workers claim whole batches through shared memory
+CREATE FUNCTION plan_without_names(query text) RETURNS SETOF text LANGUAGE plpgsql AS
+$$
+DECLARE
+  line text;
+BEGIN
+  FOR line IN EXECUTE 'EXPLAIN (costs off) ' || query LOOP
+    RETURN NEXT regexp_replace(line, ' using \S+ on \S+| on \S+', '');
+  END LOOP;
+END
+$$;
+CREATE TABLE batch_dist(time timestamptz NOT NULL, device int, val float);
+SELECT table_name FROM create_hypertable('batch_dist', 'time');
+INSERT INTO batch_dist SELECT t, d, extract(minute from t)
+FROM generate_series('2020-01-03 0:00'::timestamptz, '2020-01-03 12:00', '1 minute') t,
+  generate_series(1, 4) d;
+ALTER TABLE batch_dist SET (timescaledb.compress, timescaledb.compress_segmentby = 'device');
+SELECT count(compress_chunk(ch)) FROM show_chunks('batch_dist') ch;
+ANALYZE batch_dist;
+SET timescaledb.enable_decompression_batch_distribution TO ON;
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET max_parallel_workers_per_gather = 2;
+SELECT device, count(*), sum(val) FROM batch_dist GROUP BY device ORDER BY device;
+SELECT count(*), min(val), max(val) FROM batch_dist WHERE device = 3;
+-- every participant reads all compressed tuples and decompresses the batches it claims
+SELECT * FROM plan_without_names('SELECT sum(val) FROM batch_dist');
+RESET max_parallel_workers_per_gather;
+RESET parallel_tuple_cost;
+RESET parallel_setup_cost;
+RESET timescaledb.enable_decompression_batch_distribution;
+DROP TABLE batch_dist;
+
+-- Test batches proven by their metadata and segmentby only queries
+CREATE TABLE meta_scan(LIKE readings);
+SELECT table_name FROM create_hypertable('meta_scan', 'time');
+INSERT INTO meta_scan SELECT * FROM readings;
+ALTER TABLE meta_scan SET (timescaledb.compress, timescaledb.compress_segmentby = 'device');
+SELECT count(compress_chunk(ch)) FROM show_chunks('meta_scan') ch;
+-- the segmentby indexes cover the batch row count whether or not the setting is on
+SELECT count(*) FROM pg_indexes i
+JOIN _timescaledb_catalog.hypertable comp ON comp.schema_name = i.schemaname AND comp.table_name = i.tablename
+JOIN _timescaledb_catalog.hypertable ht ON ht.compressed_hypertable_id = comp.id
+WHERE ht.table_name = 'meta_scan' AND i.indexdef LIKE '%INCLUDE (_ts_meta_count)%';
+SET timescaledb.enable_compressed_metadata_scan TO ON;
+-- all batches are proven
+SELECT device, count(*) FROM meta_scan WHERE time >= '2020-01-01' GROUP BY device ORDER BY device;
+-- no batch is proven
+SELECT device, count(*) FROM meta_scan WHERE time > '2020-01-03 12:00' GROUP BY device
+ORDER BY device;
+SELECT DISTINCT device FROM meta_scan WHERE time < '2020-01-05' AND device > 1 ORDER BY device;
+SELECT min(val), max(val) FROM meta_scan WHERE time >= '2020-01-01';
+SELECT count(*) FROM meta_scan WHERE device = 2;
+-- a segmentby only query reads the batch row count from the index without decompressing
+SET enable_seqscan TO OFF;
+SET enable_bitmapscan TO OFF;
+SELECT * FROM plan_without_names('SELECT count(*) FROM meta_scan WHERE device = 2');
+RESET timescaledb.enable_compressed_metadata_scan;
+-- without the setting the index is scanned like for any other query
+SELECT * FROM plan_without_names('SELECT count(*) FROM meta_scan WHERE device = 2');
+DROP FUNCTION plan_without_names(text);
+RESET enable_bitmapscan;
+RESET enable_seqscan;
+DROP TABLE meta_scan;
+DROP TABLE readings;
+
+-- Test inserts into a compressed chunk are staged and merged by recompress_chunk
+CREATE TABLE staging(time int NOT NULL, device int, value float8);
+SELECT table_name FROM create_hypertable('staging', 'time', chunk_time_interval => 100);
+INSERT INTO staging SELECT t, d, t FROM generate_series(0, 49) t, generate_series(1, 3) d;
+ALTER TABLE staging SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time');
+CREATE FUNCTION plan_contains(query text, node text) RETURNS bool LANGUAGE plpgsql AS
+$$
+DECLARE
+  line text;
+BEGIN
+  FOR line IN EXECUTE 'EXPLAIN (costs off) ' || query LOOP
+    IF line LIKE '%' || node || '%' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END
+$$;
+SELECT show_chunks('staging') AS "STAGING_CHUNK" \gset
+SELECT count(compress_chunk(ch)) FROM show_chunks('staging') ch;
+SELECT format('%I.%I', comp.schema_name, comp.table_name) AS "STAGING_COMPRESSED_CHUNK"
+FROM _timescaledb_catalog.chunk ch
+JOIN _timescaledb_catalog.chunk comp ON comp.id = ch.compressed_chunk_id
+WHERE format('%I.%I', ch.schema_name, ch.table_name)::regclass = :'STAGING_CHUNK'::regclass \gset
+
+INSERT INTO staging SELECT t, d, -t FROM generate_series(50, 59) t, generate_series(1, 2) d;
+SELECT * FROM compressed_chunk_status('staging');
+-- a partial chunk returns the staged and the compressed rows together
+SELECT device, count(*), sum(value), min(time), max(time) FROM staging GROUP BY device ORDER BY device;
+SELECT plan_contains('SELECT * FROM staging', 'Append');
+SELECT plan_contains('SELECT * FROM staging', 'DecompressChunk');
+SELECT plan_contains('SELECT * FROM staging', 'Seq Scan on _hyper');
+-- the staged rows are merged into the ordered output
+SELECT time, value FROM staging WHERE device = 1 AND time >= 45 ORDER BY time;
+SELECT time, value FROM staging WHERE device = 2 ORDER BY time DESC LIMIT 3;
+
+-- only the segments with staged rows are rebuilt, the batches of device 3 stay in place
+CREATE TABLE staging_batches AS SELECT device, ctid AS batch_ctid FROM :STAGING_COMPRESSED_CHUNK;
+SELECT recompress_chunk(:'STAGING_CHUNK') IS NOT NULL AS recompressed;
+SELECT * FROM compressed_chunk_status('staging');
+SELECT b.device, EXISTS (SELECT FROM :STAGING_COMPRESSED_CHUNK c WHERE c.ctid = b.batch_ctid) AS unchanged
+FROM staging_batches b ORDER BY b.device;
+SELECT device, count(*) FROM :STAGING_COMPRESSED_CHUNK GROUP BY device ORDER BY device;
+SELECT plan_contains('SELECT * FROM staging', 'Seq Scan on _hyper');
+SELECT device, count(*), sum(value), min(time), max(time) FROM staging GROUP BY device ORDER BY device;
+DROP FUNCTION plan_contains(text, text);
+DROP TABLE staging_batches;
+DROP TABLE staging;
+
+-- Test compressing chunks by reading them through an index in segmentby and orderby order.
+-- The rows are inserted ordered by time, so only the index or the sort puts them in order.
+-- The index scans are counted in the statistics of the transaction.
+CREATE TABLE ixscan(time int NOT NULL, device int, value float8);
+SELECT table_name FROM create_hypertable('ixscan', 'time', chunk_time_interval => 1000, create_default_indexes => false);
+CREATE TABLE ixsort(time int NOT NULL, device int, value float8);
+SELECT table_name FROM create_hypertable('ixsort', 'time', chunk_time_interval => 1000, create_default_indexes => false);
+INSERT INTO ixscan SELECT t, d, t * d FROM generate_series(0, 1999) t, generate_series(1, 4) d;
+INSERT INTO ixscan SELECT t, NULL, t FROM generate_series(0, 1999, 100) t;
+INSERT INTO ixsort SELECT * FROM ixscan;
+CREATE INDEX ixscan_device_time ON ixscan(device, time);
+CREATE INDEX ixsort_device_time ON ixsort(device, time);
+ALTER TABLE ixscan SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time');
+ALTER TABLE ixsort SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time');
+SELECT format('%I.%I', comp.schema_name, comp.table_name) AS "IXSCAN_COMPRESSED"
+FROM _timescaledb_catalog.hypertable ht
+JOIN _timescaledb_catalog.hypertable comp ON comp.id = ht.compressed_hypertable_id
+WHERE ht.table_name = 'ixscan' \gset
+SELECT format('%I.%I', comp.schema_name, comp.table_name) AS "IXSORT_COMPRESSED"
+FROM _timescaledb_catalog.hypertable ht
+JOIN _timescaledb_catalog.hypertable comp ON comp.id = ht.compressed_hypertable_id
+WHERE ht.table_name = 'ixsort' \gset
+
+-- forward index scan
+BEGIN;
+SELECT count(compress_chunk(c)) FROM show_chunks('ixscan') c;
+SELECT sum(idx_scan) AS index_scans FROM pg_stat_xact_user_indexes WHERE indexrelname LIKE '%ixscan_device_time';
+COMMIT;
+SET timescaledb.enable_compression_indexscan TO off;
+BEGIN;
+SELECT count(compress_chunk(c)) FROM show_chunks('ixsort') c;
+SELECT sum(idx_scan) AS index_scans FROM pg_stat_xact_user_indexes WHERE indexrelname LIKE '%ixsort_device_time';
+COMMIT;
+RESET timescaledb.enable_compression_indexscan;
+-- both give the same batches
+SELECT count(*) FROM :IXSCAN_COMPRESSED;
+SELECT count(*) FROM (
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSCAN_COMPRESSED
+  EXCEPT ALL
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSORT_COMPRESSED
+) d;
+SELECT count(*) FROM (
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSORT_COMPRESSED
+  EXCEPT ALL
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSCAN_COMPRESSED
+) d;
+SELECT count(*), sum(value), count(device) FROM ixscan;
+
+-- backward index scan, the index has the opposite order in every column
+SELECT count(decompress_chunk(c)) FROM show_chunks('ixscan') c;
+SELECT count(decompress_chunk(c)) FROM show_chunks('ixsort') c;
+DROP INDEX ixscan_device_time;
+DROP INDEX ixsort_device_time;
+CREATE INDEX ixscan_device_desc ON ixscan(device DESC, time);
+CREATE INDEX ixsort_device_desc ON ixsort(device DESC, time);
+ALTER TABLE ixscan SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time DESC');
+ALTER TABLE ixsort SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time DESC');
+BEGIN;
+SELECT count(compress_chunk(c)) FROM show_chunks('ixscan') c;
+SELECT sum(idx_scan) AS index_scans FROM pg_stat_xact_user_indexes WHERE indexrelname LIKE '%ixscan_device_desc';
+COMMIT;
+SET timescaledb.enable_compression_indexscan TO off;
+BEGIN;
+SELECT count(compress_chunk(c)) FROM show_chunks('ixsort') c;
+SELECT sum(idx_scan) AS index_scans FROM pg_stat_xact_user_indexes WHERE indexrelname LIKE '%ixsort_device_desc';
+COMMIT;
+RESET timescaledb.enable_compression_indexscan;
+SELECT count(*) FROM (
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSCAN_COMPRESSED
+  EXCEPT ALL
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSORT_COMPRESSED
+) d;
+SELECT count(*) FROM (
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSORT_COMPRESSED
+  EXCEPT ALL
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSCAN_COMPRESSED
+) d;
+SELECT time, value FROM ixscan WHERE device = 3 ORDER BY time DESC LIMIT 3;
+
+-- The index is only used when the planner estimates reading it to be cheaper than sorting,
+-- like CLUSTER does. With a tiny cache, reading the rows in the order of an index that does
+-- not correlate with the table costs a random read per row, so the rows are sorted instead.
+SELECT count(decompress_chunk(c)) FROM show_chunks('ixscan') c;
+CREATE TABLE ixscan_rows AS SELECT * FROM ixscan;
+TRUNCATE ixscan;
+INSERT INTO ixscan SELECT * FROM ixscan_rows ORDER BY time, device;
+ANALYZE ixscan;
+SET effective_cache_size TO 1;
+BEGIN;
+SELECT count(compress_chunk(c)) FROM show_chunks('ixscan') c;
+SELECT sum(idx_scan) AS index_scans FROM pg_stat_xact_user_indexes WHERE indexrelname LIKE '%ixscan_device_desc';
+COMMIT;
+-- an index that correlates with the table is read in table order, so it is still used
+SELECT count(decompress_chunk(c)) FROM show_chunks('ixscan') c;
+TRUNCATE ixscan;
+INSERT INTO ixscan SELECT * FROM ixscan_rows ORDER BY device, time;
+ANALYZE ixscan;
+BEGIN;
+SELECT count(compress_chunk(c)) FROM show_chunks('ixscan') c;
+SELECT sum(idx_scan) AS index_scans FROM pg_stat_xact_user_indexes WHERE indexrelname LIKE '%ixscan_device_desc';
+COMMIT;
+RESET effective_cache_size;
+SELECT count(*) FROM (
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSCAN_COMPRESSED
+  EXCEPT ALL
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSORT_COMPRESSED
+) d;
+SELECT count(*) FROM (
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSORT_COMPRESSED
+  EXCEPT ALL
+  SELECT device, _ts_meta_count, _ts_meta_sequence_num, time::text, value::text FROM :IXSCAN_COMPRESSED
+) d;
+DROP TABLE ixscan_rows;
+DROP TABLE ixscan;
+DROP TABLE ixsort;
+
+-- Test the rows written in batches by compression and decompression. Device 1 crosses
+-- the row limit of the insert buffer and device 2 crosses the byte limit with toasted
+-- values. UPDATE and DELETE must find every decompressed row through the index.
+CREATE TABLE bulk_insert(time int NOT NULL, device int, val int, payload text);
+SELECT table_name FROM create_hypertable('bulk_insert', 'time', chunk_time_interval => 10000, create_default_indexes => false);
+INSERT INTO bulk_insert SELECT t, 1, t, 'p' || t FROM generate_series(0, 2499) t;
+INSERT INTO bulk_insert SELECT t, 2, t,
+  (SELECT string_agg(md5(t::text || ':' || g::text), '') FROM generate_series(1, 300) g)
+FROM generate_series(0, 99) t;
+CREATE INDEX bulk_insert_device_val ON bulk_insert(device, val);
+CREATE TABLE bulk_insert_ref AS SELECT * FROM bulk_insert;
+ALTER TABLE bulk_insert SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time');
+SELECT show_chunks('bulk_insert') AS "BULK_CHUNK" \gset
+SELECT reltoastrelid::regclass AS "BULK_TOAST" FROM pg_class WHERE oid = :'BULK_CHUNK'::regclass \gset
+CREATE VIEW bulk_insert_diff AS
+SELECT (SELECT count(*) FROM (TABLE bulk_insert EXCEPT ALL TABLE bulk_insert_ref) d) AS added,
+  (SELECT count(*) FROM (TABLE bulk_insert_ref EXCEPT ALL TABLE bulk_insert) d) AS missing;
+SELECT count(DISTINCT chunk_id) AS toasted FROM :BULK_TOAST;
+SELECT count(compress_chunk(ch)) FROM show_chunks('bulk_insert') ch;
+SELECT * FROM compressed_chunk_status('bulk_insert');
+SELECT count(DISTINCT chunk_id) AS toasted FROM :BULK_TOAST;
+SELECT * FROM bulk_insert_diff;
+
+-- decompressing the whole chunk toasts the values again
+SELECT count(decompress_chunk(ch)) FROM show_chunks('bulk_insert') ch;
+SELECT count(DISTINCT chunk_id) AS toasted FROM :BULK_TOAST;
+SELECT * FROM bulk_insert_diff;
+SELECT count(compress_chunk(ch)) FROM show_chunks('bulk_insert') ch;
+
+-- the scan of the uncompressed chunk uses the index entries of the decompressed rows
+SET enable_seqscan TO off;
+BEGIN;
+UPDATE bulk_insert SET val = val + 10000 WHERE device = 1;
+SELECT sum(idx_scan) > 0 AS index_used FROM pg_stat_xact_user_indexes WHERE indexrelname LIKE '%bulk_insert_device_val';
+COMMIT;
+UPDATE bulk_insert_ref SET val = val + 10000 WHERE device = 1;
+SELECT * FROM compressed_chunk_status('bulk_insert');
+SELECT * FROM bulk_insert_diff;
+BEGIN;
+DELETE FROM bulk_insert WHERE device = 2 AND val % 3 = 0;
+SELECT sum(idx_scan) > 0 AS index_used FROM pg_stat_xact_user_indexes WHERE indexrelname LIKE '%bulk_insert_device_val';
+COMMIT;
+DELETE FROM bulk_insert_ref WHERE device = 2 AND val % 3 = 0;
+RESET enable_seqscan;
+SELECT * FROM compressed_chunk_status('bulk_insert');
+SELECT count(DISTINCT chunk_id) AS toasted FROM :BULK_TOAST;
+SELECT * FROM bulk_insert_diff;
+SELECT device, count(*), sum(val), count(payload) FROM bulk_insert GROUP BY device ORDER BY device;
+SELECT recompress_chunk(:'BULK_CHUNK') IS NOT NULL AS recompressed;
+SELECT * FROM compressed_chunk_status('bulk_insert');
+SELECT * FROM bulk_insert_diff;
+DROP VIEW bulk_insert_diff;
+DROP TABLE bulk_insert_ref;
+DROP TABLE bulk_insert;
@@ -14,7 +14,6 @@ AS :TSL_MODULE_PATHNAME LANGUAGE C VOLATILE;
 ------------------
 
 SELECT ts_test_compression();
-
 \ir include/rand_generator.sql
 
 ------------------------
@@ -0,0 +1,50 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+CREATE TABLE batch(time int NOT NULL, device int, value float8);
+SELECT table_name FROM create_hypertable('batch', 'time', chunk_time_interval => 10000);
+INSERT INTO batch SELECT t, t % 2, t FROM generate_series(0, 9999) t;
+
+\set ON_ERROR_STOP 0
+ALTER TABLE batch SET (timescaledb.compress, timescaledb.compress_batch_size = 0);
+ALTER TABLE batch SET (timescaledb.compress, timescaledb.compress_batch_size = 1000000);
+ALTER TABLE batch SET (timescaledb.compress, timescaledb.compress_batch_target_size = 0);
+ALTER TABLE batch SET (timescaledb.compress = false, timescaledb.compress_batch_size = 100);
+\set ON_ERROR_STOP 1
+
+-- fixed number of rows per batch
+ALTER TABLE batch SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_batch_size = 2500);
+SELECT batch_size, target_batch_bytes FROM _timescaledb_catalog.hypertable_compression_batch;
+SELECT count(compress_chunk(c)) FROM show_chunks('batch') c;
+SELECT numrows_pre_compression, numrows_post_compression FROM _timescaledb_catalog.compression_chunk_size;
+SELECT count(*), sum(value) FROM batch;
+SELECT count(*), sum(value) FROM batch WHERE device = 1;
+
+-- batches sized toward a target number of compressed bytes
+SELECT count(decompress_chunk(c)) FROM show_chunks('batch') c;
+ALTER TABLE batch SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_batch_target_size = 256);
+SELECT batch_size, target_batch_bytes FROM _timescaledb_catalog.hypertable_compression_batch;
+SELECT count(compress_chunk(c)) FROM show_chunks('batch') c;
+SELECT numrows_post_compression > 20 AS smaller_batches FROM _timescaledb_catalog.compression_chunk_size;
+SELECT count(*), sum(value) FROM batch;
+
+-- the settings go away with compression
+SELECT count(decompress_chunk(c)) FROM show_chunks('batch') c;
+ALTER TABLE batch SET (timescaledb.compress = false);
+SELECT count(*) FROM _timescaledb_catalog.hypertable_compression_batch;
+
+DROP TABLE batch;
+
+-- a batch with columns large enough to be read in TOAST slices, with NULLs in one of them
+CREATE TABLE big_batch(time int NOT NULL, value int8, reading float8);
+SELECT table_name FROM create_hypertable('big_batch', 'time', chunk_time_interval => 100000);
+INSERT INTO big_batch SELECT t, CASE WHEN t % 7 <> 0 THEN hashint4(t) END, hashint4(t) / 1000.0 FROM generate_series(0, 99999) t;
+CREATE TABLE big_batch_expected AS SELECT * FROM big_batch;
+ALTER TABLE big_batch SET (timescaledb.compress, timescaledb.compress_batch_size = 100000);
+SELECT count(compress_chunk(c)) FROM show_chunks('big_batch') c;
+SELECT format('%I.%I', c.schema_name, c.table_name) AS "BIG_COMPRESSED" FROM _timescaledb_catalog.chunk c JOIN _timescaledb_catalog.chunk u ON u.compressed_chunk_id = c.id JOIN _timescaledb_catalog.hypertable h ON h.id = u.hypertable_id WHERE h.table_name = 'big_batch' \gset
+SELECT _ts_meta_count, pg_column_size(value) > 256 * 1024 AS value_sliced, pg_column_size(reading) > 256 * 1024 AS reading_sliced FROM :BIG_COMPRESSED;
+SELECT count(*) AS mismatches FROM big_batch b FULL JOIN big_batch_expected e ON b.time = e.time WHERE b.time IS NULL OR e.time IS NULL OR b.value IS DISTINCT FROM e.value OR b.reading IS DISTINCT FROM e.reading;
+DROP TABLE big_batch;
+DROP TABLE big_batch_expected;
@@ -0,0 +1,19 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+\c :TEST_DBNAME :ROLE_SUPERUSER
+CREATE OR REPLACE FUNCTION ts_compression_benchmark(
+    benchmark_values INTEGER,
+    iterations INTEGER,
+    batch_size INTEGER = 1000
+) RETURNS TABLE(data TEXT, algorithm TEXT, stored_algorithm TEXT, operation TEXT,
+    num_values BIGINT, uncompressed_bytes BIGINT, compressed_bytes BIGINT, seconds FLOAT8,
+    mb_per_second FLOAT8, values_per_second FLOAT8)
+AS :TSL_MODULE_PATHNAME LANGUAGE C STRICT VOLATILE;
+\c :TEST_DBNAME :ROLE_DEFAULT_PERM_USER
+
+-- the benchmark runs every algorithm on every data set
+SELECT count(*) AS results, count(DISTINCT data) AS data_sets,
+  count(*) FILTER (WHERE mb_per_second > 0 AND values_per_second > 0) AS timed
+FROM ts_compression_benchmark(2000, 1);
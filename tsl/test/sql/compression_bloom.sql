@@ -0,0 +1,55 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+CREATE TABLE bloom(time int NOT NULL, device int, value int, tag text);
+SELECT table_name FROM create_hypertable('bloom', 'time', chunk_time_interval => 500);
+INSERT INTO bloom SELECT t, t % 3, t % 50, 'tag' || (t % 50) FROM generate_series(0, 999) t;
+
+\set ON_ERROR_STOP 0
+ALTER TABLE bloom SET (timescaledb.compress, timescaledb.compress_bloomfilter = 'value + 1');
+ALTER TABLE bloom SET (timescaledb.compress, timescaledb.compress_bloomfilter = 'missing');
+ALTER TABLE bloom SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_bloomfilter = 'device');
+ALTER TABLE bloom SET (timescaledb.compress = false, timescaledb.compress_bloomfilter = 'value');
+\set ON_ERROR_STOP 1
+
+ALTER TABLE bloom SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time', timescaledb.compress_bloomfilter = 'value, tag');
+SELECT count(compress_chunk(c)) FROM show_chunks('bloom') c;
+ANALYZE bloom;
+
+CREATE FUNCTION plan_contains(query text, node text) RETURNS bool LANGUAGE plpgsql AS
+$$
+DECLARE
+  line text;
+BEGIN
+  FOR line IN EXECUTE 'EXPLAIN (costs off) ' || query LOOP
+    IF line LIKE '%' || node || '%' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END
+$$;
+
+-- equality and IN on columns with a bloom filter are checked on the compressed batches
+SELECT plan_contains('SELECT * FROM bloom WHERE value = 5', 'bloom1_contains');
+SELECT plan_contains('SELECT * FROM bloom WHERE tag = ''tag7''', 'bloom1_contains');
+SELECT plan_contains('SELECT * FROM bloom WHERE value IN (5, 7)', 'bloom1_contains');
+-- but not other operators
+SELECT plan_contains('SELECT * FROM bloom WHERE value > 5', 'bloom1_contains');
+SELECT plan_contains('SELECT * FROM bloom WHERE tag LIKE ''tag7%''', 'bloom1_contains');
+
+SELECT count(*) FROM bloom WHERE value = 5;
+SELECT count(*) FROM bloom WHERE tag = 'tag7';
+SELECT count(*) FROM bloom WHERE value IN (5, 7);
+SELECT count(*) FROM bloom WHERE value IN (5, NULL);
+SELECT count(*) FROM bloom WHERE value = 1000;
+SELECT count(*) FROM bloom WHERE tag = 'none';
+
+-- the bloom filter column follows renames of its column
+ALTER TABLE bloom RENAME COLUMN value TO val;
+SELECT plan_contains('SELECT * FROM bloom WHERE val = 5', 'bloom1_contains');
+SELECT count(*) FROM bloom WHERE val = 5;
+
+DROP FUNCTION plan_contains(text, text);
+DROP TABLE bloom;
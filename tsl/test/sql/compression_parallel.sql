@@ -0,0 +1,69 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+-- compress the same data serially and with parallel workers and compare
+CREATE TABLE ser(time int NOT NULL, device int, value float8, note text);
+CREATE TABLE par(time int NOT NULL, device int, value float8, note text);
+SELECT table_name FROM create_hypertable('ser', 'time', chunk_time_interval => 1000);
+SELECT table_name FROM create_hypertable('par', 'time', chunk_time_interval => 1000);
+
+INSERT INTO ser SELECT t, d, t * d, 'note ' || t % 7 FROM generate_series(0, 1999) t, generate_series(1, 5) d;
+INSERT INTO ser SELECT t, NULL, t, NULL FROM generate_series(0, 1999, 2) t;
+INSERT INTO par SELECT * FROM ser;
+
+ALTER TABLE ser SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time');
+ALTER TABLE par SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time');
+
+SELECT count(compress_chunk(c)) FROM show_chunks('ser') c;
+
+SET timescaledb.max_parallel_compression_workers = 4;
+SET min_parallel_table_scan_size = 0;
+SELECT count(compress_chunk(c)) FROM show_chunks('par') c;
+RESET min_parallel_table_scan_size;
+RESET timescaledb.max_parallel_compression_workers;
+
+-- every segment is compressed by exactly one worker, so the batches are the same
+SELECT ht.table_name, sum(s.numrows_pre_compression) AS pre, sum(s.numrows_post_compression) AS post
+FROM _timescaledb_catalog.compression_chunk_size s
+JOIN _timescaledb_catalog.chunk c ON c.id = s.chunk_id
+JOIN _timescaledb_catalog.hypertable ht ON ht.id = c.hypertable_id
+GROUP BY ht.table_name ORDER BY ht.table_name;
+
+SELECT count(*), sum(value), min(time), max(time) FROM ser;
+SELECT count(*), sum(value), min(time), max(time) FROM par;
+
+(SELECT device, count(*), sum(value), min(time), max(time) FROM ser GROUP BY device
+ EXCEPT
+ SELECT device, count(*), sum(value), min(time), max(time) FROM par GROUP BY device)
+UNION ALL
+(SELECT device, count(*), sum(value), min(time), max(time) FROM par GROUP BY device
+ EXCEPT
+ SELECT device, count(*), sum(value), min(time), max(time) FROM ser GROUP BY device);
+
+SELECT count(*) FROM (SELECT * FROM ser EXCEPT SELECT * FROM par) d;
+SELECT count(*) FROM (SELECT * FROM par EXCEPT SELECT * FROM ser) d;
+
+SELECT count(decompress_chunk(c)) FROM show_chunks('par') c;
+SELECT count(*) FROM (SELECT * FROM ser EXCEPT SELECT * FROM par) d;
+SELECT count(*), sum(value) FROM par;
+
+DROP TABLE ser;
+DROP TABLE par;
+
+-- compressed rows that need toasting are inserted once the workers are done
+CREATE TABLE par_wide(time int NOT NULL, device int, note text);
+SELECT table_name FROM create_hypertable('par_wide', 'time', chunk_time_interval => 1000);
+INSERT INTO par_wide SELECT t, d, repeat(md5((t * d)::text), 10) FROM generate_series(0, 999) t, generate_series(1, 3) d;
+CREATE TABLE par_wide_expected AS SELECT * FROM par_wide;
+ALTER TABLE par_wide SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time');
+SET timescaledb.max_parallel_compression_workers = 2;
+SET min_parallel_table_scan_size = 0;
+SELECT count(compress_chunk(c)) FROM show_chunks('par_wide') c;
+RESET min_parallel_table_scan_size;
+RESET timescaledb.max_parallel_compression_workers;
+SELECT count(*) FROM (SELECT * FROM par_wide EXCEPT SELECT * FROM par_wide_expected) d;
+SELECT count(*) FROM (SELECT * FROM par_wide_expected EXCEPT SELECT * FROM par_wide) d;
+SELECT count(*) FROM par_wide;
+DROP TABLE par_wide;
+DROP TABLE par_wide_expected;
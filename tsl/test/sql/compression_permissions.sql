@@ -75,7 +75,9 @@ update conditions
 set location = 'SFO'
 where timec = '2019-04-01 00:00+0'::timestamp with time zone;
 select location from conditions where timec = '2019-04-01 00:00+0';
---update expected to fail as executor touches all chunks
+--update expected to fail as executor touches all chunks when
+--dml on compressed chunks is disabled
+SET timescaledb.enable_compressed_dml TO OFF;
 update conditions
 set location = 'PNC'
 where location = 'SFO';
@@ -104,4 +104,18 @@ CREATE AGGREGATE _timescaledb_internal.compress_array(ANYELEMENT) (
     FINALFUNC = _timescaledb_internal.array_compressor_finish
 );
 
+--
+-- status and row counts of the compressed chunks of a hypertable
+--
+CREATE OR REPLACE FUNCTION compressed_chunk_status(hypertable REGCLASS)
+   RETURNS TABLE (status INTEGER, numrows_pre_compression BIGINT, numrows_post_compression BIGINT)
+   AS $$
+   SELECT ch.status, s.numrows_pre_compression, s.numrows_post_compression
+   FROM _timescaledb_catalog.chunk ch
+   JOIN _timescaledb_catalog.hypertable ht ON ht.id = ch.hypertable_id
+   JOIN _timescaledb_catalog.compression_chunk_size s ON s.chunk_id = ch.id
+   WHERE format('%I.%I', ht.schema_name, ht.table_name)::regclass = hypertable
+   ORDER BY ch.id
+   $$ LANGUAGE SQL STABLE;
+
 \set ECHO all
@@ -88,3 +88,28 @@ WHERE check_equal_228(rtt) ORDER BY ts;
 EXPLAIN (analyze,costs off,timing off,summary off) 
 SELECT * from test_chartab 
 WHERE check_equal_228(rtt) and ts < '2019-12-15 00:00:00' order by ts;
+
+-- test merging the batches of all segments when ordering by the orderby column only
+CREATE TABLE batch_merge(time timestamp NOT NULL, device_id int, value float);
+SELECT table_name FROM create_hypertable('batch_merge', 'time', chunk_time_interval => interval '1 week');
+ALTER TABLE batch_merge SET (timescaledb.compress, timescaledb.compress_segmentby = 'device_id', timescaledb.compress_orderby = 'time');
+INSERT INTO batch_merge SELECT time + device_id * interval '1 minute', device_id, device_id FROM generate_series('2000-01-03'::timestamp, '2000-01-04', '1h') g1(time), generate_series(1, 3) g2(device_id);
+SELECT count(compress_chunk(c)) FROM show_chunks('batch_merge') c;
+SET timescaledb.enable_decompression_batch_merge TO ON;
+SELECT time, device_id FROM batch_merge ORDER BY time DESC LIMIT 5;
+SELECT time, device_id FROM batch_merge ORDER BY time LIMIT 4;
+SELECT time, device_id FROM batch_merge WHERE value > 1 ORDER BY time DESC LIMIT 3;
+RESET timescaledb.enable_decompression_batch_merge;
+
+-- test filters on dictionary compressed columns, which are evaluated once per distinct value
+CREATE TABLE dict_filter(time timestamp NOT NULL, device_id int, status text);
+SELECT table_name FROM create_hypertable('dict_filter', 'time', chunk_time_interval => interval '1 week');
+ALTER TABLE dict_filter SET (timescaledb.compress, timescaledb.compress_orderby = 'time');
+INSERT INTO dict_filter SELECT time, device_id, CASE WHEN device_id < 3 THEN (ARRAY['OK', 'WARN', 'ERROR'])[extract(minute from time)::int / 20 + 1] END FROM generate_series('2000-01-03 0:00'::timestamp, '2000-01-03 2:00', '10m') g1(time), generate_series(1, 3) g2(device_id);
+SELECT count(compress_chunk(c)) FROM show_chunks('dict_filter') c;
+SELECT count(*) FROM dict_filter WHERE status = 'ERROR';
+SELECT status, count(*) FROM dict_filter WHERE status IN ('OK', 'WARN', NULL) GROUP BY status ORDER BY status;
+SELECT count(*) FROM dict_filter WHERE status <> ALL (ARRAY['OK', 'WARN']);
+SELECT count(*) FROM dict_filter WHERE status <> ALL (ARRAY['OK', NULL]);
+SELECT count(*) FROM dict_filter WHERE status <> ALL ('{}'::text[]);
+SELECT count(*) FROM dict_filter WHERE status = 'OK' OR device_id = 3;
@@ -0,0 +1,57 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+CREATE TABLE vagg(time int NOT NULL, device int, value int, fvalue float8);
+SELECT table_name FROM create_hypertable('vagg', 'time', chunk_time_interval => 100);
+INSERT INTO vagg SELECT t, d, d, 0.5 FROM generate_series(0, 299) t, generate_series(1, 3) d;
+ALTER TABLE vagg SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time');
+-- compress the first two chunks and leave the last one uncompressed
+SELECT count(compress_chunk(c)) FROM show_chunks('vagg', older_than => 200) c;
+ANALYZE vagg;
+
+CREATE FUNCTION plan_contains(query text, node text) RETURNS bool LANGUAGE plpgsql AS
+$$
+DECLARE
+  line text;
+BEGIN
+  FOR line IN EXECUTE 'EXPLAIN (costs off) ' || query LOOP
+    IF line LIKE '%' || node || '%' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END
+$$;
+
+SET timescaledb.enable_vectorized_aggregation TO on;
+
+SELECT plan_contains('SELECT device, sum(value) FROM vagg GROUP BY device', 'VectorAgg');
+SELECT plan_contains('SELECT count(*), max(time) FROM vagg WHERE time < 150', 'VectorAgg');
+-- grouping by a compressed column is not supported
+SELECT plan_contains('SELECT time, sum(value) FROM vagg GROUP BY time', 'VectorAgg');
+-- neither are aggregates on expressions
+SELECT plan_contains('SELECT device, sum(value + 1) FROM vagg GROUP BY device', 'VectorAgg');
+
+SELECT device, count(*), count(value), sum(value), min(time), max(time), sum(fvalue) FROM vagg GROUP BY device ORDER BY device;
+SELECT count(*), sum(value), avg(value), max(time) FROM vagg WHERE time < 150;
+SELECT device, avg(fvalue), min(value) FROM vagg WHERE device > 1 GROUP BY device ORDER BY device;
+SELECT device, sum(value) FROM vagg GROUP BY device HAVING sum(value) > 500 ORDER BY device;
+-- count(*) and min/max of orderby columns are computed from the metadata
+-- of the compressed chunks without decompression
+SELECT plan_contains('SELECT count(*), max(time) FROM vagg', 'DecompressChunk');
+SELECT plan_contains('SELECT device, count(*), min(time), max(time) FROM vagg GROUP BY device', 'DecompressChunk');
+SELECT plan_contains('SELECT count(*), max(time) FROM vagg WHERE device = 2', 'DecompressChunk');
+-- quals on orderby columns have to be checked on the decompressed rows
+SELECT plan_contains('SELECT count(*), max(time) FROM vagg WHERE time < 150', 'DecompressChunk');
+SELECT device, count(*), min(time), max(time) FROM vagg GROUP BY device ORDER BY device;
+SELECT count(*), max(time) FROM vagg WHERE device = 2;
+-- no matching rows
+SELECT count(*), sum(value), min(time) FROM vagg WHERE time > 1000;
+
+RESET timescaledb.enable_vectorized_aggregation;
+
+SELECT plan_contains('SELECT device, sum(value) FROM vagg GROUP BY device', 'VectorAgg');
+
+DROP FUNCTION plan_contains(text, text);
+DROP TABLE vagg;
@@ -0,0 +1,106 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+-- Filters on compressed columns are evaluated vectorized on whole batches. Compare
+-- them with the same filters on an uncompressed copy of the data. Every segment has
+-- 1300 rows, so it is compressed into batches of 1000 and 300 rows. i4 is NULL in
+-- every tenth row and in all rows of device 3, allnull is NULL everywhere.
+CREATE TABLE vq(time int NOT NULL, device int, i4 int, i8 bigint, f8 float8, txt text, allnull int);
+SELECT table_name FROM create_hypertable('vq', 'time', chunk_time_interval => 10000);
+CREATE TABLE vq_ref(LIKE vq);
+INSERT INTO vq_ref
+SELECT t, d, CASE WHEN d = 3 OR t % 10 = 0 THEN NULL ELSE t % 100 END, t * d, t / 7::float8, 'v' || t % 5, NULL
+FROM generate_series(0, 1299) t, generate_series(1, 3) d;
+INSERT INTO vq SELECT * FROM vq_ref;
+ALTER TABLE vq SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time');
+SELECT count(compress_chunk(c)) FROM show_chunks('vq') c;
+
+CREATE FUNCTION vq_check(pred text, OUT matching bigint, OUT differences bigint) LANGUAGE plpgsql AS
+$$
+BEGIN
+  EXECUTE format('SELECT count(*) FROM vq_ref WHERE %s', pred) INTO matching;
+  EXECUTE format('SELECT count(*) FROM ((SELECT * FROM vq WHERE %1$s EXCEPT ALL SELECT * FROM vq_ref WHERE %1$s)'
+    ' UNION ALL (SELECT * FROM vq_ref WHERE %1$s EXCEPT ALL SELECT * FROM vq WHERE %1$s)) d', pred)
+  INTO differences;
+END
+$$;
+
+-- comparisons with the column on the left, including on NULL and all-NULL columns
+SELECT p.pred, c.* FROM unnest(ARRAY[
+  'i4 > 50',
+  'i4 <= 10',
+  'i4 = 7',
+  'i4 <> 7',
+  'i8 >= 2500',
+  'i8 < 100::bigint',
+  'f8 >= 100.5',
+  'txt = ''v3''',
+  'allnull = 1',
+  'allnull <> 1'
+]) WITH ORDINALITY AS p(pred, n), LATERAL vq_check(p.pred) c
+ORDER BY p.n;
+-- the constant on the left
+SELECT p.pred, c.* FROM unnest(ARRAY[
+  '50 < i4',
+  '7 = i4',
+  '150 > f8',
+  '''v1'' <> txt'
+]) WITH ORDINALITY AS p(pred, n), LATERAL vq_check(p.pred) c
+ORDER BY p.n;
+-- AND and OR
+SELECT p.pred, c.* FROM unnest(ARRAY[
+  'i4 > 50 AND i8 < 1000',
+  'i4 < 5 OR f8 > 180',
+  '(i4 = 1 OR i4 = 2) AND txt = ''v1''',
+  'allnull = 1 OR i4 = 3'
+]) WITH ORDINALITY AS p(pred, n), LATERAL vq_check(p.pred) c
+ORDER BY p.n;
+-- arrays, including empty arrays and arrays with NULL elements
+SELECT p.pred, c.* FROM unnest(ARRAY[
+  'i4 IN (1, 2, 99)',
+  'i4 IN (1, NULL)',
+  'i4 <> ALL (ARRAY[1, 2])',
+  'txt = ANY (ARRAY[''v1'', ''v3''])',
+  'txt <> ALL (ARRAY[''v1'', NULL])',
+  'i4 <> ALL (''{}''::int[])',
+  'i4 = ANY (''{}''::int[])'
+]) WITH ORDINALITY AS p(pred, n), LATERAL vq_check(p.pred) c
+ORDER BY p.n;
+
+-- forward and reverse scans of ordered batches, across the batch boundary at time 1000
+SELECT time, i4 FROM vq WHERE device = 1 AND i4 > 95 ORDER BY time LIMIT 5;
+SELECT time, i4 FROM vq WHERE device = 1 AND i4 > 95 ORDER BY time DESC LIMIT 5;
+SELECT time, i4 FROM vq WHERE device = 2 AND txt = 'v0' AND i4 < 20 ORDER BY time DESC LIMIT 7;
+
+DROP FUNCTION vq_check(text);
+DROP TABLE vq_ref;
+DROP TABLE vq;
+
+-- Compressed columns that the filters do not reference are only decompressed for batches
+-- with matching rows. Every segment has three batches, only the middle one has rows
+-- with filter_col >= 0.
+CREATE TABLE lazy(time int NOT NULL, device int, filter_col int, proj1 int, proj2 text, proj3 float8);
+SELECT table_name FROM create_hypertable('lazy', 'time', chunk_time_interval => 10000);
+INSERT INTO lazy
+SELECT t, d, CASE WHEN t BETWEEN 1000 AND 1999 THEN t ELSE -1 END, t * 2, 'p' || t, t / 4::float8
+FROM generate_series(0, 2999) t, generate_series(1, 3) d;
+ALTER TABLE lazy SET (timescaledb.compress, timescaledb.compress_segmentby = 'device', timescaledb.compress_orderby = 'time');
+SELECT count(compress_chunk(c)) FROM show_chunks('lazy') c;
+
+-- no row passes in any batch
+SELECT count(*), sum(proj1), min(proj2) FROM lazy WHERE filter_col > 5000;
+-- rows pass in the middle batch only
+SELECT device, count(*), sum(proj1), min(proj2), max(proj3) FROM lazy WHERE filter_col > 1990
+GROUP BY device ORDER BY device;
+SELECT time, proj1, proj2, proj3 FROM lazy WHERE device = 2 AND filter_col > 1996 ORDER BY time;
+-- a filter that is evaluated per row
+SELECT time, device, proj2 FROM lazy WHERE filter_col % 500 = 0 AND device < 3 ORDER BY time, device;
+-- a whole-row reference needs all columns
+SELECT count(*), sum(l.proj1) FROM lazy l WHERE filter_col > 1990 AND l IS NOT NULL;
+-- ordered output merging the batches of all segments
+SET timescaledb.enable_decompression_batch_merge TO on;
+SELECT time, sum(proj1) FROM (SELECT time, proj1 FROM lazy WHERE filter_col > 1997 ORDER BY time DESC LIMIT 4) s
+GROUP BY time ORDER BY time;
+RESET timescaledb.enable_decompression_batch_merge;
+DROP TABLE lazy;
@@ -6,6 +6,8 @@
 
 #include <postgres.h>
 
+#include <math.h>
+
 #include <access/heapam.h>
 #include <access/htup_details.h>
 #include <catalog/pg_type.h>
@@ -14,6 +16,7 @@
 #include <lib/stringinfo.h>
 #include <utils/array.h>
 #include <utils/builtins.h>
+#include <utils/datum.h>
 #include <utils/lsyscache.h>
 #include <utils/rel.h>
 #include <utils/syscache.h>
@@ -24,12 +27,16 @@
 #include <export.h>
 #include "test_utils.h"
 
+#include "compression/alp.h"
 #include "compression/array.h"
+#include "compression/block.h"
 #include "compression/dictionary.h"
 #include "compression/gorilla.h"
 #include "compression/deltadelta.h"
+#include "compression/for.h"
 #include "compression/utils.h"
 #include "compression/segment_meta.h"
+#include "compression/simple8b_rle.h"
 
 #define VEC_PREFIX compression_info
 #define VEC_ELEMENT_TYPE Form_hypertable_compression
@@ -418,6 +425,436 @@ test_delta2()
 	TestAssertInt64Eq(i, 1015);
 }
 
+static void
+test_for()
+{
+	ForCompressor *compressor = for_compressor_alloc();
+	Datum compressed;
+	DecompressionIterator *iter;
+	int i;
+	for (i = 0; i < 1015; i++)
+	{
+		/* a counter that resets every 100 values */
+		if (i % 10 == 5)
+			for_compressor_append_null(compressor);
+		else
+			for_compressor_append_value(compressor, 1000 + i % 100);
+	}
+
+	compressed = PointerGetDatum(for_compressor_finish(compressor));
+	TestAssertTrue(DatumGetPointer(compressed) != NULL);
+	TestAssertInt64Eq(((CompressedDataHeader *) DatumGetPointer(compressed))->compression_algorithm,
+					  COMPRESSION_ALGORITHM_FOR);
+
+	i = 0;
+	iter = for_decompression_iterator_from_datum_forward(compressed, INT8OID);
+	for (DecompressResult r = for_decompression_iterator_try_next_forward(iter); !r.is_done;
+		 r = for_decompression_iterator_try_next_forward(iter))
+	{
+		TestAssertTrue(r.is_null == (i % 10 == 5));
+		if (!r.is_null)
+			TestAssertInt64Eq(DatumGetInt64(r.val), 1000 + i % 100);
+		i += 1;
+	}
+	TestAssertInt64Eq(i, 1015);
+
+	iter = for_decompression_iterator_from_datum_reverse(compressed, INT8OID);
+	for (DecompressResult r = for_decompression_iterator_try_next_reverse(iter); !r.is_done;
+		 r = for_decompression_iterator_try_next_reverse(iter))
+	{
+		i -= 1;
+		TestAssertTrue(r.is_null == (i % 10 == 5));
+		if (!r.is_null)
+			TestAssertInt64Eq(DatumGetInt64(r.val), 1000 + i % 100);
+	}
+	TestAssertInt64Eq(i, 0);
+
+	/* the full int64 range needs all 64 bits */
+	compressor = for_compressor_alloc();
+	for (i = 0; i < 100; i++)
+		for_compressor_append_value(compressor, i % 2 == 0 ? PG_INT64_MIN : PG_INT64_MAX - i);
+
+	compressed = PointerGetDatum(for_compressor_finish(compressor));
+	iter = for_decompression_iterator_from_datum_forward(compressed, INT8OID);
+	i = 0;
+	for (DecompressResult r = for_decompression_iterator_try_next_forward(iter); !r.is_done;
+		 r = for_decompression_iterator_try_next_forward(iter))
+	{
+		TestAssertTrue(!r.is_null);
+		TestAssertInt64Eq(DatumGetInt64(r.val), i % 2 == 0 ? PG_INT64_MIN : PG_INT64_MAX - i);
+		i += 1;
+	}
+	TestAssertInt64Eq(i, 100);
+}
+
+/* decimals with two digits, with NULLs and values that cannot be encoded mixed in */
+static bool
+alp_test_value(int i, double *value)
+{
+	const double exceptions[4] = { NAN, INFINITY, -0.0, 1.0 / 3.0 };
+
+	if (i % 7 == 3)
+		return false;
+
+	if (i % 50 == 0)
+		*value = exceptions[(i / 50) % 4];
+	else
+		*value = (2000 + i % 500) / 100.0;
+
+	return true;
+}
+
+static void
+test_alp()
+{
+	AlpCompressor *compressor = alp_compressor_alloc(FLOAT8OID);
+	Datum compressed;
+	DecompressionIterator *iter;
+	double value;
+	int i;
+
+	for (i = 0; i < 1015; i++)
+	{
+		if (alp_test_value(i, &value))
+			alp_compressor_append_value(compressor, value);
+		else
+			alp_compressor_append_null(compressor);
+	}
+
+	compressed = PointerGetDatum(alp_compressor_finish(compressor));
+	TestAssertTrue(DatumGetPointer(compressed) != NULL);
+	TestAssertInt64Eq(((CompressedDataHeader *) DatumGetPointer(compressed))->compression_algorithm,
+					  COMPRESSION_ALGORITHM_ALP);
+
+	i = 0;
+	iter = alp_decompression_iterator_from_datum_forward(compressed, FLOAT8OID);
+	for (DecompressResult r = alp_decompression_iterator_try_next_forward(iter); !r.is_done;
+		 r = alp_decompression_iterator_try_next_forward(iter))
+	{
+		TestAssertTrue(r.is_null == !alp_test_value(i, &value));
+		if (!r.is_null)
+			TestAssertInt64Eq(double_get_bits(DatumGetFloat8(r.val)), double_get_bits(value));
+		i += 1;
+	}
+	TestAssertInt64Eq(i, 1015);
+
+	iter = alp_decompression_iterator_from_datum_reverse(compressed, FLOAT8OID);
+	for (DecompressResult r = alp_decompression_iterator_try_next_reverse(iter); !r.is_done;
+		 r = alp_decompression_iterator_try_next_reverse(iter))
+	{
+		i -= 1;
+		TestAssertTrue(r.is_null == !alp_test_value(i, &value));
+		if (!r.is_null)
+			TestAssertInt64Eq(double_get_bits(DatumGetFloat8(r.val)), double_get_bits(value));
+	}
+	TestAssertInt64Eq(i, 0);
+
+	/* float4 values round-trip at float4 precision */
+	compressor = alp_compressor_alloc(FLOAT4OID);
+	for (i = 0; i < 1015; i++)
+		alp_compressor_append_value(compressor, (float4) (i / 10.0));
+
+	compressed = PointerGetDatum(alp_compressor_finish(compressor));
+	i = 0;
+	iter = alp_decompression_iterator_from_datum_forward(compressed, FLOAT4OID);
+	for (DecompressResult r = alp_decompression_iterator_try_next_forward(iter); !r.is_done;
+		 r = alp_decompression_iterator_try_next_forward(iter))
+	{
+		TestAssertTrue(!r.is_null);
+		TestAssertInt64Eq(float_get_bits(DatumGetFloat4(r.val)), float_get_bits(i / 10.0));
+		i += 1;
+	}
+	TestAssertInt64Eq(i, 1015);
+}
+
+/*
+ * The gorilla compressor used for float columns switches to ALP only when
+ * that is smaller
+ */
+static void
+test_gorilla_switches_to_alp()
+{
+	Compressor *compressor = gorilla_compressor_for_type(FLOAT8OID);
+	CompressedDataHeader *header;
+	int i;
+
+	for (i = 0; i < 1015; i++)
+		compressor->append_val(compressor, Float8GetDatum((2000 + i * 7919 % 1000) / 100.0));
+	header = compressor->finish(compressor);
+	TestAssertInt64Eq(header->compression_algorithm, COMPRESSION_ALGORITHM_ALP);
+
+	for (i = 0; i < 1015; i++)
+		compressor->append_val(compressor, Float8GetDatum(i / 7.0));
+	header = compressor->finish(compressor);
+	TestAssertInt64Eq(header->compression_algorithm, COMPRESSION_ALGORITHM_GORILLA);
+}
+
+/*
+ * The deltadelta compressor used for columns switches to frame-of-reference
+ * only when that is smaller
+ */
+static void
+test_delta_switches_to_for()
+{
+	Compressor *compressor = delta_delta_compressor_for_type(INT4OID);
+	CompressedDataHeader *header;
+	int i;
+
+	for (i = 0; i < 1015; i++)
+		compressor->append_val(compressor, Int32GetDatum(i * 10));
+	header = compressor->finish(compressor);
+	TestAssertInt64Eq(header->compression_algorithm, COMPRESSION_ALGORITHM_DELTADELTA);
+
+	for (i = 0; i < 1015; i++)
+		compressor->append_val(compressor, Int32GetDatum((i * 7919) % 31));
+	header = compressor->finish(compressor);
+	TestAssertInt64Eq(header->compression_algorithm, COMPRESSION_ALGORITHM_FOR);
+}
+
+static void
+test_simple8brle_decompress_all()
+{
+	Simple8bRleCompressor compressor;
+	Simple8bRleSerialized *compressed;
+	Simple8bRleDecompressionIterator iter;
+	uint64 *decompressed;
+	uint32 num_elements = 0;
+	uint32 bits;
+	uint32 i;
+
+	simple8brle_compressor_init(&compressor);
+
+	/* exercise every bit-packing width, plus RLE runs in between */
+	for (bits = 1; bits <= 64; bits++)
+	{
+		uint64 max_val = bits < 64 ? (UINT64CONST(1) << bits) - 1 : PG_UINT64_MAX;
+
+		for (i = 0; i < 77; i++)
+		{
+			simple8brle_compressor_append(&compressor, max_val - (i % 3));
+			num_elements++;
+		}
+
+		for (i = 0; i < 150; i++)
+		{
+			simple8brle_compressor_append(&compressor, bits);
+			num_elements++;
+		}
+	}
+
+	/* end with a partial block */
+	for (i = 0; i < 5; i++)
+	{
+		simple8brle_compressor_append(&compressor, i);
+		num_elements++;
+	}
+
+	compressed = simple8brle_compressor_finish(&compressor);
+	TestAssertInt64Eq(compressed->num_elements, num_elements);
+
+	/* round-trip through send/recv, the bulk decoder must handle the result the same */
+	{
+		StringInfoData buf;
+		bytea *sent;
+		StringInfoData transmition;
+
+		pq_begintypsend(&buf);
+		simple8brle_serialized_send(&buf, compressed);
+		sent = pq_endtypsend(&buf);
+
+		transmition = (StringInfoData){
+			.data = VARDATA(sent),
+			.len = VARSIZE(sent),
+			.maxlen = VARSIZE(sent),
+		};
+
+		compressed = simple8brle_serialized_recv(&transmition);
+		TestAssertInt64Eq(compressed->num_elements, num_elements);
+	}
+
+	decompressed = simple8brle_decompress_all(compressed);
+
+	simple8brle_decompression_iterator_init_forward(&iter, compressed);
+	i = 0;
+	for (Simple8bRleDecompressResult r = simple8brle_decompression_iterator_try_next_forward(&iter);
+		 !r.is_done;
+		 r = simple8brle_decompression_iterator_try_next_forward(&iter))
+	{
+		TestAssertTrue(decompressed[i] == r.val);
+		i++;
+	}
+	TestAssertInt64Eq(i, num_elements);
+}
+
+/*
+ * Check that bulk decompression returns the same rows as the forward iterator
+ */
+static void
+test_decompress_all_matches_iterator(Datum compressed, Oid element_type, int expected_rows,
+									 int expected_nulls)
+{
+	CompressionAlgorithms algorithm =
+		((CompressedDataHeader *) DatumGetPointer(compressed))->compression_algorithm;
+	DecompressedBatch *batch =
+		tsl_get_decompress_all_function(algorithm)(compressed, element_type);
+	DecompressionIterator *iter =
+		tsl_get_decompression_iterator_init(algorithm, false)(compressed, element_type);
+	int16 typlen;
+	bool typbyval;
+	uint32 row = 0;
+
+	get_typlenbyval(element_type, &typlen, &typbyval);
+
+	TestAssertInt64Eq(batch->num_rows, expected_rows);
+	TestAssertInt64Eq(batch->num_nulls, expected_nulls);
+
+	for (DecompressResult r = iter->try_next(iter); !r.is_done; r = iter->try_next(iter))
+	{
+		TestAssertTrue(row < batch->num_rows);
+		TestAssertTrue(decompressed_batch_row_is_valid(batch, row) == !r.is_null);
+		if (!r.is_null)
+			TestAssertTrue(datumIsEqual(batch->values[row], r.val, typbyval, typlen));
+		row++;
+	}
+	TestAssertInt64Eq(row, batch->num_rows);
+}
+
+static void
+test_decompress_all()
+{
+	DeltaDeltaCompressor *delta_delta = delta_delta_compressor_alloc();
+	ForCompressor *frame_of_reference = for_compressor_alloc();
+	AlpCompressor *alp = alp_compressor_alloc(FLOAT8OID);
+	GorillaCompressor *gorilla = gorilla_compressor_alloc();
+	ArrayCompressor *array = array_compressor_alloc(TEXTOID);
+	DictionaryCompressor *dictionary = dictionary_compressor_alloc(TEXTOID);
+	char *strings[5] = { "a", "foo", "bar", "gobble gobble gobble", "baz" };
+	int num_nulls = 0;
+	int i;
+
+	for (i = 0; i < 1015; i++)
+	{
+		/* a mix of runs, bit-packed blocks and NULLs */
+		if (i % 7 == 3 || (i > 500 && i < 600))
+		{
+			delta_delta_compressor_append_null(delta_delta);
+			for_compressor_append_null(frame_of_reference);
+			alp_compressor_append_null(alp);
+			gorilla_compressor_append_null(gorilla);
+			array_compressor_append_null(array);
+			dictionary_compressor_append_null(dictionary);
+			num_nulls++;
+			continue;
+		}
+
+		delta_delta_compressor_append_value(delta_delta, i < 300 ? i : i * i);
+		for_compressor_append_value(frame_of_reference, i < 300 ? -i : i % 37);
+		alp_compressor_append_value(alp, i < 700 ? i / 4.0 : i / 3.0);
+		gorilla_compressor_append_value(gorilla, double_get_bits(i < 700 ? i / 3 : i * 1.5));
+		array_compressor_append(array, CStringGetTextDatum(strings[i % 5]));
+		dictionary_compressor_append(dictionary, CStringGetTextDatum(strings[i % 5]));
+	}
+
+	test_decompress_all_matches_iterator(DirectFunctionCall1(tsl_deltadelta_compressor_finish,
+															 PointerGetDatum(delta_delta)),
+										 INT8OID,
+										 1015,
+										 num_nulls);
+	test_decompress_all_matches_iterator(PointerGetDatum(for_compressor_finish(frame_of_reference)),
+										 INT8OID,
+										 1015,
+										 num_nulls);
+	test_decompress_all_matches_iterator(PointerGetDatum(alp_compressor_finish(alp)),
+										 FLOAT8OID,
+										 1015,
+										 num_nulls);
+	test_decompress_all_matches_iterator(PointerGetDatum(gorilla_compressor_finish(gorilla)),
+										 FLOAT8OID,
+										 1015,
+										 num_nulls);
+	test_decompress_all_matches_iterator(PointerGetDatum(array_compressor_finish(array)),
+										 TEXTOID,
+										 1015,
+										 num_nulls);
+	test_decompress_all_matches_iterator(PointerGetDatum(dictionary_compressor_finish(dictionary)),
+										 TEXTOID,
+										 1015,
+										 num_nulls);
+}
+
+/*
+ * Block compression wraps array and dictionary compressed data and is
+ * transparent to decompression
+ */
+static void
+test_block_codec(CompressionBlockCodec codec)
+{
+	Compressor *compressors[2] = {
+		block_compressor_wrap(array_compressor_for_type(TEXTOID), codec),
+		block_compressor_wrap(dictionary_compressor_for_type(TEXTOID), codec),
+	};
+	char *strings[3] = { "INFO connection accepted from 10.0.0.1",
+						 "WARN connection reset by 10.0.0.2",
+						 "INFO connection closed by 10.0.0.1" };
+	int c;
+
+	for (c = 0; c < 2; c++)
+	{
+		Compressor *compressor = compressors[c];
+		CompressedDataHeader *header;
+		DecompressionIterator *iter;
+		int num_nulls = 0;
+		int i;
+
+		for (i = 0; i < 1015; i++)
+		{
+			if (i % 11 == 5)
+			{
+				compressor->append_null(compressor);
+				num_nulls++;
+				continue;
+			}
+			compressor->append_val(compressor, CStringGetTextDatum(strings[i * 7 % 3]));
+		}
+		header = compressor->finish(compressor);
+		TestAssertInt64Eq(header->compression_algorithm, COMPRESSION_ALGORITHM_BLOCK);
+		test_decompress_all_matches_iterator(PointerGetDatum(header), TEXTOID, 1015, num_nulls);
+
+		i = 1015;
+		iter = tsl_get_decompression_iterator_init(header->compression_algorithm,
+												   true)(PointerGetDatum(header), TEXTOID);
+		for (DecompressResult r = iter->try_next(iter); !r.is_done; r = iter->try_next(iter))
+		{
+			i--;
+			TestAssertTrue(r.is_null == (i % 11 == 5));
+			if (!r.is_null)
+				TestAssertTrue(strcmp(TextDatumGetCString(r.val), strings[i * 7 % 3]) == 0);
+		}
+		TestAssertInt64Eq(i, 0);
+
+		/* a block that does not get smaller is not written */
+		compressor->append_val(compressor, CStringGetTextDatum("a"));
+		header = compressor->finish(compressor);
+		TestAssertTrue(header->compression_algorithm != COMPRESSION_ALGORITHM_BLOCK);
+	}
+}
+
+static void
+test_block()
+{
+	CompressionBlockCodec codecs[2] = { COMPRESSION_BLOCK_CODEC_LZ4,
+										COMPRESSION_BLOCK_CODEC_ZSTD };
+	int i;
+
+	for (i = 0; i < 2; i++)
+	{
+		if (block_codec_is_available(codecs[i]))
+			test_block_codec(codecs[i]);
+		else
+			TestEnsureError(block_compressor_wrap(array_compressor_for_type(TEXTOID), codecs[i]));
+	}
+}
+
 Datum
 ts_test_compression(PG_FUNCTION_ARGS)
 {
@@ -430,6 +867,13 @@ ts_test_compression(PG_FUNCTION_ARGS)
 	test_gorilla_double();
 	test_delta();
 	test_delta2();
+	test_for();
+	test_delta_switches_to_for();
+	test_alp();
+	test_gorilla_switches_to_alp();
+	test_simple8brle_decompress_all();
+	test_decompress_all();
+	test_block();
 	PG_RETURN_VOID();
 }
 
@@ -488,7 +932,9 @@ ts_compress_table(PG_FUNCTION_ARGS)
 	compress_chunk(in_table,
 				   out_table,
 				   (const ColumnCompressionInfo **) compression_info->data,
-				   compression_info->num_elements);
+				   compression_info->num_elements,
+				   NULL,
+				   NULL);
 
 	PG_RETURN_VOID();
 }
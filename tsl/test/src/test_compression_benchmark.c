@@ -0,0 +1,580 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+/*
+ * Throughput benchmark of the compression algorithms.
+ *
+ * ts_compression_benchmark() generates data that looks like what is stored in
+ * hypertables, compresses it in batches the way compress_chunk does and
+ * decompresses it again with the forward and reverse iterators and the bulk
+ * decompression. It returns one row per data set, algorithm and operation, so
+ * that the results can be exported as CSV and compared between builds. The
+ * data is generated from a fixed seed, so the compressed sizes only change
+ * when the algorithms do.
+ */
+#include <postgres.h>
+
+#include <math.h>
+
+#include <access/htup_details.h>
+#include <catalog/pg_type.h>
+#include <fmgr.h>
+#include <funcapi.h>
+#include <portability/instr_time.h>
+#include <utils/builtins.h>
+#include <utils/memutils.h>
+#include <utils/timestamp.h>
+
+#include <export.h>
+
+#include "compression/compression.h"
+#include "compression/simple8b_rle.h"
+
+TS_FUNCTION_INFO_V1(ts_compression_benchmark);
+
+typedef enum BenchmarkData
+{
+	BENCHMARK_MONOTONIC_TIMESTAMPS,
+	BENCHMARK_JITTERED_TIMESTAMPS,
+	BENCHMARK_RANDOM_WALK_FLOATS,
+	BENCHMARK_LOW_CARDINALITY_STRINGS,
+	BENCHMARK_HIGH_CARDINALITY_STRINGS,
+	BENCHMARK_SMALL_INTEGERS,
+} BenchmarkData;
+
+typedef struct BenchmarkDataSet
+{
+	const char *name;
+	Oid type;
+} BenchmarkDataSet;
+
+static const BenchmarkDataSet benchmark_data_sets[] = {
+	[BENCHMARK_MONOTONIC_TIMESTAMPS] = { "monotonic timestamps", TIMESTAMPTZOID },
+	[BENCHMARK_JITTERED_TIMESTAMPS] = { "jittered timestamps", TIMESTAMPTZOID },
+	[BENCHMARK_RANDOM_WALK_FLOATS] = { "random walk floats", FLOAT8OID },
+	[BENCHMARK_LOW_CARDINALITY_STRINGS] = { "low cardinality strings", TEXTOID },
+	[BENCHMARK_HIGH_CARDINALITY_STRINGS] = { "high cardinality strings", TEXTOID },
+	/* the values are not datums, they go straight into simple8b */
+	[BENCHMARK_SMALL_INTEGERS] = { "small integers", INT8OID },
+};
+
+/* simple8b is not a compression algorithm of its own, it is used by all others */
+#define BENCHMARK_SIMPLE8B _INVALID_COMPRESSION_ALGORITHM
+
+typedef struct BenchmarkCase
+{
+	BenchmarkData data;
+	CompressionAlgorithms algorithm;
+} BenchmarkCase;
+
+static const BenchmarkCase benchmark_cases[] = {
+	{ BENCHMARK_MONOTONIC_TIMESTAMPS, COMPRESSION_ALGORITHM_DELTADELTA },
+	{ BENCHMARK_MONOTONIC_TIMESTAMPS, COMPRESSION_ALGORITHM_GORILLA },
+	{ BENCHMARK_MONOTONIC_TIMESTAMPS, COMPRESSION_ALGORITHM_ARRAY },
+	{ BENCHMARK_JITTERED_TIMESTAMPS, COMPRESSION_ALGORITHM_DELTADELTA },
+	{ BENCHMARK_JITTERED_TIMESTAMPS, COMPRESSION_ALGORITHM_GORILLA },
+	{ BENCHMARK_RANDOM_WALK_FLOATS, COMPRESSION_ALGORITHM_GORILLA },
+	{ BENCHMARK_RANDOM_WALK_FLOATS, COMPRESSION_ALGORITHM_ARRAY },
+	{ BENCHMARK_LOW_CARDINALITY_STRINGS, COMPRESSION_ALGORITHM_DICTIONARY },
+	{ BENCHMARK_LOW_CARDINALITY_STRINGS, COMPRESSION_ALGORITHM_ARRAY },
+	{ BENCHMARK_HIGH_CARDINALITY_STRINGS, COMPRESSION_ALGORITHM_DICTIONARY },
+	{ BENCHMARK_HIGH_CARDINALITY_STRINGS, COMPRESSION_ALGORITHM_ARRAY },
+	{ BENCHMARK_SMALL_INTEGERS, BENCHMARK_SIMPLE8B },
+};
+
+static const char *benchmark_algorithm_names[] = {
+	[BENCHMARK_SIMPLE8B] = "simple8b",
+	[COMPRESSION_ALGORITHM_ARRAY] = "array",
+	[COMPRESSION_ALGORITHM_DICTIONARY] = "dictionary",
+	[COMPRESSION_ALGORITHM_GORILLA] = "gorilla",
+	[COMPRESSION_ALGORITHM_DELTADELTA] = "deltadelta",
+	[COMPRESSION_ALGORITHM_FOR] = "for",
+	[COMPRESSION_ALGORITHM_ALP] = "alp",
+	[COMPRESSION_ALGORITHM_BLOCK] = "block",
+	[COMPRESSION_ALGORITHM_SHARED_DICTIONARY] = "shared dictionary",
+};
+
+typedef enum BenchmarkOperation
+{
+	BENCHMARK_COMPRESS,
+	BENCHMARK_DECOMPRESS_FORWARD,
+	BENCHMARK_DECOMPRESS_REVERSE,
+	BENCHMARK_DECOMPRESS_ALL,
+	_BENCHMARK_NUM_OPERATIONS,
+} BenchmarkOperation;
+
+static const char *benchmark_operation_names[] = {
+	[BENCHMARK_COMPRESS] = "compress",
+	[BENCHMARK_DECOMPRESS_FORWARD] = "decompress forward",
+	[BENCHMARK_DECOMPRESS_REVERSE] = "decompress reverse",
+	[BENCHMARK_DECOMPRESS_ALL] = "decompress all",
+};
+
+typedef struct BenchmarkResult
+{
+	const BenchmarkCase *benchmark_case;
+	BenchmarkOperation operation;
+	/* the algorithm the batches ended up with, the compressors may switch */
+	const char *stored_algorithm;
+	int64 uncompressed_bytes;
+	int64 compressed_bytes;
+	/* the fastest of all iterations */
+	double seconds;
+} BenchmarkResult;
+
+typedef struct BenchmarkState
+{
+	BenchmarkResult *results;
+	int num_results;
+	int next;
+	int64 num_values;
+} BenchmarkState;
+
+/*
+ * The data of a benchmark. The small integers for simple8b are stored as
+ * they are, all other data as datums.
+ */
+typedef struct BenchmarkInput
+{
+	Oid type;
+	int64 num_values;
+	Datum *datums;
+	uint64 *integers;
+	int64 uncompressed_bytes;
+} BenchmarkInput;
+
+/* xorshift64, so that every run compresses the same data */
+static uint64
+benchmark_random(uint64 *state)
+{
+	uint64 x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+/* uniformly distributed in [0, 1) */
+static double
+benchmark_random_double(uint64 *state)
+{
+	return (benchmark_random(state) >> 11) * (1.0 / (double) (UINT64CONST(1) << 53));
+}
+
+static void
+benchmark_generate(BenchmarkInput *input, BenchmarkData data, int64 num_values)
+{
+	/* 2020-01-01 00:00:00+00 in microseconds since the PostgreSQL epoch */
+	const int64 start = INT64CONST(631152000000000);
+	const int64 interval = INT64CONST(10000000);
+	uint64 state = UINT64CONST(0x9E3779B97F4A7C15);
+	double walk = 100.0;
+	int64 i;
+
+	*input = (BenchmarkInput){
+		.type = benchmark_data_sets[data].type,
+		.num_values = num_values,
+	};
+
+	if (data == BENCHMARK_SMALL_INTEGERS)
+		input->integers = palloc(sizeof(uint64) * num_values);
+	else
+		input->datums = palloc(sizeof(Datum) * num_values);
+
+	for (i = 0; i < num_values; i++)
+	{
+		switch (data)
+		{
+			case BENCHMARK_MONOTONIC_TIMESTAMPS:
+				input->datums[i] = TimestampTzGetDatum(start + i * interval);
+				break;
+			case BENCHMARK_JITTERED_TIMESTAMPS:
+			{
+				/* up to half a second early or late */
+				int64 jitter = (int64) ((benchmark_random_double(&state) - 0.5) * 1000000);
+
+				input->datums[i] = TimestampTzGetDatum(start + i * interval + jitter);
+				break;
+			}
+			case BENCHMARK_RANDOM_WALK_FLOATS:
+				/* sensors report a fixed number of digits */
+				walk += benchmark_random_double(&state) - 0.5;
+				input->datums[i] = Float8GetDatum(round(walk * 1000) / 1000);
+				break;
+			case BENCHMARK_LOW_CARDINALITY_STRINGS:
+				input->datums[i] = CStringGetTextDatum(
+					psprintf("device_%d", (int) (benchmark_random(&state) % 16)));
+				break;
+			case BENCHMARK_HIGH_CARDINALITY_STRINGS:
+				input->datums[i] = CStringGetTextDatum(
+					psprintf("%016" INT64_MODIFIER "x", benchmark_random(&state)));
+				break;
+			case BENCHMARK_SMALL_INTEGERS:
+				input->integers[i] = benchmark_random(&state) % 16;
+				break;
+		}
+
+		if (input->type == TEXTOID)
+			input->uncompressed_bytes += VARSIZE_ANY_EXHDR(DatumGetPointer(input->datums[i]));
+		else
+			input->uncompressed_bytes += sizeof(int64);
+	}
+}
+
+static double
+benchmark_elapsed(instr_time start)
+{
+	instr_time duration;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	return INSTR_TIME_GET_DOUBLE(duration);
+}
+
+static void
+benchmark_check_num_values(const BenchmarkCase *benchmark_case, BenchmarkOperation operation,
+						   int64 expected, int64 actual)
+{
+	if (expected != actual)
+		elog(ERROR,
+			 "%s of %s with %s returned " INT64_FORMAT " values instead of " INT64_FORMAT,
+			 benchmark_operation_names[operation],
+			 benchmark_data_sets[benchmark_case->data].name,
+			 benchmark_algorithm_names[benchmark_case->algorithm],
+			 actual,
+			 expected);
+}
+
+/*
+ * Run one operation over all batches and return how long it took. The
+ * compressed batches are (re)created by BENCHMARK_COMPRESS.
+ */
+static double
+benchmark_run_datums(const BenchmarkCase *benchmark_case, BenchmarkOperation operation,
+					 BenchmarkInput *input, int batch_size, Datum *batches, int num_batches,
+					 MemoryContext batch_ctx)
+{
+	DecompressedBatch *(*decompress_all)(Datum, Oid) = NULL;
+	int64 num_values = 0;
+	instr_time start;
+	int batch;
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (batch = 0; batch < num_batches; batch++)
+	{
+		CompressionAlgorithms stored_algorithm;
+		DecompressionIterator *(*iterator_init)(Datum, Oid);
+		DecompressionIterator *iter;
+		Compressor *compressor;
+		MemoryContext old_ctx;
+		int64 row;
+
+		if (operation == BENCHMARK_COMPRESS)
+		{
+			int64 end = Min(input->num_values, (int64) (batch + 1) * batch_size);
+
+			compressor =
+				compressor_for_algorithm_and_type(benchmark_case->algorithm, input->type);
+			for (row = (int64) batch * batch_size; row < end; row++)
+				compressor->append_val(compressor, input->datums[row]);
+			batches[batch] = PointerGetDatum(compressor->finish(compressor));
+			num_values += end - (int64) batch * batch_size;
+			continue;
+		}
+
+		/* the decompressed values only live until the next batch */
+		old_ctx = MemoryContextSwitchTo(batch_ctx);
+		stored_algorithm = ((CompressedDataHeader *) DatumGetPointer(batches[batch]))
+							   ->compression_algorithm;
+		switch (operation)
+		{
+			case BENCHMARK_DECOMPRESS_FORWARD:
+			case BENCHMARK_DECOMPRESS_REVERSE:
+				iterator_init =
+					tsl_get_decompression_iterator_init(stored_algorithm,
+														operation == BENCHMARK_DECOMPRESS_REVERSE);
+				iter = iterator_init(batches[batch], input->type);
+				for (DecompressResult r = iter->try_next(iter); !r.is_done;
+					 r = iter->try_next(iter))
+					num_values++;
+				break;
+			case BENCHMARK_DECOMPRESS_ALL:
+				decompress_all = tsl_get_decompress_all_function(stored_algorithm);
+				if (decompress_all != NULL)
+					num_values += decompress_all(batches[batch], input->type)->num_rows;
+				break;
+			default:
+				pg_unreachable();
+		}
+		MemoryContextSwitchTo(old_ctx);
+		MemoryContextReset(batch_ctx);
+
+		/* no bulk decompression for this algorithm */
+		if (operation == BENCHMARK_DECOMPRESS_ALL && decompress_all == NULL)
+			return -1;
+	}
+
+	benchmark_check_num_values(benchmark_case, operation, input->num_values, num_values);
+	return benchmark_elapsed(start);
+}
+
+static double
+benchmark_run_simple8b(const BenchmarkCase *benchmark_case, BenchmarkOperation operation,
+					   BenchmarkInput *input, int batch_size, Simple8bRleSerialized **batches,
+					   int num_batches, MemoryContext batch_ctx)
+{
+	Simple8bRleDecompressionIterator iter;
+	int64 num_values = 0;
+	instr_time start;
+	int batch;
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (batch = 0; batch < num_batches; batch++)
+	{
+		Simple8bRleCompressor compressor;
+		MemoryContext old_ctx;
+		int64 row;
+
+		if (operation == BENCHMARK_COMPRESS)
+		{
+			int64 end = Min(input->num_values, (int64) (batch + 1) * batch_size);
+
+			simple8brle_compressor_init(&compressor);
+			for (row = (int64) batch * batch_size; row < end; row++)
+				simple8brle_compressor_append(&compressor, input->integers[row]);
+			batches[batch] = simple8brle_compressor_finish(&compressor);
+			num_values += end - (int64) batch * batch_size;
+			continue;
+		}
+
+		old_ctx = MemoryContextSwitchTo(batch_ctx);
+		switch (operation)
+		{
+			case BENCHMARK_DECOMPRESS_FORWARD:
+				simple8brle_decompression_iterator_init_forward(&iter, batches[batch]);
+				for (Simple8bRleDecompressResult r =
+						 simple8brle_decompression_iterator_try_next_forward(&iter);
+					 !r.is_done;
+					 r = simple8brle_decompression_iterator_try_next_forward(&iter))
+					num_values++;
+				break;
+			case BENCHMARK_DECOMPRESS_REVERSE:
+				simple8brle_decompression_iterator_init_reverse(&iter, batches[batch]);
+				for (Simple8bRleDecompressResult r =
+						 simple8brle_decompression_iterator_try_next_reverse(&iter);
+					 !r.is_done;
+					 r = simple8brle_decompression_iterator_try_next_reverse(&iter))
+					num_values++;
+				break;
+			case BENCHMARK_DECOMPRESS_ALL:
+				simple8brle_decompress_all(batches[batch]);
+				num_values += batches[batch]->num_elements;
+				break;
+			default:
+				pg_unreachable();
+		}
+		MemoryContextSwitchTo(old_ctx);
+		MemoryContextReset(batch_ctx);
+	}
+
+	benchmark_check_num_values(benchmark_case, operation, input->num_values, num_values);
+	return benchmark_elapsed(start);
+}
+
+static const char *
+benchmark_stored_algorithm(Datum *batches, int num_batches)
+{
+	CompressionAlgorithms algorithm =
+		((CompressedDataHeader *) DatumGetPointer(batches[0]))->compression_algorithm;
+	int batch;
+
+	for (batch = 1; batch < num_batches; batch++)
+	{
+		if (((CompressedDataHeader *) DatumGetPointer(batches[batch]))->compression_algorithm !=
+			algorithm)
+			return "mixed";
+	}
+	return benchmark_algorithm_names[algorithm];
+}
+
+static void
+benchmark_case_run(const BenchmarkCase *benchmark_case, int64 num_values, int iterations,
+				   int batch_size, BenchmarkResult *results)
+{
+	MemoryContext case_ctx = AllocSetContextCreate(CurrentMemoryContext,
+												   "compression benchmark",
+												   ALLOCSET_DEFAULT_SIZES);
+	MemoryContext batch_ctx =
+		AllocSetContextCreate(case_ctx, "compression benchmark batch", ALLOCSET_DEFAULT_SIZES);
+	MemoryContext old_ctx = MemoryContextSwitchTo(case_ctx);
+	int num_batches = (num_values + batch_size - 1) / batch_size;
+	bool is_simple8b = benchmark_case->algorithm == BENCHMARK_SIMPLE8B;
+	Datum *batches = palloc0(sizeof(Datum) * num_batches);
+	Simple8bRleSerialized **simple8b_batches = palloc0(sizeof(*simple8b_batches) * num_batches);
+	const char *stored_algorithm = benchmark_algorithm_names[benchmark_case->algorithm];
+	int64 compressed_bytes = 0;
+	BenchmarkInput input;
+	BenchmarkOperation operation;
+	int batch;
+
+	benchmark_generate(&input, benchmark_case->data, num_values);
+
+	for (operation = 0; operation < _BENCHMARK_NUM_OPERATIONS; operation++)
+	{
+		double best = -1;
+		int i;
+
+		for (i = 0; i < iterations; i++)
+		{
+			double seconds;
+
+			CHECK_FOR_INTERRUPTS();
+			if (is_simple8b)
+				seconds = benchmark_run_simple8b(benchmark_case,
+												 operation,
+												 &input,
+												 batch_size,
+												 simple8b_batches,
+												 num_batches,
+												 batch_ctx);
+			else
+				seconds = benchmark_run_datums(benchmark_case,
+											   operation,
+											   &input,
+											   batch_size,
+											   batches,
+											   num_batches,
+											   batch_ctx);
+			if (seconds >= 0 && (best < 0 || seconds < best))
+				best = seconds;
+		}
+
+		if (operation == BENCHMARK_COMPRESS)
+		{
+			for (batch = 0; batch < num_batches; batch++)
+				compressed_bytes += is_simple8b ?
+										simple8brle_serialized_total_size(simple8b_batches[batch]) :
+										VARSIZE(DatumGetPointer(batches[batch]));
+			if (!is_simple8b)
+				stored_algorithm = benchmark_stored_algorithm(batches, num_batches);
+		}
+
+		results[operation] = (BenchmarkResult){
+			.benchmark_case = benchmark_case,
+			.operation = operation,
+			.stored_algorithm = stored_algorithm,
+			.uncompressed_bytes = input.uncompressed_bytes,
+			.compressed_bytes = compressed_bytes,
+			.seconds = best,
+		};
+	}
+
+	MemoryContextSwitchTo(old_ctx);
+	MemoryContextDelete(case_ctx);
+}
+
+static BenchmarkState *
+benchmark_run(int64 num_values, int iterations, int batch_size)
+{
+	int num_cases = lengthof(benchmark_cases);
+	BenchmarkState *state = palloc0(sizeof(*state));
+	int i;
+
+	state->num_values = num_values;
+	state->num_results = num_cases * _BENCHMARK_NUM_OPERATIONS;
+	state->results = palloc0(sizeof(BenchmarkResult) * state->num_results);
+
+	for (i = 0; i < num_cases; i++)
+		benchmark_case_run(&benchmark_cases[i],
+						   num_values,
+						   iterations,
+						   batch_size,
+						   &state->results[i * _BENCHMARK_NUM_OPERATIONS]);
+
+	return state;
+}
+
+/*
+ * ts_compression_benchmark(benchmark_values INT, iterations INT, batch_size INT)
+ *
+ * Returns (data, algorithm, stored_algorithm, operation, num_values,
+ * uncompressed_bytes, compressed_bytes, seconds, mb_per_second,
+ * values_per_second) for every benchmark. The throughput is relative to the
+ * uncompressed size and the time is the fastest of all iterations. The timing
+ * columns are NULL if an operation is not supported by the algorithm.
+ */
+Datum
+ts_compression_benchmark(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *funcctx;
+	BenchmarkState *state;
+	BenchmarkResult *result;
+	Datum values[10];
+	bool nulls[10] = { false };
+	HeapTuple tuple;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		int32 num_values = PG_GETARG_INT32(0);
+		int32 iterations = PG_GETARG_INT32(1);
+		int32 batch_size = PG_GETARG_INT32(2);
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+
+		if (num_values <= 0 || iterations <= 0 || batch_size <= 0 ||
+			batch_size > COMPRESSION_MAX_BATCH_SIZE)
+			elog(ERROR, "invalid compression benchmark parameters");
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("function returning record called in context "
+							"that cannot accept type record")));
+
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+		funcctx->user_fctx = benchmark_run(num_values, iterations, batch_size);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	state = funcctx->user_fctx;
+
+	if (state->next >= state->num_results)
+		SRF_RETURN_DONE(funcctx);
+
+	result = &state->results[state->next++];
+
+	values[0] = CStringGetTextDatum(benchmark_data_sets[result->benchmark_case->data].name);
+	values[1] = CStringGetTextDatum(benchmark_algorithm_names[result->benchmark_case->algorithm]);
+	values[2] = CStringGetTextDatum(result->stored_algorithm);
+	values[3] = CStringGetTextDatum(benchmark_operation_names[result->operation]);
+	values[4] = Int64GetDatum(state->num_values);
+	values[5] = Int64GetDatum(result->uncompressed_bytes);
+	values[6] = Int64GetDatum(result->compressed_bytes);
+	if (result->seconds < 0)
+	{
+		nulls[7] = true;
+		nulls[8] = true;
+		nulls[9] = true;
+	}
+	else
+	{
+		/* do not divide by zero for operations too fast to measure */
+		double seconds = Max(result->seconds, 1e-9);
+
+		values[7] = Float8GetDatum(result->seconds);
+		values[8] = Float8GetDatum(result->uncompressed_bytes / (1024.0 * 1024.0) / seconds);
+		values[9] = Float8GetDatum(state->num_values / seconds);
+	}
+
+	tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+	SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+}